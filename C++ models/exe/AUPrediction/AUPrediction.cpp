@@ -325,6 +325,159 @@ void get_image_input_output_params_feats(vector<vector<string> > &input_image_fi
 
 }
 
+// Writes out the AU predictions ordered by AU name. Text files keep one AU per line (the name followed by
+// the per frame predictions), the binary formats have a row per frame and a column per AU
+void output_AU_predictions(const string& filename, const vector<string>& au_names, const vector<vector<double> >& predictions)
+{
+	vector<size_t> order(au_names.size());
+	for(size_t au = 0; au < order.size(); ++au)
+	{
+		order[au] = au;
+	}
+	std::stable_sort(order.begin(), order.end(), [&au_names](size_t a, size_t b) { return au_names[a] < au_names[b]; });
+
+	if(CLMTracker::OutputFormatFromFilename(filename) == CLMTracker::OUTPUT_TEXT)
+	{
+		std::ofstream au_output_file(filename, ios_base::out);
+		for(size_t i = 0; i < order.size(); ++i)
+		{
+			au_output_file << au_names[order[i]];
+			for(size_t frame = 0; frame < predictions[order[i]].size(); ++frame)
+			{
+				au_output_file << " " << predictions[order[i]][frame];
+			}
+			au_output_file << "\n";
+		}
+		au_output_file.close();
+	}
+	else
+	{
+		vector<string> columns;
+		for(size_t i = 0; i < order.size(); ++i)
+		{
+			columns.push_back(au_names[order[i]]);
+		}
+		unique_ptr<CLMTracker::OutputSink> au_output_file = CLMTracker::OpenOutputSink(filename, columns);
+		if(!au_output_file)
+		{
+			ERROR_STREAM( "Could not open the output file " << filename );
+			return;
+		}
+
+		size_t num_frames = order.empty() ? 0 : predictions[order[0]].size();
+		vector<double> output_row(order.size());
+		for(size_t frame = 0; frame < num_frames; ++frame)
+		{
+			for(size_t i = 0; i < order.size(); ++i)
+			{
+				output_row[i] = predictions[order[i]][frame];
+			}
+			au_output_file->WriteRow(output_row);
+		}
+		au_output_file->Close();
+	}
+}
+
+// The per frame results of a segment that are needed for the AU prediction
+struct SegmentDescriptors
+{
+	vector<Vec6d> params_global;
+	vector<bool> successes;
+	vector<Mat_<double>> params_local;
+	vector<Mat_<double>> detected_landmarks;
+	vector<Mat_<double>> hog_descriptors;
+	vector<Mat_<double>> geom_descriptors;
+};
+
+// Tracks and analyses the segments of an input in parallel, each segment has its own tracker and its own analyser (copied from a fresh
+// one) that are warmed up on the frames before it. The results of the segment frames are appended to the per frame vectors in the
+// order of the segments, segment_starts receives the index of the first frame of every segment in them. If the segments are the chunks of a
+// whole input (merge_analysers), the analysers only see their own frames and are merged into a single one that starts at the first frame
+bool analyse_segments(const vector<CLMTracker::FrameSegment>& segments, int warmup_frames, const CLMTracker::OpenSourceFunction& open_source, const CLMTracker::CLM& clm_model,
+	const CLMTracker::CLMParameters& clm_parameters, bool track_as_video, double scaling, const Psyche::FaceAnalyser& analyser_prototype, bool merge_analysers, vector<Psyche::FaceAnalyser>& segment_analysers,
+	vector<size_t>& segment_starts, vector<Vec6d>& params_global_video, vector<bool>& successes_video, vector<Mat_<double>>& params_local_video, vector<Mat_<double>>& detected_landmarks_video,
+	vector<Mat_<double>>& hog_descriptors, vector<Mat_<double>>& geom_descriptors)
+{
+	segment_analysers.assign(segments.size(), analyser_prototype);
+	vector<SegmentDescriptors> segment_descriptors(segments.size());
+
+	bool success = CLMTracker::ProcessFrameSegments(segments, warmup_frames, open_source, clm_model, clm_parameters,
+		[&](int segment, int /*frame*/, bool in_segment, Mat& captured_image, Mat_<uchar>& grayscale_image, CLMTracker::CLM& segment_model, CLMTracker::CLMParameters& segment_parameters)
+	{
+		if(scaling != 1.0)
+		{
+			cv::resize(captured_image, captured_image, Size(), scaling, scaling);
+			cv::resize(grayscale_image, grayscale_image, Size(), scaling, scaling);
+		}
+
+		bool detection_success;
+		if(track_as_video)
+		{
+			detection_success = CLMTracker::DetectLandmarksInVideo(grayscale_image, segment_model, segment_parameters);
+		}
+		else
+		{
+			detection_success = CLMTracker::DetectLandmarksInImage(grayscale_image, segment_model, segment_parameters);
+		}
+
+		// The warm-up frames only update the tracker and the running medians of the analyser (the ones of chunks are seen by the analyser of the chunk before)
+		if(!in_segment && merge_analysers)
+		{
+			return;
+		}
+
+		Psyche::FaceAnalyser& face_analyser = segment_analysers[segment];
+		face_analyser.AddNextFrame(captured_image, segment_model, 0, false);
+
+		if(!in_segment)
+		{
+			return;
+		}
+
+		SegmentDescriptors& descriptors = segment_descriptors[segment];
+		descriptors.params_global.push_back(segment_model.params_global);
+		descriptors.params_local.push_back(segment_model.params_local.clone());
+		descriptors.successes.push_back(detection_success);
+		descriptors.detected_landmarks.push_back(segment_model.detected_landmarks.clone());
+
+		Mat_<double> hog_descriptor;
+		int num_hog_rows, num_hog_cols;
+		face_analyser.GetLatestHOG(hog_descriptor, num_hog_rows, num_hog_cols);
+		descriptors.hog_descriptors.push_back(hog_descriptor.clone());
+
+		Mat_<double> geom_desc;
+		face_analyser.GetGeomDescriptor(geom_desc);
+		descriptors.geom_descriptors.push_back(geom_desc);
+	});
+
+	// Stitching the segments together in order
+	for(size_t segment = 0; segment < segments.size(); ++segment)
+	{
+		const SegmentDescriptors& descriptors = segment_descriptors[segment];
+
+		segment_starts.push_back(params_global_video.size());
+		params_global_video.insert(params_global_video.end(), descriptors.params_global.begin(), descriptors.params_global.end());
+		successes_video.insert(successes_video.end(), descriptors.successes.begin(), descriptors.successes.end());
+		params_local_video.insert(params_local_video.end(), descriptors.params_local.begin(), descriptors.params_local.end());
+		detected_landmarks_video.insert(detected_landmarks_video.end(), descriptors.detected_landmarks.begin(), descriptors.detected_landmarks.end());
+		hog_descriptors.insert(hog_descriptors.end(), descriptors.hog_descriptors.begin(), descriptors.hog_descriptors.end());
+		geom_descriptors.insert(geom_descriptors.end(), descriptors.geom_descriptors.begin(), descriptors.geom_descriptors.end());
+	}
+
+	// The merged analyser has the medians of the whole input, as the one of a serial run does
+	if(merge_analysers && !segment_analysers.empty())
+	{
+		for(size_t segment = 1; segment < segment_analysers.size(); ++segment)
+		{
+			segment_analysers[0].MergeMedians(segment_analysers[segment]);
+		}
+		segment_analysers.erase(segment_analysers.begin() + 1, segment_analysers.end());
+		segment_starts.erase(segment_starts.begin() + 1, segment_starts.end());
+	}
+
+	return success;
+}
+
 int main (int argc, char **argv)
 {
 	
@@ -345,6 +498,12 @@ int main (int argc, char **argv)
     float fx = 500, fy = 500, cx = 0, cy = 0;
 			
 	CLMTracker::CLMParameters clm_parameters(arguments);
+
+	// Per stage timings (-profile <file.json>) and Chrome trace (-trace <file.json>)
+	CLMTracker::Profiler::Configure(clm_parameters.profile_location, clm_parameters.trace_location);
+
+	// In quiet (headless) mode nothing is drawn or shown and no keys are polled
+	bool visualise = !clm_parameters.quiet_mode;
 			
 	// Get the input output file parameters
 	
@@ -373,6 +532,17 @@ int main (int argc, char **argv)
 	}
 	// Get camera parameters
 	CLMTracker::get_camera_params(device, fx, fy, cx, cy, arguments);    
+
+	// Raw luma frames from a file or a pipe instead of a video (-raw <width> <height>)
+	int raw_width, raw_height, raw_chroma_bytes;
+	CLMTracker::get_raw_input_params(raw_width, raw_height, raw_chroma_bytes, arguments);
+
+	// Only parts of the inputs can be processed, given as segment lists (-segs <file>) or by -bf and -ef, or whole inputs can be
+	// split into chunks that are tracked in parallel (-chunks <n>)
+	vector<string> segment_files;
+	int num_chunks = 1;
+	int warmup_frames = -1;
+	CLMTracker::get_segment_params(segment_files, num_chunks, warmup_frames, arguments);
 	
 	if(!boost::filesystem::exists(path(clm_parameters.model_location)))
 	{
@@ -405,6 +575,17 @@ int main (int argc, char **argv)
 	vector<int> beg_frames;
 	vector<int> end_frames;
 
+	// Compare the single precision AU predictions to the double precision models (fails if they drift apart)
+	bool check_precision = false;
+	double precision_tolerance = 0.001;
+	for(size_t i = 0; i < arguments.size(); ++i)
+	{
+		if(arguments[i].compare("-check_precision") == 0)
+		{
+			check_precision = true;
+		}
+	}
+
 	get_output_feature_params(face_analyser_loc, output_aus_class, output_aus_reg, output_aus_reg_segmented, sim_scale, sim_size, scaling, video_output, grayscale, rigid, beg_frames, end_frames, arguments);
 
 	if(!boost::filesystem::exists(path(face_analyser_loc)))
@@ -418,6 +599,10 @@ int main (int argc, char **argv)
 	vector<Vec3d> orientations = vector<Vec3d>();
 	orientations.push_back(Vec3d(0.0,0.0,0.0));
 	Psyche::FaceAnalyser face_analyser(orientations, sim_scale, sim_size, sim_size, face_analyser_loc, face_analyser_loc_av, tri_location);
+	face_analyser.SetPrecisionCheck(check_precision);
+
+	// The segments get their own analysers, copied from this fresh one so that they share the models but none of the running state
+	Psyche::FaceAnalyser segment_analyser_prototype(face_analyser);
 
 	// Will warp to scaled mean shape
 	Mat_<double> similarity_normalised_shape = clm_model.pdm.mean_shape * sim_scale;
@@ -427,7 +612,6 @@ int main (int argc, char **argv)
 	// If multiple video files are tracked, use this to indicate if we are done
 	bool done = false;	
 	int f_n = -1;
-	int curr_img = -1;
 
 	// If cx (optical axis centre) is undefined will use the image size/2 as an estimate
 	bool cx_undefined = false;
@@ -448,14 +632,20 @@ int main (int argc, char **argv)
 	vector<vector<Mat_<double>>> hog_descriptors;
 	vector<vector<Mat_<double>>> geom_descriptors;
 
+	// When segments are used, the analysers of the segments and where each one starts in the frames above
+	vector<vector<Psyche::FaceAnalyser>> segment_analysers;
+	vector<vector<size_t>> segment_starts;
+
 	while(!done) // this is not a for loop as we might also be reading from a webcam
 	{
 		
 		string current_file;
 		
-		VideoCapture video_capture;
+		// Both the videos and the image sequences are decoded (and converted to grayscale) ahead on a background thread
+		CLMTracker::FrameSource frame_source;
 		
 		Mat captured_image;
+		Mat_<uchar> grayscale_image;
 
 		params_global_video.push_back(vector<Vec6d>());
 		successes_video.push_back(vector<bool>());
@@ -465,6 +655,9 @@ int main (int argc, char **argv)
 		hog_descriptors.push_back(vector<Mat_<double>>());
 		geom_descriptors.push_back(vector<Mat_<double>>());
 
+		segment_analysers.push_back(vector<Psyche::FaceAnalyser>());
+		segment_starts.push_back(vector<size_t>());
+
 		if(video)
 		{
 			// We might specify multiple video files as arguments
@@ -482,31 +675,23 @@ int main (int argc, char **argv)
 			if( current_file.size() > 0 )
 			{
 				INFO_STREAM( "Attempting to read from file: " << current_file );
-				video_capture = VideoCapture( current_file );
 			}
 			else
 			{
 				INFO_STREAM( "Attempting to capture from device: " << device );
-				video_capture = VideoCapture( device );
-
-				// Read a first frame often empty in camera
-				Mat captured_image;
-				video_capture >> captured_image;
 			}
 
-			if( !video_capture.isOpened() ) FATAL_STREAM( "Failed to open video source" );
+			if( !frame_source.Open(current_file, device, raw_width, raw_height, raw_chroma_bytes) ) FATAL_STREAM( "Failed to open video source" );
 			else INFO_STREAM( "Device or file opened");
 
-			video_capture >> captured_image;	
+			frame_source.Read(captured_image, grayscale_image);
 		}
 		else
 		{
 			f_n++;	
-			curr_img++;
-			if(!input_image_files[f_n].empty())
+			if(frame_source.OpenImageSequence(input_image_files[f_n]))
 			{
-				string curr_img_file = input_image_files[f_n][curr_img];
-				captured_image = imread(curr_img_file, -1);
+				frame_source.Read(captured_image, grayscale_image);
 			}
 			else
 			{
@@ -522,6 +707,68 @@ int main (int argc, char **argv)
 			cy = captured_image.rows / 2.0f;
 		}
 	
+		// Every segment (or chunk) opens the input again and seeks in it, which cameras and pipes (including the standard input) can not do
+		vector<CLMTracker::FrameSegment> segments;
+		bool chunked = false;
+		if((f_n < (int)segment_files.size() || num_chunks > 1) && !frame_source.IsSeekable())
+		{
+			ERROR_STREAM( "Segments and chunks need an input that can be seeked in (a video file, an image sequence or a raw file), not a camera or a pipe" );
+			return 1;
+		}
+
+		if(f_n < (int)segment_files.size())
+		{
+			if(!CLMTracker::ReadFrameSegments(segment_files[f_n], segments) || segments.empty())
+			{
+				FATAL_STREAM( "No valid segments in " + segment_files[f_n] );
+			}
+		}
+		else if((!beg_frames.empty() || !end_frames.empty()) && frame_source.IsSeekable())
+		{
+			// Otherwise the frames before the beginning are read and skipped
+			segments.push_back(CLMTracker::FrameSegment(beg_frames.empty() ? 0 : beg_frames[f_n], end_frames.empty() ? -1 : end_frames[f_n]));
+		}
+		else if(num_chunks > 1)
+		{
+			// A whole input split into chunks is stitched back together as if it was tracked in one go
+			if(frame_source.GetFrameCount() > 0)
+			{
+				segments = CLMTracker::SplitIntoChunks(frame_source.GetFrameCount(), num_chunks);
+				chunked = true;
+			}
+			else
+			{
+				WARN_STREAM( "The length of the input is not known, so it is not split into chunks" );
+			}
+		}
+
+		// The segments are seeked to and tracked in parallel, instead of the input being read from the start
+		if(!segments.empty())
+		{
+			INFO_STREAM( "Tracking " << segments.size() << (chunked ? " chunks" : " segments"));
+
+			// Unless given, the tracker is warmed up for a few seconds of the input (the analysers of chunks are merged, so only the ones of segments need it)
+			int segment_warmup_frames = warmup_frames < 0 ? CLMTracker::DefaultWarmupFrames(frame_source.GetFPS()) : warmup_frames;
+
+			frame_source.Close();
+			captured_image = Mat();
+
+			CLMTracker::OpenSourceFunction open_source = [&](CLMTracker::FrameSource& segment_source)
+			{
+				if(video)
+				{
+					return segment_source.Open(current_file, device, raw_width, raw_height, raw_chroma_bytes);
+				}
+				return segment_source.OpenImageSequence(input_image_files[f_n]);
+			};
+
+			if(!analyse_segments(segments, segment_warmup_frames, open_source, clm_model, clm_parameters, video || images_as_video, scaling, segment_analyser_prototype, chunked, segment_analysers[f_n], segment_starts[f_n],
+				params_global_video[f_n], successes_video[f_n], params_local_video[f_n], detected_landmarks_video[f_n], hog_descriptors[f_n], geom_descriptors[f_n]))
+			{
+				WARN_STREAM( "Some of the segments could not be read" );
+			}
+		}
+
 		int frame_count = 0;
 		
 		// For measuring the timings
@@ -533,21 +780,11 @@ int main (int argc, char **argv)
 		{		
 			if(beg_frames.empty() || frame_count >= beg_frames[f_n])
 			{				
+				// The grayscale version of the image comes from the frame source, so both have to be scaled
 				if(scaling != 1.0)
 				{
 					cv::resize(captured_image, captured_image, Size(), scaling, scaling);
-				}
-
-				// Reading the images
-				Mat_<uchar> grayscale_image;
-
-				if(captured_image.channels() == 3)
-				{
-					cvtColor(captured_image, grayscale_image, CV_BGR2GRAY);				
-				}
-				else
-				{
-					grayscale_image = captured_image.clone();				
+					cv::resize(grayscale_image, grayscale_image, Size(), scaling, scaling);
 				}
 		
 				// The actual facial landmark detection / tracking
@@ -596,95 +833,76 @@ int main (int argc, char **argv)
 				//Psyche::Visualise_FHOG(hog_descriptor, num_hog_rows, num_hog_cols, hog_descriptor_vis);
 				//cv::imshow("hog", hog_descriptor_vis);	
 
-				// Work out the pose of the head from the tracked model
-				Vec6d pose_estimate_CLM;
-				if(use_camera_plane_pose)
+				if(visualise)
 				{
-					pose_estimate_CLM = CLMTracker::GetCorrectedPoseCameraPlane(clm_model, fx, fy, cx, cy, clm_parameters);
-				}
-				else
-				{
-					pose_estimate_CLM = CLMTracker::GetCorrectedPoseCamera(clm_model, fx, fy, cx, cy, clm_parameters);
-				}
-
-				// Visualising the results
-				// Drawing the facial landmarks on the face and the bounding box around it if tracking is successful and initialised
-				double detection_certainty = clm_model.detection_certainty;
+					// Visualising the results
+					// Drawing the facial landmarks on the face and the bounding box around it if tracking is successful and initialised
+					double detection_certainty = clm_model.detection_certainty;
 
-				double visualisation_boundary = 0.2;
+					double visualisation_boundary = 0.2;
 			
-				// Only draw if the reliability is reasonable, the value is slightly ad-hoc
-				if(detection_certainty < visualisation_boundary)
-				{
-					CLMTracker::Draw(captured_image, clm_model);
-					//CLMTracker::Draw(captured_image, clm_model);
+					// Only draw if the reliability is reasonable, the value is slightly ad-hoc
+					if(detection_certainty < visualisation_boundary)
+					{
+						CLMTracker::Draw(captured_image, clm_model);
+						//CLMTracker::Draw(captured_image, clm_model);
 
-					if(detection_certainty > 1)
-						detection_certainty = 1;
-					if(detection_certainty < -1)
-						detection_certainty = -1;
+						if(detection_certainty > 1)
+							detection_certainty = 1;
+						if(detection_certainty < -1)
+							detection_certainty = -1;
 
-					detection_certainty = (detection_certainty + 1)/(visualisation_boundary +1);
+						detection_certainty = (detection_certainty + 1)/(visualisation_boundary +1);
 
-					// A rough heuristic for box around the face width
-					int thickness = (int)std::ceil(2.0* ((double)captured_image.cols) / 640.0);
+						// A rough heuristic for box around the face width
+						int thickness = (int)std::ceil(2.0* ((double)captured_image.cols) / 640.0);
 				
-					Vec6d pose_estimate_to_draw = CLMTracker::GetCorrectedPoseCameraPlane(clm_model, fx, fy, cx, cy, clm_parameters);
+						Vec6d pose_estimate_to_draw = CLMTracker::GetCorrectedPoseCameraPlane(clm_model, fx, fy, cx, cy, clm_parameters);
 
-					// Draw it in reddish if uncertain, blueish if certain
-					CLMTracker::DrawBox(captured_image, pose_estimate_to_draw, Scalar((1-detection_certainty)*255.0,0, detection_certainty*255), thickness, fx, fy, cx, cy);
+						// Draw it in reddish if uncertain, blueish if certain
+						CLMTracker::DrawBox(captured_image, pose_estimate_to_draw, Scalar((1-detection_certainty)*255.0,0, detection_certainty*255), thickness, fx, fy, cx, cy);
 
-				}
+					}
 			
-				// Work out the framerate
-				if(frame_count % 10 == 0)
-				{      
-					t1 = cv::getTickCount();
-					fps = 10.0 / (double(t1-t0)/cv::getTickFrequency()); 
-					t0 = t1;
-				}
+					// Work out the framerate
+					if(frame_count % 10 == 0)
+					{      
+						t1 = cv::getTickCount();
+						fps = 10.0 / (double(t1-t0)/cv::getTickFrequency()); 
+						t0 = t1;
+					}
 			
-				// Write out the framerate on the image before displaying it
-				char fpsC[255];
-				sprintf(fpsC, "%d", (int)fps);
-				string fpsSt("FPS:");
-				fpsSt += fpsC;
-				cv::putText(captured_image, fpsSt, cv::Point(10,20), CV_FONT_HERSHEY_SIMPLEX, 0.5, CV_RGB(255,0,0));		
+					// Write out the framerate on the image before displaying it
+					char fpsC[255];
+					sprintf(fpsC, "%d", (int)fps);
+					string fpsSt("FPS:");
+					fpsSt += fpsC;
+					cv::putText(captured_image, fpsSt, cv::Point(10,20), CV_FONT_HERSHEY_SIMPLEX, 0.5, CV_RGB(255,0,0));		
+				}
 			
-				if(!clm_parameters.quiet_mode)
+				if(visualise)
 				{
 					namedWindow("tracking_result",1);		
 					imshow("tracking_result", captured_image);
 				}
 			}
-			if(video)
-			{
-				video_capture >> captured_image;
-			}
-			else
+			frame_source.Read(captured_image, grayscale_image);
+
+			// detect key presses (only when there is a window to press them in)
+			if(visualise)
 			{
-				curr_img++;
-				if(curr_img < (int)input_image_files[f_n].size())
-				{
-					string curr_img_file = input_image_files[f_n][curr_img];
-					captured_image = imread(curr_img_file, -1);
-				}
-				else
+				char character_press = cv::waitKey(1);
+			
+				// quit the application
+				if(character_press=='q')
 				{
-					captured_image = Mat();
+					return(0);
 				}
 			}
-			// detect key presses
-			char character_press = cv::waitKey(1);
-			
-			// restart the tracker
-			if(character_press=='q')
-			{
-				return(0);
-			}
 
 			// Update the frame count
 			frame_count++;
+			CLMTracker::Profiler::NextFrame();
 
 			if(!end_frames.empty())
 			{
@@ -698,7 +916,6 @@ int main (int argc, char **argv)
 		
 		
 		frame_count = 0;
-		curr_img = -1;
 
 		// Reset the model, for the next video
 		clm_model.Reset();
@@ -745,6 +962,7 @@ int main (int argc, char **argv)
 		vector<string> pred_names_reg;
 		vector<string> pred_names_reg_segmented;
 		
+		size_t segment = 0;
 		for(size_t frame = 0; frame < params_global_video[i].size(); ++frame)
 		{
 		
@@ -752,12 +970,23 @@ int main (int argc, char **argv)
 			clm_model.params_local = params_local_video[i][frame].clone();
 			clm_model.params_global = params_global_video[i][frame];
 			clm_model.detection_success = successes_video[i][frame];
+
+			// The frames of a segment are predicted using the running medians of the analyser that saw them (the chunks of an input share the merged one)
+			Psyche::FaceAnalyser* frame_analyser = &face_analyser;
+			if(!segment_starts[i].empty())
+			{
+				while(segment + 1 < segment_starts[i].size() && frame >= segment_starts[i][segment + 1])
+				{
+					segment++;
+				}
+				frame_analyser = &segment_analysers[i][segment];
+			}
 				
-			face_analyser.PredictAUs(hog_descriptors[i][frame], geom_descriptors[i][frame], clm_model);
+			frame_analyser->PredictAUs(hog_descriptors[i][frame], geom_descriptors[i][frame], clm_model);
 
-			auto au_preds_class = face_analyser.GetCurrentAUsClass();
-			auto au_preds_reg = face_analyser.GetCurrentAUsReg();
-			auto au_preds_reg_segmented = face_analyser.GetCurrentAUsRegSegmented();
+			auto au_preds_class = frame_analyser->GetCurrentAUsClass();
+			auto au_preds_reg = frame_analyser->GetCurrentAUsReg();
+			auto au_preds_reg_segmented = frame_analyser->GetCurrentAUsRegSegmented();
 
 			if(frame == 0)
 			{
@@ -906,94 +1135,41 @@ int main (int argc, char **argv)
 			}
 		}
 
-		vector<string> sorted(pred_names_class);
-		std::sort(sorted.begin(), sorted.end());
-
 		if(!output_aus_class.empty())	
 		{
-			std::ofstream au_output_file_class;
-			au_output_file_class.open(output_aus_class[i], ios_base::out);
-
-			// Print the results here
-			for(size_t au_out = 0; au_out < pred_names_class.size(); ++au_out)
-			{			
-				for(size_t au = 0; au < pred_names_class.size(); ++au)
-				{
-					if(pred_names_class[au].compare(sorted[au_out]) == 0)
-					{
-						au_output_file_class << pred_names_class[au];					
-						for(size_t frame = 0; frame < all_predictions_class[au].size(); ++frame)
-						{
-							au_output_file_class << " " << all_predictions_class[au][frame];
-						}
-						au_output_file_class << std::endl;			
-						break;
-					}
-				}
-			}
-
-			au_output_file_class.close();
+			output_AU_predictions(output_aus_class[i], pred_names_class, all_predictions_class);
 		}
 
-		vector<string> sorted_reg(pred_names_reg);
-		std::sort(sorted_reg.begin(), sorted_reg.end());
-
 		if(!output_aus_reg.empty())	
 		{
-
-			std::ofstream au_output_file_reg;
-			au_output_file_reg.open(output_aus_reg[i], ios_base::out);
-
-			// Print the results here
-			for(size_t au_out = 0; au_out < pred_names_reg.size(); ++au_out)
-			{			
-				for(size_t au = 0; au < pred_names_reg.size(); ++au)
-				{
-					if(pred_names_reg[au].compare(sorted_reg[au_out]) == 0)
-					{
-						au_output_file_reg << pred_names_reg[au];					
-						for(size_t frame = 0; frame < all_predictions_reg[au].size(); ++frame)
-						{
-							au_output_file_reg << " " << all_predictions_reg[au][frame];
-						}
-						au_output_file_reg << std::endl;			
-						break;
-					}
-				}
-			}
-
-			au_output_file_reg.close();
+			output_AU_predictions(output_aus_reg[i], pred_names_reg, all_predictions_reg);
 		}
 
-		vector<string> sorted_reg_segmented(pred_names_reg_segmented);
-		std::sort(sorted_reg_segmented.begin(), sorted_reg_segmented.end());
-
 		if(!output_aus_reg_segmented.empty())	
 		{
-			std::ofstream au_output_file_reg_segmented;
-			au_output_file_reg_segmented.open(output_aus_reg_segmented[i], ios_base::out);
+			output_AU_predictions(output_aus_reg_segmented[i], pred_names_reg_segmented, all_predictions_reg_segmented);
+		}
+	}
 
-			// Print the results here
-			for(size_t au_out = 0; au_out < pred_names_reg_segmented.size(); ++au_out)
-			{			
-				for(size_t au = 0; au < pred_names_reg_segmented.size(); ++au)
-				{
-					if(pred_names_reg_segmented[au].compare(sorted_reg_segmented[au_out]) == 0)
-					{
-						au_output_file_reg_segmented << pred_names_reg_segmented[au];					
-						for(size_t frame = 0; frame < all_predictions_reg_segmented[au].size(); ++frame)
-						{
-							au_output_file_reg_segmented << " " << all_predictions_reg_segmented[au][frame];
-						}
-						au_output_file_reg_segmented << std::endl;			
-						break;
-					}
-				}
+	if(check_precision)
+	{
+		double drift = face_analyser.GetMaxPrecisionDrift();
+		for(size_t i = 0; i < segment_analysers.size(); ++i)
+		{
+			for(size_t segment = 0; segment < segment_analysers[i].size(); ++segment)
+			{
+				drift = std::max(drift, segment_analysers[i][segment].GetMaxPrecisionDrift());
 			}
-
-			au_output_file_reg_segmented.close();
+		}
+		INFO_STREAM("Largest AU intensity difference between float and double models: " << drift);
+		if(drift > precision_tolerance)
+		{
+			ERROR_STREAM("AU predictions drifted beyond the tolerance of " << precision_tolerance);
+			return 1;
 		}
 	}
+	CLMTracker::Profiler::WriteReports(clm_parameters.profile_location, clm_parameters.trace_location);
+
 	return 0;
 }
 
@@ -55,6 +55,9 @@
 
 #include <FaceAnalyser.h>
 #include <Face_utils.h>
+#include <FeatureOutputs.h>
+
+#include <tbb/tbb.h>
 
 #define INFO_STREAM( stream ) \
 std::cout << stream << std::endl
@@ -278,39 +281,205 @@ void get_image_input_output_params_feats(vector<vector<string> > &input_image_fi
 
 }
 
-void output_HOG_frame(std::ofstream* hog_file, bool good_frame, const Mat_<double>& hog_descriptor, int num_rows, int num_cols)
+// The per frame outputs of a segment, written out in order once all of the segments are done
+struct SegmentOutputs
+{
+	vector<int> frames;
+	vector<bool> successes;
+	vector<Mat_<double>> detected_landmarks;
+	vector<Vec6d> params_global;
+	vector<Mat_<double>> params_local;
+	vector<Vec6d> poses;
+
+	// The HOG descriptors of the segment are written to a file of their own (empty if there is no HOG output), so that they are not kept in memory
+	string hog_file;
+	bool hog_written;
+
+	// Success followed by the AU predictions
+	vector<string> au_names;
+	vector<vector<double> > au_rows;
+
+	SegmentOutputs() : hog_written(false) {}
+};
+
+// Tracks the segments of an input in parallel, each one with its own tracker and its own analyser (copied from a fresh one) that are warmed up on the
+// frames before the segment. The similarity aligned faces are written out directly (aligned_directory, if not empty), and so are the HOG descriptors
+// (to a file per segment named after hog_output, if not empty), everything else is kept per segment.
+// The AUs (if analyse_aus is set) are predicted in a second pass over every segment, as they are for a whole input, reading the frames of the segment again.
+// If the segments are the chunks of a whole input (merge_analysers), the analysers only see their own frames and are merged for the second pass
+bool track_segments(const vector<CLMTracker::FrameSegment>& segments, int warmup_frames, const CLMTracker::OpenSourceFunction& open_source, const CLMTracker::CLM& clm_model,
+	const CLMTracker::CLMParameters& clm_parameters, bool track_as_video, const Psyche::FaceAnalyser& analyser_prototype, bool analyse_aus, bool merge_analysers, const string& hog_output, const string& aligned_directory,
+	bool rigid, double sim_scale, int sim_size, bool use_camera_plane_pose, float fx, float fy, float cx, float cy, vector<SegmentOutputs>& segment_outputs)
 {
+	vector<Psyche::FaceAnalyser> segment_analysers(segments.size(), analyser_prototype);
+	segment_outputs.assign(segments.size(), SegmentOutputs());
 
-	// Using FHOGs, hence 31 channels
-	int num_channels = 31;
+	vector<unique_ptr<std::ofstream> > hog_files(segments.size());
+	if(!hog_output.empty())
+	{
+		for(size_t segment = 0; segment < segments.size(); ++segment)
+		{
+			stringstream hog_file;
+			hog_file << hog_output << ".segment" << segment;
+			segment_outputs[segment].hog_file = hog_file.str();
+			hog_files[segment].reset(new std::ofstream(segment_outputs[segment].hog_file, ios_base::out | ios_base::binary));
+		}
+	}
 
-	hog_file->write((char*)(&num_cols), 4);
-	hog_file->write((char*)(&num_rows), 4);
-	hog_file->write((char*)(&num_channels), 4);
+	bool success = CLMTracker::ProcessFrameSegments(segments, warmup_frames, open_source, clm_model, clm_parameters,
+		[&](int segment, int frame, bool in_segment, Mat& captured_image, Mat_<uchar>& grayscale_image, CLMTracker::CLM& segment_model, CLMTracker::CLMParameters& segment_parameters)
+	{
+		bool detection_success;
+		if(track_as_video)
+		{
+			detection_success = CLMTracker::DetectLandmarksInVideo(grayscale_image, segment_model, segment_parameters);
+		}
+		else
+		{
+			detection_success = CLMTracker::DetectLandmarksInImage(grayscale_image, segment_model, segment_parameters);
+		}
 
-	// Not the best way to store a bool, but will be much easier to read it
-	float good_frame_float;
-	if(good_frame)
-		good_frame_float = 1;
-	else
-		good_frame_float = -1;
+		// The warm-up frames only update the tracker and the running medians of the analyser (the ones of chunks are seen by the analyser of the chunk before)
+		Psyche::FaceAnalyser& face_analyser = segment_analysers[segment];
+		if(!in_segment)
+		{
+			if(analyse_aus && !merge_analysers)
+			{
+				face_analyser.AddNextFrame(captured_image, segment_model, 0, false);
+			}
+			return;
+		}
+
+		SegmentOutputs& outputs = segment_outputs[segment];
+
+		Mat sim_warped_img;
+		Mat_<double> hog_descriptor;
+		int num_hog_rows;
+		int num_hog_cols;
+		Psyche::ExtractAlignedFeatures(sim_warped_img, hog_descriptor, num_hog_rows, num_hog_cols, captured_image, segment_model, face_analyser, analyse_aus,
+			rigid, sim_scale, sim_size);
+
+		if(!aligned_directory.empty())
+		{
+			char name[100];
+			sprintf(name, "frame_det_%06d.png", frame);
+			imwrite((path(aligned_directory) / path(name)).string(), sim_warped_img);
+		}
+
+		outputs.frames.push_back(frame);
+		outputs.successes.push_back(detection_success);
+		outputs.detected_landmarks.push_back(segment_model.detected_landmarks.clone());
+		outputs.params_global.push_back(segment_model.params_global);
+		outputs.params_local.push_back(segment_model.params_local.clone());
+
+		if(use_camera_plane_pose)
+		{
+			outputs.poses.push_back(CLMTracker::GetCorrectedPoseCameraPlane(segment_model, fx, fy, cx, cy, segment_parameters));
+		}
+		else
+		{
+			outputs.poses.push_back(CLMTracker::GetCorrectedPoseCamera(segment_model, fx, fy, cx, cy, segment_parameters));
+		}
+
+		if(hog_files[segment])
+		{
+			Psyche::WriteHOGFrame(*hog_files[segment], detection_success, hog_descriptor, num_hog_rows, num_hog_cols);
+		}
+	});
 
-	hog_file->write((char*)(&good_frame_float), 4);
+	for(size_t segment = 0; segment < hog_files.size(); ++segment)
+	{
+		if(hog_files[segment])
+		{
+			hog_files[segment]->close();
+			segment_outputs[segment].hog_written = !hog_files[segment]->fail();
+		}
+	}
 
-	cv::MatConstIterator_<double> descriptor_it = hog_descriptor.begin();
+	if(!analyse_aus)
+	{
+		return success;
+	}
 
-	for(int y = 0; y < num_cols; ++y)
+	// The second pass reads the frames of a segment again, as the serial run does (the analysers are already warmed up, so without the warm-up
+	// frames), and analyses them with the landmarks of the first pass
+	auto predict_aus = [&](int segment, Psyche::FaceAnalyser& face_analyser)
 	{
-		for(int x = 0; x < num_rows; ++x)
+		SegmentOutputs& outputs = segment_outputs[segment];
+		size_t i = 0;
+
+		return CLMTracker::ProcessFrameSegments(vector<CLMTracker::FrameSegment>(1, segments[segment]), 0, open_source, clm_model, clm_parameters,
+			[&](int, int frame, bool in_segment, Mat& captured_image, Mat_<uchar>&, CLMTracker::CLM& segment_model, CLMTracker::CLMParameters&)
 		{
-			for(unsigned int o = 0; o < 31; ++o)
+			// Only the frames that were tracked in the first pass
+			while(i < outputs.frames.size() && outputs.frames[i] < frame)
+			{
+				++i;
+			}
+			if(!in_segment || i == outputs.frames.size() || outputs.frames[i] != frame)
+			{
+				return;
+			}
+
+			segment_model.detected_landmarks = outputs.detected_landmarks[i].clone();
+			segment_model.params_local = outputs.params_local[i].clone();
+			for(int p = 0; p < 6; ++p)
 			{
+				segment_model.params_global[p] = outputs.params_global[i][p];
+			}
+			segment_model.detection_success = outputs.successes[i];
+
+			face_analyser.AddNextFrame(captured_image, segment_model, 0, false);
+
+			auto au_preds = face_analyser.GetCurrentAUsCombined();
+			if(outputs.au_names.empty())
+			{
+				for(auto au_it = au_preds.begin(); au_it != au_preds.end(); ++au_it)
+				{
+					outputs.au_names.push_back(au_it->first);
+				}
+			}
 
-				float hog_data = (float)(*descriptor_it++);
-				hog_file->write ((char*)&hog_data, 4);
+			vector<double> au_row;
+			au_row.push_back(outputs.successes[i]);
+			for(auto au_it = au_preds.begin(); au_it != au_preds.end(); ++au_it)
+			{
+				au_row.push_back(au_it->second);
 			}
+			outputs.au_rows.push_back(au_row);
+		});
+	};
+
+	// Using int instead of bool as it is written to from different threads
+	vector<int> segment_predicted(segments.size(), 0);
+
+	if(merge_analysers)
+	{
+		// The merged analyser has the medians of the whole input, like the one of a serial run after its first pass, so the
+		// chunks are predicted in order with it
+		Psyche::FaceAnalyser& merged_analyser = segment_analysers[0];
+		for(size_t segment = 1; segment < segments.size(); ++segment)
+		{
+			merged_analyser.MergeMedians(segment_analysers[segment]);
+		}
+
+		for(size_t segment = 0; segment < segments.size(); ++segment)
+		{
+			segment_predicted[segment] = predict_aus((int)segment, merged_analyser);
 		}
 	}
+	else
+	{
+		tbb::parallel_for(0, (int)segments.size(), [&](int segment){
+			segment_predicted[segment] = predict_aus(segment, segment_analysers[segment]);
+		});
+	}
+
+	for(size_t segment = 0; segment < segment_predicted.size(); ++segment)
+	{
+		success = success && segment_predicted[segment] != 0;
+	}
+	return success;
 }
 
 int main (int argc, char **argv)
@@ -330,6 +499,13 @@ int main (int argc, char **argv)
     float fx = 500, fy = 500, cx = 0, cy = 0;
 			
 	CLMTracker::CLMParameters clm_parameters(arguments);
+
+	// Per stage timings (-profile <file.json>) and Chrome trace (-trace <file.json>)
+	CLMTracker::Profiler::Configure(clm_parameters.profile_location, clm_parameters.trace_location);
+
+	// In quiet (headless) mode no windows are shown and no keys are polled, the tracking
+	// results are only drawn if they are written out to a video
+	bool visualise = !clm_parameters.quiet_mode;
 			
 	// Get the input output file parameters
 	
@@ -358,6 +534,17 @@ int main (int argc, char **argv)
 	}
 	// Get camera parameters
 	CLMTracker::get_camera_params(device, fx, fy, cx, cy, arguments);    
+
+	// Raw luma frames from a file or a pipe instead of a video (-raw <width> <height>)
+	int raw_width, raw_height, raw_chroma_bytes;
+	CLMTracker::get_raw_input_params(raw_width, raw_height, raw_chroma_bytes, arguments);
+
+	// Only parts of the inputs can be processed, given as segment lists (-segs <file>), or whole inputs can be split into chunks
+	// that are tracked in parallel (-chunks <n>)
+	vector<string> segment_files;
+	int num_chunks = 1;
+	int warmup_frames = -1;
+	CLMTracker::get_segment_params(segment_files, num_chunks, warmup_frames, arguments);
 	
 	// The modules that are being used for tracking
 	CLMTracker::CLM clm_model(clm_parameters.model_location);	
@@ -393,6 +580,9 @@ int main (int argc, char **argv)
 	orientations.push_back(Vec3d(0.0,0.0,0.0));
 	Psyche::FaceAnalyser face_analyser(orientations, sim_scale, sim_size, sim_size, face_analyser_loc, face_analyser_loc_av, tri_location);
 
+	// The segments get their own analysers, copied from this fresh one so that they share the models but none of the running state
+	Psyche::FaceAnalyser segment_analyser_prototype(face_analyser);
+
 	// Will warp to scaled mean shape
 	Mat_<double> similarity_normalised_shape = clm_model.pdm.mean_shape * sim_scale;
 	// Discard the z component
@@ -401,7 +591,6 @@ int main (int argc, char **argv)
 	// If multiple video files are tracked, use this to indicate if we are done
 	bool done = false;	
 	int f_n = -1;
-	int curr_img = -1;
 
 	// If cx (optical axis centre) is undefined will use the image size/2 as an estimate
 	bool cx_undefined = false;
@@ -415,9 +604,11 @@ int main (int argc, char **argv)
 		
 		string current_file;
 		
-		VideoCapture video_capture;
+		// Both the videos and the image sequences are decoded (and converted to grayscale) ahead on a background thread
+		CLMTracker::FrameSource frame_source;
 		
 		Mat captured_image;
+		Mat_<uchar> grayscale_image;
 
 		if(video)
 		{
@@ -436,31 +627,23 @@ int main (int argc, char **argv)
 			if( current_file.size() > 0 )
 			{
 				INFO_STREAM( "Attempting to read from file: " << current_file );
-				video_capture = VideoCapture( current_file );
 			}
 			else
 			{
 				INFO_STREAM( "Attempting to capture from device: " << device );
-				video_capture = VideoCapture( device );
-
-				// Read a first frame often empty in camera
-				Mat captured_image;
-				video_capture >> captured_image;
 			}
 
-			if( !video_capture.isOpened() ) FATAL_STREAM( "Failed to open video source" );
+			if( !frame_source.Open(current_file, device, raw_width, raw_height, raw_chroma_bytes) ) FATAL_STREAM( "Failed to open video source" );
 			else INFO_STREAM( "Device or file opened");
 
-			video_capture >> captured_image;	
+			frame_source.Read(captured_image, grayscale_image);
 		}
 		else
 		{
 			f_n++;	
-			curr_img++;
-			if(!input_image_files[f_n].empty())
+			if(frame_source.OpenImageSequence(input_image_files[f_n]))
 			{
-				string curr_img_file = input_image_files[f_n][curr_img];
-				captured_image = imread(curr_img_file, -1);
+				frame_source.Read(captured_image, grayscale_image);
 			}
 			else
 			{
@@ -476,33 +659,54 @@ int main (int argc, char **argv)
 			cy = captured_image.rows / 2.0f;
 		}
 	
-		// Creating output files
-		std::ofstream pose_output_file;
+		// Creating output files, the format is picked from the extension (.bin, .binz or text)
+		unique_ptr<CLMTracker::OutputSink> pose_output_file;
 		if(!pose_output_files.empty())
 		{
-			pose_output_file.open (pose_output_files[f_n]);
+			vector<string> columns = {"frame", "timestamp", "confidence"};
+			pose_output_file = CLMTracker::OpenOutputSink(pose_output_files[f_n], CLMTracker::PoseColumnNames(columns));
+			if(!pose_output_file)
+			{
+				ERROR_STREAM( "Could not open the output file " << pose_output_files[f_n] );
+				return 1;
+			}
 		}
 	
-		std::ofstream landmarks_output_file;		
+		unique_ptr<CLMTracker::OutputSink> landmarks_output_file;		
 		if(!landmark_output_files.empty())
 		{
-			landmarks_output_file.open(landmark_output_files[f_n]);
+			vector<string> columns = {"frame", "success"};
+			landmarks_output_file = CLMTracker::OpenOutputSink(landmark_output_files[f_n], CLMTracker::LandmarkColumnNames(columns, clm_model.pdm.NumberOfPoints()), CLMTracker::PaddedTextLayout());
+			if(!landmarks_output_file)
+			{
+				ERROR_STREAM( "Could not open the output file " << landmark_output_files[f_n] );
+				return 1;
+			}
 		}
 
 		// Outputting model parameters (rigid and non-rigid), the first parameters are the 6 rigid shape parameters, they are followed by the non rigid shape parameters
-		std::ofstream params_output_file;		
+		unique_ptr<CLMTracker::OutputSink> params_output_file;		
 		if(!params_output_files.empty())
 		{
-			params_output_file.open(params_output_files[f_n]);
+			vector<string> columns = {"frame", "success"};
+			params_output_file = CLMTracker::OpenOutputSink(params_output_files[f_n], CLMTracker::ParamsColumnNames(columns, clm_model.pdm.NumberOfModes()), CLMTracker::PaddedTextLayout());
+			if(!params_output_file)
+			{
+				ERROR_STREAM( "Could not open the output file " << params_output_files[f_n] );
+				return 1;
+			}
 		}
 
+		// Reused for every output row
+		vector<double> output_row;
+
 		// saving the videos
 		VideoWriter output_similarity_aligned_video;
 		if(!output_similarity_align_files.empty())
 		{
 			if(video_output)
 			{
-				double fps = video_capture.get(CV_CAP_PROP_FPS);
+				double fps = frame_source.GetFPS();
 				output_similarity_aligned_video = VideoWriter(output_similarity_align_files[f_n], CV_FOURCC('H','F','Y','U'), fps, Size(sim_size, sim_size), true);
 			}			
 			else
@@ -527,6 +731,11 @@ int main (int argc, char **argv)
 		if(!output_hog_align_files.empty())
 		{
 			hog_output_file.open(output_hog_align_files[f_n], ios_base::out | ios_base::binary);
+			if(!hog_output_file.is_open())
+			{
+				ERROR_STREAM( "Could not open the output file " << output_hog_align_files[f_n] );
+				return 1;
+			}
 		}
 
 		// saving the videos
@@ -539,10 +748,166 @@ int main (int argc, char **argv)
 		int frame_count = 0;
 		
 		// This is useful for a second pass run (if want AU predictions)
-		vector<Vec6d> params_global_video;
-		vector<bool> successes_video;
-		vector<Mat_<double>> params_local_video;
-		vector<Mat_<double>> detected_landmarks_video;
+		Psyche::TrackedFrames tracked_frames;
+
+		// Every segment (or chunk) opens the input again and seeks in it, which cameras and pipes (including the standard input) can not do
+		vector<CLMTracker::FrameSegment> segments;
+		bool chunked = false;
+		if((f_n < (int)segment_files.size() || num_chunks > 1) && !frame_source.IsSeekable())
+		{
+			ERROR_STREAM( "Segments and chunks need an input that can be seeked in (a video file, an image sequence or a raw file), not a camera or a pipe" );
+			return 1;
+		}
+
+		if(f_n < (int)segment_files.size())
+		{
+			if(!CLMTracker::ReadFrameSegments(segment_files[f_n], segments) || segments.empty())
+			{
+				FATAL_STREAM( "No valid segments in " + segment_files[f_n] );
+			}
+		}
+		else if(num_chunks > 1)
+		{
+			// A whole input split into chunks is stitched back together as if it was tracked in one go
+			if(frame_source.GetFrameCount() > 0)
+			{
+				segments = CLMTracker::SplitIntoChunks(frame_source.GetFrameCount(), num_chunks);
+				chunked = true;
+			}
+			else
+			{
+				WARN_STREAM( "The length of the input is not known, so it is not split into chunks" );
+			}
+		}
+
+		// The segments are seeked to and tracked in parallel, instead of the input being read from the start
+		if(!segments.empty())
+		{
+			INFO_STREAM( "Tracking " << segments.size() << (chunked ? " chunks" : " segments"));
+			if(!tracked_videos_output.empty() || !output_neutrals.empty() || (!output_similarity_align_files.empty() && video_output))
+			{
+				WARN_STREAM( "Tracked videos, aligned face videos and neutral faces are not written out for segments" );
+			}
+
+
+			// Unless given, the tracker is warmed up for a few seconds of the input (the analysers of chunks are merged, so only the ones of segments need it)
+			int segment_warmup_frames = warmup_frames < 0 ? CLMTracker::DefaultWarmupFrames(frame_source.GetFPS()) : warmup_frames;
+
+			frame_source.Close();
+			captured_image = Mat();
+
+			CLMTracker::OpenSourceFunction open_source = [&](CLMTracker::FrameSource& segment_source)
+			{
+				if(video)
+				{
+					return segment_source.Open(current_file, device, raw_width, raw_height, raw_chroma_bytes);
+				}
+				return segment_source.OpenImageSequence(input_image_files[f_n]);
+			};
+
+			string aligned_directory;
+			if(!output_similarity_align_files.empty() && !video_output)
+			{
+				aligned_directory = output_similarity_align_files[f_n];
+			}
+
+			vector<SegmentOutputs> segment_outputs;
+			if(!track_segments(segments, segment_warmup_frames, open_source, clm_model, clm_parameters, video || images_as_video, segment_analyser_prototype, !output_aus.empty(), chunked, hog_output_file.is_open() ? output_hog_align_files[f_n] : string(),
+				aligned_directory, rigid, sim_scale, sim_size, use_camera_plane_pose, fx, fy, cx, cy, segment_outputs))
+			{
+				WARN_STREAM( "Some of the segments could not be read" );
+			}
+
+			// Writing the segments out in order, the frame numbers are the ones in the input
+			unique_ptr<CLMTracker::OutputSink> au_output_file;
+			for(size_t segment = 0; segment < segment_outputs.size(); ++segment)
+			{
+				const SegmentOutputs& outputs = segment_outputs[segment];
+				for(size_t i = 0; i < outputs.frames.size(); ++i)
+				{
+					if(landmarks_output_file)
+					{
+						Psyche::LandmarksRow(output_row, outputs.frames[i], outputs.successes[i], outputs.detected_landmarks[i]);
+						landmarks_output_file->WriteRow(output_row);
+					}
+
+					if(params_output_file)
+					{
+						Psyche::ParamsRow(output_row, outputs.frames[i], outputs.successes[i], outputs.params_global[i], outputs.params_local[i]);
+						params_output_file->WriteRow(output_row);
+					}
+
+					if(pose_output_file)
+					{
+						Psyche::PoseRow(output_row, outputs.frames[i], outputs.poses[i]);
+						pose_output_file->WriteRow(output_row);
+					}
+
+				}
+
+				// The HOG descriptors of the segment are appended from its own file
+				if(!outputs.hog_file.empty())
+				{
+					std::ifstream segment_hog_file(outputs.hog_file, ios_base::in | ios_base::binary);
+					if(!outputs.hog_written || !segment_hog_file.is_open())
+					{
+						ERROR_STREAM( "Could not write the HOG descriptors of the segment to " << outputs.hog_file );
+						return 1;
+					}
+					if(segment_hog_file.peek() != EOF)
+					{
+						hog_output_file << segment_hog_file.rdbuf();
+					}
+					segment_hog_file.close();
+					boost::filesystem::remove(outputs.hog_file);
+
+					if(!hog_output_file.good())
+					{
+						ERROR_STREAM( "Could not write to the output file " << output_hog_align_files[f_n] );
+						return 1;
+					}
+				}
+
+				// Chunks cover every frame, so their rows are the ones of a serial run, the rows of segments start with the frame number like the other outputs
+				if(!output_aus.empty() && !outputs.au_rows.empty())
+				{
+					if(!au_output_file)
+					{
+						vector<string> columns;
+						if(!chunked)
+						{
+							columns.push_back("frame");
+						}
+						columns.push_back("success");
+						columns.insert(columns.end(), outputs.au_names.begin(), outputs.au_names.end());
+						au_output_file = CLMTracker::OpenOutputSink(output_aus[f_n], columns, CLMTracker::TrailingSpaceTextLayout());
+						if(!au_output_file)
+						{
+							ERROR_STREAM( "Could not open the output file " << output_aus[f_n] );
+							return 1;
+						}
+					}
+					for(size_t i = 0; i < outputs.au_rows.size(); ++i)
+					{
+						if(chunked)
+						{
+							au_output_file->WriteRow(outputs.au_rows[i]);
+						}
+						else
+						{
+							output_row.clear();
+							output_row.push_back(outputs.frames[i] + 1);
+							output_row.insert(output_row.end(), outputs.au_rows[i].begin(), outputs.au_rows[i].end());
+							au_output_file->WriteRow(output_row);
+						}
+					}
+				}
+			}
+			if(au_output_file)
+			{
+				au_output_file->Close();
+			}
+		}
 
 		// For measuring the timings
 		int64 t1,t0 = cv::getTickCount();
@@ -552,17 +917,7 @@ int main (int argc, char **argv)
 		while(!captured_image.empty())
 		{		
 
-			// Reading the images
-			Mat_<uchar> grayscale_image;
-
-			if(captured_image.channels() == 3)
-			{
-				cvtColor(captured_image, grayscale_image, CV_BGR2GRAY);				
-			}
-			else
-			{
-				grayscale_image = captured_image.clone();				
-			}
+			// The grayscale version of the image comes from the frame source
 		
 			// The actual facial landmark detection / tracking
 			bool detection_success;
@@ -582,41 +937,26 @@ int main (int argc, char **argv)
 			Mat_<double> hog_descriptor;
 
 			// Use face analyser only if outputting neutrals and AUs
-			if(!output_aus.empty() || !output_neutrals.empty())
-			{
-				face_analyser.AddNextFrame(captured_image, clm_model, 0, false);
-
-				params_global_video.push_back(clm_model.params_global);
-				params_local_video.push_back(clm_model.params_local.clone());
-				successes_video.push_back(detection_success);
-				detected_landmarks_video.push_back(clm_model.detected_landmarks.clone());
-				
-				face_analyser.GetLatestAlignedFace(sim_warped_img);
-				face_analyser.GetLatestHOG(hog_descriptor, num_hog_rows, num_hog_cols);
+			bool analyse_aus = !output_aus.empty() || !output_neutrals.empty();
+			Psyche::ExtractAlignedFeatures(sim_warped_img, hog_descriptor, num_hog_rows, num_hog_cols, captured_image, clm_model, face_analyser, analyse_aus, rigid, sim_scale, sim_size);
 
-			}
-			else
+			if(analyse_aus)
 			{
-				Psyche::AlignFaceMask(sim_warped_img, captured_image, clm_model, face_analyser.GetTriangulation(), rigid, sim_scale, sim_size, sim_size);
-				Psyche::Extract_FHOG_descriptor(hog_descriptor, sim_warped_img, num_hog_rows, num_hog_cols);			
+				tracked_frames.Add(clm_model, detection_success);
 			}
 
-			cv::imshow("sim_warp", sim_warped_img);			
+			if(visualise)
+			{
+				cv::imshow("sim_warp", sim_warped_img);
+			}
 			
 			//Mat_<double> hog_descriptor_vis;
 			//Psyche::Visualise_FHOG(hog_descriptor, num_hog_rows, num_hog_cols, hog_descriptor_vis);
 			//cv::imshow("hog", hog_descriptor_vis);	
 
 			// Work out the pose of the head from the tracked model
-			Vec6d pose_estimate_CLM;
-			if(use_camera_plane_pose)
-			{
-				pose_estimate_CLM = CLMTracker::GetCorrectedPoseCameraPlane(clm_model, fx, fy, cx, cy, clm_parameters);
-			}
-			else
-			{
-				pose_estimate_CLM = CLMTracker::GetCorrectedPoseCamera(clm_model, fx, fy, cx, cy, clm_parameters);
-			}
+			Vec6d pose_estimate_CLM = use_camera_plane_pose ? CLMTracker::GetCorrectedPoseCameraPlane(clm_model, fx, fy, cx, cy, clm_parameters) :
+				CLMTracker::GetCorrectedPoseCamera(clm_model, fx, fy, cx, cy, clm_parameters);
 
 			//Mat_<double> hog_descriptor_mean;
 			//face_analyser.GetLatestNeutralHOG(hog_descriptor_mean, num_rows, num_cols);
@@ -626,7 +966,7 @@ int main (int argc, char **argv)
 
 			if(hog_output_file.is_open())
 			{
-				output_HOG_frame(&hog_output_file, detection_success, hog_descriptor, num_hog_rows, num_hog_cols);
+				Psyche::WriteHOGFrame(hog_output_file, detection_success, hog_descriptor, num_hog_rows, num_hog_cols);
 			}
 
 			// Write the similarity normalised output
@@ -655,85 +995,77 @@ int main (int argc, char **argv)
 					imwrite(out_file, sim_warped_img);
 				}
 			}
-			// Visualising the results
-			// Drawing the facial landmarks on the face and the bounding box around it if tracking is successful and initialised
-			double detection_certainty = clm_model.detection_certainty;
+			if(visualise || !tracked_videos_output.empty())
+			{
+				// Visualising the results
+				// Drawing the facial landmarks on the face and the bounding box around it if tracking is successful and initialised
+				double detection_certainty = clm_model.detection_certainty;
 
-			double visualisation_boundary = 0.2;
+				double visualisation_boundary = 0.2;
 			
-			// Only draw if the reliability is reasonable, the value is slightly ad-hoc
-			if(detection_certainty < visualisation_boundary)
-			{
-				CLMTracker::Draw(captured_image, clm_model);
-				//CLMTracker::Draw(captured_image, clm_model);
+				// Only draw if the reliability is reasonable, the value is slightly ad-hoc
+				if(detection_certainty < visualisation_boundary)
+				{
+					CLMTracker::Draw(captured_image, clm_model);
+					//CLMTracker::Draw(captured_image, clm_model);
 
-				if(detection_certainty > 1)
-					detection_certainty = 1;
-				if(detection_certainty < -1)
-					detection_certainty = -1;
+					if(detection_certainty > 1)
+						detection_certainty = 1;
+					if(detection_certainty < -1)
+						detection_certainty = -1;
 
-				detection_certainty = (detection_certainty + 1)/(visualisation_boundary +1);
+					detection_certainty = (detection_certainty + 1)/(visualisation_boundary +1);
 
-				// A rough heuristic for box around the face width
-				int thickness = (int)std::ceil(2.0* ((double)captured_image.cols) / 640.0);
+					// A rough heuristic for box around the face width
+					int thickness = (int)std::ceil(2.0* ((double)captured_image.cols) / 640.0);
 				
-				Vec6d pose_estimate_to_draw = CLMTracker::GetCorrectedPoseCameraPlane(clm_model, fx, fy, cx, cy, clm_parameters);
+					Vec6d pose_estimate_to_draw = CLMTracker::GetCorrectedPoseCameraPlane(clm_model, fx, fy, cx, cy, clm_parameters);
 
-				// Draw it in reddish if uncertain, blueish if certain
-				CLMTracker::DrawBox(captured_image, pose_estimate_to_draw, Scalar((1-detection_certainty)*255.0,0, detection_certainty*255), thickness, fx, fy, cx, cy);
+					// Draw it in reddish if uncertain, blueish if certain
+					CLMTracker::DrawBox(captured_image, pose_estimate_to_draw, Scalar((1-detection_certainty)*255.0,0, detection_certainty*255), thickness, fx, fy, cx, cy);
 
-			}
+				}
 			
-			// Work out the framerate
-			if(frame_count % 10 == 0)
-			{      
-				t1 = cv::getTickCount();
-				fps = 10.0 / (double(t1-t0)/cv::getTickFrequency()); 
-				t0 = t1;
-			}
+				// Work out the framerate
+				if(frame_count % 10 == 0)
+				{      
+					t1 = cv::getTickCount();
+					fps = 10.0 / (double(t1-t0)/cv::getTickFrequency()); 
+					t0 = t1;
+				}
 			
-			// Write out the framerate on the image before displaying it
-			char fpsC[255];
-			sprintf(fpsC, "%d", (int)fps);
-			string fpsSt("FPS:");
-			fpsSt += fpsC;
-			cv::putText(captured_image, fpsSt, cv::Point(10,20), CV_FONT_HERSHEY_SIMPLEX, 0.5, CV_RGB(255,0,0));		
+				// Write out the framerate on the image before displaying it
+				char fpsC[255];
+				sprintf(fpsC, "%d", (int)fps);
+				string fpsSt("FPS:");
+				fpsSt += fpsC;
+				cv::putText(captured_image, fpsSt, cv::Point(10,20), CV_FONT_HERSHEY_SIMPLEX, 0.5, CV_RGB(255,0,0));		
+			}
 			
-			if(!clm_parameters.quiet_mode)
+			if(visualise)
 			{
 				namedWindow("tracking_result",1);		
 				imshow("tracking_result", captured_image);
 			}
 
 			// Output the detected facial landmarks
-			if(!landmark_output_files.empty())
+			if(landmarks_output_file)
 			{
-				landmarks_output_file << frame_count + 1 << " " << detection_success;
-				for (int i = 0; i < clm_model.pdm.NumberOfPoints() * 2; ++i)
-				{
-					landmarks_output_file << " " << clm_model.detected_landmarks.at<double>(i) << " ";
-				}
-				landmarks_output_file << endl;
+				Psyche::LandmarksRow(output_row, frame_count, detection_success, clm_model.detected_landmarks);
+				landmarks_output_file->WriteRow(output_row);
 			}
 			
-			if(!params_output_files.empty())
+			if(params_output_file)
 			{
-				params_output_file << frame_count + 1 << " " << detection_success;
-				for (int i = 0; i < 6; ++i)
-				{
-					params_output_file << " " << clm_model.params_global[i] << " "; 
-				}
-				for (int i = 0; i < clm_model.pdm.NumberOfModes(); ++i)
-				{
-					params_output_file << " " << clm_model.params_local.at<double>(i,0) << " "; 
-				}
-				params_output_file << endl;
+				Psyche::ParamsRow(output_row, frame_count, detection_success, clm_model.params_global, clm_model.params_local);
+				params_output_file->WriteRow(output_row);
 			}
 
 			// Output the estimated head pose
-			if(!pose_output_files.empty())
+			if(pose_output_file)
 			{
-				pose_output_file << frame_count + 1 << " " << (float)frame_count * 1000/30 << " " << 1 << " " << pose_estimate_CLM[0] << " " << pose_estimate_CLM[1] << " " << pose_estimate_CLM[2] << " " << pose_estimate_CLM[3] << " " << pose_estimate_CLM[4] << " " << pose_estimate_CLM[5] << endl;
+				Psyche::PoseRow(output_row, frame_count, pose_estimate_CLM);
+				pose_output_file->WriteRow(output_row);
 			}				
 
 			// output the tracked video
@@ -742,44 +1074,33 @@ int main (int argc, char **argv)
 				writerFace << captured_image;
 			}
 
-			if(video)
-			{
-				video_capture >> captured_image;
-			}
-			else
+			frame_source.Read(captured_image, grayscale_image);
+
+			// detect key presses (only when there is a window to press them in)
+			if(visualise)
 			{
-				curr_img++;
-				if(curr_img < (int)input_image_files[f_n].size())
+				char character_press = cv::waitKey(1);
+			
+				// restart the tracker
+				if(character_press == 'r')
 				{
-					string curr_img_file = input_image_files[f_n][curr_img];
-					captured_image = imread(curr_img_file, -1);
+					clm_model.Reset();
 				}
-				else
+				// quit the application
+				else if(character_press=='q')
 				{
-					captured_image = Mat();
+					return(0);
 				}
 			}
-			// detect key presses
-			char character_press = cv::waitKey(1);
-			
-			// restart the tracker
-			if(character_press == 'r')
-			{
-				clm_model.Reset();
-			}
-			// quit the application
-			else if(character_press=='q')
-			{
-				return(0);
-			}
 
 			// Update the frame count
 			frame_count++;
+			CLMTracker::Profiler::NextFrame();
 
 		}
 		
 		// TODO this should be done only if writing out neutrals
-		if(!output_neutrals.empty())
+		if(!output_neutrals.empty() && segments.empty())
 		{
 			vector<Mat> face_neutral_images;
 			vector<Mat> neutral_hogs;
@@ -797,10 +1118,10 @@ int main (int argc, char **argv)
 				stringstream sstream_out_hog;			
 				sstream_out_hog << output_neutrals[f_n] << "_" << orientations[i][0] << "_" << orientations[i][1] << "_" << orientations[i][2] << ".hog";				
 				hog_output_file.open(sstream_out_hog.str(), ios_base::out | ios_base::binary);
-				output_HOG_frame(&hog_output_file, true, neutral_hogs[i], num_hog_rows, num_hog_cols);
+				Psyche::WriteHOGFrame(hog_output_file, true, neutral_hogs[i], num_hog_rows, num_hog_cols);
 				hog_output_file.close();
 
-				if(sum(face_neutral_images[i])[0] > 0.0001)
+				if(visualise && sum(face_neutral_images[i])[0] > 0.0001)
 				{
 					// TODO rem
 					stringstream sstream;			
@@ -818,61 +1139,55 @@ int main (int argc, char **argv)
 			//cv::waitKey(0);
 		}
 
-		// Do a second pass if AU outputs are needed (this need to be rethought TODO)
-		if(!output_aus.empty())
+		// Do a second pass if AU outputs are needed (this need to be rethought TODO), the segments have done their own
+		if(!output_aus.empty() && segments.empty())
 		{
-			std::ofstream au_output_file;
-			au_output_file.open(output_aus[f_n], ios_base::out);
-
+			// Start from the beginning of the input again
 			if(video)
 			{
-				video_capture = VideoCapture( current_file );
+				frame_source.Open(current_file, device, raw_width, raw_height, raw_chroma_bytes);
 			}
-
-			for(size_t frame = 0; frame < params_global_video.size(); ++frame)
+			else
 			{
-				clm_model.detected_landmarks = detected_landmarks_video[frame].clone();
-				clm_model.params_local = params_local_video[frame].clone();
-				clm_model.params_global = params_global_video[frame];
-				clm_model.detection_success = successes_video[frame];
-
-				if(video)
-				{
-					video_capture >> captured_image;
-				}
-				else
-				{
-					string curr_img_file = input_image_files[f_n][frame];
-					captured_image = imread(curr_img_file, -1);
-				}
-				face_analyser.AddNextFrame(captured_image, clm_model, 0, false);
-				
-				auto au_preds = face_analyser.GetCurrentAUsCombined();
+				frame_source.OpenImageSequence(input_image_files[f_n]);
+			}
 
-				// Print the results here
-				au_output_file << successes_video[frame] << " ";
-				for(auto au_it = au_preds.begin(); au_it != au_preds.end(); ++au_it)
+			Psyche::AUFrameFunction show_frame;
+			if(visualise)
+			{
+				show_frame = [](Mat& captured_image, const CLMTracker::CLM& clm_model)
 				{
-					au_output_file << au_it->second << " ";					
-				}
-				au_output_file << endl;
+					CLMTracker::Draw(captured_image, clm_model.detected_landmarks);
 
-				CLMTracker::Draw(captured_image, clm_model.detected_landmarks);
+					cv::imshow("Rerun", captured_image);
+					cv::waitKey(1);
+				};
+			}
 
-				cv::imshow("Rerun", captured_image);
-				cv::waitKey(1);
-			}			
-			au_output_file.close();
+			if(!Psyche::WriteAUsSecondPass(output_aus[f_n], frame_source, tracked_frames, clm_model, face_analyser, show_frame))
+			{
+				ERROR_STREAM( "Could not open the output file " << output_aus[f_n] );
+				return 1;
+			}
 		}
 
 		frame_count = 0;
-		curr_img = -1;
 
 		// Reset the model, for the next video
 		clm_model.Reset();
 
-		pose_output_file.close();
-		landmarks_output_file.close();
+		if(pose_output_file)
+		{
+			pose_output_file->Close();
+		}
+		if(landmarks_output_file)
+		{
+			landmarks_output_file->Close();
+		}
+		if(params_output_file)
+		{
+			params_output_file->Close();
+		}
 
 		// break out of the loop if done with all the files (or using a webcam)
 		if(f_n == files.size() -1 || files.empty())
@@ -881,6 +1196,8 @@ int main (int argc, char **argv)
 		}
 	}
 
+	CLMTracker::Profiler::WriteReports(clm_parameters.profile_location, clm_parameters.trace_location);
+
 	return 0;
 }
 
@@ -50,6 +50,7 @@
 
 // MultiTrackCLM.cpp : Defines the entry point for the multiple face tracking console application.
 #include "CLM_core.h"
+#include "FaceAnalyserPool.h"
 
 #include <fstream>
 #include <sstream>
@@ -93,6 +94,62 @@ vector<string> get_arguments(int argc, char **argv)
 	return arguments;
 }
 
+// Action Unit outputs, -au turns on the analysis without writing it out, -au_stride analyses only every n-th frame (the AU intensities in between lag towards the last analysis)
+void get_au_output_params(vector<string> &output_aus, bool& analyse_aus, int& analysis_stride, vector<string> &arguments)
+{
+	bool* valid = new bool[arguments.size()];
+
+	for(size_t i = 0; i < arguments.size(); ++i)
+	{
+		valid[i] = true;
+	}
+
+	string output_root = "";
+
+	for(size_t i = 0; i < arguments.size(); ++i)
+	{
+		if (arguments[i].compare("-root") == 0) 
+		{                    
+			output_root = arguments[i + 1];
+			i++;
+		}
+	}
+
+	for(size_t i = 0; i < arguments.size(); ++i)
+	{
+		if(arguments[i].compare("-oaus") == 0) 
+		{
+			output_aus.push_back(output_root + arguments[i + 1]);
+			analyse_aus = true;
+			valid[i] = false;
+			valid[i+1] = false;			
+			i++;
+		}
+		else if(arguments[i].compare("-au") == 0) 
+		{
+			analyse_aus = true;
+			valid[i] = false;
+		}
+		else if(arguments[i].compare("-au_stride") == 0) 
+		{
+			analysis_stride = stoi(arguments[i + 1]);
+			valid[i] = false;
+			valid[i+1] = false;			
+			i++;
+		}
+	}
+
+	for(int i=arguments.size()-1; i >= 0; --i)
+	{
+		if(!valid[i])
+		{
+			arguments.erase(arguments.begin()+i);
+		}
+	}
+
+	delete[] valid;
+}
+
 void NonOverlapingDetections(const vector<CLMTracker::CLM>& clm_models, vector<Rect_<double> >& face_detections)
 {
 
@@ -132,6 +189,9 @@ int main (int argc, char **argv)
     float fx = 600, fy = 600, cx = 0, cy = 0;
 			
 	CLMTracker::CLMParameters clm_params(arguments);
+
+	// Per stage timings (-profile <file.json>) and Chrome trace (-trace <file.json>)
+	CLMTracker::Profiler::Configure(clm_params.profile_location, clm_params.trace_location);
 	clm_params.use_face_template = true;	
 	// This is so that the model would not try re-initialising itself
 	clm_params.reinit_video_every = -1;
@@ -144,8 +204,22 @@ int main (int argc, char **argv)
 	// Get the input output file parameters
 	bool use_camera_plane_pose;
 	CLMTracker::get_video_input_output_params(files, depth_directories, pose_output_files, tracked_videos_output, landmark_output_files, landmark_3D_output_files, use_camera_plane_pose, arguments);
+
+	// In quiet (headless) mode no windows are shown and no keys are polled, the tracking
+	// results are only drawn if they are written out to a video
+	bool visualise = !clm_params.quiet_mode;
+	bool draw_tracking = visualise || !tracked_videos_output.empty();
 	// Get camera parameters
 	CLMTracker::get_camera_params(device, fx, fy, cx, cy, arguments);    
+
+	// Raw luma frames from a file or a pipe instead of a video (-raw <width> <height>)
+	int raw_width, raw_height, raw_chroma_bytes;
+	CLMTracker::get_raw_input_params(raw_width, raw_height, raw_chroma_bytes, arguments);
+
+	vector<string> output_aus;
+	bool analyse_aus = false;
+	int analysis_stride = 1;
+	get_au_output_params(output_aus, analyse_aus, analysis_stride, arguments);
 	
 	// The modules that are being used for tracking
 	vector<CLMTracker::CLM> clm_models;
@@ -168,6 +242,25 @@ int main (int argc, char **argv)
 		active_models.push_back(false);
 		clm_parameters.push_back(clm_params);
 	}
+
+	// One face analyser per tracker slot, sharing the AU models
+	boost::filesystem::path root = boost::filesystem::path(argv[0]).parent_path();
+
+	string face_analyser_loc("./AU_predictors/AU_SVM_BP4D_best.txt");
+	string face_analyser_loc_av("./AV_regressors/av_regressors.txt");
+	string tri_location("./model/tris_68_full.txt");
+	
+	if(!boost::filesystem::exists(boost::filesystem::path(face_analyser_loc)))
+	{
+		face_analyser_loc = (root / boost::filesystem::path(face_analyser_loc)).string();
+		face_analyser_loc_av = (root / boost::filesystem::path(face_analyser_loc_av)).string();
+		tri_location = (root / boost::filesystem::path(tri_location)).string();
+	}
+
+	vector<Vec3d> orientations;
+	orientations.push_back(Vec3d(0.0,0.0,0.0));
+	Psyche::FaceAnalyserPool face_analysers(analyse_aus ? num_faces_max : 0, orientations, 0.7, 112, 112, face_analyser_loc, face_analyser_loc_av, tri_location);
+	face_analysers.SetAnalysisStride(analysis_stride);
 	
 	// If multiple video files are tracked, use this to indicate if we are done
 	bool done = false;	
@@ -194,28 +287,23 @@ int main (int argc, char **argv)
 
 		bool use_depth = !depth_directories.empty();	
 
-		// Do some grabbing
-		VideoCapture video_capture;
+		// Do some grabbing, the frames are decoded (and converted to grayscale) ahead on a background thread
+		CLMTracker::FrameSource frame_source;
 		if( current_file.size() > 0 )
 		{
 			INFO_STREAM( "Attempting to read from file: " << current_file );
-			video_capture = VideoCapture( current_file );
 		}
 		else
 		{
 			INFO_STREAM( "Attempting to capture from device: " << device );
-			video_capture = VideoCapture( device );
-
-			// Read a first frame often empty in camera
-			Mat captured_image;
-			video_capture >> captured_image;
 		}
 
-		if( !video_capture.isOpened() ) FATAL_STREAM( "Failed to open video source" );
+		if( !frame_source.Open(current_file, device, raw_width, raw_height, raw_chroma_bytes) ) FATAL_STREAM( "Failed to open video source" );
 		else INFO_STREAM( "Device or file opened");
 
 		Mat captured_image;
-		video_capture >> captured_image;		
+		Mat_<uchar> grayscale_image;
+		frame_source.Read(captured_image, grayscale_image);
 		
 
 		// If optical centers are not defined just use center of image
@@ -225,18 +313,34 @@ int main (int argc, char **argv)
 			cy = captured_image.rows / 2.0f;
 		}
 	
-		// Creating output files
-		std::ofstream pose_output_file;
+		// Creating output files, the format is picked from the extension (.bin, .binz or text)
+		unique_ptr<CLMTracker::OutputSink> pose_output_file;
 		if(!pose_output_files.empty())
 		{
-			pose_output_file.open (pose_output_files[f_n]);
+			vector<string> columns = {"frame", "model"};
+			pose_output_file = CLMTracker::OpenOutputSink(pose_output_files[f_n], CLMTracker::PoseColumnNames(columns));
+			if(!pose_output_file)
+			{
+				ERROR_STREAM( "Could not open the output file " << pose_output_files[f_n] );
+				return 1;
+			}
 		}
 	
-		std::ofstream landmarks_output_file;		
+		unique_ptr<CLMTracker::OutputSink> landmarks_output_file;		
 		if(!landmark_output_files.empty())
 		{
-			landmarks_output_file.open(landmark_output_files[f_n]);
+			vector<string> columns = {"frame", "model"};
+			landmarks_output_file = CLMTracker::OpenOutputSink(landmark_output_files[f_n], CLMTracker::LandmarkColumnNames(columns, clm_models[0].pdm.NumberOfPoints()), CLMTracker::PaddedTextLayout());
+			if(!landmarks_output_file)
+			{
+				ERROR_STREAM( "Could not open the output file " << landmark_output_files[f_n] );
+				return 1;
+			}
 		}
+
+		// Opened once the AU names are known (on the first prediction)
+		unique_ptr<CLMTracker::OutputSink> au_output_file;
+		vector<double> output_row;
 	
 		int frame_count = 0;
 		
@@ -256,19 +360,13 @@ int main (int argc, char **argv)
 		while(!captured_image.empty())
 		{		
 
-			// Reading the images
+			// Reading the images, the grayscale version comes from the frame source
 			Mat_<float> depth_image;
-			Mat_<uchar> grayscale_image;
 
-			Mat disp_image = captured_image.clone();
-
-			if(captured_image.channels() == 3)
-			{
-				cvtColor(captured_image, grayscale_image, CV_BGR2GRAY);				
-			}
-			else
+			Mat disp_image;
+			if(draw_tracking)
 			{
-				grayscale_image = captured_image.clone();				
+				disp_image = captured_image.clone();
 			}
 		
 			// Get depth image
@@ -371,71 +469,115 @@ int main (int argc, char **argv)
 					detection_success = CLMTracker::DetectLandmarksInVideo(grayscale_image, depth_image, clm_models[model], clm_parameters[model]);
 				}
 			});
+
+			// AU analysis of every tracked face (in parallel), the slots pick up on tracker resets themselves
+			if(analyse_aus)
+			{
+				face_analysers.AddNextFrame(captured_image, clm_models, 0);
+
+				if(!output_aus.empty())
+				{
+					for(int model = 0; model < face_analysers.GetNumSlots(); ++model)
+					{
+						if(face_analysers.IsSlotAnalysed(model))
+						{
+							auto au_preds = face_analysers.GetAnalyser(model).GetCurrentAUsReg();
+
+							if(!au_output_file)
+							{
+								vector<string> columns = {"frame", "model"};
+								for(auto au_it = au_preds.begin(); au_it != au_preds.end(); ++au_it)
+								{
+									columns.push_back(au_it->first);
+								}
+								au_output_file = CLMTracker::OpenOutputSink(output_aus[f_n], columns);
+								if(!au_output_file)
+								{
+									ERROR_STREAM( "Could not open the output file " << output_aus[f_n] );
+									return 1;
+								}
+							}
+
+							output_row.clear();
+							output_row.push_back(frame_count);
+							output_row.push_back(model);
+							for(auto au_it = au_preds.begin(); au_it != au_preds.end(); ++au_it)
+							{
+								output_row.push_back(au_it->second);
+							}
+							au_output_file->WriteRow(output_row);
+						}
+					}
+				}
+			}
 								
-			// Go through every model and visualise the results
-			for(size_t model = 0; model < clm_models.size(); ++model)
-			{						
-				// Visualising the results
-				// Drawing the facial landmarks on the face and the bounding box around it if tracking is successful and initialised
-				double detection_certainty = clm_models[model].detection_certainty;
-
-				double visualisation_boundary = -0.1;
+			if(draw_tracking)
+			{
+				// Go through every model and visualise the results
+				for(size_t model = 0; model < clm_models.size(); ++model)
+				{						
+					// Visualising the results
+					// Drawing the facial landmarks on the face and the bounding box around it if tracking is successful and initialised
+					double detection_certainty = clm_models[model].detection_certainty;
+
+					double visualisation_boundary = -0.1;
 			
-				// Only draw if the reliability is reasonable, the value is slightly ad-hoc
-				if(detection_certainty < visualisation_boundary)
-				{
-					CLMTracker::Draw(disp_image, clm_models[model]);
+					// Only draw if the reliability is reasonable, the value is slightly ad-hoc
+					if(detection_certainty < visualisation_boundary)
+					{
+						CLMTracker::Draw(disp_image, clm_models[model]);
 
-					if(detection_certainty > 1)
-						detection_certainty = 1;
-					if(detection_certainty < -1)
-						detection_certainty = -1;
+						if(detection_certainty > 1)
+							detection_certainty = 1;
+						if(detection_certainty < -1)
+							detection_certainty = -1;
 
-					detection_certainty = (detection_certainty + 1)/(visualisation_boundary +1);
+						detection_certainty = (detection_certainty + 1)/(visualisation_boundary +1);
 
-					// A rough heuristic for box around the face width
-					int thickness = (int)std::ceil(2.0* ((double)captured_image.cols) / 640.0);
+						// A rough heuristic for box around the face width
+						int thickness = (int)std::ceil(2.0* ((double)captured_image.cols) / 640.0);
 					
-					// Work out the pose of the head from the tracked model
-					Vec6d pose_estimate_CLM = CLMTracker::GetCorrectedPoseCameraPlane(clm_models[model], fx, fy, cx, cy, clm_parameters[model]);
+						// Work out the pose of the head from the tracked model
+						Vec6d pose_estimate_CLM = CLMTracker::GetCorrectedPoseCameraPlane(clm_models[model], fx, fy, cx, cy, clm_parameters[model]);
 					
-					// Draw it in reddish if uncertain, blueish if certain
-					CLMTracker::DrawBox(disp_image, pose_estimate_CLM, Scalar((1-detection_certainty)*255.0,0, detection_certainty*255), thickness, fx, fy, cx, cy);
+						// Draw it in reddish if uncertain, blueish if certain
+						CLMTracker::DrawBox(disp_image, pose_estimate_CLM, Scalar((1-detection_certainty)*255.0,0, detection_certainty*255), thickness, fx, fy, cx, cy);
+					}
 				}
-			}
 
-			// Work out the framerate
-			if(frame_count % 10 == 0)
-			{      
-				t1 = cv::getTickCount();
-				fps = 10.0 / (double(t1-t0)/cv::getTickFrequency()); 
-				t0 = t1;
-			}
+				// Work out the framerate
+				if(frame_count % 10 == 0)
+				{      
+					t1 = cv::getTickCount();
+					fps = 10.0 / (double(t1-t0)/cv::getTickFrequency()); 
+					t0 = t1;
+				}
 			
-			// Write out the framerate on the image before displaying it
-			char fpsC[255];
-			sprintf(fpsC, "%d", (int)fps);
-			string fpsSt("FPS:");
-			fpsSt += fpsC;
-			cv::putText(disp_image, fpsSt, cv::Point(10,20), CV_FONT_HERSHEY_SIMPLEX, 0.5, CV_RGB(255,0,0));		
+				// Write out the framerate on the image before displaying it
+				char fpsC[255];
+				sprintf(fpsC, "%d", (int)fps);
+				string fpsSt("FPS:");
+				fpsSt += fpsC;
+				cv::putText(disp_image, fpsSt, cv::Point(10,20), CV_FONT_HERSHEY_SIMPLEX, 0.5, CV_RGB(255,0,0));		
 			
-			int num_active_models = 0;
+				int num_active_models = 0;
 
-			for( size_t active_model = 0; active_model < active_models.size(); active_model++)
-			{
-				if(active_models[active_model])
+				for( size_t active_model = 0; active_model < active_models.size(); active_model++)
 				{
-					num_active_models++;
+					if(active_models[active_model])
+					{
+						num_active_models++;
+					}
 				}
-			}
 
-			char active_m_C[255];
-			sprintf(active_m_C, "%d", num_active_models);
-			string active_models_st("Active models:");
-			active_models_st += active_m_C;
-			cv::putText(disp_image, active_models_st, cv::Point(10,60), CV_FONT_HERSHEY_SIMPLEX, 0.5, CV_RGB(255,0,0));		
+				char active_m_C[255];
+				sprintf(active_m_C, "%d", num_active_models);
+				string active_models_st("Active models:");
+				active_models_st += active_m_C;
+				cv::putText(disp_image, active_models_st, cv::Point(10,60), CV_FONT_HERSHEY_SIMPLEX, 0.5, CV_RGB(255,0,0));		
+			}
 			
-			if(!clm_parameters[0].quiet_mode)
+			if(visualise)
 			{
 				namedWindow("tracking_result",1);		
 				imshow("tracking_result", disp_image);
@@ -453,28 +595,33 @@ int main (int argc, char **argv)
 				writerFace << disp_image;
 			}
 
-			video_capture >> captured_image;
+			frame_source.Read(captured_image, grayscale_image);
 		
-			// detect key presses
-			char character_press = cv::waitKey(1);
-			
-			// restart the trackers
-			if(character_press == 'r')
+			// detect key presses (only when there is a window to press them in)
+			if(visualise)
 			{
-				for(size_t i=0; i < clm_models.size(); ++i)
+				char character_press = cv::waitKey(1);
+			
+				// restart the trackers
+				if(character_press == 'r')
 				{
-					clm_models[i].Reset();
-					active_models[i] = false;
+					for(size_t i=0; i < clm_models.size(); ++i)
+					{
+						clm_models[i].Reset();
+						active_models[i] = false;
+					}
+					face_analysers.Reset();
+				}
+				// quit the application
+				else if(character_press=='q')
+				{
+					return(0);
 				}
-			}
-			// quit the application
-			else if(character_press=='q')
-			{
-				return(0);
 			}
 
 			// Update the frame count
 			frame_count++;
+			CLMTracker::Profiler::NextFrame();
 		}
 		
 		frame_count = 0;
@@ -485,8 +632,20 @@ int main (int argc, char **argv)
 			clm_models[model].Reset();
 			active_models[model] = false;
 		}
-		pose_output_file.close();
-		landmarks_output_file.close();
+		face_analysers.Reset();
+
+		if(pose_output_file)
+		{
+			pose_output_file->Close();
+		}
+		if(landmarks_output_file)
+		{
+			landmarks_output_file->Close();
+		}
+		if(au_output_file)
+		{
+			au_output_file->Close();
+		}
 
 		// break out of the loop if done with all the files
 		if(f_n == files.size() -1)
@@ -495,6 +654,8 @@ int main (int argc, char **argv)
 		}
 	}
 
+	CLMTracker::Profiler::WriteReports(clm_params.profile_location, clm_params.trace_location);
+
 	return 0;
 }
 
@@ -148,6 +148,13 @@ int main (int argc, char **argv)
     float fx = 500, fy = 500, cx = 0, cy = 0;
 			
 	CLMTracker::CLMParameters clm_parameters(arguments);
+
+	// Per stage timings (-profile <file.json>) and Chrome trace (-trace <file.json>)
+	CLMTracker::Profiler::Configure(clm_parameters.profile_location, clm_parameters.trace_location);
+
+	// In quiet (headless) mode no windows are shown and no keys are polled, the tracking
+	// results are only drawn if they are written out to a video
+	bool visualise = !clm_parameters.quiet_mode;
 			
 	// Get the input output file parameters
 	
@@ -156,6 +163,10 @@ int main (int argc, char **argv)
 	CLMTracker::get_video_input_output_params(files, depth_directories, pose_output_files, tracked_videos_output, landmark_output_files, landmark_output_3D_files, use_camera_plane_pose, arguments);
 	// Get camera parameters
 	CLMTracker::get_camera_params(device, fx, fy, cx, cy, arguments);    
+
+	// Raw luma frames from a file or a pipe instead of a video (-raw <width> <height>)
+	int raw_width, raw_height, raw_chroma_bytes;
+	CLMTracker::get_raw_input_params(raw_width, raw_height, raw_chroma_bytes, arguments);
 	
 	vector<string> output_av_files;
 	get_output_feature_params(output_av_files, arguments);
@@ -213,28 +224,23 @@ int main (int argc, char **argv)
 
 		bool use_depth = !depth_directories.empty();	
 
-		// Do some grabbing
-		VideoCapture video_capture;
+		// Do some grabbing, the frames are decoded (and converted to grayscale) ahead on a background thread
+		CLMTracker::FrameSource frame_source;
 		if( current_file.size() > 0 )
 		{
 			INFO_STREAM( "Attempting to read from file: " << current_file );
-			video_capture = VideoCapture( current_file );
 		}
 		else
 		{
 			INFO_STREAM( "Attempting to capture from device: " << device );
-			video_capture = VideoCapture( device );
-
-			// Read a first frame often empty in camera
-			Mat captured_image;
-			video_capture >> captured_image;
 		}
 
-		if( !video_capture.isOpened() ) FATAL_STREAM( "Failed to open video source" );
+		if( !frame_source.Open(current_file, device, raw_width, raw_height, raw_chroma_bytes) ) FATAL_STREAM( "Failed to open video source" );
 		else INFO_STREAM( "Device or file opened");
 
 		Mat captured_image;
-		video_capture >> captured_image;		
+		Mat_<uchar> grayscale_image;
+		frame_source.Read(captured_image, grayscale_image);
 		
 		// If optical centers are not defined just use center of image
 		if(cx_undefined)
@@ -243,25 +249,38 @@ int main (int argc, char **argv)
 			cy = captured_image.rows / 2.0f;
 		}
 	
-		// Creating output files
-		std::ofstream pose_output_file;
-		if(!pose_output_files.empty())
-		{
-			pose_output_file.open (pose_output_files[f_n]);
-		}
+		// Creating output files, the format is picked from the extension (.bin, .binz or text)
+		// The pose file holds the AU predictions, it is opened once the AU names are known
+		unique_ptr<CLMTracker::OutputSink> pose_output_file;
+		vector<vector<double> > pending_pose_rows;
 	
-		std::ofstream landmarks_output_file;		
+		unique_ptr<CLMTracker::OutputSink> landmarks_output_file;		
 		if(!landmark_output_files.empty())
 		{
-			landmarks_output_file.open(landmark_output_files[f_n]);
+			vector<string> columns = {"frame", "success"};
+			landmarks_output_file = CLMTracker::OpenOutputSink(landmark_output_files[f_n], CLMTracker::LandmarkColumnNames(columns, clm_model.pdm.NumberOfPoints()), CLMTracker::PaddedTextLayout());
+			if(!landmarks_output_file)
+			{
+				ERROR_STREAM( "Could not open the output file " << landmark_output_files[f_n] );
+				return 1;
+			}
 		}
 	
-		std::ofstream avs_output_file;		
+		unique_ptr<CLMTracker::OutputSink> avs_output_file;		
 		if(!output_av_files.empty())
 		{
-			avs_output_file.open(output_av_files[f_n]);
+			vector<string> columns = {"success", "arousal", "valence"};
+			avs_output_file = CLMTracker::OpenOutputSink(output_av_files[f_n], columns);
+			if(!avs_output_file)
+			{
+				ERROR_STREAM( "Could not open the output file " << output_av_files[f_n] );
+				return 1;
+			}
 		}
 
+		// Reused for every output row
+		vector<double> output_row;
+
 		int frame_count = 0;
 		
 		// saving the videos
@@ -275,7 +294,7 @@ int main (int argc, char **argv)
 		int64 t1,t0 = cv::getTickCount();
 		double fps = 10;
 
-		double fps_vid = video_capture.get(CV_CAP_PROP_FPS);
+		double fps_vid = frame_source.GetFPS();
 
 		if(fps_vid == 0.0)
 		{
@@ -290,19 +309,9 @@ int main (int argc, char **argv)
 		while(!captured_image.empty())
 		{		
 
-			// Reading the images
+			// Reading the images, the grayscale version comes from the frame source
 			Mat_<float> depth_image;
-			Mat_<uchar> grayscale_image;
 
-			if(captured_image.channels() == 3)
-			{
-				cvtColor(captured_image, grayscale_image, CV_BGR2GRAY);				
-			}
-			else
-			{
-				grayscale_image = captured_image.clone();				
-			}
-		
 			// Get depth image
 			if(use_depth)
 			{
@@ -369,91 +378,134 @@ int main (int argc, char **argv)
 				//au_preds = face_analyser.GetCurrentAUs();
 			}
 
-			if(!output_av_files.empty())
+			if(avs_output_file)
 			{
-				avs_output_file << detection_success << " " << face_analyser.GetCurrentArousal() << " " << face_analyser.GetCurrentValence() << endl;
+				output_row.clear();
+				output_row.push_back(detection_success);
+				output_row.push_back(face_analyser.GetCurrentArousal());
+				output_row.push_back(face_analyser.GetCurrentValence());
+				avs_output_file->WriteRow(output_row);
 			}
 
 			// Output the estimated head pose
 			if(!pose_output_files.empty())
 			{
-				pose_output_file << frame_count + 1 << " " << (float)frame_count /fps_vid  << " " << detection_success << " ";
+				output_row.clear();
+				output_row.push_back(frame_count + 1);
+				output_row.push_back((float)frame_count /fps_vid);
+				output_row.push_back(detection_success);
 				
 				for(auto au_it = au_preds.begin(); au_it != au_preds.end(); ++au_it)
 				{
-					pose_output_file << au_it->second << " ";					
+					output_row.push_back(au_it->second);
+				}
+
+				if(!pose_output_file && !au_preds.empty())
+				{
+					vector<string> columns = {"frame", "timestamp", "success"};
+					for(auto au_it = au_preds.begin(); au_it != au_preds.end(); ++au_it)
+					{
+						columns.push_back(au_it->first);
+					}
+					pose_output_file = CLMTracker::OpenOutputSink(pose_output_files[f_n], columns, CLMTracker::TrailingSpaceTextLayout());
+					if(!pose_output_file)
+					{
+						ERROR_STREAM( "Could not open the output file " << pose_output_files[f_n] );
+						return 1;
+					}
+
+					for(size_t i = 0; i < pending_pose_rows.size(); ++i)
+					{
+						pose_output_file->WriteRow(pending_pose_rows[i]);
+					}
+					pending_pose_rows.clear();
+				}
+
+				if(pose_output_file)
+				{
+					pose_output_file->WriteRow(output_row);
+				}
+				else
+				{
+					pending_pose_rows.push_back(output_row);
 				}
-				pose_output_file << endl;
 			}		
-			// Visualising the results
-			// Drawing the facial landmarks on the face and the bounding box around it if tracking is successful and initialised
-			double detection_certainty = clm_model.detection_certainty;
+			if(visualise || !tracked_videos_output.empty())
+			{
+				// Visualising the results
+				// Drawing the facial landmarks on the face and the bounding box around it if tracking is successful and initialised
+				double detection_certainty = clm_model.detection_certainty;
 
-			double visualisation_boundary = 0.2;
+				double visualisation_boundary = 0.2;
 			
-			// Only draw if the reliability is reasonable, the value is slightly ad-hoc
-			if(detection_certainty < visualisation_boundary)
-			{
-				CLMTracker::Draw(captured_image, clm_model);
+				// Only draw if the reliability is reasonable, the value is slightly ad-hoc
+				if(detection_certainty < visualisation_boundary)
+				{
+					CLMTracker::Draw(captured_image, clm_model);
 
-				if(detection_certainty > 1)
-					detection_certainty = 1;
-				if(detection_certainty < -1)
-					detection_certainty = -1;
+					if(detection_certainty > 1)
+						detection_certainty = 1;
+					if(detection_certainty < -1)
+						detection_certainty = -1;
 
-				detection_certainty = (detection_certainty + 1)/(visualisation_boundary +1);
+					detection_certainty = (detection_certainty + 1)/(visualisation_boundary +1);
 
-				// A rough heuristic for box around the face width
-				int thickness = (int)std::ceil(2.0* ((double)captured_image.cols) / 640.0);
+					// A rough heuristic for box around the face width
+					int thickness = (int)std::ceil(2.0* ((double)captured_image.cols) / 640.0);
 				
-				Vec6d pose_estimate_to_draw = CLMTracker::GetCorrectedPoseCameraPlane(clm_model, fx, fy, cx, cy, clm_parameters);
+					Vec6d pose_estimate_to_draw = CLMTracker::GetCorrectedPoseCameraPlane(clm_model, fx, fy, cx, cy, clm_parameters);
 
-				// Draw it in reddish if uncertain, blueish if certain
-				CLMTracker::DrawBox(captured_image, pose_estimate_to_draw, Scalar((1-detection_certainty)*255.0,0, detection_certainty*255), thickness, fx, fy, cx, cy);
+					// Draw it in reddish if uncertain, blueish if certain
+					CLMTracker::DrawBox(captured_image, pose_estimate_to_draw, Scalar((1-detection_certainty)*255.0,0, detection_certainty*255), thickness, fx, fy, cx, cy);
 
-			}
+				}
 
-			vector<Mat> face_neutral_images;
-			vector<Mat> neutral_hogs;
-			vector<Vec3d> orientations;
-			face_analyser.ExtractCurrentMedians(neutral_hogs, face_neutral_images, orientations);
+				// The neutral faces are only extracted for display
+				if(visualise)
+				{
+					vector<Mat> face_neutral_images;
+					vector<Mat> neutral_hogs;
+					vector<Vec3d> orientations;
+					face_analyser.ExtractCurrentMedians(neutral_hogs, face_neutral_images, orientations);
 
-			for(size_t i = 0; i < orientations.size(); ++i)
-			{
+					for(size_t i = 0; i < orientations.size(); ++i)
+					{
 		
-				// Writing out the hog files
-
-				if(sum(face_neutral_images[i])[0] > 0.0001)
-				{
-					// TODO rem
-					stringstream sstream;			
-					sstream << "Neutral face" << i;
-					cv::imshow(sstream.str(), face_neutral_images[i]);
-
-					//stringstream sstream2;			
-					//sstream2 << "Hog face" << i;
-					//Mat_<double> hog;
-					//Psyche::Visualise_FHOG(neutral_hogs[i], 10, 10, hog);
-					//cv::imshow(sstream2.str(), hog);
+						// Writing out the hog files
+
+						if(sum(face_neutral_images[i])[0] > 0.0001)
+						{
+							// TODO rem
+							stringstream sstream;			
+							sstream << "Neutral face" << i;
+							cv::imshow(sstream.str(), face_neutral_images[i]);
+
+							//stringstream sstream2;			
+							//sstream2 << "Hog face" << i;
+							//Mat_<double> hog;
+							//Psyche::Visualise_FHOG(neutral_hogs[i], 10, 10, hog);
+							//cv::imshow(sstream2.str(), hog);
+						}
+					}
 				}
-			}
 
-			// Work out the framerate
-			if(frame_count % 10 == 0)
-			{      
-				t1 = cv::getTickCount();
-				fps = 10.0 / (double(t1-t0)/cv::getTickFrequency()); 
-				t0 = t1;
-			}
+				// Work out the framerate
+				if(frame_count % 10 == 0)
+				{      
+					t1 = cv::getTickCount();
+					fps = 10.0 / (double(t1-t0)/cv::getTickFrequency()); 
+					t0 = t1;
+				}
 			
-			// Write out the framerate on the image before displaying it
-			char fpsC[255];
-			sprintf(fpsC, "%d", (int)fps);
-			string fpsSt("FPS:");
-			fpsSt += fpsC;
-			cv::putText(captured_image, fpsSt, cv::Point(10,20), CV_FONT_HERSHEY_SIMPLEX, 0.5, CV_RGB(255,0,0));		
+				// Write out the framerate on the image before displaying it
+				char fpsC[255];
+				sprintf(fpsC, "%d", (int)fps);
+				string fpsSt("FPS:");
+				fpsSt += fpsC;
+				cv::putText(captured_image, fpsSt, cv::Point(10,20), CV_FONT_HERSHEY_SIMPLEX, 0.5, CV_RGB(255,0,0));		
+			}
 			
-			if(!clm_parameters.quiet_mode)
+			if(visualise)
 			{
 				namedWindow("tracking_result",1);		
 				imshow("tracking_result", captured_image);
@@ -466,14 +518,13 @@ int main (int argc, char **argv)
 			}
 
 			// Output the detected facial landmarks
-			if(!landmark_output_files.empty())
+			if(landmarks_output_file)
 			{
-				landmarks_output_file << frame_count + 1 << " " << detection_success;
-				for (int i = 0; i < clm_model.pdm.NumberOfPoints() * 2; ++ i)
-				{
-					landmarks_output_file << " " << clm_model.detected_landmarks.at<double>(i) << " ";
-				}
-				landmarks_output_file << endl;
+				output_row.clear();
+				output_row.push_back(frame_count + 1);
+				output_row.push_back(detection_success);
+				output_row.insert(output_row.end(), clm_model.detected_landmarks.begin(), clm_model.detected_landmarks.end());
+				landmarks_output_file->WriteRow(output_row);
 			}
 		
 			// output the tracked video
@@ -482,29 +533,36 @@ int main (int argc, char **argv)
 				writerFace << captured_image;
 			}
 
-			video_capture >> captured_image;
+			frame_source.Read(captured_image, grayscale_image);
 		
-			// detect key presses
-			char character_press = cv::waitKey(1);
-			
-			// restart the tracker
-			if(character_press == 'r')
-			{
-				clm_model.Reset();
-				face_analyser.Reset();
-			}
-			// quit the application
-			else if(character_press=='q')
+			// detect key presses (only when there is a window to press them in)
+			if(visualise)
 			{
-				return(0);
+				char character_press = cv::waitKey(1);
+			
+				// restart the tracker
+				if(character_press == 'r')
+				{
+					clm_model.Reset();
+					face_analyser.Reset();
+				}
+				// quit the application
+				else if(character_press=='q')
+				{
+					return(0);
+				}
 			}
 
 			// Update the frame count
 			frame_count++;
+			CLMTracker::Profiler::NextFrame();
 
 		}
 		
-		avs_output_file.close();
+		if(avs_output_file)
+		{
+			avs_output_file->Close();
+		}
 
 		face_analyser.ResetAV();
 
@@ -513,8 +571,30 @@ int main (int argc, char **argv)
 		// Reset the model, for the next video
 		clm_model.Reset();
 
-		pose_output_file.close();
-		landmarks_output_file.close();
+		// No face was analysed, write out the frames without AU columns
+		if(!pose_output_files.empty() && !pose_output_file)
+		{
+			vector<string> columns = {"frame", "timestamp", "success"};
+			pose_output_file = CLMTracker::OpenOutputSink(pose_output_files[f_n], columns, CLMTracker::TrailingSpaceTextLayout());
+			if(!pose_output_file)
+			{
+				ERROR_STREAM( "Could not open the output file " << pose_output_files[f_n] );
+				return 1;
+			}
+			for(size_t i = 0; i < pending_pose_rows.size(); ++i)
+			{
+				pose_output_file->WriteRow(pending_pose_rows[i]);
+			}
+		}
+
+		if(pose_output_file)
+		{
+			pose_output_file->Close();
+		}
+		if(landmarks_output_file)
+		{
+			landmarks_output_file->Close();
+		}
 
 		// break out of the loop if done with all the files (or using a webcam)
 		if(f_n == files.size() -1 || files.empty())
@@ -523,6 +603,8 @@ int main (int argc, char **argv)
 		}
 	}
 
+	CLMTracker::Profiler::WriteReports(clm_parameters.profile_location, clm_parameters.trace_location);
+
 	return 0;
 }
 
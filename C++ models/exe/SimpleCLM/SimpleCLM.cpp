@@ -105,6 +105,13 @@ int main (int argc, char **argv)
 			
 	CLMTracker::CLMParameters clm_parameters(arguments);
 
+	// Per stage timings (-profile <file.json>) and Chrome trace (-trace <file.json>)
+	CLMTracker::Profiler::Configure(clm_parameters.profile_location, clm_parameters.trace_location);
+
+	// In quiet (headless) mode no windows are shown and no keys are polled, the tracking
+	// results are only drawn if they are written out to a video
+	bool visualise = !clm_parameters.quiet_mode;
+
 	// Get the input output file parameters
 	
 	// Indicates that rotation should be with respect to camera plane or with respect to camera
@@ -112,6 +119,10 @@ int main (int argc, char **argv)
 	CLMTracker::get_video_input_output_params(files, depth_directories, pose_output_files, tracked_videos_output, landmark_output_files, landmark_3D_output_files, use_camera_plane_pose, arguments);
 	// Get camera parameters
 	CLMTracker::get_camera_params(device, fx, fy, cx, cy, arguments);    
+
+	// Raw luma frames from a file or a pipe instead of a video (-raw <width> <height>)
+	int raw_width, raw_height, raw_chroma_bytes;
+	CLMTracker::get_raw_input_params(raw_width, raw_height, raw_chroma_bytes, arguments);
 	
 	// The modules that are being used for tracking
 	CLMTracker::CLM clm_model(clm_parameters.model_location);	
@@ -146,28 +157,23 @@ int main (int argc, char **argv)
 
 		bool use_depth = !depth_directories.empty();	
 
-		// Do some grabbing
-		VideoCapture video_capture;
+		// Do some grabbing, the frames are decoded (and converted to grayscale) ahead on a background thread
+		CLMTracker::FrameSource frame_source;
 		if( current_file.size() > 0 )
 		{
 			INFO_STREAM( "Attempting to read from file: " << current_file );
-			video_capture = VideoCapture( current_file );
 		}
 		else
 		{
 			INFO_STREAM( "Attempting to capture from device: " << device );
-			video_capture = VideoCapture( device );
-
-			// Read a first frame often empty in camera
-			Mat captured_image;
-			video_capture >> captured_image;
 		}
 
-		if( !video_capture.isOpened() ) FATAL_STREAM( "Failed to open video source" );
+		if( !frame_source.Open(current_file, device, raw_width, raw_height, raw_chroma_bytes) ) FATAL_STREAM( "Failed to open video source" );
 		else INFO_STREAM( "Device or file opened");
 
 		Mat captured_image;
-		video_capture >> captured_image;		
+		Mat_<uchar> grayscale_image;
+		frame_source.Read(captured_image, grayscale_image);
 		
 		// If optical centers are not defined just use center of image
 		if(cx_undefined)
@@ -176,24 +182,45 @@ int main (int argc, char **argv)
 			cy = captured_image.rows / 2.0f;
 		}
 	
-		// Creating output files
-		std::ofstream pose_output_file;
+		// Creating output files, the format is picked from the extension (.bin, .binz or text)
+		unique_ptr<CLMTracker::OutputSink> pose_output_file;
 		if(!pose_output_files.empty())
 		{
-			pose_output_file.open (pose_output_files[f_n], ios_base::out);
+			vector<string> columns = {"frame", "confidence", "success"};
+			pose_output_file = CLMTracker::OpenOutputSink(pose_output_files[f_n], CLMTracker::PoseColumnNames(columns));
+			if(!pose_output_file)
+			{
+				ERROR_STREAM( "Could not open the output file " << pose_output_files[f_n] );
+				return 1;
+			}
 		}
 	
-		std::ofstream landmarks_output_file;		
+		unique_ptr<CLMTracker::OutputSink> landmarks_output_file;		
 		if(!landmark_output_files.empty())
 		{
-			landmarks_output_file.open(landmark_output_files[f_n], ios_base::out);
+			vector<string> columns = {"frame", "success"};
+			landmarks_output_file = CLMTracker::OpenOutputSink(landmark_output_files[f_n], CLMTracker::LandmarkColumnNames(columns, clm_model.pdm.NumberOfPoints()), CLMTracker::PaddedTextLayout());
+			if(!landmarks_output_file)
+			{
+				ERROR_STREAM( "Could not open the output file " << landmark_output_files[f_n] );
+				return 1;
+			}
 		}
 
-		std::ofstream landmarks_3D_output_file;
+		unique_ptr<CLMTracker::OutputSink> landmarks_3D_output_file;
 		if(!landmark_3D_output_files.empty())
 		{
-			landmarks_3D_output_file.open(landmark_3D_output_files[f_n], ios_base::out);
+			vector<string> columns = {"frame", "success"};
+			landmarks_3D_output_file = CLMTracker::OpenOutputSink(landmark_3D_output_files[f_n], CLMTracker::Landmark3DColumnNames(columns, clm_model.pdm.NumberOfPoints()));
+			if(!landmarks_3D_output_file)
+			{
+				ERROR_STREAM( "Could not open the output file " << landmark_3D_output_files[f_n] );
+				return 1;
+			}
 		}
+
+		// Reused for every output row
+		vector<double> output_row;
 	
 		int frame_count = 0;
 		
@@ -212,19 +239,9 @@ int main (int argc, char **argv)
 		while(!captured_image.empty())
 		{		
 
-			// Reading the images
+			// Reading the images, the grayscale version comes from the frame source
 			Mat_<float> depth_image;
-			Mat_<uchar> grayscale_image;
 
-			if(captured_image.channels() == 3)
-			{
-				cvtColor(captured_image, grayscale_image, CV_BGR2GRAY);				
-			}
-			else
-			{
-				grayscale_image = captured_image.clone();				
-			}
-		
 			// Get depth image
 			if(use_depth)
 			{
@@ -267,11 +284,12 @@ int main (int argc, char **argv)
 
 			double visualisation_boundary = 0.2;
 			
+			bool draw_tracking = visualise || !tracked_videos_output.empty();
+
 			// Only draw if the reliability is reasonable, the value is slightly ad-hoc
 			if(detection_certainty < visualisation_boundary)
 			{
-				CLMTracker::Draw(captured_image, clm_model);
-
+				// The normalised certainty is also used for the pose output confidence
 				if(detection_certainty > 1)
 					detection_certainty = 1;
 				if(detection_certainty < -1)
@@ -279,32 +297,39 @@ int main (int argc, char **argv)
 
 				detection_certainty = (detection_certainty + 1)/(visualisation_boundary +1);
 
-				// A rough heuristic for box around the face width
-				int thickness = (int)std::ceil(2.0* ((double)captured_image.cols) / 640.0);
-				
-				Vec6d pose_estimate_to_draw = CLMTracker::GetCorrectedPoseCameraPlane(clm_model, fx, fy, cx, cy, clm_parameters);
+				if(draw_tracking)
+				{
+					CLMTracker::Draw(captured_image, clm_model);
 
-				// Draw it in reddish if uncertain, blueish if certain
-				CLMTracker::DrawBox(captured_image, pose_estimate_to_draw, Scalar((1-detection_certainty)*255.0,0, detection_certainty*255), thickness, fx, fy, cx, cy);
+					// A rough heuristic for box around the face width
+					int thickness = (int)std::ceil(2.0* ((double)captured_image.cols) / 640.0);
+				
+					Vec6d pose_estimate_to_draw = CLMTracker::GetCorrectedPoseCameraPlane(clm_model, fx, fy, cx, cy, clm_parameters);
 
+					// Draw it in reddish if uncertain, blueish if certain
+					CLMTracker::DrawBox(captured_image, pose_estimate_to_draw, Scalar((1-detection_certainty)*255.0,0, detection_certainty*255), thickness, fx, fy, cx, cy);
+				}
 			}
 
-			// Work out the framerate
-			if(frame_count % 10 == 0)
-			{      
-				t1 = cv::getTickCount();
-				fps = 10.0 / (double(t1-t0)/cv::getTickFrequency()); 
-				t0 = t1;
-			}
+			if(draw_tracking)
+			{
+				// Work out the framerate
+				if(frame_count % 10 == 0)
+				{      
+					t1 = cv::getTickCount();
+					fps = 10.0 / (double(t1-t0)/cv::getTickFrequency()); 
+					t0 = t1;
+				}
 			
-			// Write out the framerate on the image before displaying it
-			char fpsC[255];
-			sprintf(fpsC, "%d", (int)fps);
-			string fpsSt("FPS:");
-			fpsSt += fpsC;
-			cv::putText(captured_image, fpsSt, cv::Point(10,20), CV_FONT_HERSHEY_SIMPLEX, 0.5, CV_RGB(255,0,0));		
+				// Write out the framerate on the image before displaying it
+				char fpsC[255];
+				sprintf(fpsC, "%d", (int)fps);
+				string fpsSt("FPS:");
+				fpsSt += fpsC;
+				cv::putText(captured_image, fpsSt, cv::Point(10,20), CV_FONT_HERSHEY_SIMPLEX, 0.5, CV_RGB(255,0,0));		
+			}
 			
-			if(!clm_parameters.quiet_mode)
+			if(visualise)
 			{
 				namedWindow("tracking_result",1);		
 				imshow("tracking_result", captured_image);
@@ -317,33 +342,36 @@ int main (int argc, char **argv)
 			}
 
 			// Output the detected facial landmarks
-			if(!landmark_output_files.empty())
+			if(landmarks_output_file)
 			{
-				landmarks_output_file << frame_count + 1 << " " << detection_success;
-				for (int i = 0; i < clm_model.pdm.NumberOfPoints() * 2; ++ i)
-				{
-					landmarks_output_file << " " << clm_model.detected_landmarks.at<double>(i) << " ";
-				}
-				landmarks_output_file << endl;
+				output_row.clear();
+				output_row.push_back(frame_count + 1);
+				output_row.push_back(detection_success);
+				output_row.insert(output_row.end(), clm_model.detected_landmarks.begin(), clm_model.detected_landmarks.end());
+				landmarks_output_file->WriteRow(output_row);
 			}
 
 			// Output the detected facial landmarks
-			if(!landmark_3D_output_files.empty())
+			if(landmarks_3D_output_file)
 			{
-				landmarks_3D_output_file << frame_count + 1 << " " << detection_success;
 				Mat_<double> shape_3D = clm_model.GetShape(fx, fy, cx, cy);
-				for (int i = 0; i < clm_model.pdm.NumberOfPoints() * 3; ++i)
-				{
-					landmarks_3D_output_file << " " << shape_3D.at<double>(i);
-				}
-				landmarks_3D_output_file << endl;
+				output_row.clear();
+				output_row.push_back(frame_count + 1);
+				output_row.push_back(detection_success);
+				output_row.insert(output_row.end(), shape_3D.begin(), shape_3D.end());
+				landmarks_3D_output_file->WriteRow(output_row);
 			}
 
 			// Output the estimated head pose
-			if(!pose_output_files.empty())
+			if(pose_output_file)
 			{
 				double confidence = 0.5 * (1 - detection_certainty);
-				pose_output_file << frame_count + 1 << " " << confidence << " " << detection_success << " " << pose_estimate_CLM[0] << " " << pose_estimate_CLM[1] << " " << pose_estimate_CLM[2] << " " << pose_estimate_CLM[3] << " " << pose_estimate_CLM[4] << " " << pose_estimate_CLM[5] << endl;
+				output_row.clear();
+				output_row.push_back(frame_count + 1);
+				output_row.push_back(confidence);
+				output_row.push_back(detection_success);
+				output_row.insert(output_row.end(), pose_estimate_CLM.val, pose_estimate_CLM.val + 6);
+				pose_output_file->WriteRow(output_row);
 			}				
 
 			// output the tracked video
@@ -352,24 +380,28 @@ int main (int argc, char **argv)
 				writerFace << captured_image;
 			}
 
-			video_capture >> captured_image;
+			frame_source.Read(captured_image, grayscale_image);
 		
-			// detect key presses
-			char character_press = cv::waitKey(1);
-			
-			// restart the tracker
-			if(character_press == 'r')
+			// detect key presses (only when there is a window to press them in)
+			if(visualise)
 			{
-				clm_model.Reset();
-			}
-			// quit the application
-			else if(character_press=='q')
-			{
-				return(0);
+				char character_press = cv::waitKey(1);
+			
+				// restart the tracker
+				if(character_press == 'r')
+				{
+					clm_model.Reset();
+				}
+				// quit the application
+				else if(character_press=='q')
+				{
+					return(0);
+				}
 			}
 
 			// Update the frame count
 			frame_count++;
+			CLMTracker::Profiler::NextFrame();
 
 		}
 		
@@ -378,8 +410,18 @@ int main (int argc, char **argv)
 		// Reset the model, for the next video
 		clm_model.Reset();
 
-		pose_output_file.close();
-		landmarks_output_file.close();
+		if(pose_output_file)
+		{
+			pose_output_file->Close();
+		}
+		if(landmarks_output_file)
+		{
+			landmarks_output_file->Close();
+		}
+		if(landmarks_3D_output_file)
+		{
+			landmarks_3D_output_file->Close();
+		}
 
 		// break out of the loop if done with all the files (or using a webcam)
 		if(f_n == files.size() -1 || files.empty())
@@ -388,6 +430,8 @@ int main (int argc, char **argv)
 		}
 	}
 
+	CLMTracker::Profiler::WriteReports(clm_parameters.profile_location, clm_parameters.trace_location);
+
 	return 0;
 }
 
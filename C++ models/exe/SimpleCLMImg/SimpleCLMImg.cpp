@@ -189,6 +189,9 @@ int main (int argc, char **argv)
 	
 	CLMTracker::get_image_input_output_params(files, depth_files, output_landmark_locations, output_images, bounding_boxes, arguments);	
 	CLMTracker::CLMParameters clm_parameters(arguments);	
+
+	// Per stage timings (-profile <file.json>) and Chrome trace (-trace <file.json>)
+	CLMTracker::Profiler::Configure(clm_parameters.profile_location, clm_parameters.trace_location);
 	// No need to validate detections, as we're not doing tracking
 	clm_parameters.validate_detections = false;
 
@@ -200,7 +203,9 @@ int main (int argc, char **argv)
 	CascadeClassifier classifier(clm_parameters.face_detector_location);	
 	dlib::frontal_face_detector face_detector_hog = dlib::get_frontal_face_detector();
 
+	// In quiet (headless) mode the display image is only created if it is written out
 	bool visualise = !clm_parameters.quiet_mode;
+	bool draw_landmarks = visualise || !output_images.empty();
 
 	// Do some image loading
 	for(size_t i = 0; i < files.size(); i++)
@@ -270,7 +275,10 @@ int main (int argc, char **argv)
 
 				// displaying detected landmarks
 				Mat display_image;
-				create_display_image(read_image, display_image, clm_model);
+				if(draw_landmarks)
+				{
+					create_display_image(read_image, display_image, clm_model);
+				}
 
 				if(visualise && success)
 				{
@@ -324,7 +332,10 @@ int main (int argc, char **argv)
 
 			// displaying detected stuff
 			Mat display_image;
-			create_display_image(read_image, display_image, clm_model);
+			if(draw_landmarks)
+			{
+				create_display_image(read_image, display_image, clm_model);
+			}
 
 			if(visualise)
 			{
@@ -342,8 +353,12 @@ int main (int argc, char **argv)
 			}
 		}				
 
+		// Every image is a frame for the per frame timings
+		CLMTracker::Profiler::NextFrame();
 	}
 	
+	CLMTracker::Profiler::WriteReports(clm_parameters.profile_location, clm_parameters.trace_location);
+
 	return 0;
 }
 
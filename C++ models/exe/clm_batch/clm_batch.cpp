@@ -0,0 +1,757 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2014, University of Southern California and University of Cambridge,
+// all rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED AS IS AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY. OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Notwithstanding the license granted herein, Licensee acknowledges that certain components
+// of the Software may be covered by so-called open source software licenses (Open Source
+// Components), which means any software licenses approved as open source licenses by the
+// Open Source Initiative or any substantially similar licenses, including without limitation any
+// license that, as a condition of distribution of the software licensed under such license,
+// requires that the distributor make the software available in source code format. Licensor shall
+// provide a list of Open Source Components for a particular version of the Software upon
+// Licensees request. Licensee will comply with the applicable terms of such licenses and to
+// the extent required by the licenses covering Open Source Components, the terms of such
+// licenses will apply in lieu of the terms of this Agreement. To the extent the terms of the
+// licenses applicable to Open Source Components prohibit any of the restrictions in this
+// License Agreement with respect to such Open Source Component, such restrictions will not
+// apply to such Open Source Component. To the extent the terms of the licenses applicable to
+// Open Source Components require Licensor to make an offer to provide source code or
+// related information in connection with the Software, such offer is hereby made. Any request
+// for source code or related information should be directed to cl-face-tracker-distribution@lists.cam.ac.uk
+// Licensee acknowledges receipt of notices for the Open Source Components for the initial
+// delivery of the Software.
+
+//     * Any publications arising from the use of this software, including but
+//       not limited to academic journal and conference publications, technical
+//       reports and manuals, must cite one of the following works:
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 3D
+//       Constrained Local Model for Rigid and Non-Rigid Facial Tracking.
+//       IEEE Conference on Computer Vision and Pattern Recognition (CVPR), 2012.    
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 
+//       Constrained Local Neural Fields for robust facial landmark detection in the wild.
+//       in IEEE Int. Conference on Computer Vision Workshops, 300 Faces in-the-Wild Challenge, 2013.    
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// clm_batch.cpp : Runs the feature extraction over a manifest of (input, outputs) jobs with the models loaded only once
+
+#include "CLM_core.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <filesystem.hpp>
+#include <filesystem/fstream.hpp>
+
+#include <FaceAnalyser.h>
+#include <FeatureOutputs.h>
+#include <ToolUtils.h>
+
+#define INFO_STREAM( stream ) \
+std::cout << stream << std::endl
+
+#define WARN_STREAM( stream ) \
+std::cout << "Warning: " << stream << std::endl
+
+#define ERROR_STREAM( stream ) \
+std::cout << "Error: " << stream << std::endl
+
+using namespace std;
+using namespace cv;
+
+using namespace boost::filesystem;
+
+vector<string> get_arguments(int argc, char **argv)
+{
+
+	vector<string> arguments;
+
+	for(int i = 0; i < argc; ++i)
+	{
+		arguments.push_back(string(argv[i]));
+	}
+	return arguments;
+}
+
+// The settings shared by all of the jobs (the same meaning as in FeatureExtraction)
+struct BatchSettings
+{
+	string au_location;
+	double sim_scale;
+	int sim_size;
+	bool rigid;
+	bool use_camera_plane_pose;
+	float fx, fy, cx, cy;
+
+	BatchSettings() : au_location("./AU_predictors/AU_SVM_BP4D_best.txt"), sim_scale(0.6), sim_size(96), rigid(false), use_camera_plane_pose(false), fx(500), fy(500), cx(0), cy(0) {}
+};
+
+// A line of the manifest: an input followed by the outputs wanted from it
+struct BatchJob
+{
+	// The manifest line identifies the job in the completion records
+	string line;
+
+	// A video file or a directory of .jpg and .png images (tracked as a sequence)
+	string input;
+
+	string landmarks_output;
+	string pose_output;
+	string params_output;
+	string hog_output;
+	string aus_output;
+	string aligned_output;
+};
+
+void get_batch_params(string& manifest_location, string& done_location, string& output_file, int& num_threads, BatchSettings& settings, vector<string>& arguments)
+{
+	bool* valid = new bool[arguments.size()];
+
+	for(size_t i = 0; i < arguments.size(); ++i)
+	{
+		valid[i] = true;
+	}
+
+	for(size_t i = 0; i < arguments.size(); ++i)
+	{
+		if (arguments[i].compare("-manifest") == 0)
+		{
+			manifest_location = arguments[i + 1];
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-done") == 0)
+		{
+			done_location = arguments[i + 1];
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-o") == 0)
+		{
+			output_file = arguments[i + 1];
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-threads") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			data >> num_threads;
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-auloc") == 0)
+		{
+			settings.au_location = arguments[i + 1];
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-simscale") == 0)
+		{
+			settings.sim_scale = stod(arguments[i + 1]);
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-simsize") == 0)
+		{
+			settings.sim_size = stoi(arguments[i + 1]);
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-rigid") == 0)
+		{
+			settings.rigid = true;
+			valid[i] = false;
+		}
+		else if (arguments[i].compare("-cp") == 0)
+		{
+			settings.use_camera_plane_pose = arguments[i + 1].compare("1") == 0;
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-help") == 0)
+		{
+			cout << "Batch parameters are defined as follows: -manifest <job list, an input followed by any of -of -op -oparams -hogalign -oaus -simalign <output> per line> -done <completion records, <manifest>.done by default> -o <report json> -threads <number of workers> -auloc <AU predictors> -simscale <scale> -simsize <size> -rigid -cp <1/0>" << endl; // Inform the user of how to use the program
+		}
+	}
+
+	for(int i=arguments.size()-1; i >= 0; --i)
+	{
+		if(!valid[i])
+		{
+			arguments.erase(arguments.begin()+i);
+		}
+	}
+
+	delete[] valid;
+}
+
+// Splits a manifest line on white space, paths containing spaces can be put in double quotes
+vector<string> split_manifest_line(const string& line)
+{
+	vector<string> tokens;
+	string token;
+	bool quoted = false;
+	bool in_token = false;
+
+	for(size_t i = 0; i < line.size(); ++i)
+	{
+		char c = line[i];
+		if(c == '"')
+		{
+			quoted = !quoted;
+			in_token = true;
+		}
+		else if(!quoted && (c == ' ' || c == '\t' || c == '\r'))
+		{
+			if(in_token)
+			{
+				tokens.push_back(token);
+				token.clear();
+				in_token = false;
+			}
+		}
+		else
+		{
+			token += c;
+			in_token = true;
+		}
+	}
+	if(in_token)
+	{
+		tokens.push_back(token);
+	}
+	return tokens;
+}
+
+bool read_manifest(const string& manifest_location, vector<BatchJob>& jobs)
+{
+	std::ifstream manifest(manifest_location);
+	if(!manifest.is_open())
+	{
+		ERROR_STREAM("Could not open the manifest " << manifest_location);
+		return false;
+	}
+
+	string line;
+	int line_number = 0;
+	while(std::getline(manifest, line))
+	{
+		line_number++;
+
+		if(!line.empty() && line[line.size() - 1] == '\r')
+		{
+			line.erase(line.size() - 1);
+		}
+
+		vector<string> tokens = split_manifest_line(line);
+		if(tokens.empty() || tokens[0][0] == '#')
+		{
+			continue;
+		}
+
+		BatchJob job;
+		job.line = line;
+		job.input = tokens[0];
+
+		bool valid_job = true;
+		for(size_t t = 1; t < tokens.size(); t += 2)
+		{
+			if(t + 1 >= tokens.size())
+			{
+				valid_job = false;
+				break;
+			}
+
+			const string& flag = tokens[t];
+			const string& value = tokens[t + 1];
+			if(flag.compare("-of") == 0) job.landmarks_output = value;
+			else if(flag.compare("-op") == 0) job.pose_output = value;
+			else if(flag.compare("-oparams") == 0) job.params_output = value;
+			else if(flag.compare("-hogalign") == 0) job.hog_output = value;
+			else if(flag.compare("-oaus") == 0) job.aus_output = value;
+			else if(flag.compare("-simalign") == 0) job.aligned_output = value;
+			else valid_job = false;
+		}
+
+		if(!valid_job)
+		{
+			ERROR_STREAM("Invalid job on line " << line_number << " of the manifest: " << line);
+			return false;
+		}
+
+		jobs.push_back(job);
+	}
+
+	return true;
+}
+
+// The completion records are lines of "<frames>\t<seconds>\t<manifest line>", a job is done if its manifest line is recorded
+set<string> read_completed_jobs(const string& done_location)
+{
+	set<string> completed;
+
+	std::ifstream done_file(done_location);
+	string line;
+	while(std::getline(done_file, line))
+	{
+		size_t first_tab = line.find('\t');
+		size_t second_tab = first_tab == string::npos ? string::npos : line.find('\t', first_tab + 1);
+
+		// A partially written last record (from a crash) does not count
+		if(second_tab != string::npos)
+		{
+			completed.insert(line.substr(second_tab + 1));
+		}
+	}
+	return completed;
+}
+
+bool open_input(const string& input, CLMTracker::FrameSource& frame_source)
+{
+	if(!is_directory(path(input)))
+	{
+		return frame_source.OpenVideoFile(input);
+	}
+
+	// Sorted, as the images are tracked as consecutive frames (the extensions are compared in lower case)
+	vector<string> image_extensions;
+	image_extensions.push_back(".jpg");
+	image_extensions.push_back(".png");
+
+	return frame_source.OpenImageSequence(ToolUtils::list_files(input, image_extensions));
+}
+
+// Tracks and analyses one input the way FeatureExtraction does, with the AUs predicted in a second pass once the running medians cover the whole input
+bool process_job(const BatchJob& job, const BatchSettings& settings, CLMTracker::CLM& clm_model, CLMTracker::CLMParameters& clm_parameters, Psyche::FaceAnalyser& face_analyser, int& num_frames)
+{
+	num_frames = 0;
+
+	CLMTracker::FrameSource frame_source;
+	if(!open_input(job.input, frame_source))
+	{
+		ERROR_STREAM("Could not open " << job.input);
+		return false;
+	}
+
+	Mat captured_image;
+	Mat_<uchar> grayscale_image;
+	frame_source.Read(captured_image, grayscale_image);
+	if(captured_image.empty())
+	{
+		ERROR_STREAM("No frames in " << job.input);
+		return false;
+	}
+
+	// If optical centers are not defined just use center of image
+	float cx = settings.cx, cy = settings.cy;
+	if(cx == 0 || cy == 0)
+	{
+		cx = captured_image.cols / 2.0f;
+		cy = captured_image.rows / 2.0f;
+	}
+
+	unique_ptr<CLMTracker::OutputSink> pose_output_file;
+	if(!job.pose_output.empty())
+	{
+		vector<string> columns = {"frame", "timestamp", "confidence"};
+		pose_output_file = CLMTracker::OpenOutputSink(job.pose_output, CLMTracker::PoseColumnNames(columns));
+		if(!pose_output_file)
+		{
+			ERROR_STREAM("Could not open the output file " << job.pose_output);
+			return false;
+		}
+	}
+
+	unique_ptr<CLMTracker::OutputSink> landmarks_output_file;
+	if(!job.landmarks_output.empty())
+	{
+		vector<string> columns = {"frame", "success"};
+		landmarks_output_file = CLMTracker::OpenOutputSink(job.landmarks_output, CLMTracker::LandmarkColumnNames(columns, clm_model.pdm.NumberOfPoints()), CLMTracker::PaddedTextLayout());
+		if(!landmarks_output_file)
+		{
+			ERROR_STREAM("Could not open the output file " << job.landmarks_output);
+			return false;
+		}
+	}
+
+	unique_ptr<CLMTracker::OutputSink> params_output_file;
+	if(!job.params_output.empty())
+	{
+		vector<string> columns = {"frame", "success"};
+		params_output_file = CLMTracker::OpenOutputSink(job.params_output, CLMTracker::ParamsColumnNames(columns, clm_model.pdm.NumberOfModes()), CLMTracker::PaddedTextLayout());
+		if(!params_output_file)
+		{
+			ERROR_STREAM("Could not open the output file " << job.params_output);
+			return false;
+		}
+	}
+
+	std::ofstream hog_output_file;
+	if(!job.hog_output.empty())
+	{
+		hog_output_file.open(job.hog_output, ios_base::out | ios_base::binary);
+		if(!hog_output_file.is_open())
+		{
+			ERROR_STREAM("Could not open the output file " << job.hog_output);
+			return false;
+		}
+	}
+
+	if(!job.aligned_output.empty() && !exists(path(job.aligned_output)))
+	{
+		create_directories(path(job.aligned_output));
+	}
+
+	bool analyse_aus = !job.aus_output.empty();
+
+	// Kept for the second pass
+	Psyche::TrackedFrames tracked;
+
+	vector<double> output_row;
+	int frame_count = 0;
+
+	while(!captured_image.empty())
+	{
+		bool detection_success = CLMTracker::DetectLandmarksInVideo(grayscale_image, clm_model, clm_parameters);
+
+		Mat sim_warped_img;
+		Mat_<double> hog_descriptor;
+		int num_hog_rows, num_hog_cols;
+
+		if(analyse_aus || hog_output_file.is_open() || !job.aligned_output.empty())
+		{
+			Psyche::ExtractAlignedFeatures(sim_warped_img, hog_descriptor, num_hog_rows, num_hog_cols, captured_image, clm_model, face_analyser, analyse_aus,
+				settings.rigid, settings.sim_scale, settings.sim_size);
+		}
+
+		if(analyse_aus)
+		{
+			tracked.Add(clm_model, detection_success);
+		}
+
+		if(hog_output_file.is_open())
+		{
+			Psyche::WriteHOGFrame(hog_output_file, detection_success, hog_descriptor, num_hog_rows, num_hog_cols);
+			if(!hog_output_file.good())
+			{
+				ERROR_STREAM("Could not write to the output file " << job.hog_output);
+				return false;
+			}
+		}
+
+		if(!job.aligned_output.empty())
+		{
+			char name[100];
+			sprintf(name, "frame_det_%06d.png", frame_count);
+			string aligned_file = (path(job.aligned_output) / path(name)).string();
+			if(!imwrite(aligned_file, sim_warped_img))
+			{
+				ERROR_STREAM("Could not write the aligned face " << aligned_file);
+				return false;
+			}
+		}
+
+		if(landmarks_output_file)
+		{
+			Psyche::LandmarksRow(output_row, frame_count, detection_success, clm_model.detected_landmarks);
+			landmarks_output_file->WriteRow(output_row);
+		}
+
+		if(params_output_file)
+		{
+			Psyche::ParamsRow(output_row, frame_count, detection_success, clm_model.params_global, clm_model.params_local);
+			params_output_file->WriteRow(output_row);
+		}
+
+		if(pose_output_file)
+		{
+			Vec6d pose_estimate_CLM = settings.use_camera_plane_pose ? CLMTracker::GetCorrectedPoseCameraPlane(clm_model, settings.fx, settings.fy, cx, cy, clm_parameters) :
+				CLMTracker::GetCorrectedPoseCamera(clm_model, settings.fx, settings.fy, cx, cy, clm_parameters);
+
+			Psyche::PoseRow(output_row, frame_count, pose_estimate_CLM);
+			pose_output_file->WriteRow(output_row);
+		}
+
+		frame_source.Read(captured_image, grayscale_image);
+		frame_count++;
+	}
+
+	num_frames = frame_count;
+
+	// Any output that is not complete fails the job, so that it is not recorded as done
+	if(analyse_aus)
+	{
+		if(!open_input(job.input, frame_source))
+		{
+			ERROR_STREAM("Could not open " << job.input << " again for the AU pass");
+			return false;
+		}
+		if(!Psyche::WriteAUsSecondPass(job.aus_output, frame_source, tracked, clm_model, face_analyser))
+		{
+			ERROR_STREAM("Could not write the output file " << job.aus_output);
+			return false;
+		}
+	}
+
+	if(pose_output_file && !pose_output_file->Close())
+	{
+		ERROR_STREAM("Could not write the output file " << job.pose_output);
+		return false;
+	}
+	if(landmarks_output_file && !landmarks_output_file->Close())
+	{
+		ERROR_STREAM("Could not write the output file " << job.landmarks_output);
+		return false;
+	}
+	if(params_output_file && !params_output_file->Close())
+	{
+		ERROR_STREAM("Could not write the output file " << job.params_output);
+		return false;
+	}
+	if(hog_output_file.is_open())
+	{
+		hog_output_file.close();
+		if(hog_output_file.fail())
+		{
+			ERROR_STREAM("Could not write the output file " << job.hog_output);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Backslashes in Windows paths have to be escaped in the json report
+string json_escape(const string& text)
+{
+	string escaped;
+	for(size_t i = 0; i < text.size(); ++i)
+	{
+		if(text[i] == '\\' || text[i] == '"')
+		{
+			escaped += '\\';
+		}
+		escaped += text[i];
+	}
+	return escaped;
+}
+
+int main (int argc, char **argv)
+{
+
+	vector<string> arguments = get_arguments(argc, argv);
+
+	path root = path(arguments[0]).parent_path();
+
+	string manifest_location;
+	string done_location;
+	string output_file = "clm_batch.json";
+	int num_threads = (int)std::thread::hardware_concurrency();
+	BatchSettings settings;
+
+	get_batch_params(manifest_location, done_location, output_file, num_threads, settings, arguments);
+
+	int device = 0;
+	CLMTracker::get_camera_params(device, settings.fx, settings.fy, settings.cx, settings.cy, arguments);
+
+	CLMTracker::CLMParameters clm_parameters(arguments);
+
+	// Nothing is drawn or shown, the workers run headless
+	clm_parameters.quiet_mode = true;
+
+	if(manifest_location.empty())
+	{
+		ERROR_STREAM("No manifest given, specify the job list with -manifest");
+		return 1;
+	}
+
+	if(done_location.empty())
+	{
+		done_location = manifest_location + ".done";
+	}
+
+	if(num_threads < 1)
+	{
+		num_threads = 1;
+	}
+
+	vector<BatchJob> jobs;
+	if(!read_manifest(manifest_location, jobs))
+	{
+		return 1;
+	}
+
+	// Resuming, the jobs with a completion record from an earlier run are skipped
+	set<string> completed_jobs = read_completed_jobs(done_location);
+
+	vector<BatchJob> pending_jobs;
+	for(size_t j = 0; j < jobs.size(); ++j)
+	{
+		if(completed_jobs.find(jobs[j].line) == completed_jobs.end())
+		{
+			pending_jobs.push_back(jobs[j]);
+		}
+	}
+
+	INFO_STREAM(jobs.size() << " jobs in the manifest, " << jobs.size() - pending_jobs.size() << " already done, running " << pending_jobs.size() << " on " << num_threads << " workers");
+
+	string face_analyser_loc_av("./AV_regressors/av_regressors.txt");
+	string tri_location("./model/tris_68_full.txt");
+
+	if(!exists(path(settings.au_location)))
+	{
+		settings.au_location = (root / path(settings.au_location)).string();
+		face_analyser_loc_av = (root / path(face_analyser_loc_av)).string();
+		tri_location = (root / path(tri_location)).string();
+	}
+
+	if(!exists(path(clm_parameters.model_location)))
+	{
+		clm_parameters.model_location = (root / path(clm_parameters.model_location)).string();
+	}
+
+	// The models are read once, the workers and jobs get copies that share the read only parts
+	CLMTracker::CLM clm_model(clm_parameters.model_location);
+
+	vector<Vec3d> orientations;
+	orientations.push_back(Vec3d(0.0,0.0,0.0));
+	Psyche::FaceAnalyser analyser_prototype(orientations, settings.sim_scale, settings.sim_size, settings.sim_size, settings.au_location, face_analyser_loc_av, tri_location);
+
+	std::ofstream done_file(done_location, ios_base::out | ios_base::app);
+	if(!done_file.is_open())
+	{
+		ERROR_STREAM("Could not open " << done_location << " for the completion records");
+		return 1;
+	}
+
+	std::atomic<size_t> next_job(0);
+	std::mutex record_mutex;
+	int jobs_finished = 0;
+	int jobs_failed = 0;
+	long long total_frames = 0;
+	vector<string> failed_inputs;
+
+	int64 start_time = cv::getTickCount();
+
+	vector<std::thread> workers;
+	for(int w = 0; w < num_threads; ++w)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			CLMTracker::CLM worker_model(clm_model);
+			CLMTracker::CLMParameters worker_parameters(clm_parameters);
+
+			for(size_t j = next_job++; j < pending_jobs.size(); j = next_job++)
+			{
+				const BatchJob& job = pending_jobs[j];
+
+				// Every job starts from scratch, the analyser is a copy of a fresh one so it has no running state
+				worker_model.Reset();
+				Psyche::FaceAnalyser face_analyser(analyser_prototype);
+
+				int64 job_start = cv::getTickCount();
+				int num_frames = 0;
+				bool success = false;
+
+				// A broken input (e.g. a corrupt frame OpenCV throws on) fails its job instead of taking the whole batch down
+				try
+				{
+					success = process_job(job, settings, worker_model, worker_parameters, face_analyser, num_frames);
+				}
+				catch(const cv::Exception& e)
+				{
+					ERROR_STREAM("OpenCV error while processing " << job.input << ": " << e.what());
+				}
+				catch(const std::exception& e)
+				{
+					ERROR_STREAM("Error while processing " << job.input << ": " << e.what());
+				}
+				catch(...)
+				{
+					ERROR_STREAM("Unknown error while processing " << job.input);
+				}
+				double seconds = (cv::getTickCount() - job_start) / cv::getTickFrequency();
+
+				std::lock_guard<std::mutex> lock(record_mutex);
+				if(success)
+				{
+					// The record is only written once all of the outputs are closed, and flushed so that it survives a crash of a later job
+					done_file << num_frames << "\t" << seconds << "\t" << job.line << endl;
+					jobs_finished++;
+					total_frames += num_frames;
+				}
+				else
+				{
+					jobs_failed++;
+					failed_inputs.push_back(job.input);
+				}
+
+				INFO_STREAM("[" << jobs_finished + jobs_failed << "/" << pending_jobs.size() << "] " << job.input << ": " << (success ? "done" : "FAILED") << ", " << num_frames << " frames in " << seconds << " s (" << (seconds > 0 ? num_frames / seconds : 0) << " fps)");
+			}
+		}));
+	}
+
+	for(size_t w = 0; w < workers.size(); ++w)
+	{
+		workers[w].join();
+	}
+
+	double total_seconds = (cv::getTickCount() - start_time) / cv::getTickFrequency();
+	double frames_per_second = total_seconds > 0 ? total_frames / total_seconds : 0;
+	double jobs_per_hour = total_seconds > 0 ? jobs_finished * 3600.0 / total_seconds : 0;
+
+	INFO_STREAM("Finished " << jobs_finished << " jobs (" << jobs_failed << " failed) in " << total_seconds << " s, " << total_frames << " frames at " << frames_per_second << " fps, " << jobs_per_hour << " jobs/hour");
+
+	std::ofstream output(output_file);
+	if(!output.is_open())
+	{
+		ERROR_STREAM("Could not open " << output_file << " for writing the batch report");
+	}
+
+	output << "{" << endl;
+	output << "\t\"runner\": \"clm_batch\"," << endl;
+	output << "\t\"manifest\": \"" << json_escape(manifest_location) << "\"," << endl;
+	output << "\t\"threads\": " << num_threads << "," << endl;
+	output << "\t\"jobs\": " << jobs.size() << ", \"skipped\": " << jobs.size() - pending_jobs.size() << ", \"finished\": " << jobs_finished << ", \"failed\": " << jobs_failed << "," << endl;
+	output << "\t\"frames\": " << total_frames << ", \"seconds\": " << total_seconds << ", \"frames_per_second\": " << frames_per_second << ", \"jobs_per_hour\": " << jobs_per_hour << "," << endl;
+	output << "\t\"failed_inputs\": [";
+	for(size_t i = 0; i < failed_inputs.size(); ++i)
+	{
+		output << "\"" << json_escape(failed_inputs[i]) << "\"" << (i + 1 < failed_inputs.size() ? ", " : "");
+	}
+	output << "]" << endl;
+	output << "}" << endl;
+
+	return jobs_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,803 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2014, University of Southern California and University of Cambridge,
+// all rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED AS IS AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY. OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Notwithstanding the license granted herein, Licensee acknowledges that certain components
+// of the Software may be covered by so-called open source software licenses (Open Source
+// Components), which means any software licenses approved as open source licenses by the
+// Open Source Initiative or any substantially similar licenses, including without limitation any
+// license that, as a condition of distribution of the software licensed under such license,
+// requires that the distributor make the software available in source code format. Licensor shall
+// provide a list of Open Source Components for a particular version of the Software upon
+// Licensees request. Licensee will comply with the applicable terms of such licenses and to
+// the extent required by the licenses covering Open Source Components, the terms of such
+// licenses will apply in lieu of the terms of this Agreement. To the extent the terms of the
+// licenses applicable to Open Source Components prohibit any of the restrictions in this
+// License Agreement with respect to such Open Source Component, such restrictions will not
+// apply to such Open Source Component. To the extent the terms of the licenses applicable to
+// Open Source Components require Licensor to make an offer to provide source code or
+// related information in connection with the Software, such offer is hereby made. Any request
+// for source code or related information should be directed to cl-face-tracker-distribution@lists.cam.ac.uk
+// Licensee acknowledges receipt of notices for the Open Source Components for the initial
+// delivery of the Software.
+
+//     * Any publications arising from the use of this software, including but
+//       not limited to academic journal and conference publications, technical
+//       reports and manuals, must cite one of the following works:
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 3D
+//       Constrained Local Model for Rigid and Non-Rigid Facial Tracking.
+//       IEEE Conference on Computer Vision and Pattern Recognition (CVPR), 2012.    
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 
+//       Constrained Local Neural Fields for robust facial landmark detection in the wild.
+//       in IEEE Int. Conference on Computer Vision Workshops, 300 Faces in-the-Wild Challenge, 2013.    
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// clm_bench.cpp : Runs fixed workloads over the bundled samples and reports their throughput, latency and memory use
+
+#include "CLM_core.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/videoio/videoio.hpp>
+
+#include <filesystem.hpp>
+#include <filesystem/fstream.hpp>
+
+#include <FaceAnalyser.h>
+#include <Face_utils.h>
+#include <ToolUtils.h>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#include <psapi.h>
+	#pragma comment(lib, "psapi.lib")
+#else
+	#include <sys/resource.h>
+	#include <unistd.h>
+	#ifdef __APPLE__
+		#include <mach/mach.h>
+	#endif
+#endif
+
+#define INFO_STREAM( stream ) \
+std::cout << stream << std::endl
+
+#define WARN_STREAM( stream ) \
+std::cout << "Warning: " << stream << std::endl
+
+#define ERROR_STREAM( stream ) \
+std::cout << "Error: " << stream << std::endl
+
+using namespace std;
+using namespace cv;
+
+using namespace boost::filesystem;
+
+vector<string> get_arguments(int argc, char **argv)
+{
+
+	vector<string> arguments;
+
+	for(int i = 0; i < argc; ++i)
+	{
+		arguments.push_back(string(argv[i]));
+	}
+	return arguments;
+}
+
+// Peak resident set size of the process so far, in MB (this only ever grows, so it is reported for the whole run)
+double get_peak_rss_mb()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+	}
+	return 0;
+#else
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+	#ifdef __APPLE__
+		// Reported in bytes on OS X
+		return usage.ru_maxrss / (1024.0 * 1024.0);
+	#else
+		// and in kilobytes on Linux
+		return usage.ru_maxrss / 1024.0;
+	#endif
+#endif
+}
+
+// Current resident set size of the process, in MB
+double get_current_rss_mb()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.WorkingSetSize / (1024.0 * 1024.0);
+	}
+	return 0;
+#elif defined(__APPLE__)
+	mach_task_basic_info_data_t info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if(task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+	{
+		return 0;
+	}
+	return info.resident_size / (1024.0 * 1024.0);
+#else
+	// The second field of statm is the number of resident pages
+	std::ifstream statm("/proc/self/statm");
+	long long size_pages = 0, resident_pages = 0;
+	if(!(statm >> size_pages >> resident_pages))
+	{
+		return 0;
+	}
+	return resident_pages * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+#endif
+}
+
+double ticks_to_ms(int64 ticks)
+{
+	return 1000.0 * (double)ticks / cv::getTickFrequency();
+}
+
+// The timings of one workload, a unit is a model load, an image or a video frame depending on the workload.
+// The workloads run one after the other in the same process, so their memory use is the resident set size
+// when the workload starts and when it is done rather than a peak
+struct WorkloadResult
+{
+	string name;
+	string units;
+	int inputs;
+	int successes;
+	vector<double> latencies_ms;
+	double rss_start_mb;
+	double rss_end_mb;
+
+	WorkloadResult(const string& name, const string& units) : name(name), units(units), inputs(0), successes(0), rss_start_mb(get_current_rss_mb()), rss_end_mb(0) {}
+};
+
+// Nearest rank percentile of sorted values
+double percentile(const vector<double>& sorted_values, double p)
+{
+	if(sorted_values.empty())
+	{
+		return 0;
+	}
+	int rank = (int)ceil(p * sorted_values.size()) - 1;
+	rank = std::min(std::max(rank, 0), (int)sorted_values.size() - 1);
+	return sorted_values[rank];
+}
+
+void write_results(const string& filename, const vector<WorkloadResult>& results, int max_frames, int num_videos)
+{
+	std::ofstream output(filename);
+
+	if(!output.is_open())
+	{
+		ERROR_STREAM("Could not open " << filename << " for writing the benchmark results");
+		return;
+	}
+
+	output << "{" << endl;
+	output << "\t\"benchmark\": \"clm_bench\"," << endl;
+	output << "\t\"headless\": true," << endl;
+	output << "\t\"max_frames_per_video\": " << max_frames << "," << endl;
+	output << "\t\"videos\": " << num_videos << "," << endl;
+	output << "\t\"process_peak_rss_mb\": " << get_peak_rss_mb() << "," << endl;
+	output << "\t\"workloads\": [" << endl;
+
+	for(size_t i = 0; i < results.size(); ++i)
+	{
+		const WorkloadResult& result = results[i];
+
+		vector<double> sorted = result.latencies_ms;
+		std::sort(sorted.begin(), sorted.end());
+
+		double total_ms = 0;
+		for(size_t j = 0; j < sorted.size(); ++j)
+		{
+			total_ms += sorted[j];
+		}
+
+		double mean_ms = sorted.empty() ? 0 : total_ms / sorted.size();
+		double throughput = total_ms > 0 ? 1000.0 * sorted.size() / total_ms : 0;
+
+		output << "\t\t{\"name\": \"" << result.name << "\", \"units\": \"" << result.units << "\"";
+		output << ", \"inputs\": " << result.inputs << ", \"count\": " << sorted.size() << ", \"successes\": " << result.successes;
+		output << ", \"total_s\": " << total_ms / 1000.0 << ", \"throughput_per_s\": " << throughput;
+		output << ", \"mean_ms\": " << mean_ms << ", \"p50_ms\": " << percentile(sorted, 0.5) << ", \"p99_ms\": " << percentile(sorted, 0.99);
+		output << ", \"max_ms\": " << (sorted.empty() ? 0 : sorted.back());
+
+		// The first model load is the cold one (nothing cached yet)
+		if(!result.latencies_ms.empty() && result.units.compare("loads") == 0)
+		{
+			output << ", \"cold_ms\": " << result.latencies_ms[0];
+		}
+
+		output << ", \"rss_start_mb\": " << result.rss_start_mb << ", \"rss_end_mb\": " << result.rss_end_mb << ", \"rss_growth_mb\": " << result.rss_end_mb - result.rss_start_mb << "}";
+		output << (i + 1 < results.size() ? "," : "") << endl;
+
+		INFO_STREAM(result.name << ": " << sorted.size() << " " << result.units << ", " << throughput << "/s, p50 " << percentile(sorted, 0.5) << "ms, p99 " << percentile(sorted, 0.99) << "ms, RSS " << result.rss_start_mb << "MB -> " << result.rss_end_mb << "MB");
+	}
+
+	output << "\t]" << endl;
+	output << "}" << endl;
+}
+
+// Extracting the following command line arguments -root, -o, -frames, -videos, -load_reps, -workload (and possible repetitions of the latter)
+void get_bench_params(string& data_root, string& output_file, int& max_frames, int& num_videos, int& load_reps, vector<string>& workloads, vector<string>& arguments)
+{
+	bool* valid = new bool[arguments.size()];
+
+	for(size_t i = 0; i < arguments.size(); ++i)
+	{
+		valid[i] = true;
+	}
+
+	for(size_t i = 0; i < arguments.size(); ++i)
+	{
+		if (arguments[i].compare("-root") == 0)
+		{
+			data_root = arguments[i + 1];
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-o") == 0)
+		{
+			output_file = arguments[i + 1];
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-frames") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			data >> max_frames;
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-videos") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			data >> num_videos;
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-load_reps") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			data >> load_reps;
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-workload") == 0)
+		{
+			workloads.push_back(arguments[i + 1]);
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-help") == 0)
+		{
+			cout << "Benchmark parameters are defined as follows: -root <directory containing videos/ and imgs/> -o <results json> -frames <max frames per video> -videos <number of single face videos> -load_reps <number of model loads> -workload <model_load|image_detection|video_default|video_motion_pred|video_init_windows|video_small_windows|multi_face|align_fhog|au_prediction> (can be repeated, all are run by default)" << endl; // Inform the user of how to use the program
+		}
+	}
+
+	for(int i=arguments.size()-1; i >= 0; --i)
+	{
+		if(!valid[i])
+		{
+			arguments.erase(arguments.begin()+i);
+		}
+	}
+
+	delete[] valid;
+}
+
+bool should_run(const vector<string>& workloads, const string& name)
+{
+	return workloads.empty() || std::find(workloads.begin(), workloads.end(), name) != workloads.end();
+}
+
+// Tracking of single face videos, only the landmark detection is timed (not the decoding)
+void bench_video_tracking(WorkloadResult& result, const vector<string>& videos, int max_frames, CLMTracker::CLM& clm_model, CLMTracker::CLMParameters& clm_parameters)
+{
+	for(size_t v = 0; v < videos.size(); ++v)
+	{
+		VideoCapture video_capture(videos[v]);
+
+		if(!video_capture.isOpened())
+		{
+			WARN_STREAM("Could not open " << videos[v]);
+			continue;
+		}
+		result.inputs++;
+
+		clm_model.Reset();
+
+		Mat captured_image;
+		Mat_<uchar> grayscale_image;
+
+		for(int frame = 0; frame < max_frames && video_capture.read(captured_image); ++frame)
+		{
+			ToolUtils::to_grayscale(captured_image, grayscale_image);
+
+			int64 start = cv::getTickCount();
+			bool detection_success = CLMTracker::DetectLandmarksInVideo(grayscale_image, clm_model, clm_parameters);
+			int64 end = cv::getTickCount();
+
+			result.latencies_ms.push_back(ticks_to_ms(end - start));
+			if(detection_success)
+			{
+				result.successes++;
+			}
+
+			CLMTracker::Profiler::NextFrame();
+		}
+	}
+	clm_model.Reset();
+	result.rss_end_mb = get_current_rss_mb();
+}
+
+// Remove the detections of faces that are already being tracked
+void remove_tracked_detections(const vector<CLMTracker::CLM>& clm_models, const vector<bool>& active_models, vector<Rect_<double> >& face_detections)
+{
+	for(size_t model = 0; model < clm_models.size(); ++model)
+	{
+		if(!active_models[model])
+		{
+			continue;
+		}
+
+		Rect_<double> model_rect = clm_models[model].GetBoundingBox();
+
+		for(int detection = face_detections.size()-1; detection >=0; --detection)
+		{
+			double intersection_area = (model_rect & face_detections[detection]).area();
+			double union_area = model_rect.area() + face_detections[detection].area() - 2 * intersection_area;
+
+			if(intersection_area/union_area > 0.5)
+			{
+				face_detections.erase(face_detections.begin() + detection);
+			}
+		}
+	}
+}
+
+// The MultiTrackCLM loop (detection every 8th frame when a tracker is free, up to 4 faces), the trackers are updated
+// serially so that the timings do not depend on the scheduling, a unit is a whole frame
+void bench_multi_face(WorkloadResult& result, const string& video, int max_frames, const CLMTracker::CLM& clm_model, const CLMTracker::CLMParameters& clm_parameters)
+{
+	const int num_faces_max = 4;
+
+	vector<CLMTracker::CLM> clm_models(num_faces_max, clm_model);
+	vector<CLMTracker::CLMParameters> clm_params(num_faces_max, clm_parameters);
+	vector<bool> active_models(num_faces_max, false);
+
+	VideoCapture video_capture(video);
+
+	if(!video_capture.isOpened())
+	{
+		WARN_STREAM("Could not open " << video);
+		return;
+	}
+	result.inputs++;
+
+	Mat captured_image;
+	Mat_<uchar> grayscale_image;
+
+	for(int frame = 0; frame < max_frames && video_capture.read(captured_image); ++frame)
+	{
+		ToolUtils::to_grayscale(captured_image, grayscale_image);
+
+		int64 start = cv::getTickCount();
+
+		bool all_models_active = std::find(active_models.begin(), active_models.end(), false) == active_models.end();
+
+		vector<Rect_<double> > face_detections;
+
+		if(frame % 8 == 0 && !all_models_active)
+		{
+			if(clm_parameters.curr_face_detector == CLMTracker::CLMParameters::HOG_SVM_DETECTOR)
+			{
+				vector<double> confidences;
+				CLMTracker::DetectFacesHOG(face_detections, grayscale_image, clm_models[0].face_detector_HOG, confidences);
+			}
+			else
+			{
+				CLMTracker::DetectFaces(face_detections, grayscale_image, clm_models[0].face_detector_HAAR);
+			}
+		}
+
+		remove_tracked_detections(clm_models, active_models, face_detections);
+
+		size_t next_detection = 0;
+		int tracked = 0;
+
+		for(int model = 0; model < num_faces_max; ++model)
+		{
+			if(clm_models[model].failures_in_a_row > 4)
+			{
+				active_models[model] = false;
+				clm_models[model].Reset();
+			}
+
+			bool detection_success = false;
+
+			if(!active_models[model])
+			{
+				if(next_detection < face_detections.size())
+				{
+					clm_models[model].Reset();
+					clm_models[model].detection_success = false;
+					detection_success = CLMTracker::DetectLandmarksInVideo(grayscale_image, face_detections[next_detection], clm_models[model], clm_params[model]);
+					active_models[model] = true;
+					next_detection++;
+				}
+			}
+			else
+			{
+				detection_success = CLMTracker::DetectLandmarksInVideo(grayscale_image, clm_models[model], clm_params[model]);
+			}
+
+			if(detection_success)
+			{
+				tracked++;
+			}
+		}
+
+		int64 end = cv::getTickCount();
+
+		result.latencies_ms.push_back(ticks_to_ms(end - start));
+		result.successes += tracked;
+
+		CLMTracker::Profiler::NextFrame();
+	}
+	result.rss_end_mb = get_current_rss_mb();
+}
+
+// Alignment + FHOG and the full AU prediction on tracked frames, the tracking itself is not timed
+void bench_analysis(WorkloadResult* align_result, WorkloadResult* au_result, const vector<string>& videos, int max_frames, CLMTracker::CLM& clm_model, CLMTracker::CLMParameters& clm_parameters, Psyche::FaceAnalyser& face_analyser)
+{
+	Mat_<int> triangulation = face_analyser.GetTriangulation();
+
+	for(size_t v = 0; v < videos.size(); ++v)
+	{
+		VideoCapture video_capture(videos[v]);
+
+		if(!video_capture.isOpened())
+		{
+			WARN_STREAM("Could not open " << videos[v]);
+			continue;
+		}
+
+		if(align_result)
+		{
+			align_result->inputs++;
+		}
+		if(au_result)
+		{
+			au_result->inputs++;
+		}
+
+		clm_model.Reset();
+		face_analyser.Reset();
+
+		double fps = video_capture.get(CV_CAP_PROP_FPS);
+		if(fps <= 0)
+		{
+			fps = 30;
+		}
+
+		Mat captured_image;
+		Mat_<uchar> grayscale_image;
+
+		for(int frame = 0; frame < max_frames && video_capture.read(captured_image); ++frame)
+		{
+			ToolUtils::to_grayscale(captured_image, grayscale_image);
+
+			bool detection_success = CLMTracker::DetectLandmarksInVideo(grayscale_image, clm_model, clm_parameters);
+
+			if(align_result && detection_success)
+			{
+				Mat sim_warped_img;
+				Mat_<double> hog_descriptor;
+				int num_hog_rows, num_hog_cols;
+
+				int64 start = cv::getTickCount();
+				Psyche::AlignFaceMask(sim_warped_img, captured_image, clm_model, triangulation, false, 0.6, 96, 96);
+				Psyche::Extract_FHOG_descriptor(hog_descriptor, sim_warped_img, num_hog_rows, num_hog_cols);
+				int64 end = cv::getTickCount();
+
+				align_result->latencies_ms.push_back(ticks_to_ms(end - start));
+				align_result->successes++;
+			}
+
+			if(au_result)
+			{
+				int64 start = cv::getTickCount();
+				face_analyser.AddNextFrame(captured_image, clm_model, frame / fps, false);
+				int64 end = cv::getTickCount();
+
+				au_result->latencies_ms.push_back(ticks_to_ms(end - start));
+				if(detection_success)
+				{
+					au_result->successes++;
+				}
+			}
+
+			CLMTracker::Profiler::NextFrame();
+		}
+	}
+
+	clm_model.Reset();
+	face_analyser.Reset();
+
+	if(align_result)
+	{
+		align_result->rss_end_mb = get_current_rss_mb();
+	}
+	if(au_result)
+	{
+		au_result->rss_end_mb = get_current_rss_mb();
+	}
+}
+
+int main (int argc, char **argv)
+{
+
+	vector<string> arguments = get_arguments(argc, argv);
+
+	path root = path(arguments[0]).parent_path();
+
+	string data_root;
+	string output_file = "clm_bench.json";
+	int max_frames = 300;
+	int num_videos = 3;
+	int load_reps = 3;
+	vector<string> workloads;
+
+	get_bench_params(data_root, output_file, max_frames, num_videos, load_reps, workloads, arguments);
+
+	CLMTracker::CLMParameters clm_parameters(arguments);
+
+	// The benchmark is always headless, so that it measures the same thing as a -q run of the executables
+	clm_parameters.quiet_mode = true;
+
+	// Per stage timings (-profile <file.json>) and Chrome trace (-trace <file.json>) of the whole run
+	CLMTracker::Profiler::Configure(clm_parameters.profile_location, clm_parameters.trace_location);
+
+	if(data_root.empty())
+	{
+		data_root = ToolUtils::find_data_root(root.string());
+	}
+
+	if(data_root.empty() || !exists(path(data_root) / "videos"))
+	{
+		ERROR_STREAM("Could not find the sample videos and images, specify their location with -root");
+		return 1;
+	}
+
+	INFO_STREAM("Using the samples in " << data_root);
+
+	vector<string> video_extensions(1, ".avi");
+	vector<string> image_extensions;
+	image_extensions.push_back(".jpg");
+	image_extensions.push_back(".png");
+
+	vector<string> all_videos = ToolUtils::list_files((path(data_root) / "videos").string(), video_extensions);
+	vector<string> images = ToolUtils::list_files((path(data_root) / "imgs").string(), image_extensions);
+
+	// The multi face sample is benchmarked separately
+	string multi_face_video;
+	vector<string> videos;
+	for(size_t i = 0; i < all_videos.size(); ++i)
+	{
+		if(path(all_videos[i]).filename().string().compare("multi_face.avi") == 0)
+		{
+			multi_face_video = all_videos[i];
+		}
+		else if((int)videos.size() < num_videos)
+		{
+			videos.push_back(all_videos[i]);
+		}
+	}
+
+	string face_analyser_loc("./AU_predictors/AU_SVM_BP4D_best.txt");
+	string face_analyser_loc_av("./AV_regressors/av_regressors.txt");
+	string tri_location("./model/tris_68_full.txt");
+
+	if(!exists(path(face_analyser_loc)))
+	{
+		face_analyser_loc = (root / path(face_analyser_loc)).string();
+		face_analyser_loc_av = (root / path(face_analyser_loc_av)).string();
+		tri_location = (root / path(tri_location)).string();
+	}
+
+	vector<Vec3d> orientations;
+	orientations.push_back(Vec3d(0.0,0.0,0.0));
+
+	vector<WorkloadResult> results;
+
+	// Loading the landmark, face detection and AU models, the first load is the cold one and
+	// the models loaded by it are used by the rest of the workloads
+	WorkloadResult load_result("model_load", "loads");
+	load_result.inputs = 1;
+
+	int64 load_start = cv::getTickCount();
+	CLMTracker::CLM clm_model(clm_parameters.model_location);
+	clm_model.face_detector_HAAR.load(clm_parameters.face_detector_location);
+	clm_model.face_detector_location = clm_parameters.face_detector_location;
+	Psyche::FaceAnalyser face_analyser(orientations, 0.6, 96, 96, face_analyser_loc, face_analyser_loc_av, tri_location);
+	int64 load_end = cv::getTickCount();
+
+	load_result.latencies_ms.push_back(ticks_to_ms(load_end - load_start));
+	load_result.successes++;
+
+	for(int rep = 1; should_run(workloads, "model_load") && rep < load_reps; ++rep)
+	{
+		int64 start = cv::getTickCount();
+		CLMTracker::CLM reloaded_model(clm_parameters.model_location);
+		reloaded_model.face_detector_HAAR.load(clm_parameters.face_detector_location);
+		Psyche::FaceAnalyser reloaded_analyser(orientations, 0.6, 96, 96, face_analyser_loc, face_analyser_loc_av, tri_location);
+		int64 end = cv::getTickCount();
+
+		load_result.latencies_ms.push_back(ticks_to_ms(end - start));
+		load_result.successes++;
+	}
+	load_result.rss_end_mb = get_current_rss_mb();
+
+	if(should_run(workloads, "model_load"))
+	{
+		results.push_back(load_result);
+	}
+
+	// Detection and landmark localisation in still images (the face detection is included)
+	if(should_run(workloads, "image_detection"))
+	{
+		WorkloadResult result("image_detection", "images");
+
+		for(size_t i = 0; i < images.size(); ++i)
+		{
+			Mat captured_image = imread(images[i], -1);
+
+			if(captured_image.empty())
+			{
+				WARN_STREAM("Could not read " << images[i]);
+				continue;
+			}
+			result.inputs++;
+
+			Mat_<uchar> grayscale_image;
+			ToolUtils::to_grayscale(captured_image, grayscale_image);
+
+			int64 start = cv::getTickCount();
+			bool success = CLMTracker::DetectLandmarksInImage(grayscale_image, clm_model, clm_parameters);
+			int64 end = cv::getTickCount();
+
+			result.latencies_ms.push_back(ticks_to_ms(end - start));
+			if(success)
+			{
+				result.successes++;
+			}
+
+			clm_model.Reset();
+			CLMTracker::Profiler::NextFrame();
+		}
+		result.rss_end_mb = get_current_rss_mb();
+		results.push_back(result);
+	}
+
+	// Video tracking with each of the window size schedules
+	if(should_run(workloads, "video_default"))
+	{
+		WorkloadResult result("video_default", "frames");
+		CLMTracker::CLMParameters params = clm_parameters;
+		bench_video_tracking(result, videos, max_frames, clm_model, params);
+		results.push_back(result);
+	}
+
+	if(should_run(workloads, "video_motion_pred"))
+	{
+		WorkloadResult result("video_motion_pred", "frames");
+		CLMTracker::CLMParameters params = clm_parameters;
+		params.use_motion_prediction = true;
+		bench_video_tracking(result, videos, max_frames, clm_model, params);
+		results.push_back(result);
+	}
+
+	// The initialisation windows for every frame (the slowest schedule)
+	if(should_run(workloads, "video_init_windows"))
+	{
+		WorkloadResult result("video_init_windows", "frames");
+		CLMTracker::CLMParameters params = clm_parameters;
+		params.window_sizes_small = params.window_sizes_init;
+		bench_video_tracking(result, videos, max_frames, clm_model, params);
+		results.push_back(result);
+	}
+
+	// Only the smallest window once tracking (the fastest schedule)
+	if(should_run(workloads, "video_small_windows"))
+	{
+		WorkloadResult result("video_small_windows", "frames");
+		CLMTracker::CLMParameters params = clm_parameters;
+		params.window_sizes_small = vector<int>(1, params.window_sizes_small.back());
+		bench_video_tracking(result, videos, max_frames, clm_model, params);
+		results.push_back(result);
+	}
+
+	if(should_run(workloads, "multi_face"))
+	{
+		WorkloadResult result("multi_face", "frames");
+
+		if(multi_face_video.empty())
+		{
+			WARN_STREAM("No multi_face.avi in the samples, skipping the multi face workload");
+		}
+		else
+		{
+			bench_multi_face(result, multi_face_video, max_frames, clm_model, clm_parameters);
+		}
+		results.push_back(result);
+	}
+
+	bool run_align = should_run(workloads, "align_fhog");
+	bool run_au = should_run(workloads, "au_prediction");
+
+	if(run_align || run_au)
+	{
+		WorkloadResult align_result("align_fhog", "faces");
+		WorkloadResult au_result("au_prediction", "frames");
+
+		bench_analysis(run_align ? &align_result : 0, run_au ? &au_result : 0, videos, max_frames, clm_model, clm_parameters, face_analyser);
+
+		if(run_align)
+		{
+			results.push_back(align_result);
+		}
+		if(run_au)
+		{
+			results.push_back(au_result);
+		}
+	}
+
+	write_results(output_file, results, max_frames, (int)videos.size());
+
+	CLMTracker::Profiler::WriteReports(clm_parameters.profile_location, clm_parameters.trace_location);
+
+	return 0;
+}
+
@@ -0,0 +1,641 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2014, University of Southern California and University of Cambridge,
+// all rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED AS IS AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY. OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Notwithstanding the license granted herein, Licensee acknowledges that certain components
+// of the Software may be covered by so-called open source software licenses (Open Source
+// Components), which means any software licenses approved as open source licenses by the
+// Open Source Initiative or any substantially similar licenses, including without limitation any
+// license that, as a condition of distribution of the software licensed under such license,
+// requires that the distributor make the software available in source code format. Licensor shall
+// provide a list of Open Source Components for a particular version of the Software upon
+// Licensees request. Licensee will comply with the applicable terms of such licenses and to
+// the extent required by the licenses covering Open Source Components, the terms of such
+// licenses will apply in lieu of the terms of this Agreement. To the extent the terms of the
+// licenses applicable to Open Source Components prohibit any of the restrictions in this
+// License Agreement with respect to such Open Source Component, such restrictions will not
+// apply to such Open Source Component. To the extent the terms of the licenses applicable to
+// Open Source Components require Licensor to make an offer to provide source code or
+// related information in connection with the Software, such offer is hereby made. Any request
+// for source code or related information should be directed to cl-face-tracker-distribution@lists.cam.ac.uk
+// Licensee acknowledges receipt of notices for the Open Source Components for the initial
+// delivery of the Software.
+
+//     * Any publications arising from the use of this software, including but
+//       not limited to academic journal and conference publications, technical
+//       reports and manuals, must cite one of the following works:
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 3D
+//       Constrained Local Model for Rigid and Non-Rigid Facial Tracking.
+//       IEEE Conference on Computer Vision and Pattern Recognition (CVPR), 2012.    
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 
+//       Constrained Local Neural Fields for robust facial landmark detection in the wild.
+//       in IEEE Int. Conference on Computer Vision Workshops, 300 Faces in-the-Wild Challenge, 2013.    
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// clm_kernel_bench.cpp : Times the hot kernels of the landmark detection and AU analysis in isolation on synthetic inputs
+
+#include "CLM_core.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <filesystem.hpp>
+#include <filesystem/fstream.hpp>
+
+#include <FaceAnalyser.h>
+
+#define INFO_STREAM( stream ) \
+std::cout << stream << std::endl
+
+#define WARN_STREAM( stream ) \
+std::cout << "Warning: " << stream << std::endl
+
+#define ERROR_STREAM( stream ) \
+std::cout << "Error: " << stream << std::endl
+
+using namespace std;
+using namespace cv;
+
+using namespace boost::filesystem;
+
+vector<string> get_arguments(int argc, char **argv)
+{
+
+	vector<string> arguments;
+
+	for(int i = 0; i < argc; ++i)
+	{
+		arguments.push_back(string(argv[i]));
+	}
+	return arguments;
+}
+
+// The timing of one kernel in one configuration, bytes_per_call is the nominal traffic (every input read and every output written once)
+struct KernelResult
+{
+	string kernel;
+	string config;
+	double ns_per_call;
+	double ns_per_call_min;
+	double bytes_per_call;
+	long long calls;
+};
+
+// Runs the kernel in batches for about min_seconds in total, the time per call is the median over the batches
+template<typename Kernel>
+KernelResult time_kernel(const string& kernel_name, const string& config, double bytes_per_call, double min_seconds, Kernel kernel)
+{
+	const int num_batches = 9;
+
+	// Warm up, this also fills the template DFT and KDE caches the same way the tracking does
+	for(int i = 0; i < 3; ++i)
+	{
+		kernel();
+	}
+
+	// Find a batch size that takes about min_seconds / num_batches
+	long long batch = 1;
+	double target_ticks = min_seconds / num_batches * cv::getTickFrequency();
+	while(batch < (1 << 24))
+	{
+		int64 start = cv::getTickCount();
+		for(long long i = 0; i < batch; ++i)
+		{
+			kernel();
+		}
+		int64 end = cv::getTickCount();
+
+		if(end - start >= target_ticks)
+		{
+			break;
+		}
+		batch *= 2;
+	}
+
+	vector<double> ns_per_call(num_batches);
+	for(int b = 0; b < num_batches; ++b)
+	{
+		int64 start = cv::getTickCount();
+		for(long long i = 0; i < batch; ++i)
+		{
+			kernel();
+		}
+		int64 end = cv::getTickCount();
+
+		ns_per_call[b] = 1e9 * (double)(end - start) / cv::getTickFrequency() / batch;
+	}
+	std::sort(ns_per_call.begin(), ns_per_call.end());
+
+	KernelResult result;
+	result.kernel = kernel_name;
+	result.config = config;
+	result.ns_per_call = ns_per_call[num_batches / 2];
+	result.ns_per_call_min = ns_per_call[0];
+	result.bytes_per_call = bytes_per_call;
+	result.calls = batch * num_batches;
+
+	// Bytes per nanosecond are GB/s
+	INFO_STREAM(kernel_name << " (" << config << "): " << result.ns_per_call << " ns/call, " << bytes_per_call / result.ns_per_call << " GB/s");
+
+	return result;
+}
+
+void write_results(const string& filename, const vector<KernelResult>& results)
+{
+	std::ofstream output(filename);
+
+	if(!output.is_open())
+	{
+		ERROR_STREAM("Could not open " << filename << " for writing the kernel timings");
+		return;
+	}
+
+	output << "{" << endl;
+	output << "\t\"benchmark\": \"clm_kernel_bench\"," << endl;
+	output << "\t\"kernels\": [" << endl;
+
+	for(size_t i = 0; i < results.size(); ++i)
+	{
+		const KernelResult& result = results[i];
+		output << "\t\t{\"kernel\": \"" << result.kernel << "\", \"config\": \"" << result.config << "\"";
+		output << ", \"ns_per_call\": " << result.ns_per_call << ", \"ns_per_call_min\": " << result.ns_per_call_min;
+		output << ", \"bytes_per_call\": " << result.bytes_per_call << ", \"gb_per_s\": " << result.bytes_per_call / result.ns_per_call;
+		output << ", \"calls\": " << result.calls << "}";
+		output << (i + 1 < results.size() ? "," : "") << endl;
+	}
+
+	output << "\t]" << endl;
+	output << "}" << endl;
+}
+
+// Extracting the following command line arguments -o, -min_time, -kernel (and possible repetitions of the latter)
+void get_kernel_bench_params(string& output_file, double& min_seconds, vector<string>& kernels, vector<string>& arguments)
+{
+	bool* valid = new bool[arguments.size()];
+
+	for(size_t i = 0; i < arguments.size(); ++i)
+	{
+		valid[i] = true;
+	}
+
+	for(size_t i = 0; i < arguments.size(); ++i)
+	{
+		if (arguments[i].compare("-o") == 0)
+		{
+			output_file = arguments[i + 1];
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-min_time") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			data >> min_seconds;
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-kernel") == 0)
+		{
+			kernels.push_back(arguments[i + 1]);
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-help") == 0)
+		{
+			cout << "Kernel benchmark parameters are defined as follows: -o <results json> -min_time <seconds per kernel and configuration> -kernel <matchTemplate_m|crossCorr_m|ccnf_neuron|ccnf_expert|svr_expert|svr_depth_expert|mean_shift|jacobian|running_median> (can be repeated, all are run by default)" << endl; // Inform the user of how to use the program
+		}
+	}
+
+	for(int i=arguments.size()-1; i >= 0; --i)
+	{
+		if(!valid[i])
+		{
+			arguments.erase(arguments.begin()+i);
+		}
+	}
+
+	delete[] valid;
+}
+
+bool should_run(const vector<string>& kernels, const string& name)
+{
+	return kernels.empty() || std::find(kernels.begin(), kernels.end(), name) != kernels.end();
+}
+
+string window_config(int window_size)
+{
+	stringstream config;
+	config << "window " << window_size;
+	return config.str();
+}
+
+// The landmarks with patch experts in the frontal view at the most detailed scale
+vector<int> visible_landmarks(const CLMTracker::CLM& clm_model)
+{
+	vector<int> visible;
+	const Mat_<int>& visibilities = clm_model.patch_experts.visibilities[0][0];
+	for(int i = 0; i < visibilities.rows; ++i)
+	{
+		if(visibilities.at<int>(i, 0) != 0)
+		{
+			visible.push_back(i);
+		}
+	}
+	return visible;
+}
+
+// Synthetic areas of interest big enough to produce responses of the window size, values within [low, high)
+vector<Mat_<float> > areas_of_interest(int window_size, int patch_width, int patch_height, int count, float low, float high, RNG& rng)
+{
+	vector<Mat_<float> > areas(count);
+	for(int i = 0; i < count; ++i)
+	{
+		areas[i].create(window_size + patch_height - 1, window_size + patch_width - 1);
+		rng.fill(areas[i], RNG::UNIFORM, low, high);
+	}
+	return areas;
+}
+
+// The correlation kernels and CCNF neurons and experts, a call cycles through the visible landmarks
+void bench_ccnf(vector<KernelResult>& results, CLMTracker::CLM& clm_model, const vector<int>& window_sizes, double min_seconds, const vector<string>& kernels)
+{
+	vector<int> landmarks = visible_landmarks(clm_model);
+	vector<CLMTracker::CCNF_patch_expert>& experts = clm_model.patch_experts.ccnf_expert_intensity[0][0];
+
+	for(size_t w = 0; w < window_sizes.size(); ++w)
+	{
+		int window_size = window_sizes[w];
+
+		clm_model.patch_experts.PrecomputeSigmas(vector<int>(1, window_size));
+
+		RNG rng(window_size);
+
+		vector<Mat_<float> > areas(landmarks.size());
+		vector<Mat_<float> > responses(landmarks.size());
+
+		// The first neuron that is not skipped for every landmark, as a template for the correlation kernels
+		vector<CLMTracker::CCNF_neuron*> neurons(landmarks.size());
+
+		double expert_bytes = 0;
+		double neuron_bytes = 0;
+
+		for(size_t l = 0; l < landmarks.size(); ++l)
+		{
+			CLMTracker::CCNF_patch_expert& expert = experts[landmarks[l]];
+			areas[l] = areas_of_interest(window_size, expert.width, expert.height, 1, 0, 255, rng)[0];
+
+			neurons[l] = &expert.neurons[0];
+			for(size_t n = 0; n < expert.neurons.size(); ++n)
+			{
+				if(expert.neurons[n].alpha > 1e-4)
+				{
+					if(neurons[l]->alpha <= 1e-4)
+					{
+						neurons[l] = &expert.neurons[n];
+					}
+					expert_bytes += expert.neurons[n].weights.total() * sizeof(float);
+				}
+			}
+
+			expert_bytes += (areas[l].total() + window_size * window_size + (double)window_size * window_size * window_size * window_size) * sizeof(float);
+			neuron_bytes += (areas[l].total() + neurons[l]->weights.total() + window_size * window_size) * sizeof(float);
+		}
+
+		expert_bytes /= landmarks.size();
+		neuron_bytes /= landmarks.size();
+
+		// Every window size has Sigmas (from the alphas alone where the model has no edge features for it)
+		int sigma_index = clm_model.patch_experts.SigmaIndex(window_size);
+
+		size_t l = 0;
+
+		if(should_run(kernels, "crossCorr_m"))
+		{
+			vector<map<int, Mat_<double> > > templ_dfts(landmarks.size());
+			results.push_back(time_kernel("crossCorr_m", window_config(window_size), neuron_bytes, min_seconds, [&]()
+			{
+				Mat_<double> img_dft;
+				responses[l].create(window_size, window_size);
+				CLMTracker::crossCorr_m(areas[l], img_dft, neurons[l]->weights, templ_dfts[l], responses[l]);
+				l = (l + 1) % landmarks.size();
+			}));
+		}
+
+		if(should_run(kernels, "matchTemplate_m"))
+		{
+			vector<map<int, Mat_<double> > > templ_dfts(landmarks.size());
+			results.push_back(time_kernel("matchTemplate_m", window_config(window_size), neuron_bytes, min_seconds, [&]()
+			{
+				Mat_<double> img_dft;
+				Mat integral_img, integral_img_sq;
+				responses[l].create(window_size, window_size);
+				CLMTracker::matchTemplate_m(areas[l], img_dft, integral_img, integral_img_sq, neurons[l]->weights, templ_dfts[l], responses[l], CV_TM_CCOEFF_NORMED);
+				l = (l + 1) % landmarks.size();
+			}));
+		}
+
+		// The image DFT and integral images are shared between the neurons of an expert, so they are computed once up front here
+		if(should_run(kernels, "ccnf_neuron"))
+		{
+			vector<Mat_<double> > img_dfts(landmarks.size());
+			vector<Mat> integral_imgs(landmarks.size());
+			vector<Mat> integral_imgs_sq(landmarks.size());
+
+			results.push_back(time_kernel("ccnf_neuron", window_config(window_size), neuron_bytes, min_seconds, [&]()
+			{
+				neurons[l]->Response(areas[l], img_dfts[l], integral_imgs[l], integral_imgs_sq[l], responses[l]);
+				l = (l + 1) % landmarks.size();
+			}));
+		}
+
+		if(should_run(kernels, "ccnf_expert"))
+		{
+			results.push_back(time_kernel("ccnf_expert", window_config(window_size), expert_bytes, min_seconds, [&]()
+			{
+				experts[landmarks[l]].Response(areas[l], responses[l], experts[landmarks[l]].Sigmas[sigma_index]);
+				l = (l + 1) % landmarks.size();
+			}));
+		}
+	}
+}
+
+// SVR patch experts (intensity, or depth for CLM-Z), a call cycles through the visible landmarks
+void bench_svr(vector<KernelResult>& results, const string& kernel_name, CLMTracker::CLM& clm_model, bool depth, const vector<int>& window_sizes, double min_seconds)
+{
+	vector<int> landmarks = visible_landmarks(clm_model);
+	vector<CLMTracker::Multi_SVR_patch_expert>& experts = depth ? clm_model.patch_experts.svr_expert_depth[0][0] : clm_model.patch_experts.svr_expert_intensity[0][0];
+
+	for(size_t w = 0; w < window_sizes.size(); ++w)
+	{
+		int window_size = window_sizes[w];
+
+		RNG rng(window_size);
+
+		vector<Mat_<float> > areas(landmarks.size());
+		vector<Mat_<float> > responses(landmarks.size());
+
+		double bytes = 0;
+		for(size_t l = 0; l < landmarks.size(); ++l)
+		{
+			CLMTracker::Multi_SVR_patch_expert& expert = experts[landmarks[l]];
+
+			// Depth in millimetres around a face at about a metre away
+			areas[l] = depth ? areas_of_interest(window_size, expert.width, expert.height, 1, 800, 1200, rng)[0] : areas_of_interest(window_size, expert.width, expert.height, 1, 0, 255, rng)[0];
+
+			bytes += (areas[l].total() + window_size * window_size) * sizeof(float);
+			for(size_t e = 0; e < expert.svr_patch_experts.size(); ++e)
+			{
+				bytes += expert.svr_patch_experts[e].weights.total() * sizeof(float);
+			}
+		}
+		bytes /= landmarks.size();
+
+		size_t l = 0;
+		results.push_back(time_kernel(kernel_name, window_config(window_size), bytes, min_seconds, [&]()
+		{
+			if(depth)
+			{
+				experts[landmarks[l]].ResponseDepth(areas[l], responses[l]);
+			}
+			else
+			{
+				experts[landmarks[l]].Response(areas[l], responses[l]);
+			}
+			l = (l + 1) % landmarks.size();
+		}));
+	}
+}
+
+// The mean shifts of all the landmarks from their response maps, a call is one NU-RLMS iteration worth
+void bench_mean_shift(vector<KernelResult>& results, CLMTracker::CLM& clm_model, const CLMTracker::CLMParameters& clm_parameters, const vector<int>& window_sizes, double min_seconds)
+{
+	int n = clm_model.pdm.NumberOfPoints();
+	float a = -0.5/(clm_parameters.sigma * clm_parameters.sigma);
+
+	for(size_t w = 0; w < window_sizes.size(); ++w)
+	{
+		int window_size = window_sizes[w];
+
+		RNG rng(window_size);
+
+		vector<Mat_<float> > responses(n);
+		for(int i = 0; i < n; ++i)
+		{
+			responses[i].create(window_size, window_size);
+			rng.fill(responses[i], RNG::UNIFORM, 0, 1);
+		}
+
+		Mat_<float> dxs(n, 1), dys(n, 1);
+		rng.fill(dxs, RNG::UNIFORM, 0, window_size);
+		rng.fill(dys, RNG::UNIFORM, 0, window_size);
+
+		Mat_<float> mean_shifts(2 * n, 1, 0.0f);
+		map<int, Mat_<float> > kde_resp_precalc;
+
+		// The responses and the matching KDE rows are read, the offsets read and the shifts written
+		double bytes = (2.0 * n * window_size * window_size + 4 * n) * sizeof(float);
+
+		results.push_back(time_kernel("mean_shift", window_config(window_size), bytes, min_seconds, [&]()
+		{
+			clm_model.NonVectorisedMeanShift_precalc_kde(mean_shifts, responses, dxs, dys, window_size, a, 0, 0, kde_resp_precalc);
+		}));
+	}
+}
+
+void bench_jacobian(vector<KernelResult>& results, CLMTracker::CLM& clm_model, double min_seconds)
+{
+	CLMTracker::PDM& pdm = clm_model.pdm;
+
+	int n = pdm.NumberOfPoints();
+	int m = pdm.NumberOfModes();
+
+	// A plausible non-rigid shape (within a standard deviation of the PDM) slightly rotated
+	RNG rng(0);
+	Mat_<float> params_local(m, 1);
+	for(int i = 0; i < m; ++i)
+	{
+		params_local(i) = (float)(rng.uniform(-1.0, 1.0) * sqrt(pdm.eigen_values.at<double>(i)));
+	}
+	Vec6d params_global(1.0, 0.1, -0.1, 0.05, 320, 240);
+
+	Mat_<float> W = Mat_<float>::eye(2 * n, 2 * n);
+	Mat_<float> J, J_w_t;
+
+	// The PDM, the weights and the two Jacobians
+	double bytes = (double)(pdm.princ_comp.total() + pdm.mean_shape.total()) * sizeof(double) + (double)(W.total() + 2 * 2 * n * (6 + m) + m) * sizeof(float);
+
+	stringstream config;
+	config << n << " points, " << m << " modes";
+
+	results.push_back(time_kernel("jacobian", config.str(), bytes, min_seconds, [&]()
+	{
+		pdm.ComputeJacobian(params_local, params_global, J, W, J_w_t);
+	}));
+}
+
+// Running median updates of the HOG and geometry descriptors with the FaceAnalyser histogram sizes
+void bench_running_median(vector<KernelResult>& results, const CLMTracker::CLM& clm_model, double min_seconds)
+{
+	// 112x112 aligned faces with 8 pixel cells give 12x12 cells of 31 FHOG features
+	int hog_dims = 12 * 12 * 31;
+	int geom_dims = clm_model.pdm.princ_comp.rows + clm_model.pdm.NumberOfModes();
+
+	const char* names[2] = {"hog", "geom"};
+	int dims[2] = {hog_dims, geom_dims};
+	int num_bins[2] = {600, 10000};
+	double min_vals[2] = {0, -60};
+	double max_vals[2] = {1, 60};
+
+	for(int d = 0; d < 2; ++d)
+	{
+		RNG rng(d);
+
+		// A pool of descriptors to cycle through, so that the histograms do not concentrate on one bin
+		const int pool_size = 16;
+		vector<Mat_<float> > descriptors(pool_size);
+		for(int i = 0; i < pool_size; ++i)
+		{
+			descriptors[i].create(1, dims[d]);
+			rng.fill(descriptors[i], RNG::UNIFORM, min_vals[d], max_vals[d]);
+		}
+
+		Mat_<unsigned short> histogram;
+		Mat_<float> median;
+		int hist_count = 0;
+
+		// Some history before timing, as after a few seconds of video
+		for(int i = 0; i < 100; ++i)
+		{
+			Psyche::FaceAnalyser::UpdateRunningMedian(histogram, hist_count, median, descriptors[i % pool_size], true, num_bins[d], min_vals[d], max_vals[d]);
+		}
+
+		// The histogram is scanned for the median, the descriptor read and the median written
+		double bytes = (double)dims[d] * num_bins[d] * sizeof(unsigned short) + 2.0 * dims[d] * sizeof(float);
+
+		stringstream config;
+		config << names[d] << ", " << dims[d] << " dims, " << num_bins[d] << " bins";
+
+		int i = 0;
+		results.push_back(time_kernel("running_median", config.str(), bytes, min_seconds, [&]()
+		{
+			Psyche::FaceAnalyser::UpdateRunningMedian(histogram, hist_count, median, descriptors[i], true, num_bins[d], min_vals[d], max_vals[d]);
+			i = (i + 1) % pool_size;
+		}));
+	}
+}
+
+int main (int argc, char **argv)
+{
+
+	vector<string> arguments = get_arguments(argc, argv);
+
+	path root = path(arguments[0]).parent_path();
+
+	string output_file = "clm_kernel_bench.json";
+	double min_seconds = 0.5;
+	vector<string> kernels;
+
+	get_kernel_bench_params(output_file, min_seconds, kernels, arguments);
+
+	CLMTracker::CLMParameters clm_parameters(arguments);
+
+	// The window sizes of the tracking schedules (small, initialisation) and of in the wild images
+	vector<int> window_sizes;
+	window_sizes.push_back(7);
+	window_sizes.push_back(9);
+	window_sizes.push_back(11);
+	window_sizes.push_back(15);
+
+	vector<KernelResult> results;
+
+	// The CCNF model (-mloc, the default one if not specified)
+	CLMTracker::CLM clm_model(clm_parameters.model_location);
+
+	if(clm_model.patch_experts.ccnf_expert_intensity.empty())
+	{
+		WARN_STREAM("The model " << clm_parameters.model_location << " has no CCNF patch experts");
+	}
+	else if(should_run(kernels, "crossCorr_m") || should_run(kernels, "matchTemplate_m") || should_run(kernels, "ccnf_neuron") || should_run(kernels, "ccnf_expert"))
+	{
+		bench_ccnf(results, clm_model, window_sizes, min_seconds, kernels);
+	}
+
+	// The SVR experts come from the CLM and CLM-Z models
+	string svr_location = "model/main_svr_general.txt";
+	string clmz_location = "model/main_clm-z.txt";
+	if(!exists(path(svr_location)))
+	{
+		svr_location = (root / path(svr_location)).string();
+		clmz_location = (root / path(clmz_location)).string();
+	}
+
+	if(should_run(kernels, "svr_expert"))
+	{
+		if(exists(path(svr_location)))
+		{
+			CLMTracker::CLM svr_model(svr_location);
+			bench_svr(results, "svr_expert", svr_model, false, window_sizes, min_seconds);
+		}
+		else
+		{
+			WARN_STREAM("Could not find " << svr_location << ", skipping the SVR experts");
+		}
+	}
+
+	if(should_run(kernels, "svr_depth_expert"))
+	{
+		if(exists(path(clmz_location)))
+		{
+			CLMTracker::CLM clmz_model(clmz_location);
+			if(!clmz_model.patch_experts.svr_expert_depth.empty())
+			{
+				bench_svr(results, "svr_depth_expert", clmz_model, true, window_sizes, min_seconds);
+			}
+		}
+		else
+		{
+			WARN_STREAM("Could not find " << clmz_location << ", skipping the depth SVR experts");
+		}
+	}
+
+	if(should_run(kernels, "mean_shift"))
+	{
+		bench_mean_shift(results, clm_model, clm_parameters, window_sizes, min_seconds);
+	}
+
+	if(should_run(kernels, "jacobian"))
+	{
+		bench_jacobian(results, clm_model, min_seconds);
+	}
+
+	if(should_run(kernels, "running_median"))
+	{
+		bench_running_median(results, clm_model, min_seconds);
+	}
+
+	write_results(output_file, results);
+
+	return 0;
+}
+
@@ -0,0 +1,1217 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2014, University of Southern California and University of Cambridge,
+// all rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED AS IS AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY. OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Notwithstanding the license granted herein, Licensee acknowledges that certain components
+// of the Software may be covered by so-called open source software licenses (Open Source
+// Components), which means any software licenses approved as open source licenses by the
+// Open Source Initiative or any substantially similar licenses, including without limitation any
+// license that, as a condition of distribution of the software licensed under such license,
+// requires that the distributor make the software available in source code format. Licensor shall
+// provide a list of Open Source Components for a particular version of the Software upon
+// Licensees request. Licensee will comply with the applicable terms of such licenses and to
+// the extent required by the licenses covering Open Source Components, the terms of such
+// licenses will apply in lieu of the terms of this Agreement. To the extent the terms of the
+// licenses applicable to Open Source Components prohibit any of the restrictions in this
+// License Agreement with respect to such Open Source Component, such restrictions will not
+// apply to such Open Source Component. To the extent the terms of the licenses applicable to
+// Open Source Components require Licensor to make an offer to provide source code or
+// related information in connection with the Software, such offer is hereby made. Any request
+// for source code or related information should be directed to cl-face-tracker-distribution@lists.cam.ac.uk
+// Licensee acknowledges receipt of notices for the Open Source Components for the initial
+// delivery of the Software.
+
+//     * Any publications arising from the use of this software, including but
+//       not limited to academic journal and conference publications, technical
+//       reports and manuals, must cite one of the following works:
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 3D
+//       Constrained Local Model for Rigid and Non-Rigid Facial Tracking.
+//       IEEE Conference on Computer Vision and Pattern Recognition (CVPR), 2012.    
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 
+//       Constrained Local Neural Fields for robust facial landmark detection in the wild.
+//       in IEEE Int. Conference on Computer Vision Workshops, 300 Faces in-the-Wild Challenge, 2013.    
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// clm_regression.cpp : Compares the landmarks, pose, HOG and AU outputs on the bundled samples against stored golden files
+
+#include "CLM_core.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/videoio/videoio.hpp>
+
+#include <filesystem.hpp>
+#include <filesystem/fstream.hpp>
+
+#include <FaceAnalyser.h>
+#include <Face_utils.h>
+#include <ToolUtils.h>
+
+#define INFO_STREAM( stream ) \
+std::cout << stream << std::endl
+
+#define WARN_STREAM( stream ) \
+std::cout << "Warning: " << stream << std::endl
+
+#define ERROR_STREAM( stream ) \
+std::cout << "Error: " << stream << std::endl
+
+using namespace std;
+using namespace cv;
+
+using namespace boost::filesystem;
+
+vector<string> get_arguments(int argc, char **argv)
+{
+
+	vector<string> arguments;
+
+	for(int i = 0; i < argc; ++i)
+	{
+		arguments.push_back(string(argv[i]));
+	}
+	return arguments;
+}
+
+// How far the outputs are allowed to drift from the golden ones
+struct Tolerances
+{
+	// Per landmark distance in pixels
+	double landmarks;
+
+	// Head translation in millimetres and rotation in radians
+	double pose_translation;
+	double pose_rotation;
+
+	// Absolute differences of the HOG features and AU predictions
+	double hog;
+	double aus;
+
+	// Largest AU intensity difference between the single precision feature path and the original double precision one
+	double au_precision;
+
+	// Largest AU intensity difference between analysing a video in chunks (with the chunk medians merged) and in one go
+	double au_chunks;
+
+	Tolerances() : landmarks(0.5), pose_translation(1.0), pose_rotation(0.01), hog(0.01), aus(0.05), au_precision(0.001), au_chunks(0.05) {}
+
+	// Sets a tolerance by its name in the tolerance file, returns false for an unknown name
+	bool Set(const string& name, double value)
+	{
+		if(name.compare("landmarks") == 0) landmarks = value;
+		else if(name.compare("pose_translation") == 0) pose_translation = value;
+		else if(name.compare("pose_rotation") == 0) pose_rotation = value;
+		else if(name.compare("hog") == 0) hog = value;
+		else if(name.compare("aus") == 0) aus = value;
+		else if(name.compare("au_precision") == 0) au_precision = value;
+		else if(name.compare("au_chunks") == 0) au_chunks = value;
+		else return false;
+		return true;
+	}
+};
+
+// The tolerances are stored with the golden files (tolerances.txt), every line is <sample> <tolerance name> <value>,
+// where the sample is * for all of them. The lines of the sample itself are applied after the * ones
+void read_tolerances(const string& filename, const string& sample, Tolerances& tolerances)
+{
+	std::ifstream tolerance_file(filename);
+	if(!tolerance_file.is_open())
+	{
+		return;
+	}
+
+	vector<string> samples;
+	vector<string> names;
+	vector<double> values;
+
+	string line;
+	while(getline(tolerance_file, line))
+	{
+		if(line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		stringstream data(line);
+		string line_sample, name;
+		double value;
+		if(data >> line_sample >> name >> value)
+		{
+			samples.push_back(line_sample);
+			names.push_back(name);
+			values.push_back(value);
+		}
+	}
+
+	for(int pass = 0; pass < 2; ++pass)
+	{
+		for(size_t i = 0; i < samples.size(); ++i)
+		{
+			bool applies = pass == 0 ? samples[i].compare("*") == 0 : samples[i].compare(sample) == 0;
+			if(applies && !tolerances.Set(names[i], values[i]))
+			{
+				WARN_STREAM("Unknown tolerance " << names[i] << " in " << filename);
+			}
+		}
+	}
+}
+
+// Written when recording the golden files for the first time, so that every golden file has its tolerance
+void write_tolerances(const string& filename, const Tolerances& tolerances)
+{
+	std::ofstream tolerance_file(filename);
+	if(!tolerance_file.is_open())
+	{
+		ERROR_STREAM("Could not open " << filename << " for writing");
+		return;
+	}
+
+	tolerance_file << "# <sample> <tolerance> <value>, * applies to every sample and a sample's own lines override it" << endl;
+	tolerance_file << "* landmarks " << tolerances.landmarks << endl;
+	tolerance_file << "* pose_translation " << tolerances.pose_translation << endl;
+	tolerance_file << "* pose_rotation " << tolerances.pose_rotation << endl;
+	tolerance_file << "* hog " << tolerances.hog << endl;
+	tolerance_file << "* aus " << tolerances.aus << endl;
+	tolerance_file << "* au_precision " << tolerances.au_precision << endl;
+	tolerance_file << "* au_chunks " << tolerances.au_chunks << endl;
+}
+
+// The per frame (or per image) rows of one output of a sample, the first num_leading columns (frame, success) have to match exactly
+struct OutputRows
+{
+	string name;
+	vector<string> columns;
+	int num_leading;
+	vector<vector<double> > rows;
+};
+
+struct OutputComparison
+{
+	string output;
+	int rows;
+	int golden_rows;
+	int rows_over_tolerance;
+	int leading_mismatches;
+	double tolerance;
+	double mean_error;
+	double p99_error;
+	double max_error;
+	bool passed;
+	// Nothing to compare against (no golden file), this does not fail the run
+	bool skipped;
+	string message;
+
+	OutputComparison() : passed(false), skipped(false) {}
+};
+
+struct SampleResult
+{
+	string name;
+	int frames;
+	double total_ms;
+	vector<OutputComparison> comparisons;
+};
+
+// The tracking results of the frames of a video, so that they can be analysed again without tracking
+struct TrackedFrames
+{
+	vector<Mat_<float> > hog_descriptors;
+	int num_hog_rows;
+	int num_hog_cols;
+	vector<Vec6d> params_global;
+	vector<Mat_<double> > params_local;
+	vector<bool> successes;
+
+	TrackedFrames() : num_hog_rows(0), num_hog_cols(0) {}
+};
+
+// Extracting the following command line arguments -root, -golden, -o, -frames, -videos, -record, -tol_lmk, -tol_pose_t, -tol_pose_r, -tol_hog, -tol_au, -tol_precision, -tol_chunks
+// (the tolerances given on the command line override the ones stored with the golden files)
+void get_regression_params(string& data_root, string& golden_dir, string& output_file, int& max_frames, int& num_videos, bool& record, vector<pair<string, double> >& tolerance_overrides, vector<string>& arguments)
+{
+	bool* valid = new bool[arguments.size()];
+
+	for(size_t i = 0; i < arguments.size(); ++i)
+	{
+		valid[i] = true;
+	}
+
+	for(size_t i = 0; i < arguments.size(); ++i)
+	{
+		if (arguments[i].compare("-root") == 0)
+		{
+			data_root = arguments[i + 1];
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-golden") == 0)
+		{
+			golden_dir = arguments[i + 1];
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-o") == 0)
+		{
+			output_file = arguments[i + 1];
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-frames") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			data >> max_frames;
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-videos") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			data >> num_videos;
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-record") == 0)
+		{
+			record = true;
+			valid[i] = false;
+		}
+		else if (arguments[i].compare("-tol_lmk") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			double tolerance;
+			data >> tolerance;
+			tolerance_overrides.push_back(make_pair(string("landmarks"), tolerance));
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-tol_pose_t") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			double tolerance;
+			data >> tolerance;
+			tolerance_overrides.push_back(make_pair(string("pose_translation"), tolerance));
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-tol_pose_r") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			double tolerance;
+			data >> tolerance;
+			tolerance_overrides.push_back(make_pair(string("pose_rotation"), tolerance));
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-tol_hog") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			double tolerance;
+			data >> tolerance;
+			tolerance_overrides.push_back(make_pair(string("hog"), tolerance));
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-tol_au") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			double tolerance;
+			data >> tolerance;
+			tolerance_overrides.push_back(make_pair(string("aus"), tolerance));
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-tol_precision") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			double tolerance;
+			data >> tolerance;
+			tolerance_overrides.push_back(make_pair(string("au_precision"), tolerance));
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-tol_chunks") == 0)
+		{
+			stringstream data(arguments[i + 1]);
+			double tolerance;
+			data >> tolerance;
+			tolerance_overrides.push_back(make_pair(string("au_chunks"), tolerance));
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-help") == 0)
+		{
+			cout << "Regression parameters are defined as follows: -root <directory containing videos/ and imgs/> -golden <golden file directory> -record (write the golden files instead of comparing) -o <results json> -frames <max frames per video> -videos <number of videos> -tol_lmk <pixels> -tol_pose_t <mm> -tol_pose_r <radians> -tol_hog <abs. difference> -tol_au <abs. difference> -tol_precision <abs. difference between the float and double AU paths> -tol_chunks <abs. difference between the chunked and whole video AUs>" << endl; // Inform the user of how to use the program
+		}
+	}
+
+	for(int i=arguments.size()-1; i >= 0; --i)
+	{
+		if(!valid[i])
+		{
+			arguments.erase(arguments.begin()+i);
+		}
+	}
+
+	delete[] valid;
+}
+
+void add_landmark_and_pose_rows(OutputRows& landmarks, OutputRows& pose, int frame, bool success, CLMTracker::CLM& clm_model, CLMTracker::CLMParameters& clm_parameters, const Mat& image)
+{
+	int n = clm_model.pdm.NumberOfPoints();
+
+	if(landmarks.columns.empty())
+	{
+		vector<string> leading;
+		leading.push_back("frame");
+		leading.push_back("success");
+
+		landmarks.columns = CLMTracker::LandmarkColumnNames(leading, n);
+		pose.columns = CLMTracker::PoseColumnNames(leading);
+	}
+
+	vector<double> landmark_row;
+	landmark_row.push_back(frame);
+	landmark_row.push_back(success);
+	for(int i = 0; i < 2 * n; ++i)
+	{
+		landmark_row.push_back(clm_model.detected_landmarks.at<double>(i));
+	}
+	landmarks.rows.push_back(landmark_row);
+
+	// The same camera assumptions as FeatureExtraction
+	double fx = 500, fy = 500, cx = image.cols / 2.0, cy = image.rows / 2.0;
+	Vec6d pose_estimate = CLMTracker::GetCorrectedPoseCamera(clm_model, fx, fy, cx, cy, clm_parameters);
+
+	vector<double> pose_row;
+	pose_row.push_back(frame);
+	pose_row.push_back(success);
+	for(int i = 0; i < 6; ++i)
+	{
+		pose_row.push_back(pose_estimate[i]);
+	}
+	pose.rows.push_back(pose_row);
+}
+
+// Tracks a video and runs the face analyser on every frame, only the processing (not the decoding) is timed
+void process_video(const string& video, int max_frames, CLMTracker::CLM& clm_model, CLMTracker::CLMParameters& clm_parameters, Psyche::FaceAnalyser& face_analyser, vector<OutputRows>& outputs,
+	TrackedFrames& tracked, SampleResult& result)
+{
+	outputs.resize(4);
+	outputs[0].name = "landmarks";
+	outputs[1].name = "pose";
+	outputs[2].name = "hog";
+	outputs[3].name = "aus";
+	outputs[0].num_leading = outputs[1].num_leading = 2;
+	outputs[2].num_leading = outputs[3].num_leading = 1;
+
+	clm_model.Reset();
+	face_analyser.Reset();
+
+	// The double precision reference path is run alongside the single precision one
+	face_analyser.SetPrecisionCheck(true);
+
+	VideoCapture video_capture(video);
+
+	if(!video_capture.isOpened())
+	{
+		WARN_STREAM("Could not open " << video);
+		return;
+	}
+
+	double fps = video_capture.get(CV_CAP_PROP_FPS);
+	if(fps <= 0)
+	{
+		fps = 30;
+	}
+
+	Mat captured_image;
+	Mat_<uchar> grayscale_image;
+
+	for(int frame = 0; frame < max_frames && video_capture.read(captured_image); ++frame)
+	{
+		ToolUtils::to_grayscale(captured_image, grayscale_image);
+
+		int64 start = cv::getTickCount();
+
+		bool success = CLMTracker::DetectLandmarksInVideo(grayscale_image, clm_model, clm_parameters);
+		face_analyser.AddNextFrame(captured_image, clm_model, frame / fps, false);
+
+		int64 end = cv::getTickCount();
+
+		result.total_ms += 1000.0 * (end - start) / cv::getTickFrequency();
+		result.frames++;
+
+		add_landmark_and_pose_rows(outputs[0], outputs[1], frame, success, clm_model, clm_parameters, captured_image);
+
+		Mat_<double> hog_descriptor;
+		int num_hog_rows, num_hog_cols;
+		face_analyser.GetLatestHOG(hog_descriptor, num_hog_rows, num_hog_cols);
+
+		if(outputs[2].columns.empty() && !hog_descriptor.empty())
+		{
+			outputs[2].columns.push_back("frame");
+			for(size_t i = 0; i < hog_descriptor.total(); ++i)
+			{
+				outputs[2].columns.push_back("hog_" + to_string((long long)i));
+			}
+		}
+
+		vector<double> hog_row(1, frame);
+		hog_row.insert(hog_row.end(), hog_descriptor.begin(), hog_descriptor.end());
+		outputs[2].rows.push_back(hog_row);
+
+		Mat_<float> hog_descriptor_float;
+		hog_descriptor.convertTo(hog_descriptor_float, CV_32F);
+		tracked.hog_descriptors.push_back(hog_descriptor_float);
+		tracked.num_hog_rows = num_hog_rows;
+		tracked.num_hog_cols = num_hog_cols;
+		tracked.params_global.push_back(clm_model.params_global);
+		tracked.params_local.push_back(clm_model.params_local.clone());
+		tracked.successes.push_back(success);
+
+		auto au_preds = face_analyser.GetCurrentAUsCombined();
+
+		// The AU names are only known once the first prediction is made
+		if(outputs[3].columns.empty() && !au_preds.empty())
+		{
+			outputs[3].columns.push_back("frame");
+			for(auto au_it = au_preds.begin(); au_it != au_preds.end(); ++au_it)
+			{
+				outputs[3].columns.push_back(au_it->first);
+			}
+		}
+
+		vector<double> au_row(1, frame);
+		for(auto au_it = au_preds.begin(); au_it != au_preds.end(); ++au_it)
+		{
+			au_row.push_back(au_it->second);
+		}
+		outputs[3].rows.push_back(au_row);
+	}
+}
+
+// Landmark detection in each of the still images
+void process_images(const vector<string>& images, CLMTracker::CLM& clm_model, CLMTracker::CLMParameters& clm_parameters, vector<OutputRows>& outputs, SampleResult& result)
+{
+	outputs.resize(2);
+	outputs[0].name = "landmarks";
+	outputs[1].name = "pose";
+	outputs[0].num_leading = outputs[1].num_leading = 2;
+
+	for(size_t i = 0; i < images.size(); ++i)
+	{
+		Mat captured_image = imread(images[i], -1);
+
+		if(captured_image.empty())
+		{
+			WARN_STREAM("Could not read " << images[i]);
+			continue;
+		}
+
+		Mat_<uchar> grayscale_image;
+		ToolUtils::to_grayscale(captured_image, grayscale_image);
+
+		clm_model.Reset();
+
+		int64 start = cv::getTickCount();
+		bool success = CLMTracker::DetectLandmarksInImage(grayscale_image, clm_model, clm_parameters);
+		int64 end = cv::getTickCount();
+
+		result.total_ms += 1000.0 * (end - start) / cv::getTickFrequency();
+		result.frames++;
+
+		add_landmark_and_pose_rows(outputs[0], outputs[1], (int)i, success, clm_model, clm_parameters, captured_image);
+	}
+	clm_model.Reset();
+}
+
+// The single precision feature path against the original double precision one, this needs no golden files
+OutputComparison compare_precision(Psyche::FaceAnalyser& face_analyser, int frames, const Tolerances& tolerances)
+{
+	OutputComparison comparison;
+	comparison.output = "au_precision";
+	comparison.rows = frames;
+	comparison.golden_rows = frames;
+	comparison.leading_mismatches = 0;
+	comparison.tolerance = tolerances.au_precision;
+	comparison.max_error = face_analyser.GetMaxPrecisionDrift();
+	comparison.mean_error = comparison.max_error;
+	comparison.p99_error = comparison.max_error;
+	comparison.passed = comparison.max_error <= comparison.tolerance;
+	comparison.rows_over_tolerance = comparison.passed ? 0 : 1;
+
+	face_analyser.SetPrecisionCheck(false);
+
+	if(frames == 0)
+	{
+		comparison.passed = false;
+		comparison.message = "no frames were analysed";
+	}
+	else if(!comparison.passed)
+	{
+		comparison.message = "the float AU predictions drifted from the double precision ones";
+	}
+	return comparison;
+}
+
+// A CCNF window size the model has no edge features for has to get a Sigma from the neuron alphas alone, (2 * sum of alphas * I)^-1,
+// and a response of that size
+OutputComparison compare_unmatched_window(const CLMTracker::CLM& clm_model)
+{
+	OutputComparison comparison;
+	comparison.output = "ccnf_unmatched_window";
+	comparison.rows = 0;
+	comparison.golden_rows = 0;
+	comparison.rows_over_tolerance = 0;
+	comparison.leading_mismatches = 0;
+	comparison.tolerance = 1e-5;
+	comparison.mean_error = 0;
+	comparison.p99_error = 0;
+	comparison.max_error = 0;
+	comparison.passed = true;
+
+	if(clm_model.patch_experts.ccnf_expert_intensity.empty())
+	{
+		comparison.message = "skipped, the model has no CCNF patch experts";
+		return comparison;
+	}
+
+	// The smallest odd window size without sigma components
+	const vector<vector<Mat_<float> > >& sigma_components = clm_model.patch_experts.sigma_components;
+	int window_size = 3;
+	for(bool matched = true; matched; )
+	{
+		matched = false;
+		for(size_t w = 0; w < sigma_components.size(); ++w)
+		{
+			if(!sigma_components[w].empty() && sigma_components[w][0].rows == window_size * window_size)
+			{
+				matched = true;
+			}
+		}
+		if(matched)
+		{
+			window_size += 2;
+		}
+	}
+
+	CLMTracker::Patch_experts patch_experts(clm_model.patch_experts);
+	patch_experts.PrecomputeSigmas(vector<int>(1, window_size));
+	int sigma_index = patch_experts.SigmaIndex(window_size);
+
+	if(sigma_index == -1)
+	{
+		stringstream message;
+		message << "no Sigma was computed for window size " << window_size;
+		comparison.message = message.str();
+		comparison.passed = false;
+		return comparison;
+	}
+
+	vector<CLMTracker::CCNF_patch_expert>& experts = patch_experts.ccnf_expert_intensity[0][0];
+	RNG rng(window_size);
+	double sum_errors = 0;
+
+	for(size_t l = 0; l < experts.size(); ++l)
+	{
+		CLMTracker::CCNF_patch_expert& expert = experts[l];
+		if(expert.neurons.empty())
+		{
+			continue;
+		}
+
+		double sum_alphas = 0;
+		for(size_t n = 0; n < expert.neurons.size(); ++n)
+		{
+			sum_alphas += expert.neurons[n].alpha;
+		}
+
+		const Mat_<float>& Sigma = expert.Sigmas[sigma_index];
+		bool over = Sigma.rows != window_size * window_size || Sigma.cols != window_size * window_size;
+
+		// The error relative to the expected diagonal
+		for(int y = 0; y < Sigma.rows && !over; ++y)
+		{
+			for(int x = 0; x < Sigma.cols; ++x)
+			{
+				double expected = x == y ? 1.0 / (2 * sum_alphas) : 0;
+				double error = std::abs(Sigma(y, x) - expected) * 2 * sum_alphas;
+				comparison.max_error = std::max(comparison.max_error, error);
+				sum_errors += error;
+				over = over || error > comparison.tolerance;
+			}
+		}
+
+		Mat_<float> area_of_interest(window_size + expert.height - 1, window_size + expert.width - 1);
+		rng.fill(area_of_interest, RNG::UNIFORM, 0, 255);
+		Mat_<float> response;
+		expert.Response(area_of_interest, response, Sigma);
+		over = over || response.rows != window_size || response.cols != window_size || !checkRange(response);
+
+		comparison.rows++;
+		comparison.rows_over_tolerance += over ? 1 : 0;
+	}
+
+	if(comparison.rows > 0)
+	{
+		comparison.mean_error = sum_errors / (comparison.rows * window_size * window_size * window_size * window_size);
+	}
+	comparison.p99_error = comparison.max_error;
+	comparison.golden_rows = comparison.rows;
+
+	if(comparison.rows_over_tolerance > 0)
+	{
+		stringstream message;
+		message << comparison.rows_over_tolerance << " landmarks have a wrong Sigma or response for window size " << window_size;
+		comparison.message = message.str();
+		comparison.passed = false;
+	}
+	return comparison;
+}
+
+// The AU intensities of the tracked frames as FeatureExtraction predicts them, a first pass over the chunks for the running medians (with an
+// analyser per chunk, merged in order) and a second pass over all of the frames for the predictions, a single chunk is the serial run
+vector<vector<double> > analyse_in_chunks(const TrackedFrames& tracked, const CLMTracker::PDM& pdm, const Psyche::FaceAnalyser& analyser_prototype, int num_chunks)
+{
+	int num_frames = (int)tracked.successes.size();
+	vector<CLMTracker::FrameSegment> chunks = CLMTracker::SplitIntoChunks(num_frames, num_chunks);
+	vector<Psyche::FaceAnalyser> analysers(chunks.size(), analyser_prototype);
+
+	for(size_t c = 0; c < chunks.size(); ++c)
+	{
+		int end = chunks[c].end < 0 ? num_frames - 1 : chunks[c].end;
+		for(int frame = chunks[c].begin; frame <= end; ++frame)
+		{
+			analysers[c].AddNextHOG(tracked.hog_descriptors[frame], tracked.num_hog_rows, tracked.num_hog_cols, pdm, tracked.params_global[frame], tracked.params_local[frame], tracked.successes[frame], 0);
+		}
+	}
+
+	for(size_t c = 1; c < chunks.size(); ++c)
+	{
+		analysers[0].MergeMedians(analysers[c]);
+	}
+
+	vector<vector<double> > rows;
+	for(int frame = 0; frame < num_frames; ++frame)
+	{
+		analysers[0].AddNextHOG(tracked.hog_descriptors[frame], tracked.num_hog_rows, tracked.num_hog_cols, pdm, tracked.params_global[frame], tracked.params_local[frame], tracked.successes[frame], 0);
+
+		auto au_preds = analysers[0].GetCurrentAUsReg();
+		auto au_preds_class = analysers[0].GetCurrentAUsClass();
+		auto au_preds_segmented = analysers[0].GetCurrentAUsRegSegmented();
+		au_preds.insert(au_preds.end(), au_preds_class.begin(), au_preds_class.end());
+		au_preds.insert(au_preds.end(), au_preds_segmented.begin(), au_preds_segmented.end());
+
+		vector<double> row;
+		for(auto au_it = au_preds.begin(); au_it != au_preds.end(); ++au_it)
+		{
+			row.push_back(au_it->second);
+		}
+		rows.push_back(row);
+	}
+	return rows;
+}
+
+// The AUs of a video analysed in chunks against the ones of it analysed in one go, on the same tracking results (so only the merging of the
+// analysers is checked, not the tracker warm-up of the chunks), this needs no golden files
+OutputComparison compare_chunks(const TrackedFrames& tracked, const CLMTracker::PDM& pdm, const Psyche::FaceAnalyser& analyser_prototype, int num_chunks, const Tolerances& tolerances)
+{
+	OutputComparison comparison;
+	comparison.output = "au_chunks";
+	comparison.rows = (int)tracked.successes.size();
+	comparison.golden_rows = comparison.rows;
+	comparison.rows_over_tolerance = 0;
+	comparison.leading_mismatches = 0;
+	comparison.tolerance = tolerances.au_chunks;
+	comparison.mean_error = 0;
+	comparison.p99_error = 0;
+	comparison.max_error = 0;
+
+	vector<vector<double> > serial_rows = analyse_in_chunks(tracked, pdm, analyser_prototype, 1);
+	vector<vector<double> > chunked_rows = analyse_in_chunks(tracked, pdm, analyser_prototype, num_chunks);
+
+	vector<double> all_errors;
+	for(size_t r = 0; r < serial_rows.size() && r < chunked_rows.size(); ++r)
+	{
+		bool over = serial_rows[r].size() != chunked_rows[r].size();
+		for(size_t i = 0; i < serial_rows[r].size() && i < chunked_rows[r].size(); ++i)
+		{
+			double error = abs(serial_rows[r][i] - chunked_rows[r][i]);
+			over = over || error > comparison.tolerance;
+			all_errors.push_back(error);
+		}
+
+		if(over)
+		{
+			comparison.rows_over_tolerance++;
+		}
+	}
+
+	if(!all_errors.empty())
+	{
+		double sum = 0;
+		for(size_t i = 0; i < all_errors.size(); ++i)
+		{
+			sum += all_errors[i];
+		}
+		comparison.mean_error = sum / all_errors.size();
+
+		std::sort(all_errors.begin(), all_errors.end());
+		comparison.p99_error = all_errors[std::min(all_errors.size() - 1, (size_t)(0.99 * all_errors.size()))];
+		comparison.max_error = all_errors.back();
+	}
+
+	comparison.passed = comparison.rows > 0 && comparison.rows_over_tolerance == 0;
+
+	if(comparison.rows == 0)
+	{
+		comparison.message = "no frames were analysed";
+	}
+	else if(!comparison.passed)
+	{
+		stringstream message;
+		message << comparison.rows_over_tolerance << " rows of the chunked AUs differ from the ones of the whole video";
+		comparison.message = message.str();
+	}
+	return comparison;
+}
+
+string golden_filename(const string& golden_dir, const string& sample, const string& output)
+{
+	return (path(golden_dir) / (sample + "_" + output + ".binz")).string();
+}
+
+bool write_golden(const string& filename, const OutputRows& output)
+{
+	unique_ptr<CLMTracker::OutputSink> sink = CLMTracker::OpenOutputSink(filename, output.columns);
+
+	if(!sink)
+	{
+		ERROR_STREAM("Could not open " << filename << " for writing");
+		return false;
+	}
+
+	for(size_t i = 0; i < output.rows.size(); ++i)
+	{
+		sink->WriteRow(output.rows[i]);
+	}
+	sink->Close();
+	return true;
+}
+
+// The errors of one row against the golden one, the landmarks are compared as per point distances and everything else per value
+void row_errors(const string& output, const vector<double>& row, const vector<float>& golden_row, int num_leading, vector<double>& errors)
+{
+	errors.clear();
+
+	int num_values = (int)std::min(row.size(), golden_row.size()) - num_leading;
+
+	if(output.compare("landmarks") == 0)
+	{
+		int n = num_values / 2;
+		for(int i = 0; i < n; ++i)
+		{
+			double dx = (float)row[num_leading + i] - golden_row[num_leading + i];
+			double dy = (float)row[num_leading + n + i] - golden_row[num_leading + n + i];
+			errors.push_back(sqrt(dx * dx + dy * dy));
+		}
+	}
+	else
+	{
+		for(int i = 0; i < num_values; ++i)
+		{
+			errors.push_back(abs((float)row[num_leading + i] - golden_row[num_leading + i]));
+		}
+	}
+}
+
+OutputComparison compare_output(const OutputRows& output, const string& golden_file, const Tolerances& tolerances)
+{
+	OutputComparison comparison;
+	comparison.output = output.name;
+	comparison.rows = (int)output.rows.size();
+	comparison.golden_rows = 0;
+	comparison.rows_over_tolerance = 0;
+	comparison.leading_mismatches = 0;
+	comparison.mean_error = 0;
+	comparison.p99_error = 0;
+	comparison.max_error = 0;
+	comparison.passed = false;
+
+	// Pose rotation and translation tolerances are applied per column
+	vector<double> column_tolerances;
+	if(output.name.compare("landmarks") == 0)
+	{
+		comparison.tolerance = tolerances.landmarks;
+	}
+	else if(output.name.compare("pose") == 0)
+	{
+		comparison.tolerance = tolerances.pose_translation;
+		column_tolerances.push_back(tolerances.pose_translation);
+		column_tolerances.push_back(tolerances.pose_translation);
+		column_tolerances.push_back(tolerances.pose_translation);
+		column_tolerances.push_back(tolerances.pose_rotation);
+		column_tolerances.push_back(tolerances.pose_rotation);
+		column_tolerances.push_back(tolerances.pose_rotation);
+	}
+	else if(output.name.compare("hog") == 0)
+	{
+		comparison.tolerance = tolerances.hog;
+	}
+	else
+	{
+		comparison.tolerance = tolerances.aus;
+	}
+
+	vector<string> golden_columns;
+	vector<vector<float> > golden_rows;
+
+	if(!exists(path(golden_file)))
+	{
+		comparison.message = "skipped, no golden file " + golden_file + " (record the golden files with -record on a trusted build)";
+		comparison.passed = true;
+		comparison.skipped = true;
+		return comparison;
+	}
+
+	if(!CLMTracker::ReadBinaryOutput(golden_file, golden_columns, golden_rows))
+	{
+		comparison.message = "could not read " + golden_file;
+		return comparison;
+	}
+	comparison.golden_rows = (int)golden_rows.size();
+
+	if(golden_columns.size() != output.columns.size() && !output.rows.empty())
+	{
+		stringstream message;
+		message << "the number of columns changed from " << golden_columns.size() << " to " << output.columns.size();
+		comparison.message = message.str();
+		return comparison;
+	}
+
+	vector<double> all_errors;
+	vector<double> errors;
+
+	size_t num_rows = std::min(output.rows.size(), golden_rows.size());
+	for(size_t r = 0; r < num_rows; ++r)
+	{
+		const vector<double>& row = output.rows[r];
+		const vector<float>& golden_row = golden_rows[r];
+
+		bool leading_match = true;
+		for(int i = 0; i < output.num_leading && i < (int)row.size() && i < (int)golden_row.size(); ++i)
+		{
+			if((float)row[i] != golden_row[i])
+			{
+				leading_match = false;
+			}
+		}
+
+		if(!leading_match)
+		{
+			comparison.leading_mismatches++;
+		}
+
+		row_errors(output.name, row, golden_row, output.num_leading, errors);
+
+		bool over = !leading_match;
+		for(size_t i = 0; i < errors.size(); ++i)
+		{
+			double tolerance = column_tolerances.empty() ? comparison.tolerance : column_tolerances[i % column_tolerances.size()];
+			if(errors[i] > tolerance)
+			{
+				over = true;
+			}
+		}
+
+		if(over)
+		{
+			comparison.rows_over_tolerance++;
+		}
+
+		all_errors.insert(all_errors.end(), errors.begin(), errors.end());
+	}
+
+	if(!all_errors.empty())
+	{
+		double sum = 0;
+		for(size_t i = 0; i < all_errors.size(); ++i)
+		{
+			sum += all_errors[i];
+		}
+		comparison.mean_error = sum / all_errors.size();
+
+		std::sort(all_errors.begin(), all_errors.end());
+		comparison.p99_error = all_errors[std::min(all_errors.size() - 1, (size_t)(0.99 * all_errors.size()))];
+		comparison.max_error = all_errors.back();
+	}
+
+	if(output.rows.size() != golden_rows.size())
+	{
+		stringstream message;
+		message << "the number of rows changed from " << golden_rows.size() << " to " << output.rows.size();
+		comparison.message = message.str();
+	}
+	else if(comparison.rows_over_tolerance > 0)
+	{
+		stringstream message;
+		message << comparison.rows_over_tolerance << " rows over the tolerance";
+		comparison.message = message.str();
+	}
+	else
+	{
+		comparison.passed = true;
+	}
+
+	return comparison;
+}
+
+bool write_results(const string& filename, const vector<SampleResult>& results, bool record)
+{
+	bool passed = true;
+	int num_skipped = 0;
+
+	std::ofstream output(filename);
+
+	if(!output.is_open())
+	{
+		ERROR_STREAM("Could not open " << filename << " for writing the regression results");
+	}
+
+	output << "{" << endl;
+	output << "\t\"benchmark\": \"clm_regression\"," << endl;
+	output << "\t\"record\": " << (record ? "true" : "false") << "," << endl;
+	output << "\t\"samples\": [" << endl;
+
+	for(size_t s = 0; s < results.size(); ++s)
+	{
+		const SampleResult& result = results[s];
+		double ms_per_frame = result.frames > 0 ? result.total_ms / result.frames : 0;
+
+		INFO_STREAM(result.name << ": " << result.frames << " frames, " << ms_per_frame << " ms/frame");
+
+		output << "\t\t{\"name\": \"" << result.name << "\", \"frames\": " << result.frames << ", \"total_ms\": " << result.total_ms << ", \"ms_per_frame\": " << ms_per_frame << ", \"outputs\": [" << endl;
+
+		for(size_t c = 0; c < result.comparisons.size(); ++c)
+		{
+			const OutputComparison& comparison = result.comparisons[c];
+			passed = passed && comparison.passed;
+			num_skipped += comparison.skipped ? 1 : 0;
+
+			INFO_STREAM("\t" << comparison.output << ": " << (comparison.skipped ? "skipped" : (comparison.passed ? "passed" : "FAILED")) << ", mean error " << comparison.mean_error << ", p99 " << comparison.p99_error << ", max " << comparison.max_error << " (tolerance " << comparison.tolerance << ")" << (comparison.message.empty() ? "" : ", ") << comparison.message);
+
+			output << "\t\t\t{\"output\": \"" << comparison.output << "\", \"passed\": " << (comparison.passed ? "true" : "false") << ", \"skipped\": " << (comparison.skipped ? "true" : "false");
+			output << ", \"rows\": " << comparison.rows << ", \"golden_rows\": " << comparison.golden_rows;
+			output << ", \"rows_over_tolerance\": " << comparison.rows_over_tolerance << ", \"leading_mismatches\": " << comparison.leading_mismatches;
+			output << ", \"tolerance\": " << comparison.tolerance << ", \"mean_error\": " << comparison.mean_error << ", \"p99_error\": " << comparison.p99_error << ", \"max_error\": " << comparison.max_error;
+			output << ", \"message\": \"" << comparison.message << "\"}" << (c + 1 < result.comparisons.size() ? "," : "") << endl;
+		}
+
+		output << "\t\t]}" << (s + 1 < results.size() ? "," : "") << endl;
+	}
+
+	output << "\t]," << endl;
+	output << "\t\"skipped\": " << num_skipped << "," << endl;
+	output << "\t\"passed\": " << (passed ? "true" : "false") << endl;
+	output << "}" << endl;
+
+	if(num_skipped > 0)
+	{
+		WARN_STREAM(num_skipped << " outputs had no golden file and were skipped, record them with -record on a trusted build");
+	}
+
+	return passed;
+}
+
+int main (int argc, char **argv)
+{
+
+	vector<string> arguments = get_arguments(argc, argv);
+
+	path root = path(arguments[0]).parent_path();
+
+	string data_root;
+	string golden_dir;
+	string output_file = "clm_regression.json";
+	int max_frames = 150;
+	int num_videos = 2;
+	bool record = false;
+	vector<pair<string, double> > tolerance_overrides;
+
+	get_regression_params(data_root, golden_dir, output_file, max_frames, num_videos, record, tolerance_overrides, arguments);
+
+	CLMTracker::CLMParameters clm_parameters(arguments);
+
+	// Nothing is drawn, the outputs have to be the same as of a -q run of the executables
+	clm_parameters.quiet_mode = true;
+
+	if(data_root.empty())
+	{
+		data_root = ToolUtils::find_data_root(root.string());
+	}
+
+	if(data_root.empty() || !exists(path(data_root) / "videos"))
+	{
+		ERROR_STREAM("Could not find the sample videos and images, specify their location with -root");
+		return 1;
+	}
+
+	if(golden_dir.empty())
+	{
+		golden_dir = (path(data_root) / "regression").string();
+	}
+
+	string tolerance_file = (path(golden_dir) / "tolerances.txt").string();
+
+	if(record)
+	{
+		create_directories(path(golden_dir));
+		INFO_STREAM("Recording the golden outputs to " << golden_dir);
+
+		if(!exists(path(tolerance_file)))
+		{
+			write_tolerances(tolerance_file, Tolerances());
+		}
+	}
+	else
+	{
+		INFO_STREAM("Comparing against the golden outputs in " << golden_dir);
+	}
+
+	vector<string> video_extensions(1, ".avi");
+	vector<string> image_extensions;
+	image_extensions.push_back(".jpg");
+	image_extensions.push_back(".png");
+
+	vector<string> all_videos = ToolUtils::list_files((path(data_root) / "videos").string(), video_extensions);
+	vector<string> images = ToolUtils::list_files((path(data_root) / "imgs").string(), image_extensions);
+
+	vector<string> videos;
+	for(size_t i = 0; i < all_videos.size() && (int)videos.size() < num_videos; ++i)
+	{
+		if(path(all_videos[i]).filename().string().compare("multi_face.avi") != 0)
+		{
+			videos.push_back(all_videos[i]);
+		}
+	}
+
+	string face_analyser_loc("./AU_predictors/AU_SVM_BP4D_best.txt");
+	string face_analyser_loc_av("./AV_regressors/av_regressors.txt");
+	string tri_location("./model/tris_68_full.txt");
+
+	if(!exists(path(face_analyser_loc)))
+	{
+		face_analyser_loc = (root / path(face_analyser_loc)).string();
+		face_analyser_loc_av = (root / path(face_analyser_loc_av)).string();
+		tri_location = (root / path(tri_location)).string();
+	}
+
+	CLMTracker::CLM clm_model(clm_parameters.model_location);
+
+	vector<Vec3d> orientations;
+	orientations.push_back(Vec3d(0.0,0.0,0.0));
+	Psyche::FaceAnalyser face_analyser(orientations, 0.7, 112, 112, face_analyser_loc, face_analyser_loc_av, tri_location);
+
+	// The chunked analysis starts every chunk from a fresh analyser, as FeatureExtraction -chunks does
+	Psyche::FaceAnalyser analyser_prototype(face_analyser);
+	int num_chunks = 4;
+
+	vector<SampleResult> results;
+
+	for(size_t v = 0; v <= videos.size(); ++v)
+	{
+		SampleResult result;
+		result.frames = 0;
+		result.total_ms = 0;
+
+		vector<OutputRows> outputs;
+
+		result.name = v < videos.size() ? path(videos[v]).stem().string() : "imgs";
+
+		Tolerances tolerances;
+		read_tolerances(tolerance_file, result.name, tolerances);
+		for(size_t t = 0; t < tolerance_overrides.size(); ++t)
+		{
+			tolerances.Set(tolerance_overrides[t].first, tolerance_overrides[t].second);
+		}
+
+		// The still images are the last sample
+		if(v < videos.size())
+		{
+			TrackedFrames tracked;
+			process_video(videos[v], max_frames, clm_model, clm_parameters, face_analyser, outputs, tracked, result);
+			result.comparisons.push_back(compare_precision(face_analyser, result.frames, tolerances));
+			result.comparisons.push_back(compare_chunks(tracked, clm_model.pdm, analyser_prototype, num_chunks, tolerances));
+		}
+		else
+		{
+			process_images(images, clm_model, clm_parameters, outputs, result);
+		}
+
+		for(size_t o = 0; o < outputs.size(); ++o)
+		{
+			string golden_file = golden_filename(golden_dir, result.name, outputs[o].name);
+
+			if(record)
+			{
+				write_golden(golden_file, outputs[o]);
+			}
+			else
+			{
+				result.comparisons.push_back(compare_output(outputs[o], golden_file, tolerances));
+			}
+		}
+
+		results.push_back(result);
+	}
+
+	// The checks of the model that do not need golden outputs
+	SampleResult model_result;
+	model_result.name = "model";
+	model_result.frames = 0;
+	model_result.total_ms = 0;
+	model_result.comparisons.push_back(compare_unmatched_window(clm_model));
+	results.push_back(model_result);
+
+	bool passed = write_results(output_file, results, record);
+
+	if(!record)
+	{
+		INFO_STREAM((passed ? "All outputs are within the tolerances" : "Some outputs drifted from the golden ones"));
+	}
+
+	return passed ? 0 : 1;
+}
+
@@ -133,12 +133,8 @@ public:
 		this->height = other.height;
 		this->patch_confidence = other.patch_confidence;
 
-		// Copy the Sigmas in a deep way
-		for(std::vector<Mat_<float> >::const_iterator it = other.Sigmas.begin(); it!= other.Sigmas.end(); it++)
-		{
-			// Make sure the matrix is copied.
-			this->Sigmas.push_back(it->clone());
-		}
+		// The Sigmas are never modified once computed, so they can be shared between the copies
+		this->Sigmas = other.Sigmas;
 
 	}
 
@@ -146,10 +142,11 @@ public:
 	void Read(std::ifstream &stream, std::vector<int> window_sizes, std::vector<std::vector<Mat_<float> > > sigma_components);
 
 	// actual work (can pass in an image and a potential depth image, if the CCNF is trained with depth)
-	void Response(Mat_<float> &area_of_interest, Mat_<float> &response);    
+	// The Sigma has to be the one of the response window size, as looked up once per window size by Patch_experts
+	void Response(Mat_<float> &area_of_interest, Mat_<float> &response, const Mat_<float>& Sigma);    
 
 	// Helper function to compute relevant sigmas
-	void ComputeSigmas(std::vector<Mat_<float> > sigma_components, int window_size);
+	void ComputeSigmas(const std::vector<Mat_<float> >& sigma_components, int window_size);
 	
 };
   //===========================================================================
@@ -54,6 +54,8 @@
 #include "DetectionValidator.h"
 #include "CLMParameters.h"
 
+#include <future>
+
 using namespace std;
 using namespace cv;
 
@@ -120,8 +122,19 @@ public:
 	// This is useful for knowing when to initialise and reinitialise tracking
 	int failures_in_a_row;
 
-	// A template of a face that last succeeded with tracking (useful for large motions in video)
+	// A template of a face that last succeeded with tracking (useful for large motions in video), kept at a low resolution together with a coarser level
 	Mat_<uchar> face_template;
+	Mat_<uchar> face_template_coarse;
+
+	// The scaling from the image to the face template
+	double face_template_scaling;
+
+	// The change of global parameters between the last two successfully tracked frames (used for motion prediction)
+	Vec6d params_global_velocity;
+
+	// When validation is not done on every frame, how many frames since the last validation was started and what the model likelihood was at that point
+	int frames_since_validation;
+	double validation_likelihood;
 
 	// Useful when resetting or initialising the model closer to a specific location (when multiple faces are present)
 	cv::Point_<double> preference_det;
@@ -138,8 +151,8 @@ public:
 	// Assignment operator for lvalues (makes a deep copy of CLM)
 	CLM & operator= (const CLM& other);
 
-	// Empty Destructor	as the memory of every object will be managed by the corresponding libraries (no pointers)
-	~CLM(){}
+	// The memory of every object is managed by the corresponding libraries (no pointers), only a background validation has to finish
+	~CLM();
 
 	// Move constructor
 	CLM(const CLM&& other);
@@ -148,7 +161,8 @@ public:
 	CLM & operator= (const CLM&& other);
 
 	// Does the actual work - landmark detection
-	bool DetectLandmarks(const Mat_<uchar> &image, const Mat_<float> &depth, CLMParameters& params);
+	// When tracking from a successful previous frame, validation can be deferred (done every n frames or on a helper thread, see CLMParameters)
+	bool DetectLandmarks(const Mat_<uchar> &image, const Mat_<float> &depth, CLMParameters& params, bool allow_deferred_validation = false);
 	
 	// Gets the shape of the current detected landmarks in camera space (given camera calibration)
 	// Can only be called after a call to DetectLandmarksInVideo or DetectLandmarksInImage
@@ -160,6 +174,9 @@ public:
 	// Reset the model (useful if we want to completelly reinitialise, or we want to track another video)
 	void Reset();
 
+	// Waits for any background validation still running and drops its result
+	void FinishPendingValidation() const;
+
 	// Reset the model, choosing the face nearest (x,y) where x and y are between 0 and 1.
 	void Reset(double x, double y);
 
@@ -168,18 +185,33 @@ public:
 
 	// Helper reading function
 	void Read_CLM(string clm_location);
+
+	// Mean shift computation that uses precalculated kernel density estimators (the one actually used), public so that it can be timed on its own
+	void NonVectorisedMeanShift_precalc_kde(Mat_<float>& out_mean_shifts, const vector<Mat_<float> >& patch_expert_responses, const Mat_<float> &dxs, const Mat_<float> &dys, int resp_size, float a, int scale, int view_id, map<int, Mat_<float> >& mean_shifts);
 	
 private:
 
+	// A landmark validation running on a helper thread (when using asynchronous validation), it uses this model's validator
+	// so it is finished before the model is copied, moved, assigned to or destroyed (also when it is the source of a copy)
+	// It is timed on the helper thread but recorded in the profiler by the thread that collects it, so the
+	// short lived helper threads never get their own profiler storage
+	struct BackgroundValidation
+	{
+		double certainty;
+		long long start_ticks;
+		long long end_ticks;
+	};
+	mutable std::future<BackgroundValidation> pending_validation;
+
+	// Waits for the background validation, records its timing and returns its certainty
+	double CollectPendingValidation() const;
+
 	// the speedup of RLMS using precalculated KDE responses (described in Saragih 2011 RLMS paper)
 	map<int, Mat_<float> >		kde_resp_precalc; 
 
 	// The model fitting: patch response computation and optimisation steps
     bool Fit(const Mat_<uchar>& intensity_image, const Mat_<float>& depth_image, const std::vector<int>& window_sizes, const CLMParameters& parameters);
 
-	// Mean shift computation that uses precalculated kernel density estimators (the one actually used)
-	void NonVectorisedMeanShift_precalc_kde(Mat_<float>& out_mean_shifts, const vector<Mat_<float> >& patch_expert_responses, const Mat_<float> &dxs, const Mat_<float> &dys, int resp_size, float a, int scale, int view_id, map<int, Mat_<float> >& mean_shifts);
-
 	// The actual model optimisation (update step), returns the model likelihood
     double NU_RLMS(Vec6d& final_global, Mat_<double>& final_local, const vector<Mat_<float> >& patch_expert_responses, const Vec6d& initial_global, const Mat_<double>& initial_local,
 		          const Mat_<double>& base_shape, const Matx22d& sim_img_to_ref, const Matx22f& sim_ref_to_img, int resp_size, int view_idx, bool rigid, int scale, Mat_<double>& landmark_lhoods, const CLMParameters& parameters);
@@ -75,6 +75,15 @@ struct CLMParameters
 	// Landmark detection validator boundary for correct detection, the regressor output -1 (perfect alignment) 1 (bad alignment), 
 	double validation_boundary;
 
+	// When tracking, validate only every n frames (the last result is used in between), validation is still done on every frame after (re)initialisation or a failure
+	int validate_every;
+
+	// When tracking, run the validation on a helper thread, the result becomes available in a later frame
+	bool validate_async;
+
+	// A drop of the model likelihood since the last validation larger than this forces a synchronous validation
+	double validation_likelihood_drop;
+
 	// Used when tracking is going well
 	vector<int> window_sizes_small;
 
@@ -84,6 +93,15 @@ struct CLMParameters
 	// Used for the current frame
 	vector<int> window_sizes_current;
 	
+	// Predicting the pose in the next frame assuming constant velocity, and picking the window sizes based on how much the face is expected to move:
+	// below motion_small_threshold (in pixels) only the last of window_sizes_small is used, above motion_large_threshold window_sizes_init are used
+	bool use_motion_prediction;
+	double motion_small_threshold;
+	double motion_large_threshold;
+
+	// How much of the previous velocity is carried over to the prediction
+	double motion_damping;
+
 	// How big is the tracking template that helps with large motions
 	double face_template_scale;	
 	bool use_face_template;
@@ -110,9 +128,13 @@ struct CLMParameters
 	string face_detector_location;
 	FaceDetector curr_face_detector;
 
-	// Should the results be visualised and reported to console
+	// Headless mode (-q), the executables do not draw, show windows or poll for key presses
 	bool quiet_mode;
 
+	// Where the per stage timings (JSON) and Chrome trace of the run are written, profiling is off if both are empty
+	string profile_location;
+	string trace_location;
+
 	CLMParameters()
 	{
 		// initialise the default values
@@ -191,6 +213,25 @@ struct CLMParameters
 				valid[i+1] = false;
 				i++;
 			}
+			else if(arguments[i].compare("-validate_every") == 0)
+			{
+				stringstream data(arguments[i + 1]);
+				data >> validate_every;
+
+				valid[i] = false;
+				valid[i+1] = false;
+				i++;
+			}
+			else if (arguments[i].compare("-motion_pred") == 0) 
+			{                    
+				use_motion_prediction = true;
+				valid[i] = false;
+			}
+			else if (arguments[i].compare("-validate_async") == 0) 
+			{                    
+				validate_async = true;
+				valid[i] = false;
+			}
 			else if(arguments[i].compare("-n_iter") == 0)
 			{
 				stringstream data(arguments[i + 1]);											
@@ -207,6 +248,20 @@ struct CLMParameters
 
 				valid[i] = false;
 			}
+			else if (arguments[i].compare("-profile") == 0) 
+			{
+				profile_location = arguments[i + 1];
+				valid[i] = false;
+				valid[i+1] = false;
+				i++;
+			}
+			else if (arguments[i].compare("-trace") == 0) 
+			{
+				trace_location = arguments[i + 1];
+				valid[i] = false;
+				valid[i+1] = false;
+				i++;
+			}
 			else if (arguments[i].compare("-clmwild") == 0) 
 			{                    
 				// For in the wild fitting these parameters are suitable
@@ -226,7 +281,7 @@ struct CLMParameters
 			}
 			else if (arguments[i].compare("-help") == 0)
 			{
-				cout << "CLM parameters are defined as follows: -mloc <location of model file> -pdm_loc <override pdm location> -w_reg <weight term for patch rel.> -reg <prior regularisation> -clm_sigma <float sigma term> -fcheck <should face checking be done 0/1> -n_iter <num EM iterations> -clwild (for in the wild images) -q (quiet mode)" << endl; // Inform the user of how to use the program				
+				cout << "CLM parameters are defined as follows: -mloc <location of model file> -pdm_loc <override pdm location> -w_reg <weight term for patch rel.> -reg <prior regularisation> -clm_sigma <float sigma term> -fcheck <should face checking be done 0/1> -validate_every <validate every n frames when tracking> -validate_async (validate on a helper thread when tracking) -motion_pred (predict motion and pick window sizes based on it) -n_iter <num EM iterations> -clwild (for in the wild images) -q (quiet mode) -profile <per stage timings json> -trace <chrome trace json>" << endl; // Inform the user of how to use the program				
 			}
 		}
 
@@ -272,9 +327,15 @@ struct CLMParameters
 			window_sizes_init.at(1) = 9;
 			window_sizes_init.at(2) = 7;
 			
+			// Off by default, as the prediction can overshoot on jittery tracks
+			use_motion_prediction = false;
+			motion_small_threshold = 1.5;
+			motion_large_threshold = 8;
+			motion_damping = 0.8;
+
 			face_template_scale = 0.3;
-			// Off by default (as it might lead to some slight inaccuracies in slowly moving faces)
-			use_face_template = false;
+			// The template tracking is done at a low resolution and only in the face region, so it is cheap enough to always use
+			use_face_template = true;
 
 			// For first frame use the initialisation
 			window_sizes_current = window_sizes_init;
@@ -287,6 +348,10 @@ struct CLMParameters
 
 			validation_boundary = -0.4;
 
+			validate_every = 1;
+			validate_async = false;
+			validation_likelihood_drop = 1.0;
+
 			limit_pose = true;
 			multi_view = false;
 
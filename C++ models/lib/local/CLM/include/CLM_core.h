@@ -7,5 +7,9 @@
 #include "CLMTracker.h"
 #include "CLMParameters.h"
 #include "CLM_utils.h"
+#include "FrameSegments.h"
+#include "FrameSource.h"
+#include "OutputSink.h"
+#include "Profiler.h"
 
 #endif
\ No newline at end of file
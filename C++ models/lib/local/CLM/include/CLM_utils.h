@@ -74,6 +74,13 @@ namespace CLMTracker
 
 	void get_camera_params(int &device, float &fx, float &fy, float &cx, float &cy, vector<string> &arguments);
 
+	// Raw 8-bit luma input (-raw <width> <height>, or -raw420 <width> <height> for planar YUV 4:2:0), width is 0 if not specified
+	void get_raw_input_params(int &width, int &height, int &chroma_bytes, vector<string> &arguments);
+
+	// Frame segment lists, ordered like the -f inputs (-segs <file>), the number of chunks a whole input is split into (-chunks <n>)
+	// and the number of warm-up frames tracked before each segment or chunk (-warmup <frames>)
+	void get_segment_params(vector<string> &segment_files, int &num_chunks, int &warmup_frames, vector<string> &arguments);
+
 	void get_image_input_output_params(vector<string> &input_image_files, vector<string> &input_depth_files, vector<string> &output_feature_files, vector<string> &output_image_files,
 		vector<Rect_<double>> &input_bounding_boxes, vector<string> &arguments);
 
@@ -85,6 +92,9 @@ namespace CLMTracker
 	// templ is the template we are convolving with, templ_dfts it's dfts at varying windows sizes (optional),  _result - the output, method the type of convolution
 	void matchTemplate_m( const Mat_<float>& input_img, Mat_<double>& img_dft, cv::Mat& _integral_img, cv::Mat& _integral_img_sq, const Mat_<float>&  templ, map<int, Mat_<double> >& templ_dfts, Mat_<float>& result, int method );
 
+	// The DFT based cross-correlation used by matchTemplate_m, corr has to be allocated to the size of the result
+	void crossCorr_m( const Mat_<float>& img, Mat_<double>& img_dft, const Mat_<float>& templ, map<int, cv::Mat_<double> >& templ_dfts, Mat_<float>& corr);
+
 	//===========================================================================
 	// Point set and landmark manipulation functions
 	//===========================================================================
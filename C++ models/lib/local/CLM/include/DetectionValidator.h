@@ -102,8 +102,9 @@ public:
 	// CNN layers for each view
 	// view -> layer -> input maps -> kernels
 	vector<vector<vector<vector<Mat_<float> > > > > cnn_convolutional_layers;
-	// Bit ugly with so much nesting, but oh well
-	vector<vector<vector<vector<pair<int, Mat_<double> > > > > > cnn_convolutional_layers_dft;
+	// The same kernels packed per layer as (num_kernels x num_in_maps*kernel_height*kernel_width), so that all
+	// of the output maps of a layer are computed using a single matrix multiplication (view -> layer)
+	vector<vector<Mat_<float> > > cnn_convolutional_layers_packed;
 	vector<vector<vector<float > > > cnn_convolutional_layers_bias;
 	vector< vector<int> > cnn_subsampling_layers;
 	vector< vector<Mat_<float> > > cnn_fully_connected_layers;
@@ -123,7 +124,7 @@ public:
 	// Copy constructor
 	DetectionValidator(const DetectionValidator& other): orientations(other.orientations), bs(other.bs), paws(other.paws),
 		cnn_subsampling_layers(other.cnn_subsampling_layers),cnn_layer_types(other.cnn_layer_types), cnn_fully_connected_layers_bias(other.cnn_fully_connected_layers_bias),
-		cnn_convolutional_layers_bias(other.cnn_convolutional_layers_bias), cnn_convolutional_layers_dft(other.cnn_convolutional_layers_dft)
+		cnn_convolutional_layers_bias(other.cnn_convolutional_layers_bias)
 	{
 	
 		this->validator_type = other.validator_type;
@@ -173,6 +174,18 @@ public:
 			}
 		}
 
+		this->cnn_convolutional_layers_packed.resize(other.cnn_convolutional_layers_packed.size());
+		for(size_t v = 0; v < other.cnn_convolutional_layers_packed.size(); ++v)
+		{
+			this->cnn_convolutional_layers_packed[v].resize(other.cnn_convolutional_layers_packed[v].size());
+
+			for(size_t l = 0; l < other.cnn_convolutional_layers_packed[v].size(); ++l)
+			{
+				// Make sure the matrix is copied.
+				this->cnn_convolutional_layers_packed[v][l] = other.cnn_convolutional_layers_packed[v][l].clone();
+			}
+		}
+
 		this->cnn_fully_connected_layers.resize(other.cnn_fully_connected_layers.size());
 		for(size_t v = 0; v < other.cnn_fully_connected_layers.size(); ++v)
 		{
@@ -202,7 +215,8 @@ public:
 	}
 
 	// Given an image, orientation and detected landmarks output the result of the appropriate regressor
-	double Check(const Vec3d& orientation, const Mat_<uchar>& intensity_img, Mat_<double>& detected_landmarks);
+	// No state is modified (the warp is done per call), so this can be called concurrently
+	double Check(const Vec3d& orientation, const Mat_<uchar>& intensity_img, Mat_<double>& detected_landmarks) const;
 
 	// Reading in the model
 	void Read(string location);
@@ -215,16 +229,16 @@ private:
 	// The actual regressor application on the image
 
 	// Support Vector Regression (linear kernel)
-	double CheckSVR(const Mat_<double>& warped_img, int view_id);
+	double CheckSVR(const Mat_<double>& warped_img, int view_id) const;
 
 	// Feed-forward Neural Network
-	double CheckNN(const Mat_<double>& warped_img, int view_id);
+	double CheckNN(const Mat_<double>& warped_img, int view_id) const;
 
-	// Convolutional Neural Network
-	double CheckCNN(const Mat_<double>& warped_img, int view_id);
+	// Convolutional Neural Network, does not modify any state so can be called concurrently
+	double CheckCNN(const Mat_<double>& warped_img, int view_id) const;
 
 	// A normalisation helper
-	void NormaliseWarpedToVector(const Mat_<double>& warped_img, Mat_<double>& feature_vec, int view_id);
+	void NormaliseWarpedToVector(const Mat_<double>& warped_img, Mat_<double>& feature_vec, int view_id) const;
 
 };
 
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2014, University of Southern California and University of Cambridge,
+// all rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED AS IS AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY. OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Notwithstanding the license granted herein, Licensee acknowledges that certain components
+// of the Software may be covered by so-called open source software licenses (Open Source
+// Components), which means any software licenses approved as open source licenses by the
+// Open Source Initiative or any substantially similar licenses, including without limitation any
+// license that, as a condition of distribution of the software licensed under such license,
+// requires that the distributor make the software available in source code format. Licensor shall
+// provide a list of Open Source Components for a particular version of the Software upon
+// Licensees request. Licensee will comply with the applicable terms of such licenses and to
+// the extent required by the licenses covering Open Source Components, the terms of such
+// licenses will apply in lieu of the terms of this Agreement. To the extent the terms of the
+// licenses applicable to Open Source Components prohibit any of the restrictions in this
+// License Agreement with respect to such Open Source Component, such restrictions will not
+// apply to such Open Source Component. To the extent the terms of the licenses applicable to
+// Open Source Components require Licensor to make an offer to provide source code or
+// related information in connection with the Software, such offer is hereby made. Any request
+// for source code or related information should be directed to cl-face-tracker-distribution@lists.cam.ac.uk
+// Licensee acknowledges receipt of notices for the Open Source Components for the initial
+// delivery of the Software.
+
+//     * Any publications arising from the use of this software, including but
+//       not limited to academic journal and conference publications, technical
+//       reports and manuals, must cite one of the following works:
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 3D
+//       Constrained Local Model for Rigid and Non-Rigid Facial Tracking.
+//       IEEE Conference on Computer Vision and Pattern Recognition (CVPR), 2012.    
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 
+//       Constrained Local Neural Fields for robust facial landmark detection in the wild.
+//       in IEEE Int. Conference on Computer Vision Workshops, 300 Faces in-the-Wild Challenge, 2013.    
+//
+///////////////////////////////////////////////////////////////////////////////
+#ifndef __FRAME_SEGMENTS_h_
+#define __FRAME_SEGMENTS_h_
+
+#include "CLM.h"
+#include "CLMParameters.h"
+#include "FrameSource.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+namespace CLMTracker
+{
+	//===========================================================================
+	// Processing selected ranges of frames of a long video (or image sequence) in parallel
+
+	// A range of frames to process, the end is included (-1 for up to the end of the input)
+	struct FrameSegment
+	{
+		int begin;
+		int end;
+
+		FrameSegment(int begin = 0, int end = -1) : begin(begin), end(end) {}
+	};
+
+	// Reads a segment list, a pair of begin and end frames (counting from 0) per line, empty lines and lines starting with # are skipped
+	bool ReadFrameSegments(const string& filename, vector<FrameSegment>& segments);
+
+	// Splits a whole input of num_frames frames into num_chunks consecutive segments of nearly equal length, the last one runs
+	// to the end of the input (so an inexact frame count of a video file does not lose any frames)
+	vector<FrameSegment> SplitIntoChunks(int num_frames, int num_chunks);
+
+	// The default number of warm-up frames before a segment, a few seconds of the input (at 30 fps if its frame rate is not known)
+	int DefaultWarmupFrames(double fps, double seconds = 3.0);
+
+	// Opens the input on a frame source (every segment has its own)
+	typedef std::function<bool(FrameSource& frame_source)> OpenSourceFunction;
+
+	// Called for every frame of a segment in order, including the warm-up frames before the segment (for which in_segment is false),
+	// the model and the parameters are the ones of the segment, so the function is responsible for the tracking itself
+	typedef std::function<void(int segment, int frame, bool in_segment, Mat& image, Mat_<uchar>& grayscale, CLM& clm_model, CLMParameters& clm_parameters)> SegmentFrameFunction;
+
+	// Processes the segments in parallel, each one on its own frame source seeked to the start of the segment and with its own copy of the
+	// model (so its own tracking state). The tracking starts warmup_frames before a segment so that the tracker has locked on to the face by the
+	// time the segment begins. process_frame is called on the thread of the segment, so anything it writes to should be kept per segment.
+	// Returns false if any of the segments could not be read
+	bool ProcessFrameSegments(const vector<FrameSegment>& segments, int warmup_frames, const OpenSourceFunction& open_source, const CLM& clm_model, const CLMParameters& clm_parameters, const SegmentFrameFunction& process_frame);
+
+}
+#endif
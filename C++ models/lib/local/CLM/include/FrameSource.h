@@ -0,0 +1,190 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2014, University of Southern California and University of Cambridge,
+// all rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED AS IS AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY. OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Notwithstanding the license granted herein, Licensee acknowledges that certain components
+// of the Software may be covered by so-called open source software licenses (Open Source
+// Components), which means any software licenses approved as open source licenses by the
+// Open Source Initiative or any substantially similar licenses, including without limitation any
+// license that, as a condition of distribution of the software licensed under such license,
+// requires that the distributor make the software available in source code format. Licensor shall
+// provide a list of Open Source Components for a particular version of the Software upon
+// Licensees request. Licensee will comply with the applicable terms of such licenses and to
+// the extent required by the licenses covering Open Source Components, the terms of such
+// licenses will apply in lieu of the terms of this Agreement. To the extent the terms of the
+// licenses applicable to Open Source Components prohibit any of the restrictions in this
+// License Agreement with respect to such Open Source Component, such restrictions will not
+// apply to such Open Source Component. To the extent the terms of the licenses applicable to
+// Open Source Components require Licensor to make an offer to provide source code or
+// related information in connection with the Software, such offer is hereby made. Any request
+// for source code or related information should be directed to cl-face-tracker-distribution@lists.cam.ac.uk
+// Licensee acknowledges receipt of notices for the Open Source Components for the initial
+// delivery of the Software.
+
+//     * Any publications arising from the use of this software, including but
+//       not limited to academic journal and conference publications, technical
+//       reports and manuals, must cite one of the following works:
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 3D
+//       Constrained Local Model for Rigid and Non-Rigid Facial Tracking.
+//       IEEE Conference on Computer Vision and Pattern Recognition (CVPR), 2012.    
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 
+//       Constrained Local Neural Fields for robust facial landmark detection in the wild.
+//       in IEEE Int. Conference on Computer Vision Workshops, 300 Faces in-the-Wild Challenge, 2013.    
+//
+///////////////////////////////////////////////////////////////////////////////
+#ifndef __FRAME_SOURCE_h_
+#define __FRAME_SOURCE_h_
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio/videoio.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+namespace CLMTracker
+{
+//===========================================================================
+// A source of frames: a video file, a camera, an image sequence or raw 8-bit luma (Y plane)
+// frames from a file or a pipe.
+//
+// The frames are decoded ahead on a background thread into a small ring of buffers that are
+// reused from frame to frame, the grayscale conversion is done on that thread as well (for
+// single channel input the grayscale image is a view of the frame, not a copy).
+//
+// A frame returned by Read stays valid until the next call to Read (or Seek), when its buffers go back
+// to the decoder, so anything that has to be kept for longer has to be cloned.
+//===========================================================================
+class FrameSource
+{
+public:
+
+	FrameSource();
+	~FrameSource();
+
+	// ring_size is the number of frames that can be decoded ahead (at least 2)
+	bool OpenVideoFile(const string& filename, int ring_size = 4);
+
+	// Cameras should not run far ahead of the tracking, so only a couple of frames are buffered
+	bool OpenCamera(int device, int ring_size = 2);
+
+	bool OpenImageSequence(const vector<string>& image_files, int ring_size = 4);
+
+	// Frames of width x height 8-bit luma values, each one followed by chroma_bytes that are skipped
+	// (see get_raw_input_params for planar YUV 4:2:0), "-" reads them from the standard input
+	bool OpenRaw(const string& filename, int width, int height, int chroma_bytes = 0, int ring_size = 4);
+
+	// Picks the source the way the executables do: a camera if the file name is empty, raw luma
+	// if raw_width is set (see get_raw_input_params) and a video file otherwise
+	bool Open(const string& filename, int device, int raw_width = 0, int raw_height = 0, int raw_chroma_bytes = 0);
+
+	// Blocks until the next frame is available, returns false (and empty images) at the end of the input
+	bool Read(Mat& image, Mat_<uchar>& grayscale);
+
+	// Moves to a frame (counting from 0), the next Read returns it. Video files are positioned by the
+	// capture backend, which seeks to the keyframe before the frame and decodes from there, instead of
+	// every frame in between being read, image sequences and raw files are indexed directly. If the
+	// backend can not seek, or the input is a pipe, the frames are skipped (so only forward moves work)
+	bool Seek(int frame);
+
+	void Close();
+
+	bool IsOpened() const { return opened; }
+
+	// Frames per second of a video file (0 if not known)
+	double GetFPS() const { return fps; }
+
+	// Number of frames in the input, -1 if not known (cameras and pipes). For video files this is what the container reports, so it can be off by a few frames
+	int GetFrameCount() const { return frame_count; }
+
+	// Index of the frame last returned by Read (starting from 0)
+	int GetFrameIndex() const { return frame_index; }
+
+	// If the input can be opened again and seeked in (video files of a known length, image sequences and raw files),
+	// cameras and pipes (including the standard input) can only be read once from the start
+	bool IsSeekable() const { return seekable; }
+
+private:
+
+	enum SourceType { SOURCE_NONE, SOURCE_VIDEO, SOURCE_IMAGES, SOURCE_RAW };
+
+	struct FrameSlot
+	{
+		Mat image;
+		Mat_<uchar> grayscale;
+	};
+
+	// Starts the decoding thread
+	void Start(int ring_size);
+
+	// Stops and joins the decoding thread, the frames already decoded are dropped
+	void StopDecoding();
+
+	// Skips frames on the decoding side (without converting them)
+	bool SkipFrames(int num_frames);
+
+	// Runs on the decoding thread
+	void DecodeLoop();
+	bool DecodeNext(Mat& image);
+
+	SourceType source_type;
+	bool opened;
+	bool seekable;
+	double fps;
+	int frame_count;
+	int frame_index;
+
+	// Index of the next frame to be decoded
+	int decode_index;
+
+	VideoCapture capture;
+
+	vector<string> image_files;
+	size_t next_image;
+
+	FILE* raw_file;
+	int raw_width;
+	int raw_height;
+	int raw_chroma_bytes;
+	vector<unsigned char> raw_chroma;
+
+	// The ring, a slot is either free (waiting to be decoded into), filled (waiting to be read) or in use by the reader
+	vector<FrameSlot> slots;
+	deque<int> free_slots;
+	deque<int> filled_slots;
+	int slot_in_use;
+	bool end_of_input;
+	bool stopping;
+
+	std::mutex ring_mutex;
+	std::condition_variable slot_freed;
+	std::condition_variable slot_filled;
+	std::thread decode_thread;
+
+	// Not copyable, the decoding thread refers to the source
+	FrameSource(const FrameSource&);
+	FrameSource& operator=(const FrameSource&);
+};
+
+}
+#endif
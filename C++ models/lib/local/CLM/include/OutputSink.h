@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2014, University of Southern California and University of Cambridge,
+// all rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED AS IS AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY. OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Notwithstanding the license granted herein, Licensee acknowledges that certain components
+// of the Software may be covered by so-called open source software licenses (Open Source
+// Components), which means any software licenses approved as open source licenses by the
+// Open Source Initiative or any substantially similar licenses, including without limitation any
+// license that, as a condition of distribution of the software licensed under such license,
+// requires that the distributor make the software available in source code format. Licensor shall
+// provide a list of Open Source Components for a particular version of the Software upon
+// Licensees request. Licensee will comply with the applicable terms of such licenses and to
+// the extent required by the licenses covering Open Source Components, the terms of such
+// licenses will apply in lieu of the terms of this Agreement. To the extent the terms of the
+// licenses applicable to Open Source Components prohibit any of the restrictions in this
+// License Agreement with respect to such Open Source Component, such restrictions will not
+// apply to such Open Source Component. To the extent the terms of the licenses applicable to
+// Open Source Components require Licensor to make an offer to provide source code or
+// related information in connection with the Software, such offer is hereby made. Any request
+// for source code or related information should be directed to cl-face-tracker-distribution@lists.cam.ac.uk
+// Licensee acknowledges receipt of notices for the Open Source Components for the initial
+// delivery of the Software.
+
+//     * Any publications arising from the use of this software, including but
+//       not limited to academic journal and conference publications, technical
+//       reports and manuals, must cite one of the following works:
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 3D
+//       Constrained Local Model for Rigid and Non-Rigid Facial Tracking.
+//       IEEE Conference on Computer Vision and Pattern Recognition (CVPR), 2012.    
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 
+//       Constrained Local Neural Fields for robust facial landmark detection in the wild.
+//       in IEEE Int. Conference on Computer Vision Workshops, 300 Faces in-the-Wild Challenge, 2013.    
+//
+///////////////////////////////////////////////////////////////////////////////
+#ifndef __OUTPUT_SINK_h_
+#define __OUTPUT_SINK_h_
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace CLMTracker
+{
+//===========================================================================
+// Sinks for the per-frame outputs (landmarks, pose, model parameters, AUs)
+//
+// OUTPUT_TEXT - space separated values, one line per row, no header (the original format,
+// see TextRowLayout)
+// OUTPUT_BINARY - a header followed by fixed width float32 rows
+// OUTPUT_BINARY_COMPRESSED - a header followed by chunks of rows, every chunk is
+// delta coded per column, split into byte planes and zero run-length encoded
+//
+// Binary header (little endian): char[4] "CLMO", int32 version, int32 format,
+// int32 number of columns, and per column an int32 name length followed by the name.
+// A compressed chunk is int32 number of rows, int32 encoded size and the encoded bytes.
+//===========================================================================
+enum OutputFormat { OUTPUT_TEXT = 0, OUTPUT_BINARY = 1, OUTPUT_BINARY_COMPRESSED = 2 };
+
+// Spacing of a text row, so that every output stays byte identical to its original stream writer.
+// The first num_leading values are separated by single spaces, every value after them is written
+// as value_prefix, value, value_suffix
+struct TextRowLayout
+{
+	int num_leading;
+	string value_prefix;
+	string value_suffix;
+
+	TextRowLayout(int num_leading = 1, const string& value_prefix = " ", const string& value_suffix = "") :
+		num_leading(num_leading), value_prefix(value_prefix), value_suffix(value_suffix) {}
+};
+
+// Frame and success followed by values with a space on either side (landmarks and model parameters)
+TextRowLayout PaddedTextLayout();
+
+// Every value followed by a space (AU outputs)
+TextRowLayout TrailingSpaceTextLayout();
+
+class OutputSink
+{
+public:
+
+	virtual ~OutputSink() {}
+
+	// Column names are only stored by the binary formats
+	virtual bool Open(const string& filename, const vector<string>& column_names) = 0;
+
+	// The binary formats pad rows shorter than the number of columns with zeros
+	virtual void WriteRow(const vector<double>& values) = 0;
+
+	// Flushes whatever is still buffered, returns false if any of the rows could not be written
+	virtual bool Close() = 0;
+
+	virtual bool IsOpen() const = 0;
+};
+
+// Text rows are formatted into a local buffer that is only written out when full
+class TextOutputSink : public OutputSink
+{
+public:
+
+	TextOutputSink(const TextRowLayout& layout = TextRowLayout());
+	~TextOutputSink();
+
+	bool Open(const string& filename, const vector<string>& column_names);
+	void WriteRow(const vector<double>& values);
+	bool Close();
+	bool IsOpen() const { return output_file.is_open(); }
+
+private:
+
+	ofstream output_file;
+	string buffer;
+
+	TextRowLayout layout;
+};
+
+class BinaryOutputSink : public OutputSink
+{
+public:
+
+	BinaryOutputSink(bool compressed);
+	~BinaryOutputSink();
+
+	bool Open(const string& filename, const vector<string>& column_names);
+	void WriteRow(const vector<double>& values);
+	bool Close();
+	bool IsOpen() const { return output_file.is_open(); }
+
+	// Number of rows per compressed chunk (or per write when uncompressed)
+	static const int CHUNK_ROWS = 256;
+
+private:
+
+	void FlushChunk();
+
+	ofstream output_file;
+	bool compressed;
+	int num_columns;
+
+	// Rows waiting to be written, row major float32
+	vector<float> chunk;
+	int rows_in_chunk;
+
+	vector<unsigned char> encoded;
+};
+
+// .bin is binary, .binz is compressed binary and anything else is text
+OutputFormat OutputFormatFromFilename(const string& filename);
+
+// The layout is only used by the text format
+unique_ptr<OutputSink> CreateOutputSink(OutputFormat format, const TextRowLayout& layout = TextRowLayout());
+
+// Creates a sink of the format suggested by the file extension and opens it, returns an empty
+// pointer if the file could not be opened
+unique_ptr<OutputSink> OpenOutputSink(const string& filename, const vector<string>& column_names, const TextRowLayout& layout = TextRowLayout());
+
+// Reads back a binary or compressed binary output file
+bool ReadBinaryOutput(const string& filename, vector<string>& column_names, vector<vector<float> >& rows);
+
+// Column names of the standard outputs, appended to the provided leading columns (e.g. frame, success)
+vector<string> LandmarkColumnNames(vector<string> columns, int num_points);
+vector<string> Landmark3DColumnNames(vector<string> columns, int num_points);
+vector<string> ParamsColumnNames(vector<string> columns, int num_modes);
+vector<string> PoseColumnNames(vector<string> columns);
+
+}
+#endif
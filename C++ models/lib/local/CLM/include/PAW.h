@@ -108,18 +108,23 @@ public:
 	// y-source of warped points
     Mat_<float> map_y;   
 
+	// Horizontal runs of destination pixels that lie in the same triangle, one per row (y, x_start, x_end, triangle),
+	// these only depend on the destination shape so are computed once
+	Mat_<int> triangle_spans;
+
 	// Default constructor
     PAW(){;}
 
 	// Construct a warp from a destination shape and triangulation
 	PAW(const Mat_<double>& destination_shape, const Mat_<int>& triangulation);
 
-	// The final optional argument allows for optimisation if the triangle indices from previous frame are known (for tracking in video)
-	PAW(const Mat_<double>& destination_shape, const Mat_<int>& triangulation, double in_min_x, double in_min_y, double in_max_x, double in_max_y);
+	// The final optional argument allows for optimisation if the triangle indices from previous frame are known (for tracking in video),
+	// without the warp tables only the pixel mask and triangle ids are computed (for masking, the PAW can not warp then)
+	PAW(const Mat_<double>& destination_shape, const Mat_<int>& triangulation, double in_min_x, double in_min_y, double in_max_x, double in_max_y, bool warp_tables = true);
 
 	// Copy constructor
 	PAW(const PAW& other): destination_landmarks(other.destination_landmarks.clone()), source_landmarks(other.source_landmarks.clone()), triangulation(other.triangulation.clone()),
-		triangle_id(other.triangle_id.clone()), pixel_mask(other.pixel_mask.clone()), coefficients(other.coefficients.clone()), alpha(other.alpha.clone()), beta(other.beta.clone()), map_x(other.map_x.clone()), map_y(other.map_y.clone())
+		triangle_id(other.triangle_id.clone()), pixel_mask(other.pixel_mask.clone()), coefficients(other.coefficients.clone()), alpha(other.alpha.clone()), beta(other.beta.clone()), map_x(other.map_x.clone()), map_y(other.map_y.clone()), triangle_spans(other.triangle_spans.clone())
 	{
 		this->number_of_pixels = other.number_of_pixels; 
 		this->min_x = other.min_x;
@@ -130,11 +135,18 @@ public:
 
 	// The actual warping
     void Warp(const Mat& image_to_warp, Mat& destination_image, const Mat_<double>& landmarks_to_warp);
+
+	// Warping straight from an 8-bit image, only the pixels covered by the face are sampled so the cost does not depend on image size
+	// The warp coefficients are kept per call, so this does not modify the PAW and can be called concurrently
+	void Warp(const Mat_<uchar>& image_to_warp, Mat_<double>& destination_image, const Mat_<double>& landmarks_to_warp) const;
 	
 	// Compute coefficients needed for warping
     void CalcCoeff();
 
-	// Perform the actual warping
+	// The same for the given source landmarks, without storing them
+	void CalcCoeff(const Mat_<double>& landmarks, Mat_<double>& coeffs) const;
+
+	// Perform the actual warping, only the pixels within the mask are written (the rest are expected to be set to -1 already)
     void WarpRegion(Mat_<float>& map_x, Mat_<float>& map_y);
 
     inline int NumberOfLandmarks() const {return destination_landmarks.rows/2;} ;
@@ -148,6 +160,9 @@ private:
 
 	int findTriangle(const cv::Point_<double>& point, const std::vector<std::vector<double>>& control_points, int guess = -1) const;
 
+	// Precompute the triangle spans and allocate the maps once the mask and triangle ids are known
+	void PrepareWarpTables();
+
   };
   //===========================================================================
 }
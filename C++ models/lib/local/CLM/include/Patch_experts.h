@@ -89,7 +89,8 @@ public:
 	Patch_experts(){;}
 
 	// A copy constructor
-	Patch_experts(const Patch_experts& other): patch_scaling(other.patch_scaling), centers(other.centers), svr_expert_intensity(other.svr_expert_intensity), svr_expert_depth(other.svr_expert_depth), ccnf_expert_intensity(other.ccnf_expert_intensity)
+	Patch_experts(const Patch_experts& other): patch_scaling(other.patch_scaling), centers(other.centers), svr_expert_intensity(other.svr_expert_intensity), svr_expert_depth(other.svr_expert_depth), ccnf_expert_intensity(other.ccnf_expert_intensity),
+		sigma_window_sizes(other.sigma_window_sizes)
 	{
 
 		// Make sure the matrices are allocated properly
@@ -129,6 +130,13 @@ public:
 	// Getting the best view associated with the current orientation
 	int GetViewIdx(const Vec6d& params_global, int scale);
 
+	// Computing the CCNF Sigmas for every scale, view and landmark for the given window sizes (the ones already computed are skipped),
+	// window sizes the model has no edge features (sigma components) for get a Sigma from the neuron alphas alone
+	void PrecomputeSigmas(const vector<int>& window_sizes);
+
+	// The index of a window size's Sigma in every CCNF patch expert (they are all computed in the same order), -1 if it has not been computed
+	int SigmaIndex(int window_size) const;
+
 	// The number of views at a particular scale
     inline int nViews(int scale=0){return centers[scale].size();};
 
@@ -139,6 +147,10 @@ public:
    
 
 private:
+
+	// The window sizes for which the CCNF Sigmas have been computed
+	vector<int> sigma_window_sizes;
+
 	void Read_SVR_patch_experts(string expert_location, std::vector<cv::Vec3d>& centers, std::vector<cv::Mat_<int> >& visibility, std::vector<std::vector<Multi_SVR_patch_expert> >& patches, double& scale);
 	void Read_CCNF_patch_experts(string patchesFileLocation, std::vector<cv::Vec3d>& centers, std::vector<cv::Mat_<int> >& visibility, std::vector<std::vector<CCNF_patch_expert> >& patches, double& patchScaling);
 	
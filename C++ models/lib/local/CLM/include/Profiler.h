@@ -0,0 +1,133 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2014, University of Southern California and University of Cambridge,
+// all rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED AS IS AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY. OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Notwithstanding the license granted herein, Licensee acknowledges that certain components
+// of the Software may be covered by so-called open source software licenses (Open Source
+// Components), which means any software licenses approved as open source licenses by the
+// Open Source Initiative or any substantially similar licenses, including without limitation any
+// license that, as a condition of distribution of the software licensed under such license,
+// requires that the distributor make the software available in source code format. Licensor shall
+// provide a list of Open Source Components for a particular version of the Software upon
+// Licensees request. Licensee will comply with the applicable terms of such licenses and to
+// the extent required by the licenses covering Open Source Components, the terms of such
+// licenses will apply in lieu of the terms of this Agreement. To the extent the terms of the
+// licenses applicable to Open Source Components prohibit any of the restrictions in this
+// License Agreement with respect to such Open Source Component, such restrictions will not
+// apply to such Open Source Component. To the extent the terms of the licenses applicable to
+// Open Source Components require Licensor to make an offer to provide source code or
+// related information in connection with the Software, such offer is hereby made. Any request
+// for source code or related information should be directed to cl-face-tracker-distribution@lists.cam.ac.uk
+// Licensee acknowledges receipt of notices for the Open Source Components for the initial
+// delivery of the Software.
+
+//     * Any publications arising from the use of this software, including but
+//       not limited to academic journal and conference publications, technical
+//       reports and manuals, must cite one of the following works:
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 3D
+//       Constrained Local Model for Rigid and Non-Rigid Facial Tracking.
+//       IEEE Conference on Computer Vision and Pattern Recognition (CVPR), 2012.    
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 
+//       Constrained Local Neural Fields for robust facial landmark detection in the wild.
+//       in IEEE Int. Conference on Computer Vision Workshops, 300 Faces in-the-Wild Challenge, 2013.    
+//
+///////////////////////////////////////////////////////////////////////////////
+#ifndef __PROFILER_h_
+#define __PROFILER_h_
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace CLMTracker
+{
+//===========================================================================
+// Lightweight per stage timing and counting of the tracking and analysis pipeline
+//
+// Stages and counters are registered by name once and accumulated per thread without
+// locking (each thread only writes to its own slots). Timings also go into a log scale
+// histogram for percentiles. When disabled (the default) a scoped timer only checks a flag.
+//
+// Usage:
+//   CLM_PROFILE_SCOPE("patch_response");   // times the rest of the enclosing scope
+//   CLM_PROFILE_COUNT("faces_detected", n);
+//
+// The executables enable it with -profile <file.json> (summary and per frame stage times)
+// and -trace <file.json> (Chrome trace format, chrome://tracing)
+//===========================================================================
+namespace Profiler
+{
+	// Upper limits so that the per thread storage never has to grow
+	const int MAX_STAGES = 64;
+	const int MAX_COUNTERS = 32;
+
+	// Turns on the timing, trace_events also keeps every timed scope for the Chrome trace
+	void Enable(bool trace_events = false);
+	void Disable();
+
+	// Enables the profiler if either of the output locations is specified
+	void Configure(const string& json_location, const string& trace_location);
+	bool IsEnabled();
+
+	// Thread safe, registering the same name twice returns the same id
+	int RegisterStage(const char* name);
+	int RegisterCounter(const char* name);
+
+	// Ticks are in cv::getTickCount units
+	void Record(int stage, long long start_ticks, long long end_ticks);
+	void Count(int counter, long long amount);
+
+	// Marks the end of a frame, the stage times since the previous call are kept for the per frame output
+	void NextFrame();
+
+	// Forgets all the recorded timings, counts and frames (the registered names are kept), safe to call
+	// while other threads are recording (a timing recorded at the same time may be lost)
+	void Reset();
+
+	// Should be called once the processing threads are done
+	void WriteSummary(ostream& output);
+	bool WriteJSON(const string& filename);
+	bool WriteChromeTrace(const string& filename);
+
+	// Writes the summary to the console and whichever of the files is specified
+	void WriteReports(const string& json_location, const string& trace_location);
+}
+
+class ScopedTimer
+{
+public:
+	ScopedTimer(int stage);
+	~ScopedTimer();
+
+private:
+	int stage;
+	long long start_ticks;
+};
+
+#define CLM_PROFILE_CONCAT_INNER(a, b) a##b
+#define CLM_PROFILE_CONCAT(a, b) CLM_PROFILE_CONCAT_INNER(a, b)
+
+#define CLM_PROFILE_SCOPE(name) \
+	static const int CLM_PROFILE_CONCAT(clm_profile_stage_, __LINE__) = CLMTracker::Profiler::RegisterStage(name); \
+	CLMTracker::ScopedTimer CLM_PROFILE_CONCAT(clm_profile_timer_, __LINE__)(CLM_PROFILE_CONCAT(clm_profile_stage_, __LINE__))
+
+#define CLM_PROFILE_COUNT(name, amount) \
+	do { static const int clm_profile_counter = CLMTracker::Profiler::RegisterCounter(name); CLMTracker::Profiler::Count(clm_profile_counter, amount); } while(0)
+
+}
+#endif
@@ -103,6 +103,13 @@ class SVR_patch_expert{
 		void Response(const Mat_<float> &area_of_interest, Mat_<float> &response);    
 		void ResponseDepth(const Mat_<float> &area_of_interest, Mat_<float> &response);
 
+		// Computing the features the patch expert works on (normalised intensity or gradient), these can be shared between patch experts of the same type
+		static void ComputeFeatures(int type, const Mat_<float> &area_of_interest, Mat_<float> &features);
+
+		// The response computation from already computed features, the dft and integral images of the features are computed if empty and can be reused
+		// by other patch experts of the same size and type on the same features
+		void ResponseFromFeatures(const Mat_<float> &features, Mat_<double> &features_dft, Mat &integral_img, Mat &integral_img_sq, Mat_<float> &response);
+
 };
 //===========================================================================
 /**
@@ -51,7 +51,7 @@
 using namespace CLMTracker;
 
 // Compute sigmas for all landmarks for a particular view and window size
-void CCNF_patch_expert::ComputeSigmas(std::vector<Mat_<float> > sigma_components, int window_size)
+void CCNF_patch_expert::ComputeSigmas(const std::vector<Mat_<float> >& sigma_components, int window_size)
 {
 	for(size_t i=0; i < window_sizes.size(); ++i)
 	{
@@ -234,7 +234,7 @@ void CCNF_patch_expert::Read(ifstream &stream, std::vector<int> window_sizes, st
 }
 
 //===========================================================================
-void CCNF_patch_expert::Response(Mat_<float> &area_of_interest, Mat_<float> &response)
+void CCNF_patch_expert::Response(Mat_<float> &area_of_interest, Mat_<float> &response, const Mat_<float>& Sigma)
 {
 	
 	int response_height = area_of_interest.rows - height + 1;
@@ -260,28 +260,15 @@ void CCNF_patch_expert::Response(Mat_<float> &area_of_interest, Mat_<float> &res
 		if(neurons[i].alpha > 1e-4)
 		{
 			neurons[i].Response(area_of_interest, area_of_interest_dft, integral_image, integral_image_sq, neuron_response);
-			response = response + neuron_response;						
+			response += neuron_response;
 		}
 	}
 
-	int s_to_use = -1;
+	// The product is written straight into the response (through a reshaped header), so the response vector itself is copied first
+	Mat_<float> resp_vec_f = response.reshape(1, response_height * response_width).clone();
 
-	// Find the matching sigma
-	for(size_t i=0; i < window_sizes.size(); ++i)
-	{
-		if(window_sizes[i] == response_height)
-		{
-			// Found the correct sigma
-			s_to_use = i;			
-			break;
-		}
-	}
-
-	Mat_<float> resp_vec_f = response.reshape(1, response_height * response_width);
-
-	Mat out = Sigmas[s_to_use] * resp_vec_f;
-	
-	response = out.reshape(1, response_height);
+	Mat out = response.reshape(1, response_height * response_width);
+	cv::gemm(Sigma, resp_vec_f, 1.0, cv::noArray(), 0.0, out);
 
 	// Making sure the response does not have negative numbers
 	double min;
@@ -289,7 +276,7 @@ void CCNF_patch_expert::Response(Mat_<float> &area_of_interest, Mat_<float> &res
 	minMaxIdx(response, &min, 0);
 	if(min < 0)
 	{
-		response = response - min;
+		response -= min;
 	}
 
 }
@@ -50,6 +50,7 @@
 
 #include <CLM.h>
 #include <CLM_utils.h>
+#include <Profiler.h>
 
 using namespace CLMTracker;
 
@@ -70,8 +71,15 @@ CLM::CLM(string fname)
 	this->Read(fname);
 }
 
+// Makes sure a background validation of the model is not touching it while it is copied
+static const CLM& FinishedValidation(const CLM& model)
+{
+	model.FinishPendingValidation();
+	return model;
+}
+
 // Copy constructor (makes a deep copy of CLM)
-CLM::CLM(const CLM& other): pdm(other.pdm), params_local(other.params_local.clone()), params_global(other.params_global), detected_landmarks(other.detected_landmarks.clone()),
+CLM::CLM(const CLM& other): pdm(FinishedValidation(other).pdm), params_local(other.params_local.clone()), params_global(other.params_global), detected_landmarks(other.detected_landmarks.clone()),
 	landmark_likelihoods(other.landmark_likelihoods.clone()), patch_experts(other.patch_experts), landmark_validator(other.landmark_validator), face_detector_location(other.face_detector_location)
 {
 	this->detection_success = other.detection_success;
@@ -79,6 +87,10 @@ CLM::CLM(const CLM& other): pdm(other.pdm), params_local(other.params_local.clon
 	this->detection_certainty = other.detection_certainty;
 	this->model_likelihood = other.model_likelihood;
 	this->failures_in_a_row = other.failures_in_a_row;
+	this->frames_since_validation = other.frames_since_validation;
+	this->validation_likelihood = other.validation_likelihood;
+	this->params_global_velocity = other.params_global_velocity;
+	this->face_template_scaling = other.face_template_scaling;
 	
 	// Load the CascadeClassifier (as it does not have a proper copy constructor)
 	if(!face_detector_location.empty())
@@ -108,6 +120,10 @@ CLM & CLM::operator= (const CLM& other)
 {
 	if (this != &other) // protect against invalid self-assignment
 	{
+		// Neither validator can be in use while it is overwritten or copied
+		this->FinishPendingValidation();
+		other.FinishPendingValidation();
+
 		pdm = PDM(other.pdm);
 		params_local = other.params_local.clone();
 		params_global = other.params_global;
@@ -123,6 +139,10 @@ CLM & CLM::operator= (const CLM& other)
 		this->detection_certainty = other.detection_certainty;
 		this->model_likelihood = other.model_likelihood;
 		this->failures_in_a_row = other.failures_in_a_row;
+		this->frames_since_validation = other.frames_since_validation;
+		this->validation_likelihood = other.validation_likelihood;
+		this->params_global_velocity = other.params_global_velocity;
+		this->face_template_scaling = other.face_template_scaling;
 
 		// Load the CascadeClassifier (as it does not have a proper copy constructor)
 		if(!face_detector_location.empty())
@@ -153,11 +173,17 @@ CLM & CLM::operator= (const CLM& other)
 // Move constructor
 CLM::CLM(const CLM&& other)
 {
+	other.FinishPendingValidation();
+
 	this->detection_success = other.detection_success;
 	this->tracking_initialised = other.tracking_initialised;
 	this->detection_certainty = other.detection_certainty;
 	this->model_likelihood = other.model_likelihood;
 	this->failures_in_a_row = other.failures_in_a_row;
+	this->frames_since_validation = other.frames_since_validation;
+	this->validation_likelihood = other.validation_likelihood;
+	this->params_global_velocity = other.params_global_velocity;
+	this->face_template_scaling = other.face_template_scaling;
 
 	pdm = other.pdm;
 	params_local = other.params_local;
@@ -180,11 +206,18 @@ CLM::CLM(const CLM&& other)
 // Assignment operator for rvalues
 CLM & CLM::operator= (const CLM&& other)
 {
+	this->FinishPendingValidation();
+	other.FinishPendingValidation();
+
 	this->detection_success = other.detection_success;
 	this->tracking_initialised = other.tracking_initialised;
 	this->detection_certainty = other.detection_certainty;
 	this->model_likelihood = other.model_likelihood;
 	this->failures_in_a_row = other.failures_in_a_row;
+	this->frames_since_validation = other.frames_since_validation;
+	this->validation_likelihood = other.validation_likelihood;
+	this->params_global_velocity = other.params_global_velocity;
+	this->face_template_scaling = other.face_template_scaling;
 
 	pdm = other.pdm;
 	params_local = other.params_local;
@@ -205,6 +238,10 @@ CLM & CLM::operator= (const CLM&& other)
 	return *this;
 }
 
+CLM::~CLM()
+{
+	FinishPendingValidation();
+}
 
 void CLM::Read_CLM(string clm_location)
 {
@@ -299,6 +336,16 @@ void CLM::Read_CLM(string clm_location)
 	// Initialise the patch experts
 	patch_experts.Read(intensity_expert_locations, depth_expert_locations, ccnf_expert_locations);
 
+	// Compute the CCNF Sigmas for the default window sizes up front, so that they are shared by all of the copies of the model
+	// (any other window sizes are computed on first use)
+	if(!patch_experts.ccnf_expert_intensity.empty())
+	{
+		CLMParameters default_params;
+		vector<int> window_sizes = default_params.window_sizes_init;
+		window_sizes.insert(window_sizes.end(), default_params.window_sizes_small.begin(), default_params.window_sizes_small.end());
+		patch_experts.PrecomputeSigmas(window_sizes);
+	}
+
 	// Read in a face detector
 	face_detector_HOG = dlib::get_frontal_face_detector();
 
@@ -380,11 +427,21 @@ void CLM::Read(string main_location)
 
 	failures_in_a_row = -1;
 
+	frames_since_validation = 0;
+	validation_likelihood = -10; // the same as the model likelihood
+
+	params_global_velocity = Vec6d(0, 0, 0, 0, 0, 0);
+
+	face_template_scaling = 1.0;
+
 }
 
 // Resetting the model (for a new video, or complet reinitialisation
 void CLM::Reset()
 {
+	// Drop any validation of the previous track
+	FinishPendingValidation();
+
 	detected_landmarks.setTo(0);
 
 	detection_success = false;
@@ -400,6 +457,13 @@ void CLM::Reset()
 
 	failures_in_a_row = -1;
 	face_template = Mat_<uchar>();
+	face_template_coarse = Mat_<uchar>();
+	face_template_scaling = 1.0;
+
+	frames_since_validation = 0;
+	validation_likelihood = -10; // the same as the model likelihood
+
+	params_global_velocity = Vec6d(0, 0, 0, 0, 0, 0);
 }
 
 // Resetting the model, choosing the face nearest (x,y)
@@ -416,7 +480,7 @@ void CLM::Reset(double x, double y)
 }
 
 // The main internal landmark detection call (should not be used externally?)
-bool CLM::DetectLandmarks(const Mat_<uchar> &image, const Mat_<float> &depth, CLMParameters& params)
+bool CLM::DetectLandmarks(const Mat_<uchar> &image, const Mat_<float> &depth, CLMParameters& params, bool allow_deferred_validation)
 {
 
 	// Fits from the current estimate of local and global parameters in clm_model
@@ -430,8 +494,57 @@ bool CLM::DetectLandmarks(const Mat_<uchar> &image, const Mat_<float> &depth, CL
 	{
 		Vec3d orientation(params_global[1], params_global[2], params_global[3]);
 
-		detection_certainty = landmark_validator.Check(orientation, image, detected_landmarks);
+		// Validation can only be skipped or done in the background when tracking from a validated frame and the fit has not got noticeably worse since the last check,
+		// otherwise (e.g. after reinitialisation) it is done synchronously
+		bool deferred = allow_deferred_validation && (params.validate_every > 1 || params.validate_async) &&
+			model_likelihood >= validation_likelihood - params.validation_likelihood_drop;
+
+		frames_since_validation++;
+
+		if(!deferred || (!params.validate_async && frames_since_validation >= params.validate_every))
+		{
+			FinishPendingValidation();
+
+			{
+				CLM_PROFILE_SCOPE("validation");
+				detection_certainty = landmark_validator.Check(orientation, image, detected_landmarks);
+			}
+
+			frames_since_validation = 0;
+			validation_likelihood = model_likelihood;
+		}
+		else if(params.validate_async)
+		{
+			// Pick up the result of a finished background validation
+			if(pending_validation.valid() && pending_validation.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			{
+				detection_certainty = CollectPendingValidation();
+			}
+
+			// And start a new one if it is time to
+			if(!pending_validation.valid() && frames_since_validation >= params.validate_every)
+			{
+				// The validation works on its own copy of the image and landmarks as they will change by the time it runs
+				Mat_<uchar> image_copy = image.clone();
+				Mat_<double> landmarks_copy = detected_landmarks.clone();
+				// The validator stays valid while the validation runs, as the model finishes it before being copied, moved or destroyed
+				const DetectionValidator* validator = &landmark_validator;
+
+				pending_validation = std::async(std::launch::async, [validator, orientation, image_copy, landmarks_copy]() mutable
+				{
+					BackgroundValidation validation;
+					validation.start_ticks = cv::getTickCount();
+					validation.certainty = validator->Check(orientation, image_copy, landmarks_copy);
+					validation.end_ticks = cv::getTickCount();
+					return validation;
+				});
+
+				frames_since_validation = 0;
+				validation_likelihood = model_likelihood;
+			}
+		}
 
+		// When validation is deferred this uses the latest available result
 		detection_success = detection_certainty < params.validation_boundary;
 	}
 	else
@@ -451,6 +564,23 @@ bool CLM::DetectLandmarks(const Mat_<uchar> &image, const Mat_<float> &depth, CL
 	return detection_success;
 }
 
+void CLM::FinishPendingValidation() const
+{
+	if(pending_validation.valid())
+	{
+		CollectPendingValidation();
+	}
+}
+
+double CLM::CollectPendingValidation() const
+{
+	static const int validation_stage = Profiler::RegisterStage("validation");
+
+	BackgroundValidation validation = pending_validation.get();
+	Profiler::Record(validation_stage, validation.start_ticks, validation.end_ticks);
+	return validation.certainty;
+}
+
 //=============================================================================
 bool CLM::Fit(const Mat_<uchar>& im, const Mat_<float>& depthImg, const std::vector<int>& window_sizes, const CLMParameters& clm_parameters)
 {
@@ -717,6 +847,7 @@ double CLM::NU_RLMS(Vec6d& final_global, Mat_<double>& final_local, const vector
 		          const Mat_<double>& base_shape, const Matx22d& sim_img_to_ref, const Matx22f& sim_ref_to_img, int resp_size, int view_id, bool rigid, int scale, Mat_<double>& landmark_lhoods,
 				  const CLMParameters& parameters)
 {
+	CLM_PROFILE_SCOPE("nu_rlms");
 	
 	int n = pdm.NumberOfPoints();  
 	
@@ -959,32 +1090,49 @@ bool CLM::RemoveBackground(Mat_<float>& out_depth_image, const Mat_<float>& dept
 	if(roi.x >= depth_image.cols) roi.x = 0;
 	if(roi.y >= depth_image.rows) roi.y = 0;
 
-	// Initialise the mask
-	Mat_<uchar> mask(depth_image.rows, depth_image.cols, (uchar)0);
+	// The average of valid depth values near the estimate (the window is clipped to the image, if nothing is left there is no depth)
+	double Z = 0;
+	int num_valid = 0;
 
-	Mat_<uchar> valid_pixels = depth_image > 0;
+	Rect_<int> depth_window = Rect_<int>((int)tx - 8, (int)ty - 8, 16, 16) & Rect_<int>(0, 0, depth_image.cols, depth_image.rows);
+
+	for(int y = depth_window.y; y < depth_window.y + depth_window.height; ++y)
+	{
+		const float* d = depth_image.ptr<float>(y);
+		for(int x = depth_window.x; x < depth_window.x + depth_window.width; ++x)
+		{
+			if(d[x] > 0)
+			{
+				Z += d[x];
+				num_valid++;
+			}
+		}
+	}
 
 	// check if there is any depth near the estimate
-	if(sum(valid_pixels(Rect((int)tx - 8, (int)ty - 8, 16, 16))/255)[0] > 0)
+	if(num_valid > 0)
 	{
-		double Z = mean(depth_image(Rect((int)tx - 8, (int)ty - 8, 16, 16)), valid_pixels(Rect((int)tx - 8, (int)ty - 8, 16, 16)))[0]; // Z offset from the surface of the face
-				
-		// Only operate within region of interest of the depth image
-		Mat dRoi = depth_image(roi);
+		Z = Z / num_valid; // Z offset from the surface of the face
 
-		Mat mRoi = mask(roi);
+		float z_min = (float)(Z - 200);
+		float z_max = (float)(Z + 200);
 
-		// Filter all pixels further than 20cm away from the current pose depth estimate
-		inRange(dRoi, Z - 200, Z + 200, mRoi);
-		
-		// Convert to be either 0 or 1
-		mask = mask / 255;
-		
-		Mat_<float> maskF;
-		mask.convertTo(maskF, CV_32F);
+		// Everything outside the region of interest is background
+		roi = roi & Rect_<int>(0, 0, depth_image.cols, depth_image.rows);
+		out_depth_image.create(depth_image.size());
+		out_depth_image.setTo(0);
+
+		// Only operate within region of interest of the depth image, filtering all pixels further than 20cm away from the current pose depth estimate in a single pass
+		for(int y = roi.y; y < roi.y + roi.height; ++y)
+		{
+			const float* d = depth_image.ptr<float>(y);
+			float* out = out_depth_image.ptr<float>(y);
 
-		//Filter the depth image
-		out_depth_image = depth_image.mul(maskF);
+			for(int x = roi.x; x < roi.x + roi.width; ++x)
+			{
+				out[x] = (d[x] >= z_min && d[x] <= z_max) ? d[x] : 0.0f;
+			}
+		}
 	}
 	else
 	{
@@ -49,6 +49,7 @@
 #include "stdafx.h"
 
 #include <CLMTracker.h>
+#include <Profiler.h>
 
 using namespace CLMTracker;
 using namespace cv;
@@ -211,20 +212,80 @@ Vec6d CLMTracker::GetCorrectedPoseCamera(CLM& clm_model, double fx, double fy, d
 	}
 }
 
-// If landmark detection in video succeeded create a template for use in simple tracking
-void UpdateTemplate(const Mat_<uchar> &grayscale_image, CLM& clm_model)
+// The area around the face searched by the template tracking, at the resolution of the template
+struct TemplateSearchArea
+{
+	Mat_<uchar> image;
+	Rect roi;
+	double scaling;
+};
+
+// If landmark detection in video succeeded create a template for use in simple tracking, the template is kept at a low resolution (face_template_scale
+// relative to the model scale) together with a coarser level, so only the face region is ever resized
+// When the frame was already downscaled for the template search (and the face is still about the same size) the template is cut out of that instead
+void UpdateTemplate(const Mat_<uchar> &grayscale_image, CLM& clm_model, const CLMParameters& params, const TemplateSearchArea* search_area = NULL)
 {
 	Rect bounding_box;
 	clm_model.pdm.CalcBoundingBox(bounding_box, clm_model.params_global, clm_model.params_local);
 	// Make sure the box is not out of bounds
 	bounding_box = bounding_box & Rect(0, 0, grayscale_image.cols, grayscale_image.rows);
 
-	clm_model.face_template = grayscale_image(bounding_box).clone();
+	if(bounding_box.area() == 0)
+	{
+		return;
+	}
+
+	double scaling = std::min(params.face_template_scale / clm_model.params_global[0], 1.0);
+
+	// The template resolution is allowed to drift by 10% before the face region is resized again
+	bool reuse_search_area = search_area != NULL && !search_area->image.empty() && std::abs(search_area->scaling - scaling) <= 0.1 * scaling &&
+		(bounding_box & search_area->roi) == bounding_box;
+
+	if(reuse_search_area)
+	{
+		double s = search_area->scaling;
+		Rect scaled_box(cvRound((bounding_box.x - search_area->roi.x) * s), cvRound((bounding_box.y - search_area->roi.y) * s), cvRound(bounding_box.width * s), cvRound(bounding_box.height * s));
+		scaled_box = scaled_box & Rect(0, 0, search_area->image.cols, search_area->image.rows);
+
+		reuse_search_area = scaled_box.area() > 0;
+		if(reuse_search_area)
+		{
+			clm_model.face_template = search_area->image(scaled_box).clone();
+			scaling = s;
+		}
+	}
+
+	if(reuse_search_area)
+	{
+		CLM_PROFILE_COUNT("template_reused_frames", 1);
+	}
+	else if(scaling < 1)
+	{
+		cv::resize(grayscale_image(bounding_box), clm_model.face_template, Size(), scaling, scaling, cv::INTER_AREA);
+	}
+	else
+	{
+		clm_model.face_template = grayscale_image(bounding_box).clone();
+	}
+	clm_model.face_template_scaling = scaling;
+
+	// The coarse level is only useful if it's still big enough to match against
+	if(clm_model.face_template.rows >= 16 && clm_model.face_template.cols >= 16)
+	{
+		cv::pyrDown(clm_model.face_template, clm_model.face_template_coarse);
+	}
+	else
+	{
+		clm_model.face_template_coarse = Mat_<uchar>();
+	}
 }
 
 // This method uses basic template matching in order to allow for better tracking of fast moving faces
-void CorrectGlobalParametersVideo(const Mat_<uchar> &grayscale_image, CLM& clm_model, const CLMParameters& params)
+// The search is done around the current estimate at the resolution of the template, first at the coarse level over the whole search area, and then refined
+// at the template level in a small window around the coarse match. The downscaled search area is returned so the template update can reuse it
+void CorrectGlobalParametersVideo(const Mat_<uchar> &grayscale_image, CLM& clm_model, const CLMParameters& params, TemplateSearchArea& search_area)
 {
+	CLM_PROFILE_SCOPE("face_template");
 	Rect init_box;
 	clm_model.pdm.CalcBoundingBox(init_box, clm_model.params_global, clm_model.params_local);
 
@@ -234,41 +295,111 @@ void CorrectGlobalParametersVideo(const Mat_<uchar> &grayscale_image, CLM& clm_m
 	int off_x = roi.x;
 	int off_y = roi.y;
 
-	double scaling = params.face_template_scale / clm_model.params_global[0];
-	Mat_<uchar> image;
+	// The search area is brought to the same resolution as the template (the template itself is never resized)
+	double scaling = clm_model.face_template_scaling;
+	Mat_<uchar>& image = search_area.image;
 	if(scaling < 1)
 	{
-		cv::resize(clm_model.face_template, clm_model.face_template, Size(), scaling, scaling);
-		cv::resize(grayscale_image(roi), image, Size(), scaling, scaling);
+		cv::resize(grayscale_image(roi), image, Size(), scaling, scaling, cv::INTER_AREA);
 	}
 	else
 	{
-		scaling = 1;
-		image = grayscale_image(roi).clone();
+		image = grayscale_image(roi);
 	}
-		
-	// Resizing the template			
+	search_area.roi = roi;
+	search_area.scaling = scaling;
+
+	const Mat_<uchar>& templ = clm_model.face_template;
+	if(image.rows < templ.rows || image.cols < templ.cols)
+	{
+		return;
+	}
+
+	// The search window at the template level, the whole area unless the coarse level narrows it down
+	Rect search(0, 0, image.cols, image.rows);
+
+	const Mat_<uchar>& templ_coarse = clm_model.face_template_coarse;
+	if(!templ_coarse.empty())
+	{
+		Mat_<uchar> image_coarse;
+		cv::pyrDown(image, image_coarse);
+
+		if(image_coarse.rows >= templ_coarse.rows && image_coarse.cols >= templ_coarse.cols)
+		{
+			Mat corr_coarse;
+			cv::matchTemplate(image_coarse, templ_coarse, corr_coarse, CV_TM_CCOEFF_NORMED);
+
+			int max_loc_coarse[2];
+			cv::minMaxIdx(corr_coarse, NULL, NULL, NULL, max_loc_coarse);
+
+			// A few pixels around the coarse match are enough to refine it
+			const int margin = 3;
+			search = Rect(max_loc_coarse[1] * 2 - margin, max_loc_coarse[0] * 2 - margin, templ.cols + 2 * margin, templ.rows + 2 * margin);
+			search = search & Rect(0, 0, image.cols, image.rows);
+
+			if(search.width < templ.cols || search.height < templ.rows)
+			{
+				search = Rect(0, 0, image.cols, image.rows);
+			}
+		}
+	}
+
 	Mat corr_out;
-	cv::matchTemplate(image, clm_model.face_template, corr_out, CV_TM_CCOEFF_NORMED);
+	cv::matchTemplate(image(search), templ, corr_out, CV_TM_CCOEFF_NORMED);
 
 	// Actually matching it
-	//double min, max;
 	int max_loc[2];
 
 	cv::minMaxIdx(corr_out, NULL, NULL, NULL, max_loc);
 
-	Rect_<double> out_bbox(max_loc[1]/scaling + off_x, max_loc[0]/scaling + off_y, clm_model.face_template.rows / scaling, clm_model.face_template.cols / scaling);
-
-	double shift_x = out_bbox.x - (double)init_box.x;
-	double shift_y = out_bbox.y - (double)init_box.y;
+	double shift_x = (max_loc[1] + search.x) / scaling + off_x - (double)init_box.x;
+	double shift_y = (max_loc[0] + search.y) / scaling + off_y - (double)init_box.y;
 			
 	clm_model.params_global[4] = clm_model.params_global[4] + shift_x;
 	clm_model.params_global[5] = clm_model.params_global[5] + shift_y;
 	
 }
 
+// Moves the model to where it is expected to be in the current frame (assuming constant velocity), and picks the window sizes based on how far the landmarks
+// are expected to move, slow moving faces only need a single small window while fast moving ones need the initialisation sizes
+void PredictMotion(CLM& clm_model, CLMParameters& params)
+{
+	Vec6d predicted = clm_model.params_global + params.motion_damping * clm_model.params_global_velocity;
+
+	Mat_<double> shape_prev, shape_predicted;
+	clm_model.pdm.CalcShape2D(shape_prev, clm_model.params_local, clm_model.params_global);
+	clm_model.pdm.CalcShape2D(shape_predicted, clm_model.params_local, predicted);
+
+	// Mean expected landmark displacement in pixels
+	int n = shape_prev.rows / 2;
+	double motion = 0;
+	for(int i = 0; i < n; ++i)
+	{
+		double dx = shape_predicted.at<double>(i) - shape_prev.at<double>(i);
+		double dy = shape_predicted.at<double>(i + n) - shape_prev.at<double>(i + n);
+		motion += sqrt(dx * dx + dy * dy);
+	}
+	motion /= n;
+
+	clm_model.params_global = predicted;
+
+	if(motion < params.motion_small_threshold)
+	{
+		params.window_sizes_current = vector<int>(1, params.window_sizes_small.back());
+	}
+	else if(motion > params.motion_large_threshold)
+	{
+		params.window_sizes_current = params.window_sizes_init;
+	}
+	else
+	{
+		params.window_sizes_current = params.window_sizes_small;
+	}
+}
+
 bool CLMTracker::DetectLandmarksInVideo(const Mat_<uchar> &grayscale_image, const Mat_<float> &depth_image, CLM& clm_model, CLMParameters& params)
 {
+	CLM_PROFILE_SCOPE("landmarks_video");
 	// First need to decide if the landmarks should be "detected" or "tracked"
 	// Detected means running face detection and a larger search area, tracked means initialising from previous step
 	// and using a smaller search area
@@ -280,33 +411,44 @@ bool CLMTracker::DetectLandmarksInVideo(const Mat_<uchar> &grayscale_image, cons
 	if(clm_model.tracking_initialised)
 	{
 
+		// The estimate from the previous frame, used to work out the velocity
+		Vec6d params_global_prev = clm_model.params_global;
+
 		// The area of interest search size will depend if the previous track was successful
 		if(!clm_model.detection_success)
 		{
 			params.window_sizes_current = params.window_sizes_init;
 		}
+		else if(params.use_motion_prediction)
+		{
+			PredictMotion(clm_model, params);
+		}
 		else
 		{
 			params.window_sizes_current = params.window_sizes_small;
 		}
 
 		// Before the expensive landmark detection step apply a quick template tracking approach
+		TemplateSearchArea search_area;
 		if(params.use_face_template && !clm_model.face_template.empty() && clm_model.detection_success)
 		{
-			CorrectGlobalParametersVideo(grayscale_image, clm_model, params);
+			CorrectGlobalParametersVideo(grayscale_image, clm_model, params, search_area);
 		}
 
-		bool track_success = clm_model.DetectLandmarks(grayscale_image, depth_image, params);
+		// Tracking from a successful frame, so validation does not have to be done every frame
+		bool track_success = clm_model.DetectLandmarks(grayscale_image, depth_image, params, clm_model.detection_success);
 		if(!track_success)
 		{
 			// Make a record that tracking failed
 			clm_model.failures_in_a_row++;
+			clm_model.params_global_velocity = Vec6d(0, 0, 0, 0, 0, 0);
 		}
 		else
 		{
 			// indicate that tracking is a success
 			clm_model.failures_in_a_row = -1;			
-			UpdateTemplate(grayscale_image, clm_model);
+			UpdateTemplate(grayscale_image, clm_model, params, &search_area);
+			clm_model.params_global_velocity = clm_model.params_global - params_global_prev;
 		}
 	}
 
@@ -314,7 +456,8 @@ bool CLMTracker::DetectLandmarksInVideo(const Mat_<uchar> &grayscale_image, cons
 	// This also has the effect of an attempt to reinitialise just after the tracking has failed, which is useful during large motions
 	if(!clm_model.tracking_initialised || (!clm_model.detection_success && params.reinit_video_every > 0 && clm_model.failures_in_a_row % params.reinit_video_every == 0))
 	{
-		
+		CLM_PROFILE_COUNT("reinitialisations", 1);
+
 		Rect_<double> bounding_box;
 
 		// If the face detector has not been initialised read it in
@@ -385,7 +528,7 @@ bool CLMTracker::DetectLandmarksInVideo(const Mat_<uchar> &grayscale_image, cons
 			else
 			{
 				clm_model.failures_in_a_row = -1;				
-				UpdateTemplate(grayscale_image, clm_model);
+				UpdateTemplate(grayscale_image, clm_model, params);
 				return true;
 			}
 		}
@@ -430,6 +573,7 @@ bool CLMTracker::DetectLandmarksInVideo(const Mat_<uchar> &grayscale_image, cons
 // This is the one where the actual work gets done, other DetectLandmarksInImage calls lead to this one
 bool CLMTracker::DetectLandmarksInImage(const Mat_<uchar> &grayscale_image, const Mat_<float> depth_image, const Rect_<double> bounding_box, CLM& clm_model, CLMParameters& params)
 {
+	CLM_PROFILE_SCOPE("landmarks_image");
 
 	// Can have multiple hypotheses
 	vector<Vec3d> rotation_hypotheses;
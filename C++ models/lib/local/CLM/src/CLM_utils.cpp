@@ -49,6 +49,9 @@
 #include "stdafx.h"
 
 #include <CLM_utils.h>
+#include <Profiler.h>
+
+#include <algorithm>
 
 using namespace boost::filesystem;
 
@@ -252,6 +255,99 @@ void get_camera_params(int &device, float &fx, float &fy, float &cx, float &cy,
 	}
 }
 
+void get_raw_input_params(int &width, int &height, int &chroma_bytes, vector<string> &arguments)
+{
+	bool* valid = new bool[arguments.size()];
+
+	width = 0;
+	height = 0;
+	chroma_bytes = 0;
+
+	for(size_t i=0; i < arguments.size(); ++i)
+	{
+		valid[i] = true;
+		if (arguments[i].compare("-raw") == 0 || arguments[i].compare("-raw420") == 0) 
+		{
+			stringstream data_w(arguments[i+1]);
+			data_w >> width;
+			stringstream data_h(arguments[i+2]);
+			data_h >> height;
+
+			// Planar YUV 4:2:0 has a quarter size U and V plane after the luma, odd sizes are rounded up
+			if(arguments[i].compare("-raw420") == 0)
+			{
+				chroma_bytes = 2 * ((width + 1) / 2) * ((height + 1) / 2);
+			}
+
+			valid[i] = false;
+			valid[i+1] = false;
+			valid[i+2] = false;
+			i += 2;
+		}
+		else if (arguments[i].compare("-help") == 0)
+		{
+			cout << "Raw input is defined as: -raw <width> <height> (8-bit luma frames) or -raw420 <width> <height> (planar YUV 4:2:0 frames, only the luma is used), the -f inputs are then raw streams, - for the standard input"  << endl; // Inform the user of how to use the program				
+		}
+	}
+
+	for(int i=arguments.size()-1; i >= 0; --i)
+	{
+		if(!valid[i])
+		{
+			arguments.erase(arguments.begin()+i);
+		}
+	}
+
+	delete[] valid;
+}
+
+void get_segment_params(vector<string> &segment_files, int &num_chunks, int &warmup_frames, vector<string> &arguments)
+{
+	bool* valid = new bool[arguments.size()];
+
+	for(size_t i=0; i < arguments.size(); ++i)
+	{
+		valid[i] = true;
+		if (arguments[i].compare("-segs") == 0) 
+		{
+			segment_files.push_back(arguments[i+1]);
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-chunks") == 0) 
+		{
+			stringstream data(arguments[i+1]);
+			data >> num_chunks;
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-warmup") == 0) 
+		{
+			stringstream data(arguments[i+1]);
+			data >> warmup_frames;
+			valid[i] = false;
+			valid[i+1] = false;
+			i++;
+		}
+		else if (arguments[i].compare("-help") == 0)
+		{
+			cout << "Frame segments are defined as: -segs <segment list file (one per input, a begin and end frame per line)> -chunks <number of parts a whole input is split into to be tracked in parallel> -warmup <number of frames tracked before each segment or chunk starts>"  << endl; // Inform the user of how to use the program				
+		}
+	}
+
+	for(int i=arguments.size()-1; i >= 0; --i)
+	{
+		if(!valid[i])
+		{
+			arguments.erase(arguments.begin()+i);
+		}
+	}
+
+	delete[] valid;
+}
+
 void get_image_input_output_params(vector<string> &input_image_files, vector<string> &input_depth_files, vector<string> &output_feature_files, vector<string> &output_image_files,
 		vector<Rect_<double>> &input_bounding_boxes, vector<string> &arguments)
 {
@@ -1024,10 +1120,13 @@ bool DetectFaces(vector<Rect_<double> >& o_regions, const Mat_<uchar>& intensity
 
 bool DetectFaces(vector<Rect_<double> >& o_regions, const Mat_<uchar>& intensity, CascadeClassifier& classifier)
 {
+	CLM_PROFILE_SCOPE("face_detection");
 		
 	vector<Rect> face_detections;
 	classifier.detectMultiScale(intensity, face_detections, 1.2, 2, 0, Size(50, 50)); 		
 
+	CLM_PROFILE_COUNT("faces_detected", (long long)face_detections.size());
+
 	// Convert from int bounding box do a double one with corrections
 	o_regions.resize(face_detections.size());
 
@@ -1121,6 +1220,7 @@ bool DetectFacesHOG(vector<Rect_<double> >& o_regions, const Mat_<uchar>& intens
 
 bool DetectFacesHOG(vector<Rect_<double> >& o_regions, const Mat_<uchar>& intensity, dlib::frontal_face_detector& detector, std::vector<double>& o_confidences)
 {
+	CLM_PROFILE_SCOPE("face_detection");
 		
 	Mat_<uchar> upsampled_intensity;
 
@@ -1133,6 +1233,8 @@ bool DetectFacesHOG(vector<Rect_<double> >& o_regions, const Mat_<uchar>& intens
 	std::vector<dlib::full_detection> face_detections;
 	detector(cv_grayscale, face_detections, -0.2);
 
+	CLM_PROFILE_COUNT("faces_detected", (long long)face_detections.size());
+
 	// Convert from int bounding box do a double one with corrections
 	o_regions.resize(face_detections.size());
 	o_confidences.resize(face_detections.size());
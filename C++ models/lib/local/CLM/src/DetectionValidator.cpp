@@ -103,7 +103,7 @@ void DetectionValidator::Read(string location)
 		else if(validator_type == 2)
 		{
 			cnn_convolutional_layers.resize(n);
-			cnn_convolutional_layers_dft.resize(n);
+			cnn_convolutional_layers_packed.resize(n);
 			cnn_subsampling_layers.resize(n);
 			cnn_fully_connected_layers.resize(n);
 			cnn_layer_types.resize(n);
@@ -183,10 +183,8 @@ void DetectionValidator::Read(string location)
 						detection_validator_stream.read ((char*)&num_kernels, 4);
 
 						vector<vector<Mat_<float> > > kernels;
-						vector<vector<pair<int, Mat_<double> > > > kernel_dfts;
 
 						kernels.resize(num_in_maps);
-						kernel_dfts.resize(num_in_maps);
 
 						vector<float> biases;
 						for (int k = 0; k < num_kernels; ++k)
@@ -202,7 +200,6 @@ void DetectionValidator::Read(string location)
 						for (int in = 0; in < num_in_maps; ++in)
 						{
 							kernels[in].resize(num_kernels);
-							kernel_dfts[in].resize(num_kernels);
 
 							// For every kernel on that input map
 							for (int k = 0; k < num_kernels; ++k)
@@ -215,7 +212,20 @@ void DetectionValidator::Read(string location)
 						}
 
 						cnn_convolutional_layers[i].push_back(kernels);
-						cnn_convolutional_layers_dft[i].push_back(kernel_dfts);
+
+						// Pack the kernels, a row per output map with the kernels of every input map following each other, ConvolveLayer
+						// correlates the input with these, which is a convolution with the kernels as stored in the model as they are flipped above
+						int kernel_size = kernels[0][0].rows * kernels[0][0].cols;
+						Mat_<float> packed(num_kernels, num_in_maps * kernel_size);
+						for (int k = 0; k < num_kernels; ++k)
+						{
+							for (int in = 0; in < num_in_maps; ++in)
+							{
+								Mat_<float> kernel = kernels[in][k].clone();
+								kernel.reshape(1, 1).copyTo(packed(Rect(in * kernel_size, k, kernel_size, 1)));
+							}
+						}
+						cnn_convolutional_layers_packed[i].push_back(packed);
 					}
 					else if(layer_type == 1)
 					{
@@ -253,19 +263,15 @@ void DetectionValidator::Read(string location)
 
 //===========================================================================
 // Check if the fitting actually succeeded
-double DetectionValidator::Check(const Vec3d& orientation, const Mat_<uchar>& intensity_img, Mat_<double>& detected_landmarks)
+double DetectionValidator::Check(const Vec3d& orientation, const Mat_<uchar>& intensity_img, Mat_<double>& detected_landmarks) const
 {
-
 	int id = GetViewId(orientation);
 	
 	// The warped (cropped) image, corresponding to a face lying withing the detected lanmarks
 	Mat_<double> warped;
 	
-	// the piece-wise affine image
-	Mat_<double> intensity_img_double;
-	intensity_img.convertTo(intensity_img_double, CV_64F);
-
-	paws[id].Warp(intensity_img_double, warped, detected_landmarks);	
+	// the piece-wise affine image, sampled straight from the 8-bit image so only the face region is touched
+	paws[id].Warp(intensity_img, warped, detected_landmarks);	
 	
 	double dec;
 	if(validator_type == 0)
@@ -283,7 +289,7 @@ double DetectionValidator::Check(const Vec3d& orientation, const Mat_<uchar>& in
 	return dec;
 }
 
-double DetectionValidator::CheckNN(const Mat_<double>& warped_img, int view_id)
+double DetectionValidator::CheckNN(const Mat_<double>& warped_img, int view_id) const
 {
 	Mat_<double> feature_vec;
 	NormaliseWarpedToVector(warped_img, feature_vec, view_id);
@@ -336,7 +342,7 @@ double DetectionValidator::CheckNN(const Mat_<double>& warped_img, int view_id)
 
 }
 
-double DetectionValidator::CheckSVR(const Mat_<double>& warped_img, int view_id)
+double DetectionValidator::CheckSVR(const Mat_<double>& warped_img, int view_id) const
 {
 
 	Mat_<double> feature_vec;
@@ -349,39 +355,144 @@ double DetectionValidator::CheckSVR(const Mat_<double>& warped_img, int view_id)
 
 }
 
+// Helpers for the convolutional neural network evaluation
+namespace
+{
+	// Computes all of the output maps of a convolutional layer at once, the input maps are unrolled (im2col) so that
+	// every row corresponds to a single kernel tap over all of the output locations, the (valid) correlation with
+	// all of the packed kernels then becomes a single matrix multiplication, followed by a fused bias and sigmoid
+	void ConvolveLayer(const vector<Mat_<float> >& input_maps, const Mat_<float>& packed_kernels, const vector<float>& biases, int kernel_h, int kernel_w, vector<Mat_<float> >& outputs)
+	{
+		int out_h = input_maps[0].rows - kernel_h + 1;
+		int out_w = input_maps[0].cols - kernel_w + 1;
+
+		Mat_<float> unrolled(packed_kernels.cols, out_h * out_w);
+
+		int row = 0;
+		for(size_t in = 0; in < input_maps.size(); ++in)
+		{
+			for(int i = 0; i < kernel_h; ++i)
+			{
+				for(int j = 0; j < kernel_w; ++j, ++row)
+				{
+					float* dst = unrolled.ptr<float>(row);
+					for(int y = 0; y < out_h; ++y)
+					{
+						const float* src = input_maps[in].ptr<float>(y + i) + j;
+						std::copy(src, src + out_w, dst + y * out_w);
+					}
+				}
+			}
+		}
+
+		Mat_<float> response = packed_kernels * unrolled;
+
+		outputs.resize(response.rows);
+		for(int k = 0; k < response.rows; ++k)
+		{
+			float* resp = response.ptr<float>(k);
+			float bias = biases[k];
+			for(int p = 0; p < response.cols; ++p)
+			{
+				resp[p] = 1.0f / (1.0f + std::exp(-resp[p] - bias));
+			}
+			outputs[k] = response.row(k).reshape(1, out_h);
+		}
+	}
+
+	// Subsampling of every map, each output is the 2x2 neighbourhood sum scaled by 1/scale^2 taken at every scale'th pixel
+	void SubsampleLayer(const vector<Mat_<float> >& input_maps, int scale, vector<Mat_<float> >& outputs)
+	{
+		float weight = 1.0f / (scale * scale);
+
+		outputs.resize(input_maps.size());
+		for(size_t in = 0; in < input_maps.size(); ++in)
+		{
+			const Mat_<float>& input = input_maps[in];
+
+			// Only locations with a full 2x2 neighbourhood are considered
+			int conv_rows = input.rows - 1;
+			int conv_cols = input.cols - 1;
+
+			Mat_<float> sub_out((conv_rows + scale - 1) / scale, (conv_cols + scale - 1) / scale);
+
+			for(int h = 0; h < conv_rows; h += scale)
+			{
+				const float* r0 = input.ptr<float>(h);
+				const float* r1 = input.ptr<float>(h + 1);
+				float* out = sub_out.ptr<float>(h / scale);
+
+				for(int w = 0; w < conv_cols; w += scale)
+				{
+					out[w / scale] = (r0[w] + r0[w + 1] + r1[w] + r1[w + 1]) * weight;
+				}
+			}
+			outputs[in] = sub_out;
+		}
+	}
+
+	// Fully connected layer with a fused bias and sigmoid, the maps are concatenated in column major order
+	void FullyConnectedLayer(const vector<Mat_<float> >& input_maps, const Mat_<float>& weights, float bias, vector<Mat_<float> >& outputs)
+	{
+		int total = 0;
+		for(size_t in = 0; in < input_maps.size(); ++in)
+		{
+			total += input_maps[in].rows * input_maps[in].cols;
+		}
+
+		Mat_<float> input_concat(1, total);
+		float* concat_it = input_concat.ptr<float>(0);
+
+		for(size_t in = 0; in < input_maps.size(); ++in)
+		{
+			const Mat_<float>& input = input_maps[in];
+			for(int w = 0; w < input.cols; ++w)
+			{
+				for(int h = 0; h < input.rows; ++h)
+				{
+					*concat_it++ = input(h, w);
+				}
+			}
+		}
+
+		Mat_<float> output;
+		cv::gemm(input_concat, weights, 1.0, cv::noArray(), 0.0, output, cv::GEMM_2_T);
+
+		float* out_it = output.ptr<float>(0);
+		for(int i = 0; i < output.cols; ++i)
+		{
+			out_it[i] = 1.0f / (1.0f + std::exp(-out_it[i] - bias));
+		}
+
+		outputs.clear();
+		outputs.push_back(output);
+	}
+}
+
 // Convolutional Neural Network
-double DetectionValidator::CheckCNN(const Mat_<double>& warped_img, int view_id)
+double DetectionValidator::CheckCNN(const Mat_<double>& warped_img, int view_id) const
 {
 
 	Mat_<double> feature_vec;
 	NormaliseWarpedToVector(warped_img, feature_vec, view_id);
 	
-	// Create a normalised image from the crop vector
-	Mat_<float> img(warped_img.size(), 0.0);
-	img = img.t();
-
-	cv::Mat mask = paws[view_id].pixel_mask.t();
-	cv::MatIterator_<uchar>  mask_it = mask.begin<uchar>();
-	
-	cv::MatIterator_<double> feature_it = feature_vec.begin();
-	cv::MatIterator_<float> img_it = img.begin();		
+	// Create a normalised image from the crop vector (the vector is in column major order)
+	Mat_<float> img(warped_img.size(), 0.0f);
 
-	int wInt = img.cols;
-	int hInt = img.rows;
+	const Mat_<uchar>& mask = paws[view_id].pixel_mask;
+	cv::MatConstIterator_<double> feature_it = feature_vec.begin();
 
-	for(int i=0; i < wInt; ++i)
+	for(int x = 0; x < img.cols; ++x)
 	{
-		for(int j=0; j < hInt; ++j, ++mask_it, ++img_it)
+		for(int y = 0; y < img.rows; ++y)
 		{
-			// if is within mask
-			if(*mask_it)
+			// assign the feature to image if it is within the mask
+			if(mask(y, x))
 			{
-				// assign the feature to image if it is within the mask
-				*img_it = (float)*feature_it++;
+				img(y, x) = (float)*feature_it++;
 			}
 		}
 	}
-	img = img.t();
 	
 	int cnn_layer = 0;
 	int subsample_layer = 0;
@@ -397,147 +508,37 @@ double DetectionValidator::CheckCNN(const Mat_<double>& warped_img, int view_id)
 		// Determine layer type
 		int layer_type = cnn_layer_types[view_id][layer];
 		
-		
-		// Convolutional layer
 		if(layer_type == 0)
 		{
-			vector<Mat_<float> > outputs_kern;
-			for(size_t in = 0; in < input_maps.size(); ++in)
-			{
-				Mat_<float> input_image = input_maps[in];
-
-				// Useful precomputed data placeholders for quick correlation (convolution)
-				Mat_<double> input_image_dft;
-				Mat integral_image;
-				Mat integral_image_sq;
-
-				for(size_t k = 0; k < cnn_convolutional_layers[view_id][cnn_layer][in].size(); ++k)
-				{
-					Mat_<float> kernel = cnn_convolutional_layers[view_id][cnn_layer][in][k];					
-										
-					// The convolution (with precomputation)
-					Mat_<float> output;
-					if(cnn_convolutional_layers_dft[view_id][cnn_layer][in][k].second.empty())
-					{
-						std::map<int, Mat_<double> > precomputed_dft;
-						
-						CLMTracker::matchTemplate_m(input_image, input_image_dft, integral_image, integral_image_sq, kernel, precomputed_dft, output, CV_TM_CCORR);
-						
-						cnn_convolutional_layers_dft[view_id][cnn_layer][in][k].first = precomputed_dft.begin()->first;
-						cnn_convolutional_layers_dft[view_id][cnn_layer][in][k].second = precomputed_dft.begin()->second;
-					}
-					else
-					{
-						std::map<int, Mat_<double> > precomputed_dft;
-						precomputed_dft[cnn_convolutional_layers_dft[view_id][cnn_layer][in][k].first] = cnn_convolutional_layers_dft[view_id][cnn_layer][in][k].second;
-						CLMTracker::matchTemplate_m(input_image, input_image_dft, integral_image, integral_image_sq, kernel,  precomputed_dft, output, CV_TM_CCORR);						
-					}
-
-					// Combining the maps
-					if(in == 0)
-					{
-						outputs_kern.push_back(output);
-					}
-					else
-					{
-						outputs_kern[k] = outputs_kern[k] + output;
-					}
-
-				}
-								
-			}
-			
-			outputs.clear();
-			for(size_t k = 0; k < cnn_convolutional_layers[view_id][cnn_layer][0].size(); ++k)
-			{
-				// Apply the sigmoid
-				cv::exp(-outputs_kern[k] - cnn_convolutional_layers_bias[view_id][cnn_layer][k], outputs_kern[k]);
-				outputs_kern[k] = 1.0 /(1.0 + outputs_kern[k]);	
-
-				outputs.push_back(outputs_kern[k]);
-
-			}			
-
+			// Convolutional layer
+			const Mat_<float>& kernel = cnn_convolutional_layers[view_id][cnn_layer][0][0];
+			ConvolveLayer(input_maps, cnn_convolutional_layers_packed[view_id][cnn_layer], cnn_convolutional_layers_bias[view_id][cnn_layer], kernel.rows, kernel.cols, outputs);
 			cnn_layer++;
 		}				
-		if(layer_type == 1)
+		else if(layer_type == 1)
 		{
 			// Subsampling layer
-			int scale = cnn_subsampling_layers[view_id][subsample_layer];
-			
-			Mat kx = Mat::ones(2, 1, CV_32F)*1.0f/scale;
-			Mat ky = Mat::ones(1, 2, CV_32F)*1.0f/scale;
-
-			vector<Mat_<float>> outputs_sub;
-			for(size_t in = 0; in < input_maps.size(); ++in)
-			{
-
-				Mat_<float> conv_out;
-
-				sepFilter2D(input_maps[in], conv_out, CV_32F, kx, ky);
-				conv_out = conv_out(Rect(1, 1, conv_out.cols - 1, conv_out.rows - 1));
-
-				int res_rows = conv_out.rows / scale;
-				int res_cols = conv_out.cols / scale;
-
-				if(conv_out.rows % scale != 0)
-				{
-					res_rows++;
-				}
-				if(conv_out.cols % scale != 0)
-				{
-					res_cols++;
-				}
-
-				Mat_<float> sub_out(res_rows, res_cols);
-				for(int w = 0; w < conv_out.cols; w+=scale)
-				{
-					for(int h=0; h < conv_out.rows; h+=scale)
-					{
-						sub_out.at<float>(h/scale, w/scale) = conv_out(h, w);
-					}
-				}
-				outputs_sub.push_back(sub_out);
-			}
-			outputs = outputs_sub;
+			SubsampleLayer(input_maps, cnn_subsampling_layers[view_id][subsample_layer], outputs);
 			subsample_layer++;
-
 		}
-		if(layer_type == 2)
+		else if(layer_type == 2)
 		{
-			// Concatenate all the maps
-			Mat_<float> input_concat = input_maps[0].t();
-			input_concat = input_concat.reshape(0, 1);
-
-			for(size_t in = 1; in < input_maps.size(); ++in)
-			{
-				Mat_<float> add = input_maps[in].t();
-				add = add.reshape(0,1);
-				cv::hconcat(input_concat, add, input_concat);
-			}
-						
-			input_concat = input_concat * cnn_fully_connected_layers[view_id][fully_connected_layer].t();
-
-			cv::exp(-input_concat - cnn_fully_connected_layers_bias[view_id][fully_connected_layer], input_concat);
-			input_concat = 1.0 /(1.0 + input_concat);		
-
-			outputs.clear();
-			outputs.push_back(input_concat);
-
+			// Fully connected layer
+			FullyConnectedLayer(input_maps, cnn_fully_connected_layers[view_id][fully_connected_layer], cnn_fully_connected_layers_bias[view_id][fully_connected_layer], outputs);
 			fully_connected_layer++;
 		}
 		// Set the outputs of this layer to inputs of the next
-		input_maps = outputs;
+		input_maps.swap(outputs);
 
 	}
 
 	// Turn it to -1, 1 range
-	double dec = (outputs[0].at<float>(0) - 0.5) * 2.0;
+	double dec = (input_maps[0].at<float>(0) - 0.5) * 2.0;
 
 	return dec;
 }
 
-void DetectionValidator::NormaliseWarpedToVector(const Mat_<double>& warped_img, Mat_<double>& feature_vec, int view_id)
+void DetectionValidator::NormaliseWarpedToVector(const Mat_<double>& warped_img, Mat_<double>& feature_vec, int view_id) const
 {
 	Mat_<double> warped_t = warped_img.t();
 	
@@ -0,0 +1,162 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2014, University of Southern California and University of Cambridge,
+// all rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED AS IS AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY. OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Notwithstanding the license granted herein, Licensee acknowledges that certain components
+// of the Software may be covered by so-called open source software licenses (Open Source
+// Components), which means any software licenses approved as open source licenses by the
+// Open Source Initiative or any substantially similar licenses, including without limitation any
+// license that, as a condition of distribution of the software licensed under such license,
+// requires that the distributor make the software available in source code format. Licensor shall
+// provide a list of Open Source Components for a particular version of the Software upon
+// Licensees request. Licensee will comply with the applicable terms of such licenses and to
+// the extent required by the licenses covering Open Source Components, the terms of such
+// licenses will apply in lieu of the terms of this Agreement. To the extent the terms of the
+// licenses applicable to Open Source Components prohibit any of the restrictions in this
+// License Agreement with respect to such Open Source Component, such restrictions will not
+// apply to such Open Source Component. To the extent the terms of the licenses applicable to
+// Open Source Components require Licensor to make an offer to provide source code or
+// related information in connection with the Software, such offer is hereby made. Any request
+// for source code or related information should be directed to cl-face-tracker-distribution@lists.cam.ac.uk
+// Licensee acknowledges receipt of notices for the Open Source Components for the initial
+// delivery of the Software.
+
+//     * Any publications arising from the use of this software, including but
+//       not limited to academic journal and conference publications, technical
+//       reports and manuals, must cite one of the following works:
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 3D
+//       Constrained Local Model for Rigid and Non-Rigid Facial Tracking.
+//       IEEE Conference on Computer Vision and Pattern Recognition (CVPR), 2012.    
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 
+//       Constrained Local Neural Fields for robust facial landmark detection in the wild.
+//       in IEEE Int. Conference on Computer Vision Workshops, 300 Faces in-the-Wild Challenge, 2013.    
+//
+///////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+
+#include "FrameSegments.h"
+
+#include <tbb/tbb.h>
+
+using namespace CLMTracker;
+
+bool CLMTracker::ReadFrameSegments(const string& filename, vector<FrameSegment>& segments)
+{
+	ifstream segment_file(filename);
+	if(!segment_file.is_open())
+	{
+		cout << "Could not open the segment list " << filename << endl;
+		return false;
+	}
+
+	string line;
+	while(getline(segment_file, line))
+	{
+		if(line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		FrameSegment segment;
+		stringstream line_stream(line);
+		if(!(line_stream >> segment.begin >> segment.end) || segment.begin < 0 || (segment.end >= 0 && segment.end < segment.begin))
+		{
+			cout << "Invalid segment in " << filename << ": " << line << endl;
+			return false;
+		}
+		segments.push_back(segment);
+	}
+
+	return true;
+}
+
+vector<FrameSegment> CLMTracker::SplitIntoChunks(int num_frames, int num_chunks)
+{
+	vector<FrameSegment> chunks;
+	num_chunks = std::max(1, std::min(num_chunks, num_frames));
+
+	for(int c = 0; c < num_chunks; ++c)
+	{
+		int begin = (int)((long long)num_frames * c / num_chunks);
+		int end = (int)((long long)num_frames * (c + 1) / num_chunks) - 1;
+		chunks.push_back(FrameSegment(begin, c == num_chunks - 1 ? -1 : end));
+	}
+
+	return chunks;
+}
+
+int CLMTracker::DefaultWarmupFrames(double fps, double seconds)
+{
+	if(fps <= 0)
+	{
+		fps = 30;
+	}
+	return (int)(fps * seconds + 0.5);
+}
+
+bool CLMTracker::ProcessFrameSegments(const vector<FrameSegment>& segments, int warmup_frames, const OpenSourceFunction& open_source, const CLM& clm_model, const CLMParameters& clm_parameters, const SegmentFrameFunction& process_frame)
+{
+	// Using int instead of bool as it is written to from different threads
+	vector<int> segment_read(segments.size(), 0);
+
+	tbb::parallel_for(0, (int)segments.size(), [&](int s){
+
+		const FrameSegment& segment = segments[s];
+
+		FrameSource frame_source;
+		if(!open_source(frame_source))
+		{
+			return;
+		}
+
+		// Seeking goes to the closest keyframe instead of reading all of the preceding frames
+		int first_frame = std::max(0, segment.begin - warmup_frames);
+		if(first_frame > 0 && !frame_source.Seek(first_frame))
+		{
+			cout << "Could not seek to frame " << first_frame << endl;
+			return;
+		}
+
+		// The copies share nothing that is written to while tracking
+		CLM segment_model(clm_model);
+		segment_model.Reset();
+		CLMParameters segment_parameters(clm_parameters);
+
+		Mat image;
+		Mat_<uchar> grayscale;
+		while(frame_source.Read(image, grayscale))
+		{
+			int frame = frame_source.GetFrameIndex();
+			if(segment.end >= 0 && frame > segment.end)
+			{
+				break;
+			}
+			process_frame(s, frame, frame >= segment.begin, image, grayscale, segment_model, segment_parameters);
+		}
+
+		segment_read[s] = 1;
+	});
+
+	for(size_t s = 0; s < segment_read.size(); ++s)
+	{
+		if(!segment_read[s])
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,488 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2014, University of Southern California and University of Cambridge,
+// all rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED AS IS AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY. OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Notwithstanding the license granted herein, Licensee acknowledges that certain components
+// of the Software may be covered by so-called open source software licenses (Open Source
+// Components), which means any software licenses approved as open source licenses by the
+// Open Source Initiative or any substantially similar licenses, including without limitation any
+// license that, as a condition of distribution of the software licensed under such license,
+// requires that the distributor make the software available in source code format. Licensor shall
+// provide a list of Open Source Components for a particular version of the Software upon
+// Licensees request. Licensee will comply with the applicable terms of such licenses and to
+// the extent required by the licenses covering Open Source Components, the terms of such
+// licenses will apply in lieu of the terms of this Agreement. To the extent the terms of the
+// licenses applicable to Open Source Components prohibit any of the restrictions in this
+// License Agreement with respect to such Open Source Component, such restrictions will not
+// apply to such Open Source Component. To the extent the terms of the licenses applicable to
+// Open Source Components require Licensor to make an offer to provide source code or
+// related information in connection with the Software, such offer is hereby made. Any request
+// for source code or related information should be directed to cl-face-tracker-distribution@lists.cam.ac.uk
+// Licensee acknowledges receipt of notices for the Open Source Components for the initial
+// delivery of the Software.
+
+//     * Any publications arising from the use of this software, including but
+//       not limited to academic journal and conference publications, technical
+//       reports and manuals, must cite one of the following works:
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 3D
+//       Constrained Local Model for Rigid and Non-Rigid Facial Tracking.
+//       IEEE Conference on Computer Vision and Pattern Recognition (CVPR), 2012.    
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 
+//       Constrained Local Neural Fields for robust facial landmark detection in the wild.
+//       in IEEE Int. Conference on Computer Vision Workshops, 300 Faces in-the-Wild Challenge, 2013.    
+//
+///////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+
+#include "FrameSource.h"
+
+#include <opencv2/videoio/videoio_c.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+using namespace CLMTracker;
+
+FrameSource::FrameSource() : source_type(SOURCE_NONE), opened(false), seekable(false), fps(0), frame_count(-1), frame_index(-1), decode_index(0), next_image(0), raw_file(0), raw_width(0), raw_height(0), raw_chroma_bytes(0),
+	slot_in_use(-1), end_of_input(false), stopping(false)
+{
+}
+
+FrameSource::~FrameSource()
+{
+	Close();
+}
+
+bool FrameSource::OpenVideoFile(const string& filename, int ring_size)
+{
+	Close();
+
+	capture.open(filename);
+	if(!capture.isOpened())
+	{
+		return false;
+	}
+
+	fps = capture.get(CV_CAP_PROP_FPS);
+	frame_count = (int)capture.get(CV_CAP_PROP_FRAME_COUNT);
+	if(frame_count <= 0)
+	{
+		frame_count = -1;
+	}
+
+	// Streams and pipes opened by the capture backend have no known length
+	seekable = frame_count > 0;
+	source_type = SOURCE_VIDEO;
+	Start(ring_size);
+	return true;
+}
+
+bool FrameSource::OpenCamera(int device, int ring_size)
+{
+	Close();
+
+	capture.open(device);
+	if(!capture.isOpened())
+	{
+		return false;
+	}
+
+	// Read a first frame often empty in camera
+	Mat first_frame;
+	capture >> first_frame;
+
+	source_type = SOURCE_VIDEO;
+	Start(ring_size);
+	return true;
+}
+
+bool FrameSource::OpenImageSequence(const vector<string>& image_files, int ring_size)
+{
+	Close();
+
+	if(image_files.empty())
+	{
+		return false;
+	}
+
+	this->image_files = image_files;
+	next_image = 0;
+	frame_count = (int)image_files.size();
+	seekable = true;
+
+	source_type = SOURCE_IMAGES;
+	Start(ring_size);
+	return true;
+}
+
+bool FrameSource::OpenRaw(const string& filename, int width, int height, int chroma_bytes, int ring_size)
+{
+	Close();
+
+	if(width <= 0 || height <= 0)
+	{
+		cout << "The raw frame size has to be specified" << endl;
+		return false;
+	}
+
+	if(filename.compare("-") == 0)
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+		raw_file = stdin;
+	}
+	else
+	{
+		raw_file = fopen(filename.c_str(), "rb");
+	}
+
+	if(!raw_file)
+	{
+		return false;
+	}
+
+	raw_width = width;
+	raw_height = height;
+	raw_chroma_bytes = chroma_bytes;
+	raw_chroma.resize(chroma_bytes);
+
+	// The length of a raw file follows from its size, named pipes can not seek to find it
+	if(raw_file != stdin)
+	{
+#ifdef _WIN32
+		seekable = _fseeki64(raw_file, 0, SEEK_END) == 0;
+		long long file_size = _ftelli64(raw_file);
+#else
+		seekable = fseeko(raw_file, 0, SEEK_END) == 0;
+		long long file_size = (long long)ftello(raw_file);
+#endif
+		if(seekable && file_size >= 0)
+		{
+			rewind(raw_file);
+			frame_count = (int)(file_size / (width * height + chroma_bytes));
+		}
+		else
+		{
+			seekable = false;
+		}
+	}
+
+	source_type = SOURCE_RAW;
+	Start(ring_size);
+	return true;
+}
+
+bool FrameSource::Open(const string& filename, int device, int raw_width, int raw_height, int raw_chroma_bytes)
+{
+	if(filename.empty())
+	{
+		return OpenCamera(device);
+	}
+	else if(raw_width > 0)
+	{
+		return OpenRaw(filename, raw_width, raw_height, raw_chroma_bytes);
+	}
+	else
+	{
+		return OpenVideoFile(filename);
+	}
+}
+
+void FrameSource::Start(int ring_size)
+{
+	if(ring_size < 2)
+	{
+		ring_size = 2;
+	}
+
+	slots.resize(ring_size);
+	free_slots.clear();
+	filled_slots.clear();
+	for(int i = 0; i < ring_size; ++i)
+	{
+		free_slots.push_back(i);
+	}
+
+	slot_in_use = -1;
+	end_of_input = false;
+	stopping = false;
+	frame_index = -1;
+	opened = true;
+
+	decode_thread = std::thread(&FrameSource::DecodeLoop, this);
+}
+
+void FrameSource::DecodeLoop()
+{
+	while(true)
+	{
+		int slot;
+		{
+			std::unique_lock<std::mutex> lock(ring_mutex);
+			while(!stopping && free_slots.empty())
+			{
+				slot_freed.wait(lock);
+			}
+
+			if(stopping)
+			{
+				return;
+			}
+
+			slot = free_slots.front();
+			free_slots.pop_front();
+		}
+
+		FrameSlot& frame = slots[slot];
+
+		// The decoders write into the existing buffers when the size does not change
+		bool success = DecodeNext(frame.image);
+
+		if(success)
+		{
+			decode_index++;
+
+			if(frame.image.channels() == 3)
+			{
+				cvtColor(frame.image, frame.grayscale, CV_BGR2GRAY);
+			}
+			else if(frame.image.channels() == 4)
+			{
+				cvtColor(frame.image, frame.grayscale, CV_BGRA2GRAY);
+			}
+			else
+			{
+				// A view of the same data for 8-bit images (other depths are converted)
+				frame.grayscale = frame.image;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(ring_mutex);
+			if(success)
+			{
+				filled_slots.push_back(slot);
+			}
+			else
+			{
+				free_slots.push_front(slot);
+				end_of_input = true;
+			}
+		}
+		slot_filled.notify_one();
+
+		if(!success)
+		{
+			return;
+		}
+	}
+}
+
+bool FrameSource::DecodeNext(Mat& image)
+{
+	if(source_type == SOURCE_VIDEO)
+	{
+		return capture.read(image) && !image.empty();
+	}
+	else if(source_type == SOURCE_IMAGES)
+	{
+		if(next_image >= image_files.size())
+		{
+			return false;
+		}
+		image = imread(image_files[next_image++], -1);
+		return !image.empty();
+	}
+	else if(source_type == SOURCE_RAW)
+	{
+		// Pipes can not seek, so the chroma is read into a scratch buffer and dropped
+		image.create(raw_height, raw_width, CV_8UC1);
+
+		if(fread(image.data, 1, raw_width * raw_height, raw_file) != (size_t)(raw_width * raw_height))
+		{
+			return false;
+		}
+		if(raw_chroma_bytes > 0 && fread(&raw_chroma[0], 1, raw_chroma_bytes, raw_file) != (size_t)raw_chroma_bytes)
+		{
+			return false;
+		}
+		return true;
+	}
+	return false;
+}
+
+bool FrameSource::Read(Mat& image, Mat_<uchar>& grayscale)
+{
+	if(!opened)
+	{
+		image = Mat();
+		grayscale = Mat_<uchar>();
+		return false;
+	}
+
+	int slot;
+	{
+		std::unique_lock<std::mutex> lock(ring_mutex);
+
+		// The previously read frame can now be decoded into
+		if(slot_in_use >= 0)
+		{
+			free_slots.push_back(slot_in_use);
+			slot_in_use = -1;
+			slot_freed.notify_one();
+		}
+
+		while(filled_slots.empty() && !end_of_input)
+		{
+			slot_filled.wait(lock);
+		}
+
+		if(filled_slots.empty())
+		{
+			image = Mat();
+			grayscale = Mat_<uchar>();
+			return false;
+		}
+
+		slot = filled_slots.front();
+		filled_slots.pop_front();
+		slot_in_use = slot;
+	}
+
+	image = slots[slot].image;
+	grayscale = slots[slot].grayscale;
+	frame_index++;
+
+	return true;
+}
+
+bool FrameSource::Seek(int frame)
+{
+	if(!opened || frame < 0)
+	{
+		return false;
+	}
+
+	int ring_size = (int)slots.size();
+	StopDecoding();
+
+	bool success = false;
+	if(source_type == SOURCE_VIDEO)
+	{
+		success = capture.set(CV_CAP_PROP_POS_FRAMES, frame);
+	}
+	else if(source_type == SOURCE_IMAGES)
+	{
+		success = frame < (int)image_files.size();
+		if(success)
+		{
+			next_image = frame;
+		}
+	}
+	else if(source_type == SOURCE_RAW && seekable)
+	{
+		// Raw recordings of long videos easily go over 2GB
+		long long offset = (long long)frame * (raw_width * raw_height + raw_chroma_bytes);
+#ifdef _WIN32
+		success = _fseeki64(raw_file, offset, SEEK_SET) == 0;
+#else
+		success = fseeko(raw_file, (off_t)offset, SEEK_SET) == 0;
+#endif
+	}
+
+	if(success)
+	{
+		decode_index = frame;
+	}
+	else if(frame >= decode_index)
+	{
+		success = SkipFrames(frame - decode_index);
+	}
+
+	// The frames that were decoded ahead are stale now, so the ring starts from scratch
+	Start(ring_size);
+	frame_index = decode_index - 1;
+
+	return success;
+}
+
+bool FrameSource::SkipFrames(int num_frames)
+{
+	Mat skipped;
+	for(int i = 0; i < num_frames; ++i)
+	{
+		if(source_type == SOURCE_VIDEO)
+		{
+			// Grabbing still decodes the frame, but it is not converted or copied out
+			if(!capture.grab())
+			{
+				return false;
+			}
+		}
+		else if(!DecodeNext(skipped))
+		{
+			return false;
+		}
+		decode_index++;
+	}
+	return true;
+}
+
+void FrameSource::StopDecoding()
+{
+	if(decode_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(ring_mutex);
+			stopping = true;
+		}
+		slot_freed.notify_all();
+		decode_thread.join();
+	}
+}
+
+void FrameSource::Close()
+{
+	StopDecoding();
+
+	if(capture.isOpened())
+	{
+		capture.release();
+	}
+
+	if(raw_file && raw_file != stdin)
+	{
+		fclose(raw_file);
+	}
+	raw_file = 0;
+
+	image_files.clear();
+	slots.clear();
+	free_slots.clear();
+	filled_slots.clear();
+	slot_in_use = -1;
+
+	source_type = SOURCE_NONE;
+	opened = false;
+	seekable = false;
+	fps = 0;
+	frame_count = -1;
+	decode_index = 0;
+}
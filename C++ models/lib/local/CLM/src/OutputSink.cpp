@@ -0,0 +1,475 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2014, University of Southern California and University of Cambridge,
+// all rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED AS IS AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY. OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Notwithstanding the license granted herein, Licensee acknowledges that certain components
+// of the Software may be covered by so-called open source software licenses (Open Source
+// Components), which means any software licenses approved as open source licenses by the
+// Open Source Initiative or any substantially similar licenses, including without limitation any
+// license that, as a condition of distribution of the software licensed under such license,
+// requires that the distributor make the software available in source code format. Licensor shall
+// provide a list of Open Source Components for a particular version of the Software upon
+// Licensees request. Licensee will comply with the applicable terms of such licenses and to
+// the extent required by the licenses covering Open Source Components, the terms of such
+// licenses will apply in lieu of the terms of this Agreement. To the extent the terms of the
+// licenses applicable to Open Source Components prohibit any of the restrictions in this
+// License Agreement with respect to such Open Source Component, such restrictions will not
+// apply to such Open Source Component. To the extent the terms of the licenses applicable to
+// Open Source Components require Licensor to make an offer to provide source code or
+// related information in connection with the Software, such offer is hereby made. Any request
+// for source code or related information should be directed to cl-face-tracker-distribution@lists.cam.ac.uk
+// Licensee acknowledges receipt of notices for the Open Source Components for the initial
+// delivery of the Software.
+
+//     * Any publications arising from the use of this software, including but
+//       not limited to academic journal and conference publications, technical
+//       reports and manuals, must cite one of the following works:
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 3D
+//       Constrained Local Model for Rigid and Non-Rigid Facial Tracking.
+//       IEEE Conference on Computer Vision and Pattern Recognition (CVPR), 2012.    
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 
+//       Constrained Local Neural Fields for robust facial landmark detection in the wild.
+//       in IEEE Int. Conference on Computer Vision Workshops, 300 Faces in-the-Wild Challenge, 2013.    
+//
+///////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+
+#include "OutputSink.h"
+
+#include <string.h>
+
+using namespace CLMTracker;
+
+namespace
+{
+	const char OUTPUT_MAGIC[4] = {'C', 'L', 'M', 'O'};
+	const int OUTPUT_VERSION = 1;
+
+	// Text is written out in blocks of roughly this size
+	const size_t TEXT_BUFFER_SIZE = 1 << 16;
+
+	// Compressed chunks are coded per column, every value is XOR-ed with the one in the previous
+	// row (slowly changing values share sign, exponent and upper mantissa bits) and the result is
+	// split into byte planes so that the resulting zero bytes end up next to each other
+	void EncodeChunk(const vector<float>& chunk, int num_rows, int num_columns, vector<unsigned char>& encoded)
+	{
+		int num_values = num_rows * num_columns;
+
+		vector<unsigned char> planes(num_values * 4);
+
+		int ind = 0;
+		for(int c = 0; c < num_columns; ++c)
+		{
+			unsigned int prev = 0;
+			for(int r = 0; r < num_rows; ++r)
+			{
+				unsigned int bits;
+				memcpy(&bits, &chunk[r * num_columns + c], 4);
+				unsigned int delta = bits ^ prev;
+				prev = bits;
+
+				for(int b = 0; b < 4; ++b)
+				{
+					planes[b * num_values + ind] = (unsigned char)(delta >> (8 * b));
+				}
+				ind++;
+			}
+		}
+
+		// Zero runs are stored as a zero byte followed by the run length, other bytes as they are
+		encoded.clear();
+		encoded.reserve(planes.size());
+		for(size_t i = 0; i < planes.size(); ++i)
+		{
+			if(planes[i] == 0)
+			{
+				int run = 1;
+				while(i + 1 < planes.size() && planes[i + 1] == 0 && run < 255)
+				{
+					++i;
+					++run;
+				}
+				encoded.push_back(0);
+				encoded.push_back((unsigned char)run);
+			}
+			else
+			{
+				encoded.push_back(planes[i]);
+			}
+		}
+	}
+
+	bool DecodeChunk(const vector<unsigned char>& encoded, int num_rows, int num_columns, vector<vector<float> >& rows)
+	{
+		int num_values = num_rows * num_columns;
+
+		vector<unsigned char> planes;
+		planes.reserve(num_values * 4);
+
+		for(size_t i = 0; i < encoded.size(); ++i)
+		{
+			if(encoded[i] == 0)
+			{
+				if(i + 1 >= encoded.size())
+					return false;
+				planes.insert(planes.end(), (size_t)encoded[++i], (unsigned char)0);
+			}
+			else
+			{
+				planes.push_back(encoded[i]);
+			}
+		}
+
+		if(planes.size() != (size_t)num_values * 4)
+			return false;
+
+		size_t first_row = rows.size();
+		rows.resize(first_row + num_rows, vector<float>(num_columns));
+
+		int ind = 0;
+		for(int c = 0; c < num_columns; ++c)
+		{
+			unsigned int prev = 0;
+			for(int r = 0; r < num_rows; ++r)
+			{
+				unsigned int delta = 0;
+				for(int b = 0; b < 4; ++b)
+				{
+					delta |= ((unsigned int)planes[b * num_values + ind]) << (8 * b);
+				}
+				prev = delta ^ prev;
+				memcpy(&rows[first_row + r][c], &prev, 4);
+				ind++;
+			}
+		}
+		return true;
+	}
+}
+
+//===========================================================================
+// Text sink
+TextOutputSink::TextOutputSink(const TextRowLayout& layout) : layout(layout)
+{
+	buffer.reserve(TEXT_BUFFER_SIZE + 4096);
+}
+
+TextOutputSink::~TextOutputSink()
+{
+	Close();
+}
+
+bool TextOutputSink::Open(const string& filename, const vector<string>&)
+{
+	buffer.clear();
+
+	// Text mode, so the line endings are the platform ones like those of the original writers
+	output_file.open(filename, ios_base::out);
+	return output_file.is_open();
+}
+
+void TextOutputSink::WriteRow(const vector<double>& values)
+{
+	if(!output_file.is_open())
+		return;
+
+	char value_str[32];
+	for(size_t i = 0; i < values.size(); ++i)
+	{
+		if((int)i >= layout.num_leading)
+		{
+			buffer.append(layout.value_prefix);
+		}
+		else if(i > 0)
+		{
+			buffer.push_back(' ');
+		}
+
+		// Same representation as the default stream formatting (6 significant digits)
+		int length = snprintf(value_str, sizeof(value_str), "%g", values[i]);
+		buffer.append(value_str, length);
+
+		if((int)i >= layout.num_leading)
+		{
+			buffer.append(layout.value_suffix);
+		}
+	}
+	buffer.push_back('\n');
+
+	if(buffer.size() >= TEXT_BUFFER_SIZE)
+	{
+		output_file.write(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+}
+
+bool TextOutputSink::Close()
+{
+	if(output_file.is_open())
+	{
+		output_file.write(buffer.data(), buffer.size());
+		buffer.clear();
+		output_file.close();
+	}
+	// The stream state is kept after closing, so a failed write or close shows up here
+	return !output_file.fail();
+}
+
+//===========================================================================
+// Binary sink
+BinaryOutputSink::BinaryOutputSink(bool compressed) : compressed(compressed), num_columns(0), rows_in_chunk(0)
+{
+}
+
+BinaryOutputSink::~BinaryOutputSink()
+{
+	Close();
+}
+
+bool BinaryOutputSink::Open(const string& filename, const vector<string>& column_names)
+{
+	output_file.open(filename, ios_base::out | ios_base::binary);
+
+	if(!output_file.is_open())
+	{
+		return false;
+	}
+
+	num_columns = (int)column_names.size();
+	rows_in_chunk = 0;
+	chunk.assign(CHUNK_ROWS * num_columns, 0.0f);
+
+	int format = compressed ? OUTPUT_BINARY_COMPRESSED : OUTPUT_BINARY;
+
+	output_file.write(OUTPUT_MAGIC, 4);
+	output_file.write((char*)&OUTPUT_VERSION, 4);
+	output_file.write((char*)&format, 4);
+	output_file.write((char*)&num_columns, 4);
+
+	for(size_t i = 0; i < column_names.size(); ++i)
+	{
+		int length = (int)column_names[i].size();
+		output_file.write((char*)&length, 4);
+		output_file.write(column_names[i].data(), length);
+	}
+
+	return true;
+}
+
+void BinaryOutputSink::WriteRow(const vector<double>& values)
+{
+	if(!output_file.is_open() || num_columns == 0)
+		return;
+
+	// Short rows (e.g. frames without a face) are padded with zeros, longer ones are cut to the header
+
+	float* row = &chunk[rows_in_chunk * num_columns];
+	for(int i = 0; i < num_columns; ++i)
+	{
+		row[i] = i < (int)values.size() ? (float)values[i] : 0.0f;
+	}
+	rows_in_chunk++;
+
+	if(rows_in_chunk == CHUNK_ROWS)
+	{
+		FlushChunk();
+	}
+}
+
+void BinaryOutputSink::FlushChunk()
+{
+	if(rows_in_chunk == 0 || num_columns == 0)
+	{
+		rows_in_chunk = 0;
+		return;
+	}
+
+	if(compressed)
+	{
+		EncodeChunk(chunk, rows_in_chunk, num_columns, encoded);
+
+		int encoded_size = (int)encoded.size();
+		output_file.write((char*)&rows_in_chunk, 4);
+		output_file.write((char*)&encoded_size, 4);
+		output_file.write((char*)encoded.data(), encoded_size);
+	}
+	else
+	{
+		output_file.write((char*)chunk.data(), rows_in_chunk * num_columns * sizeof(float));
+	}
+	rows_in_chunk = 0;
+}
+
+bool BinaryOutputSink::Close()
+{
+	if(output_file.is_open())
+	{
+		FlushChunk();
+		output_file.close();
+	}
+	return !output_file.fail();
+}
+
+//===========================================================================
+OutputFormat CLMTracker::OutputFormatFromFilename(const string& filename)
+{
+	size_t dot = filename.find_last_of('.');
+	if(dot != string::npos)
+	{
+		string extension = filename.substr(dot);
+		if(extension.compare(".bin") == 0)
+		{
+			return OUTPUT_BINARY;
+		}
+		else if(extension.compare(".binz") == 0)
+		{
+			return OUTPUT_BINARY_COMPRESSED;
+		}
+	}
+	return OUTPUT_TEXT;
+}
+
+TextRowLayout CLMTracker::PaddedTextLayout()
+{
+	return TextRowLayout(2, " ", " ");
+}
+
+TextRowLayout CLMTracker::TrailingSpaceTextLayout()
+{
+	return TextRowLayout(0, "", " ");
+}
+
+unique_ptr<OutputSink> CLMTracker::CreateOutputSink(OutputFormat format, const TextRowLayout& layout)
+{
+	if(format == OUTPUT_TEXT)
+	{
+		return unique_ptr<OutputSink>(new TextOutputSink(layout));
+	}
+	return unique_ptr<OutputSink>(new BinaryOutputSink(format == OUTPUT_BINARY_COMPRESSED));
+}
+
+unique_ptr<OutputSink> CLMTracker::OpenOutputSink(const string& filename, const vector<string>& column_names, const TextRowLayout& layout)
+{
+	unique_ptr<OutputSink> sink = CreateOutputSink(OutputFormatFromFilename(filename), layout);
+	if(!sink->Open(filename, column_names))
+	{
+		sink.reset();
+	}
+	return sink;
+}
+
+bool CLMTracker::ReadBinaryOutput(const string& filename, vector<string>& column_names, vector<vector<float> >& rows)
+{
+	ifstream input_file(filename, ios_base::in | ios_base::binary);
+	if(!input_file.is_open())
+	{
+		cout << "Could not open the output file " << filename << endl;
+		return false;
+	}
+
+	char magic[4];
+	int version, format, num_columns;
+	input_file.read(magic, 4);
+	input_file.read((char*)&version, 4);
+	input_file.read((char*)&format, 4);
+	input_file.read((char*)&num_columns, 4);
+
+	if(!input_file || memcmp(magic, OUTPUT_MAGIC, 4) != 0 || version != OUTPUT_VERSION || num_columns < 0)
+	{
+		cout << filename << " is not a binary output file" << endl;
+		return false;
+	}
+
+	column_names.resize(num_columns);
+	for(int i = 0; i < num_columns; ++i)
+	{
+		int length;
+		input_file.read((char*)&length, 4);
+		column_names[i].resize(length);
+		input_file.read(&column_names[i][0], length);
+	}
+
+	rows.clear();
+	if(num_columns == 0)
+	{
+		return (bool)input_file;
+	}
+
+	if(format == OUTPUT_BINARY_COMPRESSED)
+	{
+		vector<unsigned char> encoded;
+		int num_rows, encoded_size;
+		while(input_file.read((char*)&num_rows, 4) && input_file.read((char*)&encoded_size, 4))
+		{
+			encoded.resize(encoded_size);
+			input_file.read((char*)encoded.data(), encoded_size);
+
+			if(!input_file || !DecodeChunk(encoded, num_rows, num_columns, rows))
+			{
+				cout << "Corrupt chunk in " << filename << endl;
+				return false;
+			}
+		}
+	}
+	else
+	{
+		vector<float> row(num_columns);
+		while(input_file.read((char*)row.data(), num_columns * sizeof(float)))
+		{
+			rows.push_back(row);
+		}
+	}
+
+	return true;
+}
+
+//===========================================================================
+vector<string> CLMTracker::LandmarkColumnNames(vector<string> columns, int num_points)
+{
+	// Landmarks are stored as all the x coordinates followed by all the y ones
+	for(int i = 0; i < num_points; ++i)
+		columns.push_back("x_" + to_string(i));
+	for(int i = 0; i < num_points; ++i)
+		columns.push_back("y_" + to_string(i));
+	return columns;
+}
+
+vector<string> CLMTracker::Landmark3DColumnNames(vector<string> columns, int num_points)
+{
+	for(int i = 0; i < num_points; ++i)
+		columns.push_back("X_" + to_string(i));
+	for(int i = 0; i < num_points; ++i)
+		columns.push_back("Y_" + to_string(i));
+	for(int i = 0; i < num_points; ++i)
+		columns.push_back("Z_" + to_string(i));
+	return columns;
+}
+
+vector<string> CLMTracker::ParamsColumnNames(vector<string> columns, int num_modes)
+{
+	const char* global_names[] = {"p_scale", "p_rx", "p_ry", "p_rz", "p_tx", "p_ty"};
+	columns.insert(columns.end(), global_names, global_names + 6);
+	for(int i = 0; i < num_modes; ++i)
+		columns.push_back("p_" + to_string(i));
+	return columns;
+}
+
+vector<string> CLMTracker::PoseColumnNames(vector<string> columns)
+{
+	const char* pose_names[] = {"pose_Tx", "pose_Ty", "pose_Tz", "pose_Rx", "pose_Ry", "pose_Rz"};
+	columns.insert(columns.end(), pose_names, pose_names + 6);
+	return columns;
+}
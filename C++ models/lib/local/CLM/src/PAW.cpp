@@ -156,14 +156,13 @@ PAW::PAW(const Mat_<double>& destination_shape, const Mat_<int>& triangulation)
     	
 	// Preallocate maps and coefficients
 	coefficients.create(num_tris, 6);
-	map_x.create(pixel_mask.rows,pixel_mask.cols);
-	map_y.create(pixel_mask.rows,pixel_mask.cols);
+	PrepareWarpTables();
 
 
 }
 
 // Manually define min and max values
-PAW::PAW(const Mat_<double>& destination_shape, const Mat_<int>& triangulation, double in_min_x, double in_min_y, double in_max_x, double in_max_y)
+PAW::PAW(const Mat_<double>& destination_shape, const Mat_<int>& triangulation, double in_min_x, double in_min_y, double in_max_x, double in_max_y, bool warp_tables)
 {
 	// Initialise some variables directly
 	this->destination_landmarks = destination_shape;
@@ -265,9 +264,11 @@ PAW::PAW(const Mat_<double>& destination_shape, const Mat_<int>& triangulation,
 	}    	
 
 	// Preallocate maps and coefficients
-	coefficients.create(num_tris, 6);
-	map_x.create(pixel_mask.rows,pixel_mask.cols);
-	map_y.create(pixel_mask.rows,pixel_mask.cols);
+	if(warp_tables)
+	{
+		coefficients.create(num_tris, 6);
+		PrepareWarpTables();
+	}
 
 }
 
@@ -293,10 +294,9 @@ void PAW::Read(std::ifstream& stream)
 
 	CLMTracker::ReadMatBin(stream, beta);
 
-	map_x.create(pixel_mask.rows,pixel_mask.cols);
-	map_y.create(pixel_mask.rows,pixel_mask.cols);
-
 	coefficients.create(this->NumberOfTriangles(),6);
+
+	PrepareWarpTables();
 	
 	source_landmarks = destination_landmarks;
 }
@@ -320,13 +320,94 @@ void PAW::Warp(const Mat& image_to_warp, Mat& destination_image, const Mat_<doub
   
 }
 
+// Bi-linear sampling of an 8-bit image, with pixels outside the image treated as 0 (as with remap)
+static inline double SampleBilinear(const Mat_<uchar>& image, double xs, double ys)
+{
+	int x0 = cvFloor(xs);
+	int y0 = cvFloor(ys);
+
+	double fx = xs - x0;
+	double fy = ys - y0;
+
+	double v00, v01, v10, v11;
+
+	if(x0 >= 0 && y0 >= 0 && x0 < image.cols - 1 && y0 < image.rows - 1)
+	{
+		// The most common case, all four neighbours are inside the image
+		const uchar* r0 = image.ptr<uchar>(y0) + x0;
+		const uchar* r1 = r0 + image.step[0];
+		v00 = r0[0]; v01 = r0[1];
+		v10 = r1[0]; v11 = r1[1];
+	}
+	else
+	{
+		bool x0_in = x0 >= 0 && x0 < image.cols;
+		bool x1_in = x0 + 1 >= 0 && x0 + 1 < image.cols;
+		bool y0_in = y0 >= 0 && y0 < image.rows;
+		bool y1_in = y0 + 1 >= 0 && y0 + 1 < image.rows;
+
+		v00 = (y0_in && x0_in) ? image(y0, x0) : 0;
+		v01 = (y0_in && x1_in) ? image(y0, x0 + 1) : 0;
+		v10 = (y1_in && x0_in) ? image(y0 + 1, x0) : 0;
+		v11 = (y1_in && x1_in) ? image(y0 + 1, x0 + 1) : 0;
+	}
+
+	double top = v00 + (v01 - v00) * fx;
+	double bottom = v10 + (v11 - v10) * fx;
+	return top + (bottom - top) * fy;
+}
+
+//=============================================================================
+// Same as above, but bi-linearly sampling the 8-bit image directly, avoiding the conversion of the whole image to floating point
+// The affine mapping is evaluated along the triangle spans and sampled straight away, so the maps are not filled in
+void PAW::Warp(const Mat_<uchar>& image_to_warp, Mat_<double>& destination_image, const Mat_<double>& landmarks_to_warp) const
+{
+	Mat_<double> warp_coefficients;
+	this->CalcCoeff(landmarks_to_warp, warp_coefficients);
+
+	// Pixels outside of the mask are 0
+	destination_image.create(pixel_mask.rows, pixel_mask.cols);
+	destination_image.setTo(0);
+
+	for(int s = 0; s < triangle_spans.rows; ++s)
+	{
+		const int* span = triangle_spans.ptr<int>(s);
+
+		const double* a = warp_coefficients.ptr<double>(span[3]);
+		
+		double yi = double(span[0]) + min_y;
+
+		double x_base = a[0] + a[2] * yi;
+		double y_base = a[3] + a[5] * yi;
+
+		double* out = destination_image.ptr<double>(span[0]);
+
+		for(int x = span[1]; x < span[2]; ++x)
+		{
+			double xi = double(x) + min_x;
+			
+			// Keeping the float precision of the maps used by remap
+			float xs = float(x_base + a[1] * xi);
+			float ys = float(y_base + a[4] * xi);
+
+			out[x] = SampleBilinear(image_to_warp, xs, ys);
+		}
+	}
+}
 
 //=============================================================================
 // Calculate the warping coefficients
 void PAW::CalcCoeff()
+{
+	CalcCoeff(source_landmarks, coefficients);
+}
+
+void PAW::CalcCoeff(const Mat_<double>& landmarks, Mat_<double>& coeffs) const
 {
 	int p = this->NumberOfLandmarks();
 
+	coeffs.create(this->NumberOfTriangles(), 6);
+
 	for(int l = 0; l < this->NumberOfTriangles(); l++)
 	{
 	  
@@ -334,19 +415,19 @@ void PAW::CalcCoeff()
 		int j = triangulation.at<int>(l,1);
 		int k = triangulation.at<int>(l,2);
 
-		double c1 = source_landmarks.at<double>(i    , 0);
-		double c2 = source_landmarks.at<double>(j    , 0) - c1;
-		double c3 = source_landmarks.at<double>(k    , 0) - c1;
-		double c4 = source_landmarks.at<double>(i + p, 0);
-		double c5 = source_landmarks.at<double>(j + p, 0) - c4;
-		double c6 = source_landmarks.at<double>(k + p, 0) - c4;
+		double c1 = landmarks.at<double>(i    , 0);
+		double c2 = landmarks.at<double>(j    , 0) - c1;
+		double c3 = landmarks.at<double>(k    , 0) - c1;
+		double c4 = landmarks.at<double>(i + p, 0);
+		double c5 = landmarks.at<double>(j + p, 0) - c4;
+		double c6 = landmarks.at<double>(k + p, 0) - c4;
 
 		// Get a pointer to the coefficient we will be precomputing
-		double *coeff = coefficients.ptr<double>(l);
+		double *coeff = coeffs.ptr<double>(l);
 
 		// Extract the relevant alphas and betas
-		double *c_alpha = alpha.ptr<double>(l);
-		double *c_beta  = beta.ptr<double>(l);
+		const double *c_alpha = alpha.ptr<double>(l);
+		const double *c_beta  = beta.ptr<double>(l);
 
 		coeff[0] = c1 + c2 * c_alpha[0] + c3 * c_beta[0];
 		coeff[1] =      c2 * c_alpha[1] + c3 * c_beta[1];
@@ -361,66 +442,73 @@ void PAW::CalcCoeff()
 // Compute the mapping coefficients
 void PAW::WarpRegion(Mat_<float>& mapx, Mat_<float>& mapy)
 {
-	
-	cv::MatIterator_<float> xp = mapx.begin();
-	cv::MatIterator_<float> yp = mapy.begin();
-	cv::MatIterator_<uchar> mp = pixel_mask.begin();
-	cv::MatIterator_<int>   tp = triangle_id.begin();
-	
-	// The coefficients corresponding to the current triangle
-	double * a;
+	// Every span lies in a single triangle, so the source location is an affine function of x along it
+	for(int s = 0; s < triangle_spans.rows; ++s)
+	{
+		const int* span = triangle_spans.ptr<int>(s);
+
+		const double* a = coefficients.ptr<double>(span[3]);
+		
+		double yi = double(span[0]) + min_y;
 
-	// Current triangle being processed	
-	int k=-1;
+		// The parts of the affine transform that are constant along the row
+		double x_base = a[0] + a[2] * yi;
+		double y_base = a[3] + a[5] * yi;
+		double x_step = a[1];
+		double y_step = a[4];
 
-	for(int y = 0; y < pixel_mask.rows; y++)
-	{
-		double yi = double(y) + min_y;
-	
-		for(int x = 0; x < pixel_mask.cols; x++)
+		float* xp = mapx.ptr<float>(span[0]);
+		float* yp = mapy.ptr<float>(span[0]);
+
+		for(int x = span[1]; x < span[2]; ++x)
 		{
 			double xi = double(x) + min_x;
+			xp[x] = float(x_base + x_step * xi);
+			yp[x] = float(y_base + y_step * xi);
+		}
+	}
+}
+
+//======================================================================
+// Find the runs of pixels belonging to the same triangle and prepare the maps (with everything outside the mask mapping outside of the image)
+void PAW::PrepareWarpTables()
+{
+	vector<Vec4i> spans;
 
-			if(*mp == 0)
+	for(int y = 0; y < pixel_mask.rows; y++)
+	{
+		int x = 0;
+		while(x < pixel_mask.cols)
+		{
+			if(pixel_mask(y, x) == 0)
 			{
-				*xp = -1;
-				*yp = -1;
+				x++;
+				continue;
 			}
-			else
-			{
-				// triangle corresponding to the current pixel
-				int j = *tp;
-
-				// If it is different from the previous triangle point to new coefficients
-				// This will always be the case in the first iteration, hence a will not point to nothing
-				if(j != k)
-				{
-					// Update the coefficient pointer if a new triangle is being processed
-					a = coefficients.ptr<double>(j);			
-					k = j;
-				}  	
-
-				//ap is now the pointer to the coefficients
-				double *ap = a;							
-
-				//look at the first coefficient (and increment). first coefficient is an x offset
-				double xo = *ap++;						
-				//second coefficient is an x scale as a function of x
-				xo += *ap++ * xi;						
-				//third coefficient ap(2) is an x scale as a function of y
-				*xp = float(xo + *ap++ * yi);			
-
-				//then fourth coefficient ap(3) is a y offset
-				double yo = *ap++;						
-				//fifth coeff adds coeff[4]*x to y
-				yo += *ap++ * xi;						
-				//final coeff adds coeff[5]*y to y
-				*yp = float(yo + *ap++ * yi);			
 
+			int tri = triangle_id(y, x);
+			int start = x;
+			while(x < pixel_mask.cols && pixel_mask(y, x) != 0 && triangle_id(y, x) == tri)
+			{
+				x++;
 			}
-			mp++; tp++; xp++; yp++;	
+			spans.push_back(Vec4i(y, start, x, tri));
 		}
 	}
+
+	triangle_spans.create((int)spans.size(), 4);
+	for(size_t i = 0; i < spans.size(); ++i)
+	{
+		for(int k = 0; k < 4; ++k)
+		{
+			triangle_spans((int)i, k) = spans[i][k];
+		}
+	}
+
+	map_x.create(pixel_mask.rows, pixel_mask.cols);
+	map_y.create(pixel_mask.rows, pixel_mask.cols);
+	map_x.setTo(-1);
+	map_y.setTo(-1);
 }
 
 // ============================================================
@@ -50,11 +50,126 @@
 
 #include "Patch_experts.h"
 #include "CLM_utils.h"
+#include "Profiler.h"
 
 using namespace cv;
 
 using namespace CLMTracker;
 
+// Extracts the areas of interest around all of the landmarks into a single contiguous buffer (areas[i] point into it), and the depth areas of interest if depth is provided.
+// The sampling follows cvGetQuadrangleSubPix (bi-linear, borders replicated), all the areas share the rotation and scale of the similarity transform [a1 -b1; b1 a1]
+// and differ only in their centers. Depth samples that interpolate any missing (0) depth value are set to 0. Areas with an empty size are skipped
+static void ExtractAreasOfInterest(const Mat_<uchar>& grayscale_image, const Mat_<float>& depth_image, float a1, float b1, const Mat_<double>& landmark_locations,
+								   const vector<Size>& sizes, Mat_<float>& buffer, Mat_<float>& depth_buffer, vector<Mat_<float> >& areas, vector<Mat_<float> >& depth_areas)
+{
+	int n = (int)sizes.size();
+	bool use_depth = !depth_image.empty();
+
+	int total = 0;
+	for(int i = 0; i < n; ++i)
+	{
+		total += sizes[i].area();
+	}
+
+	buffer.create(1, std::max(total, 1));
+	areas.resize(n);
+	if(use_depth)
+	{
+		depth_buffer.create(1, std::max(total, 1));
+		depth_areas.resize(n);
+	}
+
+	int max_x = grayscale_image.cols - 1;
+	int max_y = grayscale_image.rows - 1;
+
+	int offset = 0;
+	for(int i = 0; i < n; ++i)
+	{
+		int width = sizes[i].width;
+		int height = sizes[i].height;
+
+		if(width * height == 0)
+		{
+			areas[i] = Mat_<float>();
+			continue;
+		}
+
+		areas[i] = Mat_<float>(height, width, buffer.ptr<float>(0) + offset);
+		if(use_depth)
+		{
+			depth_areas[i] = Mat_<float>(height, width, depth_buffer.ptr<float>(0) + offset);
+		}
+		offset += width * height;
+
+		float cx = (width - 1) * 0.5f;
+		float cy = (height - 1) * 0.5f;
+
+		float center_x = (float)landmark_locations.at<double>(i, 0);
+		float center_y = (float)landmark_locations.at<double>(i + n, 0);
+
+		for(int r = 0; r < height; ++r)
+		{
+			float* out = areas[i].ptr<float>(r);
+			float* out_depth = use_depth ? depth_areas[i].ptr<float>(r) : 0;
+
+			float dy = r - cy;
+
+			// Location of the first sample in the row, the rest follow along the same direction
+			float row_x = -a1 * cx - b1 * dy + center_x;
+			float row_y = -b1 * cx + a1 * dy + center_y;
+
+			for(int c = 0; c < width; ++c)
+			{
+				float xs = row_x + a1 * c;
+				float ys = row_y + b1 * c;
+
+				int x0 = cvFloor(xs);
+				int y0 = cvFloor(ys);
+
+				float fx = xs - x0;
+				float fy = ys - y0;
+
+				int x1 = x0 + 1;
+				int y1 = y0 + 1;
+
+				// Replicate the borders
+				if(x0 < 0 || y0 < 0 || x1 > max_x || y1 > max_y)
+				{
+					x1 = std::min(std::max(x1, 0), max_x);
+					y1 = std::min(std::max(y1, 0), max_y);
+					x0 = std::min(std::max(x0, 0), max_x);
+					y0 = std::min(std::max(y0, 0), max_y);
+				}
+
+				float w00 = (1 - fx) * (1 - fy);
+				float w01 = fx * (1 - fy);
+				float w10 = (1 - fx) * fy;
+				float w11 = fx * fy;
+
+				const uchar* i0 = grayscale_image.ptr<uchar>(y0);
+				const uchar* i1 = grayscale_image.ptr<uchar>(y1);
+
+				out[c] = w00 * i0[x0] + w01 * i0[x1] + w10 * i1[x0] + w11 * i1[x1];
+
+				if(use_depth)
+				{
+					const float* d0 = depth_image.ptr<float>(y0);
+					const float* d1 = depth_image.ptr<float>(y1);
+
+					float d00 = d0[x0];
+					float d01 = d0[x1];
+					float d10 = d1[x0];
+					float d11 = d1[x1];
+
+					// How much of the sample comes from valid depth
+					float valid = (d00 > 0 ? w00 : 0) + (d01 > 0 ? w01 : 0) + (d10 > 0 ? w10 : 0) + (d11 > 0 ? w11 : 0);
+
+					out_depth[c] = valid < 1 ? 0 : (w00 * d00 + w01 * d01 + w10 * d10 + w11 * d11);
+				}
+			}
+		}
+	}
+}
 
 // Returns the patch expert responses given a grayscale and an optional depth image.
 // Additionally returns the transform from the image coordinates to the response coordinates (and vice versa).
@@ -63,6 +178,7 @@ using namespace CLMTracker;
 void Patch_experts::Response(vector<cv::Mat_<float> >& patch_expert_responses, Matx22f& sim_ref_to_img, Matx22d& sim_img_to_ref, const Mat_<uchar>& grayscale_image, const Mat_<float>& depth_image,
 							 const PDM& pdm, const Vec6d& params_global, const Mat_<double>& params_local, int window_size, int scale)
 {
+	CLM_PROFILE_SCOPE("patch_response");
 
 	int view_id = GetViewIdx(params_global, scale);		
 
@@ -96,44 +212,45 @@ void Patch_experts::Response(vector<cv::Mat_<float> >& patch_expert_responses, M
 	sim_ref_to_img(1,0) = (float)sim_ref_to_img_d(1,0);
 	sim_ref_to_img(1,1) = (float)sim_ref_to_img_d(1,1);
 
-	// Indicates the legal pixels in a depth image, if available (used for CLM-Z area of interest (window) interpolation)
-	Mat_<uchar> mask;
-	if(!depth_image.empty())
-	{
-		mask = depth_image > 0;			
-		mask = mask / 255;
-	}		
-	
+	// Are depth responses computed as well (CLM-Z)
+	bool use_depth = !svr_expert_depth.empty() && !depth_image.empty();
 
 	bool use_ccnf = !this->ccnf_expert_intensity.empty();
 
-	// If using CCNF patch experts might need to precalculate Sigmas
+	// If using CCNF patch experts the Sigmas need to be available (this only computes them if a new window size is used)
+	int sigma_index = -1;
 	if(use_ccnf)
 	{
-		vector<Mat_<float> > sigma_components;
-
-		// Retrieve the correct sigma component size
-		for( size_t w_size = 0; w_size < this->sigma_components.size(); ++w_size)
-		{
-			if(window_size*window_size == this->sigma_components[w_size][0].rows)
-			{
-				sigma_components = this->sigma_components[w_size];
-			}
-		}			
+		PrecomputeSigmas(vector<int>(1, window_size));
+		sigma_index = SigmaIndex(window_size);
+	}
 
-		// Go through all of the landmarks and compute the Sigma for each
-		for( int lmark = 0; lmark < n; lmark++)
+	// Work out how big the area of interest has to be to get a response of window size (empty for landmarks that are not visible)
+	vector<Size> area_of_interest_sizes(n);
+	if(visibilities[scale][view_id].rows == n)
+	{
+		for(int i = 0; i < n; i++)
 		{
-			// Only for visible landmarks
-			if(visibilities[scale][view_id].at<int>(lmark,0))
+			if(visibilities[scale][view_id].at<int>(i,0) != 0)
 			{
-				// Precompute sigmas if they are not computed yet
-				ccnf_expert_intensity[scale][view_id][lmark].ComputeSigmas(sigma_components, window_size);
+				if(use_ccnf)
+				{
+					area_of_interest_sizes[i] = Size(window_size + ccnf_expert_intensity[scale][view_id][i].width - 1, window_size + ccnf_expert_intensity[scale][view_id][i].height - 1);
+				}
+				else
+				{
+					area_of_interest_sizes[i] = Size(window_size + svr_expert_intensity[scale][view_id][i].width - 1, window_size + svr_expert_intensity[scale][view_id][i].height - 1);
+				}
 			}
 		}
-
 	}
 
+	// Extract the areas of interest around all of the landmarks at once (intensity and depth if it's used)
+	Mat_<float> areas_buffer, depth_areas_buffer;
+	vector<Mat_<float> > areas_of_interest, depth_areas_of_interest;
+	ExtractAreasOfInterest(grayscale_image, use_depth ? depth_image : Mat_<float>(), (float)a1, (float)b1, landmark_locations, area_of_interest_sizes,
+		areas_buffer, depth_areas_buffer, areas_of_interest, depth_areas_of_interest);
+
 	// calculate the patch responses for every landmark, Actual work happens here. If openMP is turned on it is possible to do this in parallel,
 	// this might work well on some machines, while potentially have an adverse effect on others
 #ifdef _OPENMP
@@ -147,34 +264,8 @@ void Patch_experts::Response(vector<cv::Mat_<float> >& patch_expert_responses, M
 		{
 			if(visibilities[scale][view_id].at<int>(i,0) != 0)
 			{
+				Mat_<float>& area_of_interest = areas_of_interest[i];
 
-				// Work out how big the area of interest has to be to get a response of window size
-				int area_of_interest_width;
-				int area_of_interest_height;
-
-				if(use_ccnf)
-				{
-					area_of_interest_width = window_size + ccnf_expert_intensity[scale][view_id][i].width - 1; 
-					area_of_interest_height = window_size + ccnf_expert_intensity[scale][view_id][i].height - 1;				
-				}
-				else
-				{
-					area_of_interest_width = window_size + svr_expert_intensity[scale][view_id][i].width - 1; 
-					area_of_interest_height = window_size + svr_expert_intensity[scale][view_id][i].height - 1;
-				}
-			
-				// scale and rotate to mean shape to reference frame
-				Mat sim = (Mat_<float>(2,3) << a1, -b1, landmark_locations.at<double>(i,0), b1, a1, landmark_locations.at<double>(i+n,0));
-
-				// Extract the region of interest around the current landmark location
-				Mat_<float> area_of_interest(area_of_interest_height, area_of_interest_width);
-
-				// Using C style openCV as it does what we need
-				CvMat area_of_interest_o = area_of_interest;
-				CvMat sim_o = sim;
-				IplImage im_o = grayscale_image;			
-				cvGetQuadrangleSubPix(&im_o, &area_of_interest_o, &sim_o);
-			
 				// get the correct size response window			
 				patch_expert_responses[i] = Mat_<float>(window_size, window_size);
 
@@ -182,7 +273,8 @@ void Patch_experts::Response(vector<cv::Mat_<float> >& patch_expert_responses, M
 				if(!ccnf_expert_intensity.empty())
 				{				
 
-					ccnf_expert_intensity[scale][view_id][i].Response(area_of_interest, patch_expert_responses[i]);
+					CCNF_patch_expert& expert = ccnf_expert_intensity[scale][view_id][i];
+					expert.Response(area_of_interest, patch_expert_responses[i], expert.Sigmas[sigma_index]);
 				}
 				else
 				{
@@ -190,27 +282,12 @@ void Patch_experts::Response(vector<cv::Mat_<float> >& patch_expert_responses, M
 				}
 			
 				// if we have a corresponding depth patch and it is visible		
-				if(!svr_expert_depth.empty() && !depth_image.empty() && visibilities[scale][view_id].at<int>(i,0))
+				if(use_depth && visibilities[scale][view_id].at<int>(i,0))
 				{
 
-					Mat_<float> dProb = patch_expert_responses[i].clone();
-					Mat_<float> depthWindow(area_of_interest_height, area_of_interest_width);
-			
-
-					CvMat dimg_o = depthWindow;
-					Mat maskWindow(area_of_interest_height, area_of_interest_width, CV_32F);
-					CvMat mimg_o = maskWindow;
-
-					IplImage d_o = depth_image;
-					IplImage m_o = mask;
-
-					cvGetQuadrangleSubPix(&d_o,&dimg_o,&sim_o);
-				
-					cvGetQuadrangleSubPix(&m_o,&mimg_o,&sim_o);
-
-					depthWindow.setTo(0, maskWindow < 1);
+					Mat_<float> dProb(window_size, window_size);
 
-					svr_expert_depth[scale][view_id][i].ResponseDepth(depthWindow, dProb);
+					svr_expert_depth[scale][view_id][i].ResponseDepth(depth_areas_of_interest[i], dProb);
 							
 					// Sum to one
 					double sum = cv::sum(patch_expert_responses[i])[0];
@@ -221,7 +298,7 @@ void Patch_experts::Response(vector<cv::Mat_<float> >& patch_expert_responses, M
 						sum = 1;
 					}
 
-					patch_expert_responses[i] /= sum;
+					patch_expert_responses[i] *= 1.0 / sum;
 
 					// Sum to one
 					sum = cv::sum(dProb)[0];
@@ -231,9 +308,8 @@ void Patch_experts::Response(vector<cv::Mat_<float> >& patch_expert_responses, M
 						sum = 1;
 					}
 
-					dProb /= sum;
-
-					patch_expert_responses[i] = patch_expert_responses[i] + dProb;
+					// Add the normalised depth response in place
+					cv::scaleAdd(dProb, 1.0 / sum, patch_expert_responses[i], patch_expert_responses[i]);
 
 				}
 			}
@@ -243,6 +319,67 @@ void Patch_experts::Response(vector<cv::Mat_<float> >& patch_expert_responses, M
 
 }
 
+//=============================================================================
+int Patch_experts::SigmaIndex(int window_size) const
+{
+	for(size_t i = 0; i < sigma_window_sizes.size(); ++i)
+	{
+		if(sigma_window_sizes[i] == window_size)
+		{
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+void Patch_experts::PrecomputeSigmas(const vector<int>& window_sizes)
+{
+	for(size_t w = 0; w < window_sizes.size(); ++w)
+	{
+		int window_size = window_sizes[w];
+
+		if(std::find(sigma_window_sizes.begin(), sigma_window_sizes.end(), window_size) != sigma_window_sizes.end())
+		{
+			continue;
+		}
+
+		// Retrieve the correct sigma component size
+		int components_id = -1;
+		for(size_t w_size = 0; w_size < this->sigma_components.size(); ++w_size)
+		{
+			if(!this->sigma_components[w_size].empty() && window_size*window_size == this->sigma_components[w_size][0].rows)
+			{
+				components_id = w_size;
+			}
+		}
+
+		// Without matching components the Sigma only comes from the alphas, as if the response pixels were not connected
+		vector<Mat_<float> > no_components;
+		const vector<Mat_<float> >& components = components_id == -1 ? no_components : this->sigma_components[components_id];
+
+		for(size_t scale = 0; scale < ccnf_expert_intensity.size(); ++scale)
+		{
+			for(size_t view = 0; view < ccnf_expert_intensity[scale].size(); ++view)
+			{
+				vector<CCNF_patch_expert>& experts = ccnf_expert_intensity[scale][view];
+
+				// Every landmark is independent so they can be done in parallel
+				tbb::parallel_for(0, (int)experts.size(), [&](int lmark){
+				{
+					// Invisible landmarks have no neurons and no Sigmas
+					if(!experts[lmark].neurons.empty())
+					{
+						experts[lmark].ComputeSigmas(components, window_size);
+					}
+				}
+				});
+			}
+		}
+
+		sigma_window_sizes.push_back(window_size);
+	}
+}
+
 //=============================================================================
 // Getting the closest view center based on orientation
 int Patch_experts::GetViewIdx(const Vec6d& params_global, int scale)
@@ -0,0 +1,520 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2014, University of Southern California and University of Cambridge,
+// all rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED AS IS AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY. OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Notwithstanding the license granted herein, Licensee acknowledges that certain components
+// of the Software may be covered by so-called open source software licenses (Open Source
+// Components), which means any software licenses approved as open source licenses by the
+// Open Source Initiative or any substantially similar licenses, including without limitation any
+// license that, as a condition of distribution of the software licensed under such license,
+// requires that the distributor make the software available in source code format. Licensor shall
+// provide a list of Open Source Components for a particular version of the Software upon
+// Licensees request. Licensee will comply with the applicable terms of such licenses and to
+// the extent required by the licenses covering Open Source Components, the terms of such
+// licenses will apply in lieu of the terms of this Agreement. To the extent the terms of the
+// licenses applicable to Open Source Components prohibit any of the restrictions in this
+// License Agreement with respect to such Open Source Component, such restrictions will not
+// apply to such Open Source Component. To the extent the terms of the licenses applicable to
+// Open Source Components require Licensor to make an offer to provide source code or
+// related information in connection with the Software, such offer is hereby made. Any request
+// for source code or related information should be directed to cl-face-tracker-distribution@lists.cam.ac.uk
+// Licensee acknowledges receipt of notices for the Open Source Components for the initial
+// delivery of the Software.
+
+//     * Any publications arising from the use of this software, including but
+//       not limited to academic journal and conference publications, technical
+//       reports and manuals, must cite one of the following works:
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 3D
+//       Constrained Local Model for Rigid and Non-Rigid Facial Tracking.
+//       IEEE Conference on Computer Vision and Pattern Recognition (CVPR), 2012.    
+//
+//       Tadas Baltrusaitis, Peter Robinson, and Louis-Philippe Morency. 
+//       Constrained Local Neural Fields for robust facial landmark detection in the wild.
+//       in IEEE Int. Conference on Computer Vision Workshops, 300 Faces in-the-Wild Challenge, 2013.    
+//
+///////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+
+#include "Profiler.h"
+
+#include <atomic>
+#include <limits.h>
+#include <mutex>
+
+#ifdef _MSC_VER
+#define CLM_THREAD_LOCAL __declspec(thread)
+#else
+#define CLM_THREAD_LOCAL thread_local
+#endif
+
+using namespace CLMTracker;
+
+namespace
+{
+	// Log scale histogram, 4 bins per doubling of nanoseconds (up to about 18 minutes)
+	const int HISTOGRAM_BINS = 160;
+	const int BINS_PER_OCTAVE = 4;
+
+	struct TraceEvent
+	{
+		int stage;
+		long long start_ticks;
+		long long end_ticks;
+	};
+
+	// Only ever written by the thread that owns it, so no locking is needed when recording timings and counts.
+	// A Reset from another thread only stores zeros into the atomics (a value being added may be lost), the
+	// trace events are a vector so they are guarded by their own lock (only taken when tracing)
+	struct ThreadData
+	{
+		int thread_index;
+
+		atomic<long long> calls[Profiler::MAX_STAGES];
+		atomic<long long> ticks[Profiler::MAX_STAGES];
+		atomic<long long> max_ticks[Profiler::MAX_STAGES];
+		atomic<long long> histogram[Profiler::MAX_STAGES][HISTOGRAM_BINS];
+		atomic<long long> counters[Profiler::MAX_COUNTERS];
+
+		mutex events_mutex;
+		vector<TraceEvent> events;
+
+		ThreadData(int thread_index) : thread_index(thread_index)
+		{
+			Clear();
+		}
+
+		void Clear()
+		{
+			for(int s = 0; s < Profiler::MAX_STAGES; ++s)
+			{
+				calls[s] = 0;
+				ticks[s] = 0;
+				max_ticks[s] = 0;
+				for(int b = 0; b < HISTOGRAM_BINS; ++b)
+				{
+					histogram[s][b] = 0;
+				}
+			}
+			for(int c = 0; c < Profiler::MAX_COUNTERS; ++c)
+			{
+				counters[c] = 0;
+			}
+			lock_guard<mutex> lock(events_mutex);
+			events.clear();
+		}
+	};
+
+	inline void Add(atomic<long long>& value, long long amount)
+	{
+		// Single writer, so a relaxed load and store is enough (and avoids a locked instruction)
+		value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed);
+	}
+
+	atomic<bool> profiler_enabled(false);
+	atomic<bool> trace_enabled(false);
+
+	// Guards the registration of names and threads and the per frame records
+	mutex profiler_mutex;
+	vector<string> stage_names;
+	vector<string> counter_names;
+	vector<ThreadData*> thread_data;
+
+	vector<vector<double> > frame_stage_ms;
+	vector<long long> previous_frame_ticks(Profiler::MAX_STAGES, 0);
+
+	// One slot per recording thread for the lifetime of the process, these are the executables' own threads and the
+	// pooled TBB workers (short lived threads, like the background validations, are recorded by the thread that waits on them)
+	ThreadData* GetThreadData()
+	{
+		static CLM_THREAD_LOCAL ThreadData* data = 0;
+		if(data == 0)
+		{
+			lock_guard<mutex> lock(profiler_mutex);
+			data = new ThreadData((int)thread_data.size());
+			thread_data.push_back(data);
+		}
+		return data;
+	}
+
+	double TicksToMs(long long ticks)
+	{
+		return 1000.0 * (double)ticks / cv::getTickFrequency();
+	}
+
+	int HistogramBin(long long ticks)
+	{
+		double ns = 1e9 * (double)ticks / cv::getTickFrequency();
+		if(ns <= 1.0)
+			return 0;
+		int bin = (int)(log(ns) / log(2.0) * BINS_PER_OCTAVE);
+		return bin < HISTOGRAM_BINS ? bin : HISTOGRAM_BINS - 1;
+	}
+
+	struct StageSummary
+	{
+		string name;
+		long long calls;
+		long long ticks;
+		long long max_ticks;
+		vector<long long> histogram;
+	};
+
+	// The middle of the histogram bin the percentile falls in (in ms), capped by the slowest call
+	double Percentile(const StageSummary& stage, double percentile)
+	{
+		if(stage.calls == 0)
+			return 0;
+
+		long long target = (long long)ceil(percentile * stage.calls);
+		long long cumulative = 0;
+		int b = 0;
+		for(; b < HISTOGRAM_BINS - 1; ++b)
+		{
+			cumulative += stage.histogram[b];
+			if(cumulative >= target)
+				break;
+		}
+		return min(pow(2.0, (b + 0.5) / BINS_PER_OCTAVE) / 1e6, TicksToMs(stage.max_ticks));
+	}
+
+	// Combines the per thread records, expects the profiler mutex to be held
+	void Summarise(vector<StageSummary>& stages, vector<long long>& counts)
+	{
+		stages.resize(stage_names.size());
+		for(size_t s = 0; s < stage_names.size(); ++s)
+		{
+			stages[s].name = stage_names[s];
+			stages[s].calls = 0;
+			stages[s].ticks = 0;
+			stages[s].max_ticks = 0;
+			stages[s].histogram.assign(HISTOGRAM_BINS, 0);
+
+			for(size_t t = 0; t < thread_data.size(); ++t)
+			{
+				stages[s].calls += thread_data[t]->calls[s];
+				stages[s].ticks += thread_data[t]->ticks[s];
+				stages[s].max_ticks = max(stages[s].max_ticks, thread_data[t]->max_ticks[s].load());
+				for(int b = 0; b < HISTOGRAM_BINS; ++b)
+				{
+					stages[s].histogram[b] += thread_data[t]->histogram[s][b];
+				}
+			}
+		}
+
+		counts.assign(counter_names.size(), 0);
+		for(size_t c = 0; c < counter_names.size(); ++c)
+		{
+			for(size_t t = 0; t < thread_data.size(); ++t)
+			{
+				counts[c] += thread_data[t]->counters[c];
+			}
+		}
+	}
+
+	string Escape(const string& name)
+	{
+		string escaped;
+		for(size_t i = 0; i < name.size(); ++i)
+		{
+			if(name[i] == '"' || name[i] == '\\')
+				escaped.push_back('\\');
+			escaped.push_back(name[i]);
+		}
+		return escaped;
+	}
+}
+
+//===========================================================================
+void Profiler::Enable(bool trace_events)
+{
+	trace_enabled = trace_events;
+	profiler_enabled = true;
+}
+
+void Profiler::Disable()
+{
+	profiler_enabled = false;
+	trace_enabled = false;
+}
+
+void Profiler::Configure(const string& json_location, const string& trace_location)
+{
+	if(!json_location.empty() || !trace_location.empty())
+	{
+		Enable(!trace_location.empty());
+	}
+}
+
+bool Profiler::IsEnabled()
+{
+	return profiler_enabled.load(memory_order_relaxed);
+}
+
+int Profiler::RegisterStage(const char* name)
+{
+	lock_guard<mutex> lock(profiler_mutex);
+	for(size_t i = 0; i < stage_names.size(); ++i)
+	{
+		if(stage_names[i].compare(name) == 0)
+			return (int)i;
+	}
+	if((int)stage_names.size() == MAX_STAGES)
+	{
+		cout << "Too many profiler stages, " << name << " will not be timed" << endl;
+		return -1;
+	}
+	stage_names.push_back(name);
+	return (int)stage_names.size() - 1;
+}
+
+int Profiler::RegisterCounter(const char* name)
+{
+	lock_guard<mutex> lock(profiler_mutex);
+	for(size_t i = 0; i < counter_names.size(); ++i)
+	{
+		if(counter_names[i].compare(name) == 0)
+			return (int)i;
+	}
+	if((int)counter_names.size() == MAX_COUNTERS)
+	{
+		cout << "Too many profiler counters, " << name << " will not be counted" << endl;
+		return -1;
+	}
+	counter_names.push_back(name);
+	return (int)counter_names.size() - 1;
+}
+
+void Profiler::Record(int stage, long long start_ticks, long long end_ticks)
+{
+	if(stage < 0 || !IsEnabled())
+		return;
+
+	ThreadData* data = GetThreadData();
+	long long ticks = end_ticks - start_ticks;
+
+	Add(data->calls[stage], 1);
+	Add(data->ticks[stage], ticks);
+	Add(data->histogram[stage][HistogramBin(ticks)], 1);
+	if(ticks > data->max_ticks[stage].load(memory_order_relaxed))
+	{
+		data->max_ticks[stage].store(ticks, memory_order_relaxed);
+	}
+
+	if(trace_enabled.load(memory_order_relaxed))
+	{
+		TraceEvent trace_event = {stage, start_ticks, end_ticks};
+		lock_guard<mutex> lock(data->events_mutex);
+		data->events.push_back(trace_event);
+	}
+}
+
+void Profiler::Count(int counter, long long amount)
+{
+	if(counter < 0 || !IsEnabled())
+		return;
+
+	Add(GetThreadData()->counters[counter], amount);
+}
+
+void Profiler::NextFrame()
+{
+	if(!IsEnabled())
+		return;
+
+	lock_guard<mutex> lock(profiler_mutex);
+
+	vector<double> frame(stage_names.size());
+	for(size_t s = 0; s < stage_names.size(); ++s)
+	{
+		long long ticks = 0;
+		for(size_t t = 0; t < thread_data.size(); ++t)
+		{
+			ticks += thread_data[t]->ticks[s];
+		}
+		frame[s] = TicksToMs(ticks - previous_frame_ticks[s]);
+		previous_frame_ticks[s] = ticks;
+	}
+	frame_stage_ms.push_back(frame);
+}
+
+void Profiler::Reset()
+{
+	lock_guard<mutex> lock(profiler_mutex);
+	for(size_t t = 0; t < thread_data.size(); ++t)
+	{
+		thread_data[t]->Clear();
+	}
+	frame_stage_ms.clear();
+	previous_frame_ticks.assign(MAX_STAGES, 0);
+}
+
+void Profiler::WriteSummary(ostream& output)
+{
+	lock_guard<mutex> lock(profiler_mutex);
+
+	vector<StageSummary> stages;
+	vector<long long> counts;
+	Summarise(stages, counts);
+
+	char line[512];
+	sprintf(line, "%-22s %9s %11s %9s %9s %9s %9s\n", "stage", "calls", "total ms", "mean ms", "p50 ms", "p99 ms", "max ms");
+	output << line;
+	for(size_t s = 0; s < stages.size(); ++s)
+	{
+		if(stages[s].calls == 0)
+			continue;
+
+		double total = TicksToMs(stages[s].ticks);
+		sprintf(line, "%-22s %9lld %11.2f %9.3f %9.3f %9.3f %9.3f\n", stages[s].name.c_str(), stages[s].calls, total, total / stages[s].calls,
+			Percentile(stages[s], 0.5), Percentile(stages[s], 0.99), TicksToMs(stages[s].max_ticks));
+		output << line;
+	}
+	for(size_t c = 0; c < counts.size(); ++c)
+	{
+		output << counter_names[c] << ": " << counts[c] << "\n";
+	}
+	output.flush();
+}
+
+bool Profiler::WriteJSON(const string& filename)
+{
+	ofstream output(filename);
+	if(!output.is_open())
+	{
+		cout << "Could not open the profile file " << filename << endl;
+		return false;
+	}
+
+	lock_guard<mutex> lock(profiler_mutex);
+
+	vector<StageSummary> stages;
+	vector<long long> counts;
+	Summarise(stages, counts);
+
+	output << "{\n\"stages\": [";
+	for(size_t s = 0; s < stages.size(); ++s)
+	{
+		double total = TicksToMs(stages[s].ticks);
+		output << (s == 0 ? "\n" : ",\n");
+		output << "{\"name\": \"" << Escape(stages[s].name) << "\", \"calls\": " << stages[s].calls << ", \"total_ms\": " << total
+			<< ", \"mean_ms\": " << (stages[s].calls > 0 ? total / stages[s].calls : 0)
+			<< ", \"p50_ms\": " << Percentile(stages[s], 0.5)
+			<< ", \"p90_ms\": " << Percentile(stages[s], 0.9)
+			<< ", \"p99_ms\": " << Percentile(stages[s], 0.99)
+			<< ", \"max_ms\": " << TicksToMs(stages[s].max_ticks) << "}";
+	}
+	output << "\n],\n\"counters\": {";
+	for(size_t c = 0; c < counts.size(); ++c)
+	{
+		output << (c == 0 ? "\n" : ",\n") << "\"" << Escape(counter_names[c]) << "\": " << counts[c];
+	}
+
+	// Per frame stage times, in the order of the stages above
+	output << "\n},\n\"frames\": [";
+	for(size_t f = 0; f < frame_stage_ms.size(); ++f)
+	{
+		output << (f == 0 ? "\n[" : ",\n[");
+		for(size_t s = 0; s < frame_stage_ms[f].size(); ++s)
+		{
+			output << (s == 0 ? "" : ", ") << frame_stage_ms[f][s];
+		}
+		output << "]";
+	}
+	output << "\n]\n}\n";
+
+	return true;
+}
+
+bool Profiler::WriteChromeTrace(const string& filename)
+{
+	ofstream output(filename);
+	if(!output.is_open())
+	{
+		cout << "Could not open the trace file " << filename << endl;
+		return false;
+	}
+
+	lock_guard<mutex> lock(profiler_mutex);
+
+	// The events are copied out as threads that are still running may add to them
+	vector<vector<TraceEvent> > thread_events(thread_data.size());
+	long long first_ticks = LLONG_MAX;
+	for(size_t t = 0; t < thread_data.size(); ++t)
+	{
+		{
+			lock_guard<mutex> events_lock(thread_data[t]->events_mutex);
+			thread_events[t] = thread_data[t]->events;
+		}
+		for(size_t e = 0; e < thread_events[t].size(); ++e)
+		{
+			first_ticks = min(first_ticks, thread_events[t][e].start_ticks);
+		}
+	}
+
+	// Complete ("X") events with microsecond timestamps
+	double us_per_tick = 1e6 / cv::getTickFrequency();
+	bool first = true;
+	output << "{\"traceEvents\": [";
+	for(size_t t = 0; t < thread_data.size(); ++t)
+	{
+		const vector<TraceEvent>& events = thread_events[t];
+		for(size_t e = 0; e < events.size(); ++e)
+		{
+			output << (first ? "\n" : ",\n");
+			output << "{\"name\": \"" << Escape(stage_names[events[e].stage]) << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread_data[t]->thread_index
+				<< ", \"ts\": " << (events[e].start_ticks - first_ticks) * us_per_tick << ", \"dur\": " << (events[e].end_ticks - events[e].start_ticks) * us_per_tick << "}";
+			first = false;
+		}
+	}
+	output << "\n],\n\"displayTimeUnit\": \"ms\"}\n";
+
+	return true;
+}
+
+void Profiler::WriteReports(const string& json_location, const string& trace_location)
+{
+	if(!IsEnabled())
+		return;
+
+	WriteSummary(cout);
+
+	if(!json_location.empty())
+	{
+		WriteJSON(json_location);
+	}
+	if(!trace_location.empty())
+	{
+		WriteChromeTrace(trace_location);
+	}
+}
+
+//===========================================================================
+ScopedTimer::ScopedTimer(int stage) : stage(stage), start_ticks(0)
+{
+	if(Profiler::IsEnabled())
+	{
+		start_ticks = cv::getTickCount();
+	}
+}
+
+ScopedTimer::~ScopedTimer()
+{
+	// Scopes that started before the profiler was enabled are not recorded
+	if(start_ticks != 0)
+	{
+		Profiler::Record(stage, start_ticks, cv::getTickCount());
+	}
+}
@@ -125,20 +125,25 @@ void SVR_patch_expert::Read(ifstream &stream)
 }
 
 //===========================================================================
-void SVR_patch_expert::Response(const Mat_<float>& area_of_interest, Mat_<float>& response)
+// The SVR response passed through a logistic regressor, 1/(1 + exp(-(r * scaling + bias))), done in place using vectorised OpenCV operations
+static void Logistic(Mat_<float>& response, double scaling, double bias)
 {
+	response.convertTo(response, CV_32F, -scaling, -bias);
+	cv::exp(response, response);
 
-	int response_height = area_of_interest.rows - weights.rows + 1;
-	int response_width = area_of_interest.cols - weights.cols + 1;
-	
-	// the patch area on which we will calculate reponses
-	cv::Mat_<float> normalised_area_of_interest;
-  
-	if(response.rows != response_height || response.cols != response_width)
+	for(int y = 0; y < response.rows; ++y)
 	{
-		response.create(response_height, response_width);
+		float* p = response.ptr<float>(y);
+		for(int x = 0; x < response.cols; ++x)
+		{
+			p[x] = 1.0f / (1.0f + p[x]);
+		}
 	}
+}
 
+//===========================================================================
+void SVR_patch_expert::ComputeFeatures(int type, const Mat_<float>& area_of_interest, Mat_<float>& features)
+{
 	// If type is raw just normalise mean and standard deviation
 	if(type == 0)
 	{
@@ -152,41 +157,51 @@ void SVR_patch_expert::Response(const Mat_<float>& area_of_interest, Mat_<float>
 		{
 			std[0] = 1;
 		}
-		normalised_area_of_interest = (area_of_interest - mean[0]) / std[0];
+
+		// (area - mean) / std in a single pass
+		area_of_interest.convertTo(features, CV_32F, 1.0 / std[0], -mean[0] / std[0]);
 	}
 	// If type is gradient, perform the image gradient computation
 	else if(type == 1)
 	{
-		Grad(area_of_interest, normalised_area_of_interest);
+		Grad(area_of_interest, features);
 	}
   	else
 	{
 		printf("ERROR(%s,%d): Unsupported patch type %d!\n", __FILE__,__LINE__, type);
 		abort();
 	}
-	
-	Mat_<float> svr_response;
+}
 
-	// The empty matrix as we don't pass precomputed dft's of image
-	Mat_<double> empty_matrix_0(0,0,0.0);
-	Mat_<float> empty_matrix_1(0,0,0.0);
-	Mat_<float> empty_matrix_2(0,0,0.0);
+//===========================================================================
+void SVR_patch_expert::ResponseFromFeatures(const Mat_<float>& features, Mat_<double>& features_dft, Mat& integral_img, Mat& integral_img_sq, Mat_<float>& response)
+{
+	int response_height = features.rows - weights.rows + 1;
+	int response_width = features.cols - weights.cols + 1;
+
+	if(response.rows != response_height || response.cols != response_width)
+	{
+		response.create(response_height, response_width);
+	}
 
 	// Efficient calc of patch expert SVR response across the area of interest
-	matchTemplate_m(normalised_area_of_interest, empty_matrix_0, empty_matrix_1, empty_matrix_2, weights, weights_dfts, svr_response, CV_TM_CCOEFF_NORMED); 
+	matchTemplate_m(features, features_dft, integral_img, integral_img_sq, weights, weights_dfts, response, CV_TM_CCOEFF_NORMED); 
 	
-	response.create(svr_response.size());
-	MatIterator_<float> p = response.begin();
+	Logistic(response, scaling, bias);
+}
 
-	cv::MatIterator_<float> q1 = svr_response.begin(); // respone for each pixel
-	cv::MatIterator_<float> q2 = svr_response.end();
+//===========================================================================
+void SVR_patch_expert::Response(const Mat_<float>& area_of_interest, Mat_<float>& response)
+{
+	// the patch area on which we will calculate reponses
+	cv::Mat_<float> normalised_area_of_interest;
+	ComputeFeatures(type, area_of_interest, normalised_area_of_interest);
 
-	while(q1 != q2)
-	{
-		// the SVR response passed into logistic regressor
-		*p++ = 1.0/(1.0 + exp( -(*q1++ * scaling + bias )));
-	}
+	// The empty matrices as we don't pass precomputed dft's or integral images of the area
+	Mat_<double> features_dft;
+	Mat integral_img, integral_img_sq;
 
+	ResponseFromFeatures(normalised_area_of_interest, features_dft, integral_img, integral_img_sq, response);
 }
 
 void SVR_patch_expert::ResponseDepth(const Mat_<float>& area_of_interest, cv::Mat_<float> &response)
@@ -231,28 +246,14 @@ void SVR_patch_expert::ResponseDepth(const Mat_<float>& area_of_interest, cv::Ma
 		abort();
 	}
   
-	Mat_<float> svr_response;
-		
-	// The empty matrix as we don't pass precomputed dft's of image
+	// The empty matrices as we don't pass precomputed dft's or integral images of the area
 	Mat_<double> empty_matrix_0(0,0,0.0);
-	Mat_<float> empty_matrix_1(0,0,0.0);
-	Mat_<float> empty_matrix_2(0,0,0.0);
+	Mat empty_matrix_1, empty_matrix_2;
 
 	// Efficient calc of patch expert response across the area of interest
-
-	matchTemplate_m(normalised_area_of_interest, empty_matrix_0, empty_matrix_1, empty_matrix_2, weights, weights_dfts, svr_response, CV_TM_CCOEFF); 
+	matchTemplate_m(normalised_area_of_interest, empty_matrix_0, empty_matrix_1, empty_matrix_2, weights, weights_dfts, response, CV_TM_CCOEFF); 
 	
-	response.create(svr_response.size());
-	MatIterator_<float> p = response.begin();
-
-	cv::MatIterator_<float> q1 = svr_response.begin(); // respone for each pixel
-	cv::MatIterator_<float> q2 = svr_response.end();
-
-	while(q1 != q2)
-	{
-		// the SVR response passed through a logistic regressor
-		*p++ = 1.0/(1.0 + exp( -(*q1++ * scaling + bias )));
-	}	
+	Logistic(response, scaling, bias);
 }
 
 //===========================================================================
@@ -298,10 +299,30 @@ void Multi_SVR_patch_expert::Response(const Mat_<float> &area_of_interest, Mat_<
 		
 		Mat_<float> modality_resp(response_height, response_width);
 
+		// The features (and their dft and integral images) are computed once per type and shared between the patch experts
+		// (0 - raw, 1 - gradient)
+		Mat_<float> features[2];
+		Mat_<double> features_dft[2];
+		Mat integral_img[2];
+		Mat integral_img_sq[2];
+
 		for(size_t i = 0; i < svr_patch_experts.size(); i++)
 		{			
-			svr_patch_experts[i].Response(area_of_interest, modality_resp);			
-			response = response.mul(modality_resp);	
+			int type = svr_patch_experts[i].type;
+
+			if(type < 0 || type > 1)
+			{
+				printf("ERROR(%s,%d): Unsupported patch type %d!\n", __FILE__,__LINE__, type);
+				abort();
+			}
+
+			if(features[type].empty())
+			{
+				SVR_patch_expert::ComputeFeatures(type, area_of_interest, features[type]);
+			}
+
+			svr_patch_experts[i].ResponseFromFeatures(features[type], features_dft[type], integral_img[type], integral_img_sq[type], modality_resp);
+			cv::multiply(response, modality_resp, response);
 		}	
 		
 	}
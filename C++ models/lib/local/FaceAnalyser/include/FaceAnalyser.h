@@ -13,6 +13,8 @@
 
 #include "CLM_core.h"
 
+#include "Face_utils.h"
+
 namespace Psyche
 {
 
@@ -25,10 +27,21 @@ public:
 
 	// Constructor from a model file (or a default one if not provided
 	// TODO scale width and height should be part of the model?
-	FaceAnalyser(vector<Vec3d> orientation_bins = vector<Vec3d>(), double scale = 0.7, int width = 112, int height = 112, std::string au_location = "AU_predictors/AU_SVM_BP4D_best.txt", std::string av_location = "AV_regressors/AV_regressors.txt", std::string tri_location = "model/tris_68_full.txt");
+	// num_bins_hog controls the resolution (and memory use) of the per-view neutral HOG histograms
+	FaceAnalyser(vector<Vec3d> orientation_bins = vector<Vec3d>(), double scale = 0.7, int width = 112, int height = 112, std::string au_location = "AU_predictors/AU_SVM_BP4D_best.txt", std::string av_location = "AV_regressors/AV_regressors.txt", std::string tri_location = "model/tris_68_full.txt", int num_bins_hog = 600);
 
 	void AddNextFrame(const cv::Mat& frame, const CLMTracker::CLM& clm, double timestamp_seconds, bool visualise = true);
 
+	// Analyses a frame from its HOG descriptor (as returned by GetLatestHOG after AddNextFrame on the same landmarks) instead of aligning the face
+	// again, the running medians and the predictions are updated as by AddNextFrame (the neutral faces are not, as there is no image)
+	void AddNextHOG(const Mat_<float>& hog_descriptor, int num_hog_rows, int num_hog_cols, const CLMTracker::PDM& pdm, const Vec6d& params_global,
+		const Mat_<double>& params_local, bool detection_success, double timestamp_seconds);
+
+	// Adds the running median histograms of another analyser (with the same models) to the ones of this analyser, as if its frames were seen
+	// after the ones of this analyser, so the analysers of the chunks of an input merged in order have the medians of the whole input.
+	// The neutral faces are kept as they are
+	void MergeMedians(const FaceAnalyser& other);
+
 	// If the features are extracted manually
 	void PredictAUs(const cv::Mat_<double>& hog_features, const cv::Mat_<double>& geom_features, const CLMTracker::CLM& clm_model);
 
@@ -66,13 +79,15 @@ public:
 
 	}
 
+	// The HOG descriptor and aligned face are the ones of the last analysed frame, with an analysis stride they are stale on the
+	// frames in between (see IsLatestHOGStale)
 	void GetLatestHOG(Mat_<double>& hog_descriptor, int& num_rows, int& num_cols);
 	void GetLatestAlignedFace(Mat& image);
 	
 	void GetLatestNeutralHOG(Mat_<double>& hog_descriptor, int& num_rows, int& num_cols);
 	void GetLatestNeutralFace(Mat& image);
 	
-	Mat_<int> FaceAnalyser::GetTriangulation();
+	Mat_<int> GetTriangulation();
 
 	Mat_<uchar> GetLatestAlignedFaceGrayscale();
 	
@@ -80,10 +95,46 @@ public:
 
 	void ExtractCurrentMedians(vector<Mat>& hog_medians, vector<Mat>& face_image_medians, vector<Vec3d>& orientations);
 
+	// The number of bytes currently held by the neutral expression histograms, the upper bound is
+	// (number of views * HOG dimensions * num_bins_hog + geometry dimensions * num_bins_geom) * sizeof(unsigned short)
+	size_t GetNeutralModelMemory() const;
+
+	// The analysis is done in single precision, this enables a comparison of every AU intensity prediction against
+	// the original double precision path (geometry, running medians and models), the largest absolute difference seen is kept
+	void SetPrecisionCheck(bool check);
+	double GetMaxPrecisionDrift() const;
+
+	// For high frame rate input only every stride-th frame is fully analysed (alignment, HOG and prediction). This is a lagged hold,
+	// not an interpolation: the frames in between do not look ahead, their AU intensities step from the output at the last analysis
+	// towards its prediction and reach it a stride later, so the output lags the analysed frames by up to a stride. An analysis is
+	// forced whenever the shape parameters move further than shape_change_threshold (in standard deviations of the PDM) from the
+	// ones at the last analysis
+	void SetAnalysisStride(int stride, double shape_change_threshold = 1.0);
+
+	// If the last call to AddNextFrame did the full analysis (otherwise the predictions are held towards the last analysis)
+	bool WasLastFrameAnalysed() const;
+
+	// If the HOG descriptor and aligned face are from an earlier frame than the last one added (it was skipped by the stride)
+	bool IsLatestHOGStale() const;
+
+	// A utility function for keeping track of approximate running medians used for AU and emotion inference using a set of histograms (the histograms are evenly spaced from min_val to max_val)
+	// Descriptor has to be a row vector
+	// TODO this duplicates some other code
+	static void UpdateRunningMedian(cv::Mat_<unsigned short>& histogram, int& hist_sum, cv::Mat_<float>& median, const cv::Mat_<float>& descriptor, bool update, int num_bins, double min_val, double max_val);
+	static void UpdateRunningMedian(cv::Mat_<unsigned short>& histogram, int& hist_sum, cv::Mat_<double>& median, const cv::Mat_<double>& descriptor, bool update, int num_bins, double min_val, double max_val);
+
 
 
 private:
 
+	// Decides if a frame is analysed (otherwise the predictions step towards the last analysis), returns true if it is
+	bool StartFrame(const CLMTracker::PDM& pdm, const Mat_<double>& params_local, double timestamp_seconds);
+
+	// The running medians and the predictions of an analysed frame from its HOG descriptor, the neutral faces are only
+	// kept if the aligned face is the one of this frame
+	void AnalyseFrame(const Mat_<float>& hog_descriptor, bool keep_neutral_face, const CLMTracker::PDM& pdm, const Vec6d& params_global,
+		const Mat_<double>& params_local, bool detection_success, double timestamp_seconds, bool visualise);
+
 	// Where the predictions are kept
 	std::vector<std::pair<std::string, double>> AU_predictions_reg;
 	std::vector<std::pair<std::string, double>> AU_predictions_reg_segmented;
@@ -95,6 +146,19 @@ private:
 	double valence_value;
 	int frames_tracking;
 
+	// Skipping frames of analysis
+	int analysis_stride;
+	double shape_change_threshold;
+	int frames_since_analysis;
+	int frames_analysed;
+	Mat_<double> params_local_analysed;
+
+	// The intensity predictions step between these on the skipped frames (from the output at the last analysis to its prediction)
+	std::vector<std::pair<std::string, double>> AU_predictions_reg_from;
+	std::vector<std::pair<std::string, double>> AU_predictions_reg_to;
+	std::vector<std::pair<std::string, double>> AU_predictions_reg_segmented_from;
+	std::vector<std::pair<std::string, double>> AU_predictions_reg_segmented_to;
+
 	// Cache of intermediate images
 	Mat_<uchar> aligned_face_grayscale;
 	Mat aligned_face;
@@ -102,21 +166,20 @@ private:
 
 	// Private members to be used for predictions
 	// The HOG descriptor of the last frame
-	Mat_<double> hog_desc_frame;
+	Mat_<float> hog_desc_frame;
 	int num_hog_rows;
 	int num_hog_cols;
 
-	// Keep a running median of the hog descriptors and a aligned images
-	Mat_<double> hog_desc_median;
-	Mat_<double> face_image_median;
+	// Keep a running median of the hog descriptors for each view
+	vector<Mat_<float> > hog_desc_median;
 
-	// Use histograms for quick (but approximate) median computation
-	// Use the same for
-	vector<Mat_<unsigned int> > hog_desc_hist;
+	// Use histograms for quick (but approximate) median computation, 16 bit counts are enough as the
+	// histograms are rescaled before they can saturate. They are only allocated once a view is seen
+	vector<Mat_<unsigned short> > hog_desc_hist;
 
-	// TODO populate this
-	vector<Mat_<unsigned int> > face_image_hist;
-	vector<int> face_image_hist_sum;
+	// The aligned face (and its HOG) closest to the neutral HOG of each view, face image histograms would be too costly
+	vector<Mat> neutral_face;
+	vector<Mat_<float> > neutral_face_hog;
 
 	vector<Vec3d> head_orientations;
 
@@ -127,11 +190,11 @@ private:
 	int view_used;
 
 	// The geometry descriptor (rigid followed by non-rigid shape parameters from CLM)
-	Mat_<double> geom_descriptor_frame;
-	Mat_<double> geom_descriptor_median;
+	Mat_<float> geom_descriptor_frame;
+	Mat_<float> geom_descriptor_median;
 	
 	int geom_hist_sum;
-	Mat_<unsigned int> geom_desc_hist;
+	Mat_<unsigned short> geom_desc_hist;
 	int num_bins_geom;
 	double min_val_geom;
 	double max_val_geom;
@@ -148,16 +211,34 @@ private:
 
 	void PredictCurrentAVs(const CLMTracker::CLM& clm);
 
+	const Mat_<float>& GetViewMedianHOG(int view) const;
+
+	void StepPredictions(std::vector<std::pair<std::string, double>>& predictions, const std::vector<std::pair<std::string, double>>& from, const std::vector<std::pair<std::string, double>>& to, double ratio);
+
+	// Comparing the single precision predictions to double precision ones
+	void UpdatePrecisionDrift(int view, const std::vector<std::pair<std::string, double>>& predictions, SVR_static_lin_regressors& static_regressors, SVR_dynamic_lin_regressors& dynamic_regressors, const Mat_<double>& geom_median_ref);
+	bool precision_check;
+	double max_precision_drift;
+
+	// The double precision descriptors and running medians, only kept up to date when checking the precision
+	Mat_<double> hog_desc_frame_ref;
+	vector<Mat_<double> > hog_desc_median_ref;
+	vector<Mat_<unsigned short> > hog_desc_hist_ref;
+	vector<int> hog_hist_sum_ref;
+
+	Mat_<double> geom_descriptor_frame_ref;
+	Mat_<double> geom_descriptor_median_ref;
+	Mat_<unsigned short> geom_desc_hist_ref;
+	int geom_hist_sum_ref;
+
+	void ResetPrecisionReference();
+
 	void ReadAU(std::string au_location);
 	void ReadAV(std::string av_location);
 
 	void ReadRegressor(std::string fname, const vector<string>& au_names);
 
-	// A utility function for keeping track of approximate running medians used for AU and emotion inference using a set of histograms (the histograms are evenly spaced from min_val to max_val)
-	// Descriptor has to be a row vector
-	// TODO this duplicates some other code
-	void UpdateRunningMedian(cv::Mat_<unsigned int>& histogram, int& hist_sum, cv::Mat_<double>& median, const cv::Mat_<double>& descriptor, bool update, int num_bins, double min_val, double max_val);
-	void ExtractMedian(cv::Mat_<unsigned int>& histogram, int hist_count, cv::Mat_<double>& median, int num_bins, double min_val, double max_val);
+	void ExtractMedian(const cv::Mat_<unsigned short>& histogram, int hist_count, cv::Mat_<double>& median, int num_bins, double min_val, double max_val) const;
 	
 	// The linear SVR regressors
 	SVR_static_lin_regressors AU_SVR_static_appearance_lin_regressors;
@@ -199,6 +280,8 @@ private:
 
 	// Used for face alignment
 	Mat_<int> triangulation;
+	Mat_<double> align_destination;
+	AlignmentMaskCache align_mask_cache;
 	double align_scale;	
 	int align_width;
 	int align_height;
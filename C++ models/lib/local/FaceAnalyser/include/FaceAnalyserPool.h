@@ -0,0 +1,61 @@
+#ifndef __FACEANALYSERPOOL_h_
+#define __FACEANALYSERPOOL_h_
+
+#include "FaceAnalyser.h"
+
+#include <string>
+#include <vector>
+
+#include <cv.h>
+
+#include "CLM_core.h"
+
+namespace Psyche
+{
+
+// A collection of face analysers, one per CLM tracker slot (as used in multiple face tracking), so AUs can be predicted per person.
+// The AU models are loaded once and shared between the slots (they are read only), only the person specific state
+// (running medians, prediction corrections) is kept per slot
+class FaceAnalyserPool{
+
+public:
+
+	// max_failures is the number of failed frames in a row after which the tracked person is assumed to have changed
+	FaceAnalyserPool(int num_slots, vector<Vec3d> orientation_bins = vector<Vec3d>(), double scale = 0.7, int width = 112, int height = 112, std::string au_location = "AU_predictors/AU_SVM_BP4D_best.txt", std::string av_location = "AV_regressors/AV_regressors.txt", std::string tri_location = "model/tris_68_full.txt", int max_failures = 4);
+
+	// Analyse every successfully tracked face in the frame in parallel, clm_models are indexed by slot
+	void AddNextFrame(const cv::Mat& frame, const std::vector<CLMTracker::CLM>& clm_models, double timestamp_seconds);
+
+	// Forget the person in a slot, the next face tracked there will start from scratch
+	void ResetSlot(int slot);
+
+	void Reset();
+
+	// Sets the analysis stride of every slot (see FaceAnalyser::SetAnalysisStride)
+	void SetAnalysisStride(int stride, double shape_change_threshold = 1.0);
+
+	// If the slot was analysed in the last call to AddNextFrame (and the analyser holds up to date predictions)
+	bool IsSlotAnalysed(int slot) const;
+
+	int GetNumSlots() const;
+
+	FaceAnalyser& GetAnalyser(int slot);
+
+	// Total memory used by the neutral expression models of all slots
+	size_t GetNeutralModelMemory() const;
+
+private:
+
+	// Per slot analysers, copies of the same prototype so the model matrices share data
+	std::vector<FaceAnalyser> analysers;
+
+	// Using int instead of bool as they are written to from different threads
+	std::vector<int> needs_reset;
+	std::vector<int> analysed;
+
+	int max_failures;
+
+};
+  //===========================================================================
+}
+#endif
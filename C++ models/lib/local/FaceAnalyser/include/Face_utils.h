@@ -15,7 +15,24 @@ namespace Psyche
 	void AlignFace(cv::Mat& aligned_face, const cv::Mat& frame, const CLMTracker::CLM& clm_model, bool rigid = true, double scale = 0.6, int width = 96, int height = 96);
 	void AlignFaceMask(cv::Mat& aligned_face, const cv::Mat& frame, const CLMTracker::CLM& clm_model, const cv::Mat_<int>& triangulation, bool rigid = true, double scale = 0.6, int width = 96, int height = 96);
 
+	// The face mask of the last masked alignment, it is only rebuilt when the aligned landmarks or the triangulation change
+	struct AlignmentMaskCache
+	{
+		cv::Mat_<double> destination_landmarks;
+		cv::Mat_<int> triangulation;
+		cv::Mat_<uchar> pixel_mask;
+	};
+
+	// The alignment destination (the scaled mean shape) can be precomputed with ComputeAlignmentDestination and reused across frames,
+	// and the mask kept across frames in a cache owned by the caller
+	void AlignFaceMask(cv::Mat& aligned_face, const cv::Mat& frame, const CLMTracker::CLM& clm_model, const cv::Mat_<int>& triangulation, const cv::Mat_<double>& alignment_destination, int width = 96, int height = 96);
+	void AlignFaceMask(cv::Mat& aligned_face, const cv::Mat& frame, const CLMTracker::CLM& clm_model, const cv::Mat_<int>& triangulation, const cv::Mat_<double>& alignment_destination,
+		AlignmentMaskCache& mask_cache, int width = 96, int height = 96);
+	void ComputeAlignmentDestination(cv::Mat_<double>& destination_points, const cv::Mat_<double>& mean_shape, bool rigid = true, double scale = 0.6);
+
 	void Extract_FHOG_descriptor(cv::Mat_<double>& descriptor, const cv::Mat& image, int& num_rows, int& num_cols, int cell_size = 8);
+	// Single precision version (FHOG is computed in floats, so no precision is lost)
+	void Extract_FHOG_descriptor(cv::Mat_<float>& descriptor, const cv::Mat& image, int& num_rows, int& num_cols, int cell_size = 8);
 
 	void Visualise_FHOG(const cv::Mat_<double>& descriptor, int num_rows, int num_cols, cv::Mat& visualisation);
 
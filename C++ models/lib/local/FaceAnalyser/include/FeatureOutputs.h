@@ -0,0 +1,56 @@
+#ifndef __FEATUREOUTPUTS_h_
+#define __FEATUREOUTPUTS_h_
+
+#include "FaceAnalyser.h"
+
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <cv.h>
+
+#include "CLM_core.h"
+
+namespace Psyche
+{
+	//===========================================================================
+	// The per frame outputs of the feature extraction, shared by FeatureExtraction and clm_batch so that both write the same files
+
+	// Writes the HOG descriptor of a frame to a .hog file, the number of columns, rows and channels (31 for FHOG), 1 or -1 for a
+	// successful or a failed frame and then the descriptor values, all as 4 byte values
+	void WriteHOGFrame(std::ofstream& hog_file, bool good_frame, const cv::Mat_<double>& hog_descriptor, int num_rows, int num_cols);
+
+	// The similarity aligned face and its HOG descriptor of a tracked frame. When the AUs are analysed they come from the analyser (so the
+	// frame updates its running medians), otherwise the face is aligned and its descriptor extracted directly
+	void ExtractAlignedFeatures(cv::Mat& sim_warped_img, cv::Mat_<double>& hog_descriptor, int& num_hog_rows, int& num_hog_cols, const cv::Mat& captured_image,
+		const CLMTracker::CLM& clm_model, FaceAnalyser& face_analyser, bool analyse_aus, bool rigid, double sim_scale, int sim_size);
+
+	// The rows of the landmark, shape parameter and head pose outputs, the frame numbers start from 1 and the pose timestamps assume 30 fps
+	void LandmarksRow(std::vector<double>& row, int frame, bool success, const cv::Mat_<double>& detected_landmarks);
+	void ParamsRow(std::vector<double>& row, int frame, bool success, const cv::Vec6d& params_global, const cv::Mat_<double>& params_local);
+	void PoseRow(std::vector<double>& row, int frame, const cv::Vec6d& pose);
+
+	// The tracking results of the frames of an input, kept for the second AU pass
+	struct TrackedFrames
+	{
+		std::vector<cv::Vec6d> params_global;
+		std::vector<cv::Mat_<double> > params_local;
+		std::vector<cv::Mat_<double> > detected_landmarks;
+		std::vector<bool> successes;
+
+		void Add(const CLMTracker::CLM& clm_model, bool detection_success);
+	};
+
+	// Called after every frame of the second AU pass, with the frame and the model set to its tracking results
+	typedef std::function<void(cv::Mat& captured_image, const CLMTracker::CLM& clm_model)> AUFrameFunction;
+
+	// The second AU pass, the frames are read again from the (reopened) source and analysed with the tracking results of the first pass,
+	// so that the running medians of the analyser cover the whole input. A row with the success and the AU predictions is written for every
+	// frame. Returns false if the output can not be opened or written
+	bool WriteAUsSecondPass(const std::string& aus_output, CLMTracker::FrameSource& frame_source, const TrackedFrames& tracked, CLMTracker::CLM& clm_model,
+		FaceAnalyser& face_analyser, const AUFrameFunction& after_frame = AUFrameFunction());
+
+  //===========================================================================
+}
+#endif
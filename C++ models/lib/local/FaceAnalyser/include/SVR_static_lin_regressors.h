@@ -23,6 +23,9 @@ public:
 	// Predict the AU from HOG appearance of the face
 	void Predict(std::vector<double>& predictions, std::vector<std::string>& names, const cv::Mat_<double>& fhog_descriptor, const cv::Mat_<double>& geom_params);
 
+	// The same prediction in single precision
+	void Predict(std::vector<double>& predictions, std::vector<std::string>& names, const cv::Mat_<float>& fhog_descriptor, const cv::Mat_<float>& geom_params);
+
 	// Reading in the model (or adding to it)
 	void Read(std::ifstream& stream, const std::vector<std::string>& au_names);
 
@@ -38,6 +41,11 @@ private:
 	cv::Mat_<double> support_vectors;	
 	cv::Mat_<double> biases;
 
+	// Single precision copies of the above
+	cv::Mat_<float> means_f;
+	cv::Mat_<float> support_vectors_f;
+	cv::Mat_<float> biases_f;
+
 };
   //===========================================================================
 }
@@ -5,6 +5,7 @@
 #include "CLM_core.h"
 
 #include <stdio.h>
+#include <limits.h>
 #include <iostream>
 
 #include <string>
@@ -19,7 +20,7 @@ using namespace Psyche;
 using namespace std;
 
 // Constructor from a model file (or a default one if not provided
-FaceAnalyser::FaceAnalyser(vector<Vec3d> orientation_bins, double scale, int width, int height, std::string au_location, std::string av_location, std::string tri_location)
+FaceAnalyser::FaceAnalyser(vector<Vec3d> orientation_bins, double scale, int width, int height, std::string au_location, std::string av_location, std::string tri_location, int num_bins_hog)
 {
 	this->ReadAU(au_location);
 	this->ReadAV(av_location);
@@ -30,7 +31,7 @@ FaceAnalyser::FaceAnalyser(vector<Vec3d> orientation_bins, double scale, int wid
 
 	// Initialise the histograms that will represent bins from 0 - 1 (as HoG values are only stored as those)
 	// Set the number of bins for the histograms
-	num_bins_hog = 600;
+	this->num_bins_hog = num_bins_hog;
 	max_val_hog = 1;
 	min_val_hog = 0;
 
@@ -57,16 +58,30 @@ FaceAnalyser::FaceAnalyser(vector<Vec3d> orientation_bins, double scale, int wid
 	{
 		head_orientations = orientation_bins;
 	}
-	hog_hist_sum.resize(head_orientations.size());
-	face_image_hist_sum.resize(head_orientations.size());
+	hog_hist_sum.resize(head_orientations.size(), 0);
 	hog_desc_hist.resize(head_orientations.size());
+	hog_desc_median.resize(head_orientations.size());
+	neutral_face.resize(head_orientations.size());
+	neutral_face_hog.resize(head_orientations.size());
 	geom_hist_sum = 0;
-	face_image_hist.resize(head_orientations.size());
 
 	au_prediction_correction_count.resize(head_orientations.size(), 0);
 	au_prediction_correction_histogram.resize(head_orientations.size());
 	dyn_scaling.resize(head_orientations.size());
 
+	view_used = 0;
+	num_hog_rows = 0;
+	num_hog_cols = 0;
+
+	precision_check = false;
+	max_precision_drift = 0;
+	ResetPrecisionReference();
+
+	analysis_stride = 1;
+	shape_change_threshold = 1.0;
+	frames_since_analysis = 0;
+	frames_analysed = 0;
+
 	// The triangulation used for masking out the non-face parts of aligned image
 	std::ifstream triangulation_file(tri_location);	
 	CLMTracker::ReadMat(triangulation_file, triangulation);
@@ -80,7 +95,7 @@ Mat_<int> FaceAnalyser::GetTriangulation()
 
 void FaceAnalyser::GetLatestHOG(Mat_<double>& hog_descriptor, int& num_rows, int& num_cols)
 {
-	hog_descriptor = this->hog_desc_frame.clone();
+	this->hog_desc_frame.convertTo(hog_descriptor, CV_64F);
 
 	if(!hog_desc_frame.empty())
 	{
@@ -101,8 +116,8 @@ void FaceAnalyser::GetLatestAlignedFace(Mat& image)
 
 void FaceAnalyser::GetLatestNeutralHOG(Mat_<double>& hog_descriptor, int& num_rows, int& num_cols)
 {
-	hog_descriptor = this->hog_desc_median;
-	if(!hog_desc_median.empty())
+	this->hog_desc_median[view_used].convertTo(hog_descriptor, CV_64F);
+	if(!hog_descriptor.empty())
 	{
 		num_rows = this->num_hog_rows;
 		num_cols = this->num_hog_cols;
@@ -149,36 +164,48 @@ void FaceAnalyser::ExtractCurrentMedians(vector<Mat>& hog_medians, vector<Mat>&
 
 	for(size_t i = 0; i < orientations.size(); ++i)
 	{
-		Mat_<double> median_face(this->face_image_median.rows, this->face_image_median.cols, 0.0);
-		Mat_<double> median_hog(this->hog_desc_median.rows, this->hog_desc_median.cols, 0.0);
+		// Views that have not been seen yet get the median of the active view
+		int view = this->hog_desc_hist[i].empty() ? view_used : (int)i;
 
-		ExtractMedian(this->face_image_hist[i], this->face_image_hist_sum[i], median_face, 256, 0, 255);		
-		ExtractMedian(this->hog_desc_hist[i], this->hog_hist_sum[i], median_hog, this->num_bins_hog, 0, 1);
+		Mat_<double> median_hog(1, this->num_hog_rows * this->num_hog_cols * 31, 0.0);
+
+		if(!this->hog_desc_hist[view].empty())
+		{
+			ExtractMedian(this->hog_desc_hist[view], this->hog_hist_sum[view], median_hog, this->num_bins_hog, this->min_val_hog, this->max_val_hog);
+		}
 
 		// Add the HOG sample
 		hog_medians.push_back(median_hog.clone());
 
-		// For the face image need to convert it to suitable format
-		Mat_<uchar> aligned_face_cols_uchar;
-		median_face.convertTo(aligned_face_cols_uchar, CV_8U);
-
-		Mat aligned_face_uchar;
-		if(aligned_face.channels() == 1)
+		if(!this->neutral_face[view].empty())
 		{
-			aligned_face_uchar = Mat(aligned_face.rows, aligned_face.cols, CV_8U, aligned_face_cols_uchar.data);
+			face_image_medians.push_back(this->neutral_face[view].clone());
 		}
 		else
 		{
-			aligned_face_uchar = Mat(aligned_face.rows, aligned_face.cols, CV_8UC3, aligned_face_cols_uchar.data);
+			face_image_medians.push_back(Mat::zeros(aligned_face.rows, aligned_face.cols, aligned_face.type()));
 		}
-
-		face_image_medians.push_back(aligned_face_uchar.clone());
 		
 	}
 }
 
+size_t FaceAnalyser::GetNeutralModelMemory() const
+{
+	size_t num_bytes = geom_desc_hist.total() * geom_desc_hist.elemSize();
+
+	for(size_t i = 0; i < hog_desc_hist.size(); ++i)
+	{
+		num_bytes += hog_desc_hist[i].total() * hog_desc_hist[i].elemSize();
+		num_bytes += neutral_face[i].total() * neutral_face[i].elemSize();
+		num_bytes += neutral_face_hog[i].total() * neutral_face_hog[i].elemSize();
+	}
+
+	return num_bytes;
+}
+
 void FaceAnalyser::AddNextFrame(const cv::Mat& frame, const CLMTracker::CLM& clm_model, double timestamp_seconds, bool visualise)
 {
+	CLM_PROFILE_SCOPE("face_analysis");
 	// Check if a reset is needed first (TODO single person no reset)
 	//if(face_bounding_box.area() > 0)
 	//{
@@ -201,10 +228,17 @@ void FaceAnalyser::AddNextFrame(const cv::Mat& frame, const CLMTracker::CLM& clm
 	//	this->Reset();
 	//}
 
-	frames_tracking++;
+	if(!StartFrame(clm_model.pdm, clm_model.params_local, timestamp_seconds))
+	{
+		return;
+	}
 
-	// First align the face
-	AlignFaceMask(aligned_face, frame, clm_model, triangulation, true, align_scale, align_width, align_height);
+	// First align the face (the destination of alignment only depends on the PDM so is computed once)
+	if(align_destination.empty())
+	{
+		ComputeAlignmentDestination(align_destination, clm_model.pdm.mean_shape, true, align_scale);
+	}
+	AlignFaceMask(aligned_face, frame, clm_model, triangulation, align_destination, align_mask_cache, align_width, align_height);
 	
 	if(aligned_face.channels() == 3)
 	{
@@ -216,13 +250,72 @@ void FaceAnalyser::AddNextFrame(const cv::Mat& frame, const CLMTracker::CLM& clm
 	}
 
 	// Extract HOG descriptor from the frame and convert it to a useable format
-	Mat_<double> hog_descriptor;
+	Mat_<float> hog_descriptor;
 	Extract_FHOG_descriptor(hog_descriptor, aligned_face, this->num_hog_rows, this->num_hog_cols);
 
+	AnalyseFrame(hog_descriptor, true, clm_model.pdm, clm_model.params_global, clm_model.params_local, clm_model.detection_success, timestamp_seconds, visualise);
+}
+
+void FaceAnalyser::AddNextHOG(const Mat_<float>& hog_descriptor, int num_hog_rows, int num_hog_cols, const CLMTracker::PDM& pdm, const Vec6d& params_global,
+	const Mat_<double>& params_local, bool detection_success, double timestamp_seconds)
+{
+	CLM_PROFILE_SCOPE("face_analysis");
+
+	if(!StartFrame(pdm, params_local, timestamp_seconds))
+	{
+		return;
+	}
+
+	this->num_hog_rows = num_hog_rows;
+	this->num_hog_cols = num_hog_cols;
+
+	AnalyseFrame(hog_descriptor, false, pdm, params_global, params_local, detection_success, timestamp_seconds, false);
+}
+
+bool FaceAnalyser::StartFrame(const CLMTracker::PDM& pdm, const Mat_<double>& params_local, double timestamp_seconds)
+{
+	frames_tracking++;
+
+	// See if the frame needs the full analysis or if the AU predictions can just step towards the last one
+	bool analyse = frames_analysed == 0 || frames_since_analysis + 1 >= analysis_stride || params_local_analysed.rows != params_local.rows;
+
+	if(!analyse)
+	{
+		// Large changes of shape (relative to the shape variance) are likely to be expression changes
+		double shape_change = 0;
+		for(int i = 0; i < params_local.rows; ++i)
+		{
+			double diff = params_local.at<double>(i) - params_local_analysed.at<double>(i);
+			shape_change += diff * diff / pdm.eigen_values.at<double>(i);
+		}
+		analyse = sqrt(shape_change) > shape_change_threshold;
+	}
+
+	if(!analyse)
+	{
+		frames_since_analysis++;
+
+		double step = (double)(frames_since_analysis + 1) / analysis_stride;
+		StepPredictions(AU_predictions_reg, AU_predictions_reg_from, AU_predictions_reg_to, step);
+		StepPredictions(AU_predictions_reg_segmented, AU_predictions_reg_segmented_from, AU_predictions_reg_segmented_to, step);
+
+		this->current_time_seconds = timestamp_seconds;
+		return false;
+	}
+
+	frames_since_analysis = 0;
+	frames_analysed++;
+	params_local_analysed = params_local.clone();
+	return true;
+}
+
+void FaceAnalyser::AnalyseFrame(const Mat_<float>& hog_descriptor, bool keep_neutral_face, const CLMTracker::PDM& pdm, const Vec6d& params_global,
+	const Mat_<double>& params_local, bool detection_success, double timestamp_seconds, bool visualise)
+{
 	// Store the descriptor
 	hog_desc_frame = hog_descriptor;
 
-	Vec3d curr_orient(clm_model.params_global[1], clm_model.params_global[2], clm_model.params_global[3]);
+	Vec3d curr_orient(params_global[1], params_global[2], params_global[3]);
 	int orientation_to_use = GetViewId(this->head_orientations, curr_orient);
 
 	// Only update the running median if predictions are not high
@@ -241,40 +334,66 @@ void FaceAnalyser::AddNextFrame(const cv::Mat& frame, const CLMTracker::CLM& clm
 	//		}
 	//	}
 	//}
-	update_median = update_median & clm_model.detection_success;
+	update_median = update_median & detection_success;
 
-	// A small speedup
-	if(frames_tracking % 2 == 1)
+	// A small speedup, but the median of a view is always started on the frame the view is first seen in
+	bool update_hog_median = frames_analysed % 2 == 1 || this->hog_desc_hist[orientation_to_use].empty();
+
+	if(precision_check)
+	{
+		// The reference follows the original double precision path on the same (single precision) FHOG
+		hog_descriptor.convertTo(hog_desc_frame_ref, CV_64F);
+		if(update_hog_median)
+		{
+			UpdateRunningMedian(this->hog_desc_hist_ref[orientation_to_use], this->hog_hist_sum_ref[orientation_to_use], this->hog_desc_median_ref[orientation_to_use], hog_desc_frame_ref, update_median, this->num_bins_hog, this->min_val_hog, this->max_val_hog);
+		}
+	}
+
+	if(update_hog_median)
 	{
-		UpdateRunningMedian(this->hog_desc_hist[orientation_to_use], this->hog_hist_sum[orientation_to_use], this->hog_desc_median, hog_descriptor, update_median, this->num_bins_hog, this->min_val_hog, this->max_val_hog);
+		UpdateRunningMedian(this->hog_desc_hist[orientation_to_use], this->hog_hist_sum[orientation_to_use], this->hog_desc_median[orientation_to_use], hog_descriptor, update_median, this->num_bins_hog, this->min_val_hog, this->max_val_hog);
+
+		// Keep the face that is the closest to the neutral HOG of the view
+		if(update_median && keep_neutral_face)
+		{
+			const Mat_<float>& median = this->hog_desc_median[orientation_to_use];
+			if(this->neutral_face[orientation_to_use].empty() || cv::norm(hog_descriptor, median) <= cv::norm(this->neutral_face_hog[orientation_to_use], median))
+			{
+				this->neutral_face[orientation_to_use] = aligned_face.clone();
+				this->neutral_face_hog[orientation_to_use] = hog_descriptor.clone();
+			}
+		}
 	}	
 	// Geom descriptor and its median
-	geom_descriptor_frame = clm_model.params_local.t();
+	Mat_<double> geom_params = params_local.t();
 	
 	// Stack with the actual feature point locations (without mean)
-	Mat_<double> locs = clm_model.pdm.princ_comp * clm_model.params_local;
+	Mat_<double> locs = pdm.princ_comp * params_local;
 	
-	cv::hconcat(locs.t(), geom_descriptor_frame.clone(), geom_descriptor_frame);
+	cv::hconcat(locs.t(), geom_params, geom_params);
+	geom_params.convertTo(geom_descriptor_frame, CV_32F);
 	
 	// A small speedup
-	if(frames_tracking % 2 == 1)
+	if(frames_analysed % 2 == 1)
 	{
 		UpdateRunningMedian(this->geom_desc_hist, this->geom_hist_sum, this->geom_descriptor_median, geom_descriptor_frame, update_median, this->num_bins_geom, this->min_val_geom, this->max_val_geom);
+
+		if(precision_check)
+		{
+			UpdateRunningMedian(this->geom_desc_hist_ref, this->geom_hist_sum_ref, this->geom_descriptor_median_ref, geom_params, update_median, this->num_bins_geom, this->min_val_geom, this->max_val_geom);
+		}
 	}
 
-	// First convert the face image to double representation as a row vector
-	Mat_<uchar> aligned_face_cols(1, aligned_face.cols * aligned_face.rows * aligned_face.channels(), aligned_face.data, 1);
-	Mat_<double> aligned_face_cols_double;
-	aligned_face_cols.convertTo(aligned_face_cols_double, CV_64F);
-	
-	// TODO get rid of this completely?
-	//UpdateRunningMedian(this->face_image_hist[orientation_to_use], this->face_image_hist_sum[orientation_to_use], this->face_image_median, aligned_face_cols_double, update_median, 256, 0, 255);
+	if(precision_check)
+	{
+		geom_descriptor_frame_ref = geom_params;
+	}
 
 	// Visualising the median HOG
 	if(visualise)
 	{
 		Mat visualisation_new;
-		Psyche::Visualise_FHOG(hog_descriptor - this->hog_desc_median, 10, 10, visualisation_new);
+		Psyche::Visualise_FHOG(hog_descriptor - this->hog_desc_median[orientation_to_use], 10, 10, visualisation_new);
 		
 		if(!hog_descriptor_visualisation.empty())
 		{
@@ -288,12 +407,23 @@ void FaceAnalyser::AddNextFrame(const cv::Mat& frame, const CLMTracker::CLM& clm
 
 	//if(clm_model.detection_success)
 	//{
-	// Perform AU prediction
-	AU_predictions_reg = PredictCurrentAUs(orientation_to_use, false);
+	// Perform AU prediction, the intensities are moved towards the new prediction from the current output over the stride
+	// (not stepping from the predictions before a reset)
+	if(frames_analysed == 1)
+	{
+		AU_predictions_reg.clear();
+		AU_predictions_reg_segmented.clear();
+	}
+
+	AU_predictions_reg_from = AU_predictions_reg;
+	AU_predictions_reg_to = PredictCurrentAUs(orientation_to_use, false);
+	StepPredictions(AU_predictions_reg, AU_predictions_reg_from, AU_predictions_reg_to, 1.0 / analysis_stride);
 
 	AU_predictions_class = PredictCurrentAUsClass(orientation_to_use);
 
-	AU_predictions_reg_segmented = PredictCurrentAUsSegmented(orientation_to_use, false);
+	AU_predictions_reg_segmented_from = AU_predictions_reg_segmented;
+	AU_predictions_reg_segmented_to = PredictCurrentAUsSegmented(orientation_to_use, false);
+	StepPredictions(AU_predictions_reg_segmented, AU_predictions_reg_segmented_from, AU_predictions_reg_segmented_to, 1.0 / analysis_stride);
 
 	this->current_time_seconds = timestamp_seconds;
 
@@ -301,16 +431,57 @@ void FaceAnalyser::AddNextFrame(const cv::Mat& frame, const CLMTracker::CLM& clm
 
 }
 
+void FaceAnalyser::SetAnalysisStride(int stride, double shape_change_threshold)
+{
+	this->analysis_stride = stride < 1 ? 1 : stride;
+	this->shape_change_threshold = shape_change_threshold;
+}
+
+bool FaceAnalyser::WasLastFrameAnalysed() const
+{
+	return frames_since_analysis == 0;
+}
+
+bool FaceAnalyser::IsLatestHOGStale() const
+{
+	return frames_since_analysis > 0;
+}
+
+// Moves the predictions a ratio of the way from the earlier output towards the target (if there is nothing to start from the target is used),
+// only past predictions are used so this lags behind the frames rather than interpolating between analyses
+void FaceAnalyser::StepPredictions(vector<pair<string, double>>& predictions, const vector<pair<string, double>>& from, const vector<pair<string, double>>& to, double ratio)
+{
+	if(ratio >= 1 || from.size() != to.size())
+	{
+		predictions = to;
+		return;
+	}
+
+	predictions.resize(to.size());
+	for(size_t i = 0; i < to.size(); ++i)
+	{
+		predictions[i].first = to[i].first;
+		predictions[i].second = from[i].second + (to[i].second - from[i].second) * ratio;
+	}
+}
+
 void FaceAnalyser::GetGeomDescriptor(Mat_<double>& geom_desc)
 {
-	geom_desc = this->geom_descriptor_frame.clone();
+	this->geom_descriptor_frame.convertTo(geom_desc, CV_64F);
 }
 
 void FaceAnalyser::PredictAUs(const cv::Mat_<double>& hog_features, const cv::Mat_<double>& geom_features, const CLMTracker::CLM& clm_model)
 {
+	CLM_PROFILE_SCOPE("au_prediction");
 	// Store the descriptor
-	hog_desc_frame = hog_features.clone();
-	this->geom_descriptor_frame = geom_features.clone();
+	hog_features.convertTo(hog_desc_frame, CV_32F);
+	geom_features.convertTo(this->geom_descriptor_frame, CV_32F);
+
+	if(precision_check)
+	{
+		hog_desc_frame_ref = hog_features.clone();
+		geom_descriptor_frame_ref = geom_features.clone();
+	}
 
 	Vec3d curr_orient(clm_model.params_global[1], clm_model.params_global[2], clm_model.params_global[3]);
 	int orientation_to_use = GetViewId(this->head_orientations, curr_orient);
@@ -427,28 +598,29 @@ void FaceAnalyser::PredictAUs(const cv::Mat_<double>& hog_features, const cv::Ma
 void FaceAnalyser::Reset()
 {
 	frames_tracking = 0;
-
-	this->hog_desc_median.setTo(Scalar(0));
-	this->face_image_median.setTo(Scalar(0));
+	frames_since_analysis = 0;
+	frames_analysed = 0;
 
 	for( size_t i = 0; i < hog_desc_hist.size(); ++i)
 	{
-		this->hog_desc_hist[i] = Mat_<unsigned int>(hog_desc_hist[i].rows, hog_desc_hist[i].cols, (unsigned int)0);
+		// Release the histograms, they will be allocated again only for the views that are seen after the reset
+		this->hog_desc_hist[i].release();
+		this->hog_desc_median[i].release();
+		this->neutral_face[i].release();
+		this->neutral_face_hog[i].release();
 		this->hog_hist_sum[i] = 0;
 
-
-		this->face_image_hist[i] = Mat_<unsigned int>(face_image_hist[i].rows, face_image_hist[i].cols, (unsigned int)0);
-		this->face_image_hist_sum[i] = 0;
-
 		// 0 callibration predictions
 		this->au_prediction_correction_count[i] = 0;
 		this->au_prediction_correction_histogram[i] = Mat_<unsigned int>(au_prediction_correction_histogram[i].rows, au_prediction_correction_histogram[i].cols, (unsigned int)0);
 	}
 
 	this->geom_descriptor_median.setTo(Scalar(0));
-	this->geom_desc_hist = Mat_<unsigned int>(geom_desc_hist.rows, geom_desc_hist.cols, (unsigned int)0);
+	this->geom_desc_hist.release();
 	geom_hist_sum = 0;
 
+	ResetPrecisionReference();
+
 	// Reset the predictions
 	AU_prediction_track = Mat_<double>(AU_prediction_track.rows, AU_prediction_track.cols, 0.0);
 
@@ -468,7 +640,8 @@ void FaceAnalyser::ResetAV()
 {
 
 	this->geom_descriptor_median.setTo(Scalar(0));
-	this->geom_desc_hist = Mat_<unsigned int>(geom_desc_hist.rows, geom_desc_hist.cols, (unsigned int)0);
+	this->geom_desc_hist.release();
+	geom_hist_sum = 0;
 
 	// Reset the predictions
 	AU_prediction_track = Mat_<double>(AU_prediction_track.rows, AU_prediction_track.cols, 0.0);
@@ -545,9 +718,28 @@ std::string FaceAnalyser::GetCurrentCategoricalEmotion()
 	return emotion;
 }
 
-void FaceAnalyser::UpdateRunningMedian(cv::Mat_<unsigned int>& histogram, int& hist_count, cv::Mat_<double>& median, const cv::Mat_<double>& descriptor, bool update, int num_bins, double min_val, double max_val)
+// Halves the counts of a histogram with integer division (rounding would turn counts of 1 into 0 or 1 unevenly), the count of frames
+// is the one the halved histogram holds, so that the median threshold matches the counts
+template<typename C>
+int HalveHistogram(cv::Mat_<C>& histogram)
 {
+	double total = 0;
+	for(int i = 0; i < histogram.rows; ++i)
+	{
+		C* hist_row = histogram[i];
+		for(int j = 0; j < histogram.cols; ++j)
+		{
+			hist_row[j] = hist_row[j] / 2;
+			total += hist_row[j];
+		}
+	}
+	return histogram.rows > 0 ? (int)(total / histogram.rows) : 0;
+}
 
+// The running median in the precision of the descriptor (the double version is the reference for the single precision one)
+template<typename T>
+void UpdateRunningMedianTyped(cv::Mat_<unsigned short>& histogram, int& hist_count, cv::Mat_<T>& median, const cv::Mat_<T>& descriptor, bool update, int num_bins, double min_val, double max_val)
+{
 	double length = max_val - min_val;
 	if(length < 0)
 		length = -length;
@@ -555,14 +747,20 @@ void FaceAnalyser::UpdateRunningMedian(cv::Mat_<unsigned int>& histogram, int& h
 	// The median update
 	if(histogram.empty())
 	{
-		histogram = Mat_<unsigned int>(descriptor.cols, num_bins, (unsigned int)0);
+		histogram = Mat_<unsigned short>(descriptor.cols, num_bins, (unsigned short)0);
 		median = descriptor.clone();
 	}
 
 	if(update)
 	{
+		// Before the counts can saturate halve them, this keeps the median (approximately) the same and lets newer frames count a bit more
+		if(hist_count >= USHRT_MAX)
+		{
+			hist_count = HalveHistogram(histogram);
+		}
+
 		// Find the bins corresponding to the current descriptor
-		Mat_<double> converted_descriptor = (descriptor - min_val)*((double)num_bins)/(length);
+		Mat_<T> converted_descriptor = (descriptor - min_val)*((double)num_bins)/(length);
 
 		// Capping the top and bottom values
 		converted_descriptor.setTo(Scalar(num_bins-1), converted_descriptor > num_bins - 1);
@@ -571,8 +769,12 @@ void FaceAnalyser::UpdateRunningMedian(cv::Mat_<unsigned int>& histogram, int& h
 		// Only count the median till a certain number of frame seen?
 		for(int i = 0; i < histogram.rows; ++i)
 		{
-			int index = (int)converted_descriptor.at<double>(i);
-			histogram.at<unsigned int>(i, index)++;
+			int index = (int)converted_descriptor(i);
+			unsigned short& count = histogram.at<unsigned short>(i, index);
+			if(count < USHRT_MAX)
+			{
+				count++;
+			}
 		}
 
 		// Update the histogram count
@@ -591,13 +793,14 @@ void FaceAnalyser::UpdateRunningMedian(cv::Mat_<unsigned int>& histogram, int& h
 		// For each dimension
 		for(int i = 0; i < histogram.rows; ++i)
 		{
+			const unsigned short* hist_row = histogram[i];
 			int cummulative_sum = 0;
 			for(int j = 0; j < histogram.cols; ++j)
 			{
-				cummulative_sum += histogram.at<unsigned int>(i, j);
+				cummulative_sum += hist_row[j];
 				if(cummulative_sum > cutoff_point)
 				{
-					median.at<double>(i) = min_val + j * (length/num_bins) + (0.5*(length)/num_bins);
+					median(i) = (T)(min_val + j * (length/num_bins) + (0.5*(length)/num_bins));
 					break;
 				}
 			}
@@ -605,8 +808,82 @@ void FaceAnalyser::UpdateRunningMedian(cv::Mat_<unsigned int>& histogram, int& h
 	}
 }
 
+void FaceAnalyser::UpdateRunningMedian(cv::Mat_<unsigned short>& histogram, int& hist_count, cv::Mat_<float>& median, const cv::Mat_<float>& descriptor, bool update, int num_bins, double min_val, double max_val)
+{
+	CLM_PROFILE_SCOPE("running_median");
+	UpdateRunningMedianTyped(histogram, hist_count, median, descriptor, update, num_bins, min_val, max_val);
+}
+
+void FaceAnalyser::UpdateRunningMedian(cv::Mat_<unsigned short>& histogram, int& hist_count, cv::Mat_<double>& median, const cv::Mat_<double>& descriptor, bool update, int num_bins, double min_val, double max_val)
+{
+	UpdateRunningMedianTyped(histogram, hist_count, median, descriptor, update, num_bins, min_val, max_val);
+}
+
+// The counts of two running median histograms are added up (halving them like the update does if they would saturate) and the median is recomputed
+template<typename T>
+void MergeRunningMedianTyped(cv::Mat_<unsigned short>& histogram, int& hist_count, cv::Mat_<T>& median, const cv::Mat_<unsigned short>& other_histogram, int other_hist_count,
+	const cv::Mat_<T>& other_median, int num_bins, double min_val, double max_val)
+{
+	if(other_histogram.empty())
+	{
+		return;
+	}
+
+	if(histogram.empty())
+	{
+		histogram = other_histogram.clone();
+		hist_count = other_hist_count;
+		median = other_median.clone();
+		return;
+	}
+
+	Mat_<int> counts, other_counts;
+	histogram.convertTo(counts, CV_32S);
+	other_histogram.convertTo(other_counts, CV_32S);
+	counts += other_counts;
+
+	// With a single frame counted the median is that frame
+	Mat_<T> single_frame = hist_count > 0 ? median.clone() : other_median.clone();
+
+	hist_count += other_hist_count;
+	while(hist_count >= USHRT_MAX)
+	{
+		hist_count = HalveHistogram(counts);
+	}
+	counts.convertTo(histogram, CV_16U);
+
+	UpdateRunningMedianTyped(histogram, hist_count, median, single_frame, false, num_bins, min_val, max_val);
+}
+
+void FaceAnalyser::MergeMedians(const FaceAnalyser& other)
+{
+	for(size_t i = 0; i < hog_desc_hist.size(); ++i)
+	{
+		MergeRunningMedianTyped(this->hog_desc_hist[i], this->hog_hist_sum[i], this->hog_desc_median[i], other.hog_desc_hist[i], other.hog_hist_sum[i], other.hog_desc_median[i],
+			this->num_bins_hog, this->min_val_hog, this->max_val_hog);
+	}
+	MergeRunningMedianTyped(this->geom_desc_hist, this->geom_hist_sum, this->geom_descriptor_median, other.geom_desc_hist, other.geom_hist_sum, other.geom_descriptor_median,
+		this->num_bins_geom, this->min_val_geom, this->max_val_geom);
+
+	if(precision_check)
+	{
+		for(size_t i = 0; i < hog_desc_hist_ref.size() && i < other.hog_desc_hist_ref.size(); ++i)
+		{
+			MergeRunningMedianTyped(this->hog_desc_hist_ref[i], this->hog_hist_sum_ref[i], this->hog_desc_median_ref[i], other.hog_desc_hist_ref[i], other.hog_hist_sum_ref[i], other.hog_desc_median_ref[i],
+				this->num_bins_hog, this->min_val_hog, this->max_val_hog);
+		}
+		MergeRunningMedianTyped(this->geom_desc_hist_ref, this->geom_hist_sum_ref, this->geom_descriptor_median_ref, other.geom_desc_hist_ref, other.geom_hist_sum_ref, other.geom_descriptor_median_ref,
+			this->num_bins_geom, this->min_val_geom, this->max_val_geom);
+	}
+
+	// The frames that follow continue the counts (which frames update the HOG medians depends on them)
+	this->frames_tracking += other.frames_tracking;
+	this->frames_analysed += other.frames_analysed;
+	this->max_precision_drift = std::max(this->max_precision_drift, other.max_precision_drift);
+}
+
 
-void FaceAnalyser::ExtractMedian(cv::Mat_<unsigned int>& histogram, int hist_count, cv::Mat_<double>& median, int num_bins, double min_val, double max_val)
+void FaceAnalyser::ExtractMedian(const cv::Mat_<unsigned short>& histogram, int hist_count, cv::Mat_<double>& median, int num_bins, double min_val, double max_val) const
 {
 
 	double length = max_val - min_val;
@@ -634,16 +911,77 @@ void FaceAnalyser::ExtractMedian(cv::Mat_<unsigned int>& histogram, int hist_cou
 			int cummulative_sum = 0;
 			for(int j = 0; j < histogram.cols; ++j)
 			{
-				cummulative_sum += histogram.at<unsigned int>(i, j);
+				cummulative_sum += histogram.at<unsigned short>(i, j);
 				if(cummulative_sum > cutoff_point)
 				{
-					median.at<double>(i) = min_val + j * (max_val/num_bins) + (0.5*(length)/num_bins);
+					median.at<double>(i) = min_val + j * (length/num_bins) + (0.5*(length)/num_bins);
 					break;
 				}
 			}
 		}
 	}
 }
+// The neutral HOG of a view, if the view has not been seen yet the current frame is the best guess
+const Mat_<float>& FaceAnalyser::GetViewMedianHOG(int view) const
+{
+	if(hog_desc_median[view].empty())
+	{
+		return hog_desc_frame;
+	}
+	return hog_desc_median[view];
+}
+
+void FaceAnalyser::SetPrecisionCheck(bool check)
+{
+	precision_check = check;
+	max_precision_drift = 0;
+	ResetPrecisionReference();
+}
+
+void FaceAnalyser::ResetPrecisionReference()
+{
+	hog_desc_frame_ref.release();
+	hog_desc_median_ref = vector<Mat_<double> >(head_orientations.size());
+	hog_desc_hist_ref = vector<Mat_<unsigned short> >(head_orientations.size());
+	hog_hist_sum_ref = vector<int>(head_orientations.size(), 0);
+
+	geom_descriptor_frame_ref.release();
+	geom_descriptor_median_ref.release();
+	geom_desc_hist_ref.release();
+	geom_hist_sum_ref = 0;
+}
+
+double FaceAnalyser::GetMaxPrecisionDrift() const
+{
+	return max_precision_drift;
+}
+
+// Redo the static and dynamic predictions with the double precision models on the double precision descriptors and medians, and record the largest difference
+void FaceAnalyser::UpdatePrecisionDrift(int view, const vector<pair<string, double>>& predictions, SVR_static_lin_regressors& static_regressors, SVR_dynamic_lin_regressors& dynamic_regressors, const Mat_<double>& geom_median_ref)
+{
+	if(hog_desc_frame_ref.empty() || geom_descriptor_frame_ref.empty())
+	{
+		return;
+	}
+
+	// As with the single precision one, an unseen view uses the current frame as its neutral
+	const Mat_<double>& hog_median_ref = hog_desc_median_ref[view].empty() ? hog_desc_frame_ref : hog_desc_median_ref[view];
+
+	vector<string> names;
+	vector<double> reference;
+	static_regressors.Predict(reference, names, hog_desc_frame_ref, geom_descriptor_frame_ref);
+	dynamic_regressors.Predict(reference, names, hog_desc_frame_ref, geom_descriptor_frame_ref, hog_median_ref, geom_median_ref);
+
+	for(size_t i = 0; i < reference.size() && i < predictions.size(); ++i)
+	{
+		double drift = std::abs(predictions[i].second - reference[i]);
+		if(drift > max_precision_drift)
+		{
+			max_precision_drift = drift;
+		}
+	}
+}
+
 // Apply the current predictors to the currently stored descriptors
 vector<pair<string, double>> FaceAnalyser::PredictCurrentAUs(int view, bool dyn_correct)
 {
@@ -665,13 +1003,18 @@ vector<pair<string, double>> FaceAnalyser::PredictCurrentAUs(int view, bool dyn_
 		vector<string> svr_lin_dyn_aus;
 		vector<double> svr_lin_dyn_preds;
 
-		AU_SVR_dynamic_appearance_lin_regressors.Predict(svr_lin_dyn_preds, svr_lin_dyn_aus, hog_desc_frame, geom_descriptor_frame,  this->hog_desc_median, this->geom_descriptor_frame);
+		AU_SVR_dynamic_appearance_lin_regressors.Predict(svr_lin_dyn_preds, svr_lin_dyn_aus, hog_desc_frame, geom_descriptor_frame,  this->GetViewMedianHOG(view), this->geom_descriptor_frame);
 
 		for(size_t i = 0; i < svr_lin_dyn_preds.size(); ++i)
 		{
 			predictions.push_back(pair<string, double>(svr_lin_dyn_aus[i], svr_lin_dyn_preds[i]));
 		}
 
+		if(precision_check)
+		{
+			UpdatePrecisionDrift(view, predictions, AU_SVR_static_appearance_lin_regressors, AU_SVR_dynamic_appearance_lin_regressors, this->geom_descriptor_frame_ref);
+		}
+
 		// Correction that drags the predicion to 0 (assuming the bottom 10% of predictions are of neutral expresssions)
 		if(dyn_correct)
 		{
@@ -742,13 +1085,18 @@ vector<pair<string, double>> FaceAnalyser::PredictCurrentAUsSegmented(int view,
 		vector<string> svr_lin_dyn_aus;
 		vector<double> svr_lin_dyn_preds;
 
-		AU_SVR_dynamic_appearance_lin_regressors_seg.Predict(svr_lin_dyn_preds, svr_lin_dyn_aus, hog_desc_frame, geom_descriptor_frame, this->hog_desc_median, this->geom_descriptor_median);
+		AU_SVR_dynamic_appearance_lin_regressors_seg.Predict(svr_lin_dyn_preds, svr_lin_dyn_aus, hog_desc_frame, geom_descriptor_frame, this->GetViewMedianHOG(view), this->geom_descriptor_median);
 
 		for(size_t i = 0; i < svr_lin_dyn_preds.size(); ++i)
 		{
 			predictions.push_back(pair<string, double>(svr_lin_dyn_aus[i], svr_lin_dyn_preds[i]));
 		}
 
+		if(precision_check)
+		{
+			UpdatePrecisionDrift(view, predictions, AU_SVR_static_appearance_lin_regressors_seg, AU_SVR_dynamic_appearance_lin_regressors_seg, this->geom_descriptor_median_ref.empty() ? this->geom_descriptor_frame_ref : this->geom_descriptor_median_ref);
+		}
+
 		if(predictions.size() > 0)
 		{
 			
@@ -826,7 +1174,7 @@ vector<pair<string, double>> FaceAnalyser::PredictCurrentAUsClass(int view)
 		vector<string> svm_lin_dyn_aus;
 		vector<double> svm_lin_dyn_preds;
 
-		AU_SVM_dynamic_appearance_lin.Predict(svm_lin_dyn_preds, svm_lin_dyn_aus, hog_desc_frame, geom_descriptor_frame, this->hog_desc_median, this->geom_descriptor_median);
+		AU_SVM_dynamic_appearance_lin.Predict(svm_lin_dyn_preds, svm_lin_dyn_aus, hog_desc_frame, geom_descriptor_frame, this->GetViewMedianHOG(view), this->geom_descriptor_median);
 
 		for(size_t i = 0; i < svm_lin_dyn_aus.size(); ++i)
 		{
@@ -0,0 +1,103 @@
+#include "FaceAnalyserPool.h"
+
+#include "CLM_core.h"
+
+#include <tbb/tbb.h>
+
+using namespace Psyche;
+
+using namespace std;
+
+FaceAnalyserPool::FaceAnalyserPool(int num_slots, vector<Vec3d> orientation_bins, double scale, int width, int height, std::string au_location, std::string av_location, std::string tri_location, int max_failures)
+{
+	// Read the models only once, the copies of a fresh analyser share the (read only) model matrices but no per person state
+	if(num_slots > 0)
+	{
+		FaceAnalyser prototype(orientation_bins, scale, width, height, au_location, av_location, tri_location);
+		analysers.resize(num_slots, prototype);
+	}
+	needs_reset.resize(num_slots, 0);
+	analysed.resize(num_slots, 0);
+
+	this->max_failures = max_failures;
+}
+
+void FaceAnalyserPool::AddNextFrame(const cv::Mat& frame, const vector<CLMTracker::CLM>& clm_models, double timestamp_seconds)
+{
+	int num_slots = (int)min(analysers.size(), clm_models.size());
+
+	tbb::parallel_for(0, num_slots, [&](int slot){
+
+		analysed[slot] = 0;
+
+		const CLMTracker::CLM& clm_model = clm_models[slot];
+
+		// An uninitialised tracker or one that failed for too long is likely to pick up a different person next
+		if(!clm_model.tracking_initialised || clm_model.failures_in_a_row > max_failures)
+		{
+			needs_reset[slot] = 1;
+			return;
+		}
+
+		if(!clm_model.detection_success)
+		{
+			return;
+		}
+
+		if(needs_reset[slot])
+		{
+			analysers[slot].Reset();
+			needs_reset[slot] = 0;
+		}
+
+		analysers[slot].AddNextFrame(frame, clm_model, timestamp_seconds, false);
+		analysed[slot] = 1;
+	});
+}
+
+void FaceAnalyserPool::ResetSlot(int slot)
+{
+	needs_reset[slot] = 1;
+	analysed[slot] = 0;
+}
+
+void FaceAnalyserPool::Reset()
+{
+	for(size_t slot = 0; slot < analysers.size(); ++slot)
+	{
+		ResetSlot(slot);
+	}
+}
+
+void FaceAnalyserPool::SetAnalysisStride(int stride, double shape_change_threshold)
+{
+	for(size_t slot = 0; slot < analysers.size(); ++slot)
+	{
+		analysers[slot].SetAnalysisStride(stride, shape_change_threshold);
+	}
+}
+
+bool FaceAnalyserPool::IsSlotAnalysed(int slot) const
+{
+	return analysed[slot] != 0;
+}
+
+int FaceAnalyserPool::GetNumSlots() const
+{
+	return (int)analysers.size();
+}
+
+FaceAnalyser& FaceAnalyserPool::GetAnalyser(int slot)
+{
+	return analysers[slot];
+}
+
+size_t FaceAnalyserPool::GetNeutralModelMemory() const
+{
+	size_t num_bytes = 0;
+	for(size_t slot = 0; slot < analysers.size(); ++slot)
+	{
+		num_bytes += analysers[slot].GetNeutralModelMemory();
+	}
+	return num_bytes;
+}
@@ -5,124 +5,82 @@
 // For FHOG visualisation
 #include <dlib/opencv.h>
 
+#include <float.h>
+
 using namespace cv;
 using namespace std;
 
 namespace Psyche
 {
 
+	// The points of the 68 point model that are more stable/rigid under changes of expression (face outline, nose and eyes)
+	static const int num_rigid_points = 24;
+	static const int rigid_point_ids[num_rigid_points] = {1, 2, 3, 4, 12, 13, 14, 15, 27, 28, 29, 31, 32, 33, 34, 35, 36, 39, 40, 41, 42, 45, 46, 47};
+
 	// Pick only the more stable/rigid points under changes of expression
 	void extract_rigid_points(Mat_<double>& source_points, Mat_<double>& destination_points)
 	{
 		if(source_points.rows == 68)
 		{
-			Mat_<double> tmp_source = source_points.clone();
-			source_points = Mat_<double>();
-
-			// Push back the rigid points (some face outline, eyes, and nose)
-			//source_points.push_back(tmp_source.row(0));
-			//source_points.push_back(tmp_source.row(2));
-			//source_points.push_back(tmp_source.row(14));
-			//source_points.push_back(tmp_source.row(16));
-			//source_points.push_back(tmp_source.row(36));
-			//source_points.push_back(tmp_source.row(39));
-			//source_points.push_back(tmp_source.row(43));
-			//source_points.push_back(tmp_source.row(38));
-			//source_points.push_back(tmp_source.row(42));
-			//source_points.push_back(tmp_source.row(45));
-			//source_points.push_back(tmp_source.row(31));
-			//source_points.push_back(tmp_source.row(33));
-			//source_points.push_back(tmp_source.row(35));
-
-			source_points.push_back(tmp_source.row(1));
-			source_points.push_back(tmp_source.row(2));
-			source_points.push_back(tmp_source.row(3));
-			source_points.push_back(tmp_source.row(4));
-			source_points.push_back(tmp_source.row(12));
-			source_points.push_back(tmp_source.row(13));
-			source_points.push_back(tmp_source.row(14));
-			source_points.push_back(tmp_source.row(15));
-			source_points.push_back(tmp_source.row(27));
-			source_points.push_back(tmp_source.row(28));
-			source_points.push_back(tmp_source.row(29));
-			source_points.push_back(tmp_source.row(31));
-			source_points.push_back(tmp_source.row(32));
-			source_points.push_back(tmp_source.row(33));
-			source_points.push_back(tmp_source.row(34));
-			source_points.push_back(tmp_source.row(35));
-			source_points.push_back(tmp_source.row(36));
-			source_points.push_back(tmp_source.row(39));
-			source_points.push_back(tmp_source.row(40));
-			source_points.push_back(tmp_source.row(41));
-			source_points.push_back(tmp_source.row(42));
-			source_points.push_back(tmp_source.row(45));
-			source_points.push_back(tmp_source.row(46));
-			source_points.push_back(tmp_source.row(47));
-
-			Mat_<double> tmp_dest = destination_points.clone();
-			destination_points = Mat_<double>();
-
-			// Push back the rigid points
-			//destination_points.push_back(tmp_dest.row(0));
-			//destination_points.push_back(tmp_dest.row(2));
-			//destination_points.push_back(tmp_dest.row(14));
-			//destination_points.push_back(tmp_dest.row(16));
-			//destination_points.push_back(tmp_dest.row(36));
-			//destination_points.push_back(tmp_dest.row(39));
-			//destination_points.push_back(tmp_dest.row(43));
-			//destination_points.push_back(tmp_dest.row(38));
-			//destination_points.push_back(tmp_dest.row(42));
-			//destination_points.push_back(tmp_dest.row(45));
-			//destination_points.push_back(tmp_dest.row(31));
-			//destination_points.push_back(tmp_dest.row(33));
-			//destination_points.push_back(tmp_dest.row(35));
-
-			destination_points.push_back(tmp_dest.row(1));
-			destination_points.push_back(tmp_dest.row(2));
-			destination_points.push_back(tmp_dest.row(3));
-			destination_points.push_back(tmp_dest.row(4));
-			destination_points.push_back(tmp_dest.row(12));
-			destination_points.push_back(tmp_dest.row(13));
-			destination_points.push_back(tmp_dest.row(14));
-			destination_points.push_back(tmp_dest.row(15));
-			destination_points.push_back(tmp_dest.row(27));
-			destination_points.push_back(tmp_dest.row(28));
-			destination_points.push_back(tmp_dest.row(29));
-			destination_points.push_back(tmp_dest.row(31));
-			destination_points.push_back(tmp_dest.row(32));
-			destination_points.push_back(tmp_dest.row(33));
-			destination_points.push_back(tmp_dest.row(34));
-			destination_points.push_back(tmp_dest.row(35));
-			destination_points.push_back(tmp_dest.row(36));
-			destination_points.push_back(tmp_dest.row(39));
-			destination_points.push_back(tmp_dest.row(40));
-			destination_points.push_back(tmp_dest.row(41));
-			destination_points.push_back(tmp_dest.row(42));
-			destination_points.push_back(tmp_dest.row(45));
-			destination_points.push_back(tmp_dest.row(46));
-			destination_points.push_back(tmp_dest.row(47));
+			Mat_<double> tmp_source = source_points;
+			Mat_<double> tmp_dest = destination_points;
+
+			source_points = Mat_<double>(num_rigid_points, 2);
+			destination_points = Mat_<double>(num_rigid_points, 2);
+
+			for(int i = 0; i < num_rigid_points; ++i)
+			{
+				tmp_source.row(rigid_point_ids[i]).copyTo(source_points.row(i));
+				tmp_dest.row(rigid_point_ids[i]).copyTo(destination_points.row(i));
+			}
 		}
 	}
 
-	// Aligning a face to a common reference frame
-	void AlignFace(cv::Mat& aligned_face, const cv::Mat& frame, const CLMTracker::CLM& clm_model, bool rigid, double sim_scale, int out_width, int out_height)
+	// The destination points only depend on the mean shape of the PDM and the scale, so they can be computed once and reused
+	void ComputeAlignmentDestination(Mat_<double>& destination_points, const Mat_<double>& mean_shape, bool rigid, double sim_scale)
 	{
-		// Will warp to scaled mean shape
-		Mat_<double> similarity_normalised_shape = clm_model.pdm.mean_shape * sim_scale;
-	
+		int n = mean_shape.rows / 3;
+
 		// Discard the z component
-		similarity_normalised_shape = similarity_normalised_shape(Rect(0, 0, 1, 2*similarity_normalised_shape.rows/3)).clone();
+		if(rigid && n == 68)
+		{
+			destination_points.create(num_rigid_points, 2);
+			for(int i = 0; i < num_rigid_points; ++i)
+			{
+				destination_points(i, 0) = mean_shape(rigid_point_ids[i]) * sim_scale;
+				destination_points(i, 1) = mean_shape(rigid_point_ids[i] + n) * sim_scale;
+			}
+		}
+		else
+		{
+			destination_points.create(n, 2);
+			for(int i = 0; i < n; ++i)
+			{
+				destination_points(i, 0) = mean_shape(i) * sim_scale;
+				destination_points(i, 1) = mean_shape(i + n) * sim_scale;
+			}
+		}
+	}
+
+	// The similarity transform from the image to the reference frame
+	Matx23d ComputeAlignmentWarp(const CLMTracker::CLM& clm_model, const Mat_<double>& destination_points, int out_width, int out_height)
+	{
+		int n = clm_model.detected_landmarks.rows / 2;
+		bool rigid = destination_points.rows == num_rigid_points && n == 68;
 
-		Mat_<double> source_landmarks = clm_model.detected_landmarks.reshape(1, 2).t();
-		Mat_<double> destination_landmarks = similarity_normalised_shape.reshape(1, 2).t();
+		// Gather the source points on the stack, avoiding per frame allocations
+		int num_points = rigid ? num_rigid_points : n;
+		cv::AutoBuffer<double, 2 * 68> source_buffer(2 * num_points);
+		Mat_<double> source_landmarks(num_points, 2, (double*)source_buffer);
 
-		// Aligning only the more rigid points
-		if(rigid)
+		for(int i = 0; i < num_points; ++i)
 		{
-			extract_rigid_points(source_landmarks, destination_landmarks);
+			int id = rigid ? rigid_point_ids[i] : i;
+			source_landmarks(i, 0) = clm_model.detected_landmarks.at<double>(id);
+			source_landmarks(i, 1) = clm_model.detected_landmarks.at<double>(id + n);
 		}
 
-		Matx22d scale_rot_matrix = CLMTracker::AlignShapesWithScale(source_landmarks, destination_landmarks);
+		Matx22d scale_rot_matrix = CLMTracker::AlignShapesWithScale(source_landmarks, destination_points);
 		Matx23d warp_matrix;
 
 		warp_matrix(0,0) = scale_rot_matrix(0,0);
@@ -140,46 +98,105 @@ namespace Psyche
 		warp_matrix(0,2) = -T(0) + out_width/2;
 		warp_matrix(1,2) = -T(1) + out_height/2;
 
-		cv::warpAffine(frame, aligned_face, warp_matrix, Size(out_width, out_height), INTER_LINEAR);
+		return warp_matrix;
 	}
 
-	// Aligning a face to a common reference frame
-	void AlignFaceMask(cv::Mat& aligned_face, const cv::Mat& frame, const CLMTracker::CLM& clm_model, const Mat_<int>& triangulation, bool rigid, double sim_scale, int out_width, int out_height)
+	// Warp only from the part of the frame that maps into the output, so the cost does not depend on the input resolution
+	void WarpFaceROI(cv::Mat& aligned_face, const cv::Mat& frame, const Matx23d& warp_matrix, int out_width, int out_height)
 	{
-		// Will warp to scaled mean shape
-		Mat_<double> similarity_normalised_shape = clm_model.pdm.mean_shape * sim_scale;
-	
-		// Discard the z component
-		similarity_normalised_shape = similarity_normalised_shape(Rect(0, 0, 1, 2*similarity_normalised_shape.rows/3)).clone();
+		Matx23d inverse_warp;
+		cv::invertAffineTransform(warp_matrix, inverse_warp);
+
+		// The source area is the bounding box of the output corners mapped back to the image (with a margin for interpolation)
+		double min_x = DBL_MAX, min_y = DBL_MAX, max_x = -DBL_MAX, max_y = -DBL_MAX;
+		for(int c = 0; c < 4; ++c)
+		{
+			Vec3d corner((c % 2) * out_width, (c / 2) * out_height, 1);
+			Vec2d src = inverse_warp * corner;
+			min_x = min(min_x, src(0));
+			min_y = min(min_y, src(1));
+			max_x = max(max_x, src(0));
+			max_y = max(max_y, src(1));
+		}
 
-		Mat_<double> source_landmarks = clm_model.detected_landmarks.reshape(1, 2).t();
-		Mat_<double> destination_landmarks = similarity_normalised_shape.reshape(1, 2).t();
+		Rect roi((int)floor(min_x) - 2, (int)floor(min_y) - 2, (int)ceil(max_x - min_x) + 5, (int)ceil(max_y - min_y) + 5);
+		roi = roi & Rect(0, 0, frame.cols, frame.rows);
 
-		// Aligning only the more rigid points
-		if(rigid)
+		if(roi.area() == 0)
 		{
-			extract_rigid_points(source_landmarks, destination_landmarks);
+			aligned_face = Mat::zeros(out_height, out_width, frame.type());
+			return;
 		}
 
-		Matx22d scale_rot_matrix = CLMTracker::AlignShapesWithScale(source_landmarks, destination_landmarks);
-		Matx23d warp_matrix;
+		// Account for the offset of the region
+		Matx23d warp_roi = warp_matrix;
+		warp_roi(0,2) += warp_matrix(0,0) * roi.x + warp_matrix(0,1) * roi.y;
+		warp_roi(1,2) += warp_matrix(1,0) * roi.x + warp_matrix(1,1) * roi.y;
 
-		warp_matrix(0,0) = scale_rot_matrix(0,0);
-		warp_matrix(0,1) = scale_rot_matrix(0,1);
-		warp_matrix(1,0) = scale_rot_matrix(1,0);
-		warp_matrix(1,1) = scale_rot_matrix(1,1);
+		cv::warpAffine(frame(roi), aligned_face, warp_roi, Size(out_width, out_height), INTER_LINEAR);
+	}
 
-		double tx = clm_model.params_global[4];
-		double ty = clm_model.params_global[5];
+	// Aligning a face to a common reference frame
+	void AlignFace(cv::Mat& aligned_face, const cv::Mat& frame, const CLMTracker::CLM& clm_model, bool rigid, double sim_scale, int out_width, int out_height)
+	{
+		CLM_PROFILE_SCOPE("alignment");
+		// Will warp to scaled mean shape
+		Mat_<double> destination_landmarks;
+		ComputeAlignmentDestination(destination_landmarks, clm_model.pdm.mean_shape, rigid, sim_scale);
 
-		Vec2d T(tx, ty);
-		T = scale_rot_matrix * T;
+		Matx23d warp_matrix = ComputeAlignmentWarp(clm_model, destination_landmarks, out_width, out_height);
 
-		// Make sure centering is correct
-		warp_matrix(0,2) = -T(0) + out_width/2;
-		warp_matrix(1,2) = -T(1) + out_height/2;
+		WarpFaceROI(aligned_face, frame, warp_matrix, out_width, out_height);
+	}
+
+	// Aligning a face to a common reference frame
+	void AlignFaceMask(cv::Mat& aligned_face, const cv::Mat& frame, const CLMTracker::CLM& clm_model, const Mat_<int>& triangulation, bool rigid, double sim_scale, int out_width, int out_height)
+	{
+		// Will warp to scaled mean shape
+		Mat_<double> destination_landmarks;
+		ComputeAlignmentDestination(destination_landmarks, clm_model.pdm.mean_shape, rigid, sim_scale);
+
+		AlignFaceMask(aligned_face, frame, clm_model, triangulation, destination_landmarks, out_width, out_height);
+	}
+
+	void AlignFaceMask(cv::Mat& aligned_face, const cv::Mat& frame, const CLMTracker::CLM& clm_model, const Mat_<int>& triangulation, const Mat_<double>& alignment_destination, int out_width, int out_height)
+	{
+		AlignmentMaskCache mask_cache;
+		AlignFaceMask(aligned_face, frame, clm_model, triangulation, alignment_destination, mask_cache, out_width, out_height);
+	}
 
-		cv::warpAffine(frame, aligned_face, warp_matrix, Size(out_width, out_height), INTER_LINEAR);
+	// If two matrices have the same size and values
+	template<typename T>
+	bool SameValues(const Mat_<T>& a, const Mat_<T>& b)
+	{
+		if(a.size() != b.size())
+		{
+			return false;
+		}
+		for(int y = 0; y < a.rows; ++y)
+		{
+			const T* a_row = a[y];
+			const T* b_row = b[y];
+			for(int x = 0; x < a.cols; ++x)
+			{
+				if(a_row[x] != b_row[x])
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void AlignFaceMask(cv::Mat& aligned_face, const cv::Mat& frame, const CLMTracker::CLM& clm_model, const Mat_<int>& triangulation, const Mat_<double>& alignment_destination,
+		AlignmentMaskCache& mask_cache, int out_width, int out_height)
+	{
+		CLM_PROFILE_SCOPE("alignment");
+		Matx23d warp_matrix = ComputeAlignmentWarp(clm_model, alignment_destination, out_width, out_height);
+
+		WarpFaceROI(aligned_face, frame, warp_matrix, out_width, out_height);
+
+		Mat_<double> destination_landmarks;
 
 		// Move the destination landmarks there as well
 		Matx22d warp_matrix_2d(warp_matrix(0,0), warp_matrix(0,1), warp_matrix(1,0), warp_matrix(1,1));
@@ -206,14 +223,22 @@ namespace Psyche
 
 		destination_landmarks = Mat(destination_landmarks.t()).reshape(1, 1).t();		
 
-		CLMTracker::PAW paw(destination_landmarks, triangulation, 0, 0, aligned_face.cols-1, aligned_face.rows-1);
+		// Only the mask of the warp is needed, so it is built without the warp tables and reused while the landmarks stay the same
+		if(mask_cache.pixel_mask.rows != aligned_face.rows || mask_cache.pixel_mask.cols != aligned_face.cols ||
+			!SameValues(destination_landmarks, mask_cache.destination_landmarks) || !SameValues(triangulation, mask_cache.triangulation))
+		{
+			CLMTracker::PAW paw(destination_landmarks, triangulation, 0, 0, aligned_face.cols-1, aligned_face.rows-1, false);
+			mask_cache.destination_landmarks = destination_landmarks;
+			mask_cache.triangulation = triangulation;
+			mask_cache.pixel_mask = paw.pixel_mask;
+		}
 		
 		vector<Mat> aligned_face_channels;
 		cv::split(aligned_face, aligned_face_channels);
 
 		for(size_t i = 0; i < aligned_face_channels.size(); ++i)
 		{
-			aligned_face_channels[i] = aligned_face_channels[i].mul(paw.pixel_mask);
+			aligned_face_channels[i] = aligned_face_channels[i].mul(mask_cache.pixel_mask);
 		}
 
 		cv::merge(aligned_face_channels, aligned_face);
@@ -247,6 +272,14 @@ namespace Psyche
 	// Create a row vector Felzenszwalb HOG descriptor from a given image
 	void Extract_FHOG_descriptor(cv::Mat_<double>& descriptor, const cv::Mat& image, int& num_rows, int& num_cols, int cell_size)
 	{
+		cv::Mat_<float> descriptor_float;
+		Extract_FHOG_descriptor(descriptor_float, image, num_rows, num_cols, cell_size);
+		descriptor_float.convertTo(descriptor, CV_64F);
+	}
+
+	void Extract_FHOG_descriptor(cv::Mat_<float>& descriptor, const cv::Mat& image, int& num_rows, int& num_cols, int cell_size)
+	{
+		CLM_PROFILE_SCOPE("fhog");
 		
 		dlib::array2d<dlib::matrix<float,31,1> > hog;
 		if(image.channels() == 1)
@@ -264,15 +297,15 @@ namespace Psyche
 		num_cols = hog.nc();
 		num_rows = hog.nr();
 
-		descriptor = Mat_<double>(1, num_cols * num_rows * 31);
-		cv::MatIterator_<double> descriptor_it = descriptor.begin();
+		descriptor = Mat_<float>(1, num_cols * num_rows * 31);
+		cv::MatIterator_<float> descriptor_it = descriptor.begin();
 		for(int y = 0; y < num_cols; ++y)
 		{
 			for(int x = 0; x < num_rows; ++x)
 			{
 				for(unsigned int o = 0; o < 31; ++o)
 				{
-					*descriptor_it++ = (double)hog[y][x](o);
+					*descriptor_it++ = hog[y][x](o);
 				}
 			}
 		}
@@ -0,0 +1,154 @@
+#include "FeatureOutputs.h"
+
+#include "CLM_core.h"
+
+#include <Face_utils.h>
+
+using namespace cv;
+using namespace std;
+
+using namespace Psyche;
+
+void Psyche::WriteHOGFrame(std::ofstream& hog_file, bool good_frame, const Mat_<double>& hog_descriptor, int num_rows, int num_cols)
+{
+
+	// Using FHOGs, hence 31 channels
+	int num_channels = 31;
+
+	hog_file.write((char*)(&num_cols), 4);
+	hog_file.write((char*)(&num_rows), 4);
+	hog_file.write((char*)(&num_channels), 4);
+
+	// Not the best way to store a bool, but will be much easier to read it
+	float good_frame_float;
+	if(good_frame)
+		good_frame_float = 1;
+	else
+		good_frame_float = -1;
+
+	hog_file.write((char*)(&good_frame_float), 4);
+
+	cv::MatConstIterator_<double> descriptor_it = hog_descriptor.begin();
+
+	for(int y = 0; y < num_cols; ++y)
+	{
+		for(int x = 0; x < num_rows; ++x)
+		{
+			for(unsigned int o = 0; o < 31; ++o)
+			{
+
+				float hog_data = (float)(*descriptor_it++);
+				hog_file.write ((char*)&hog_data, 4);
+			}
+		}
+	}
+}
+
+void Psyche::ExtractAlignedFeatures(Mat& sim_warped_img, Mat_<double>& hog_descriptor, int& num_hog_rows, int& num_hog_cols, const Mat& captured_image,
+	const CLMTracker::CLM& clm_model, FaceAnalyser& face_analyser, bool analyse_aus, bool rigid, double sim_scale, int sim_size)
+{
+	if(analyse_aus)
+	{
+		face_analyser.AddNextFrame(captured_image, clm_model, 0, false);
+		face_analyser.GetLatestAlignedFace(sim_warped_img);
+		face_analyser.GetLatestHOG(hog_descriptor, num_hog_rows, num_hog_cols);
+	}
+	else
+	{
+		AlignFaceMask(sim_warped_img, captured_image, clm_model, face_analyser.GetTriangulation(), rigid, sim_scale, sim_size, sim_size);
+		Extract_FHOG_descriptor(hog_descriptor, sim_warped_img, num_hog_rows, num_hog_cols);
+	}
+}
+
+void Psyche::LandmarksRow(vector<double>& row, int frame, bool success, const Mat_<double>& detected_landmarks)
+{
+	row.clear();
+	row.push_back(frame + 1);
+	row.push_back(success);
+	row.insert(row.end(), detected_landmarks.begin(), detected_landmarks.end());
+}
+
+void Psyche::ParamsRow(vector<double>& row, int frame, bool success, const Vec6d& params_global, const Mat_<double>& params_local)
+{
+	row.clear();
+	row.push_back(frame + 1);
+	row.push_back(success);
+	row.insert(row.end(), params_global.val, params_global.val + 6);
+	row.insert(row.end(), params_local.begin(), params_local.end());
+}
+
+void Psyche::PoseRow(vector<double>& row, int frame, const Vec6d& pose)
+{
+	row.clear();
+	row.push_back(frame + 1);
+	row.push_back((float)frame * 1000/30);
+	row.push_back(1);
+	row.insert(row.end(), pose.val, pose.val + 6);
+}
+
+void TrackedFrames::Add(const CLMTracker::CLM& clm_model, bool detection_success)
+{
+	params_global.push_back(clm_model.params_global);
+	params_local.push_back(clm_model.params_local.clone());
+	successes.push_back(detection_success);
+	detected_landmarks.push_back(clm_model.detected_landmarks.clone());
+}
+
+bool Psyche::WriteAUsSecondPass(const string& aus_output, CLMTracker::FrameSource& frame_source, const TrackedFrames& tracked, CLMTracker::CLM& clm_model,
+	FaceAnalyser& face_analyser, const AUFrameFunction& after_frame)
+{
+	unique_ptr<CLMTracker::OutputSink> au_output_file;
+
+	Mat captured_image;
+	Mat_<uchar> grayscale_image;
+	vector<double> output_row;
+
+	for(size_t frame = 0; frame < tracked.params_global.size() && frame_source.Read(captured_image, grayscale_image); ++frame)
+	{
+		clm_model.detected_landmarks = tracked.detected_landmarks[frame].clone();
+		clm_model.params_local = tracked.params_local[frame].clone();
+		for(int p = 0; p < 6; ++p)
+		{
+			clm_model.params_global[p] = tracked.params_global[frame][p];
+		}
+		clm_model.detection_success = tracked.successes[frame];
+
+		face_analyser.AddNextFrame(captured_image, clm_model, 0, false);
+
+		auto au_preds = face_analyser.GetCurrentAUsCombined();
+
+		// The AU names are only known once the first prediction is made
+		if(!au_output_file)
+		{
+			vector<string> columns = {"success"};
+			for(auto au_it = au_preds.begin(); au_it != au_preds.end(); ++au_it)
+			{
+				columns.push_back(au_it->first);
+			}
+			au_output_file = CLMTracker::OpenOutputSink(aus_output, columns, CLMTracker::TrailingSpaceTextLayout());
+			if(!au_output_file)
+			{
+				return false;
+			}
+		}
+
+		output_row.clear();
+		output_row.push_back(tracked.successes[frame]);
+		for(auto au_it = au_preds.begin(); au_it != au_preds.end(); ++au_it)
+		{
+			output_row.push_back(au_it->second);
+		}
+		au_output_file->WriteRow(output_row);
+
+		if(after_frame)
+		{
+			after_frame(captured_image, clm_model);
+		}
+	}
+
+	if(au_output_file)
+	{
+		return au_output_file->Close();
+	}
+	return true;
+}
@@ -61,6 +61,11 @@ void SVM_dynamic_lin::Read(std::ifstream& stream, const std::vector<std::string>
 	{
 		this->AU_names.push_back(au_names[i]);
 	}
+
+	// Keep single precision copies of the model for the float prediction path
+	this->means.convertTo(this->means_f, CV_32F);
+	this->support_vectors.convertTo(this->support_vectors_f, CV_32F);
+	this->biases.convertTo(this->biases_f, CV_32F);
 }
 
 // Prediction using the HOG descriptor
@@ -96,6 +101,43 @@ void SVM_dynamic_lin::Predict(std::vector<double>& predictions, std::vector<std:
 			}
 		}
 
+		names = this->AU_names;
+	}
+}
+
+// Single precision prediction, halves the memory traffic compared to the double version above
+void SVM_dynamic_lin::Predict(std::vector<double>& predictions, std::vector<std::string>& names, const cv::Mat_<float>& fhog_descriptor, const cv::Mat_<float>& geom_params,  const cv::Mat_<float>& running_median,  const cv::Mat_<float>& running_median_geom)
+{
+	if(AU_names.size() > 0)
+	{
+		Mat_<float> preds;
+		if(fhog_descriptor.cols ==  this->means_f.cols)
+		{
+			preds = (fhog_descriptor - this->means_f - running_median) * this->support_vectors_f + this->biases_f;
+		}
+		else
+		{
+			Mat_<float> input;
+			cv::hconcat(fhog_descriptor, geom_params, input);
+
+			Mat_<float> run_med;
+			cv::hconcat(running_median, running_median_geom, run_med);
+
+			preds = (input - this->means_f - run_med) * this->support_vectors_f + this->biases_f;
+		}
+
+		for(int i = 0; i < preds.cols; ++i)
+		{		
+			if(preds.at<float>(i) > 0)
+			{
+				predictions.push_back(pos_classes[i]);
+			}
+			else
+			{
+				predictions.push_back(neg_classes[i]);
+			}
+		}
+
 		names = this->AU_names;
 	}
 }
\ No newline at end of file
@@ -50,6 +50,11 @@ void SVR_dynamic_lin_regressors::Read(std::ifstream& stream, const std::vector<s
 	{
 		this->AU_names.push_back(au_names[i]);
 	}
+
+	// Keep single precision copies of the model for the float prediction path
+	this->means.convertTo(this->means_f, CV_32F);
+	this->support_vectors.convertTo(this->support_vectors_f, CV_32F);
+	this->biases.convertTo(this->biases_f, CV_32F);
 }
 
 // Prediction using the HOG descriptor
@@ -79,6 +84,37 @@ void SVR_dynamic_lin_regressors::Predict(std::vector<double>& predictions, std::
 			predictions.push_back(*pred_it);
 		}
 
+		names = this->AU_names;
+	}
+}
+
+// Single precision prediction, halves the memory traffic compared to the double version above
+void SVR_dynamic_lin_regressors::Predict(std::vector<double>& predictions, std::vector<std::string>& names, const cv::Mat_<float>& fhog_descriptor, const cv::Mat_<float>& geom_params,  const cv::Mat_<float>& running_median,  const cv::Mat_<float>& running_median_geom)
+{
+	if(AU_names.size() > 0)
+	{
+
+		Mat_<float> preds;
+		if(fhog_descriptor.cols ==  this->means_f.cols)
+		{
+			preds = (fhog_descriptor - this->means_f - running_median) * this->support_vectors_f + this->biases_f;
+		}
+		else
+		{
+			Mat_<float> input;
+			cv::hconcat(fhog_descriptor, geom_params, input);
+
+			Mat_<float> run_med;
+			cv::hconcat(running_median, running_median_geom, run_med);
+
+			preds = (input - this->means_f - run_med) * this->support_vectors_f + this->biases_f;
+		}
+
+		for(MatIterator_<float> pred_it = preds.begin(); pred_it != preds.end(); ++pred_it)
+		{		
+			predictions.push_back(*pred_it);
+		}
+
 		names = this->AU_names;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef __TOOLUTILS_h_
+#define __TOOLUTILS_h_
+
+#include <string>
+#include <vector>
+
+#include <cv.h>
+
+namespace ToolUtils
+{
+	//===========================================================================
+	// Helpers of the tools that run over the bundled samples and batches of inputs (clm_bench, clm_regression, clm_batch)
+
+	// Looks for the bundled samples (videos/ and imgs/) in the working directory or above the executable (it usually lives in <source>/<build>/bin),
+	// returns an empty string if they are not found
+	std::string find_data_root(const std::string& executable_root);
+
+	// The files in a directory with one of the (lower case) extensions, sorted so that the runs are the same from run to run
+	std::vector<std::string> list_files(const std::string& directory, const std::vector<std::string>& extensions);
+
+	void to_grayscale(const cv::Mat& captured_image, cv::Mat_<uchar>& grayscale_image);
+
+  //===========================================================================
+}
+#endif
@@ -0,0 +1,70 @@
+#include "ToolUtils.h"
+
+#include <algorithm>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <filesystem.hpp>
+
+using namespace boost::filesystem;
+
+using namespace cv;
+using namespace std;
+
+string ToolUtils::find_data_root(const string& executable_root)
+{
+	vector<path> candidates;
+	candidates.push_back(current_path());
+
+	path curr = executable_root;
+	for(int i = 0; i < 4 && !curr.empty(); ++i)
+	{
+		candidates.push_back(curr);
+		curr = curr.parent_path();
+	}
+
+	for(size_t i = 0; i < candidates.size(); ++i)
+	{
+		if(exists(candidates[i] / "videos") && exists(candidates[i] / "imgs"))
+		{
+			return candidates[i].string();
+		}
+	}
+	return "";
+}
+
+vector<string> ToolUtils::list_files(const string& directory, const vector<string>& extensions)
+{
+	vector<string> files;
+
+	if(!exists(path(directory)) || !is_directory(path(directory)))
+	{
+		return files;
+	}
+
+	for(directory_iterator it(directory); it != directory_iterator(); ++it)
+	{
+		string extension = it->path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+		if(is_regular_file(it->status()) && std::find(extensions.begin(), extensions.end(), extension) != extensions.end())
+		{
+			files.push_back(it->path().string());
+		}
+	}
+
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+void ToolUtils::to_grayscale(const Mat& captured_image, Mat_<uchar>& grayscale_image)
+{
+	if(captured_image.channels() == 3)
+	{
+		cvtColor(captured_image, grayscale_image, CV_BGR2GRAY);
+	}
+	else
+	{
+		grayscale_image = captured_image.clone();
+	}
+}